@@ -133,6 +133,7 @@ void fi_util_init(void);
 void fi_util_fini(void);
 void fi_log_init(void);
 void fi_log_fini(void);
+void ofi_log_flush(void);
 void fi_param_init(void);
 void fi_param_fini(void);
 void fi_param_undefine(const struct fi_provider *provider);
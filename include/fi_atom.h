@@ -262,6 +262,13 @@ extern "C" {
 OFI_ATOMIC_DEFINE(32)
 OFI_ATOMIC_DEFINE(64)
 
+/* Full memory barrier: orders earlier stores before later loads */
+#ifdef HAVE_ATOMICS
+#define ofi_atomic_mb() atomic_thread_fence(memory_order_seq_cst)
+#else
+#define ofi_atomic_mb() __sync_synchronize()
+#endif
+
 #ifdef __cplusplus
 }
 #endif
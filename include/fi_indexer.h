@@ -37,34 +37,54 @@
 
 #include "config.h"
 
+#include <stdint.h>
 #include <sys/types.h>
 
 /*
  * Indexer - to find a structure given an index.  Synchronization
  * must be provided by the caller.  Caller must initialize the
- * indexer by setting free_list and size to 0.
+ * indexer by setting it to 0.
+ *
+ * Indices are resolved through a three level radix tree: a directory
+ * of mid-level blocks, each holding pointers to leaf arrays of entries.
+ * All levels are allocated on demand, so small tables only pay for a
+ * single leaf plus one block of each upper level.
+ *
+ * Free entries link to the next free index.  The link is stored with
+ * its low bit set, which no aligned item pointer has, so looking up a
+ * removed index returns NULL rather than the link.
  */
 
 union ofi_idx_entry {
-	void *item;
-	int   next;
+	void	  *item;
+	uintptr_t next;
 };
 
-#define OFI_IDX_INDEX_BITS 16
+#define ofi_idx_link(index)	((((uintptr_t) (index)) << 1) | 1)
+#define ofi_idx_unlink(next)	((int) ((next) >> 1))
+#define ofi_idx_is_link(entry)	((entry)->next & 1)
+
+#define OFI_IDX_INDEX_BITS 31
 #define OFI_IDX_ENTRY_BITS 10
+#define OFI_IDX_MID_BITS   10
+#define OFI_IDX_DIR_BITS   (OFI_IDX_INDEX_BITS - OFI_IDX_MID_BITS - OFI_IDX_ENTRY_BITS)
 #define OFI_IDX_ENTRY_SIZE (1 << OFI_IDX_ENTRY_BITS)
+#define OFI_IDX_MID_SIZE   (1 << OFI_IDX_MID_BITS)
+#define OFI_IDX_DIR_SIZE   (1 << OFI_IDX_DIR_BITS)
 #define OFI_IDX_ARRAY_SIZE (1 << (OFI_IDX_INDEX_BITS - OFI_IDX_ENTRY_BITS))
-#define OFI_IDX_MAX_INDEX  ((1 << OFI_IDX_INDEX_BITS) - 1)
+#define OFI_IDX_MAX_INDEX  ((int) ((1U << OFI_IDX_INDEX_BITS) - 1))
 
 struct indexer
 {
-	union ofi_idx_entry *array[OFI_IDX_ARRAY_SIZE];
+	union ofi_idx_entry ***array;	/* directory, allocated on first insert */
 	int		 free_list;
-	int		 size;	/* Array size (used): [0, OFI_IDX_ARRAY_SIZE) */
+	int		 size;	/* Leaves in use: [0, OFI_IDX_ARRAY_SIZE] */
 };
 
-#define ofi_idx_array_index(index) (index >> OFI_IDX_ENTRY_BITS)
-#define ofi_idx_entry_index(index) (index & (OFI_IDX_ENTRY_SIZE - 1))
+#define ofi_idx_array_index(index) ((index) >> OFI_IDX_ENTRY_BITS)
+#define ofi_idx_dir_index(index) ((index) >> (OFI_IDX_ENTRY_BITS + OFI_IDX_MID_BITS))
+#define ofi_idx_mid_index(index) (ofi_idx_array_index(index) & (OFI_IDX_MID_SIZE - 1))
+#define ofi_idx_entry_index(index) ((index) & (OFI_IDX_ENTRY_SIZE - 1))
 
 int ofi_idx_insert(struct indexer *idx, void *item);
 void *ofi_idx_remove(struct indexer *idx, int index);
@@ -73,12 +93,20 @@ void ofi_idx_reset(struct indexer *idx);
 
 static inline int ofi_idx_is_valid(struct indexer *idx, int index)
 {
-	return (index > 0) && (index < idx->size * OFI_IDX_ENTRY_SIZE);
+	return (index > 0) && (ofi_idx_array_index(index) < idx->size);
+}
+
+static inline union ofi_idx_entry *ofi_idx_slot(struct indexer *idx, int index)
+{
+	return idx->array[ofi_idx_dir_index(index)][ofi_idx_mid_index(index)] +
+	       ofi_idx_entry_index(index);
 }
 
 static inline void *ofi_idx_at(struct indexer *idx, int index)
 {
-	return (idx->array[ofi_idx_array_index(index)] + ofi_idx_entry_index(index))->item;
+	union ofi_idx_entry *entry = ofi_idx_slot(idx, index);
+
+	return ofi_idx_is_link(entry) ? NULL : entry->item;
 }
 
 static inline void *ofi_idx_lookup(struct indexer *idx, int index)
@@ -90,12 +118,22 @@ static inline void *ofi_idx_lookup(struct indexer *idx, int index)
  * Index map - associates a structure with an index.  Synchronization
  * must be provided by the caller.  Caller must initialize the
  * index map by setting it to 0.
+ *
+ * Uses the same radix layout as the indexer.  Each mid-level block
+ * tracks how many entries its leaves hold so that empty leaves, and
+ * then empty blocks, are released as entries are cleared.
  */
 
+struct ofi_idm_block
+{
+	void **leaf[OFI_IDX_MID_SIZE];
+	int count[OFI_IDX_MID_SIZE];
+	int used;	/* leaves allocated in this block */
+};
+
 struct index_map
 {
-	void **array[OFI_IDX_ARRAY_SIZE];
-	int count[OFI_IDX_ARRAY_SIZE];
+	struct ofi_idm_block **array;	/* directory, allocated on first set */
 };
 
 int ofi_idm_set(struct index_map *idm, int index, void *item);
@@ -105,14 +143,24 @@ void ofi_idm_reset(struct index_map *idm);
 static inline void *ofi_idm_at(struct index_map *idm, int index)
 {
 	void **entry;
-	entry = idm->array[ofi_idx_array_index(index)];
+	entry = idm->array[ofi_idx_dir_index(index)]->leaf[ofi_idx_mid_index(index)];
 	return entry[ofi_idx_entry_index(index)];
 }
 
 static inline void *ofi_idm_lookup(struct index_map *idm, int index)
 {
-	return ((index <= OFI_IDX_MAX_INDEX) && idm->array[ofi_idx_array_index(index)]) ?
-		ofi_idm_at(idm, index) : NULL;
+	struct ofi_idm_block *block;
+	void **entry;
+
+	if (index < 0 || !idm->array)
+		return NULL;
+
+	block = idm->array[ofi_idx_dir_index(index)];
+	if (!block)
+		return NULL;
+
+	entry = block->leaf[ofi_idx_mid_index(index)];
+	return entry ? entry[ofi_idx_entry_index(index)] : NULL;
 }
 
 #endif /* INDEXER_H */
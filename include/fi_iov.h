@@ -62,14 +62,51 @@ static inline size_t ofi_total_ioc_cnt(const struct fi_ioc *ioc, size_t ioc_coun
 #define OFI_COPY_IOV_TO_BUF 0
 #define OFI_COPY_BUF_TO_IOV 1
 
+/*
+ * Copies of at least ofi_copy_nt_threshold bytes use non-temporal stores,
+ * so bulk payloads do not evict the working set from the cache.  The
+ * threshold is derived from the cache size by ofi_iov_init(); until then
+ * all copies go through the cache.
+ */
+extern size_t ofi_copy_nt_threshold;
+
+void ofi_iov_init(void);
+void ofi_memcpy_nt(void *dst, const void *src, size_t len);
+
+static inline void ofi_memcpy(void *dst, const void *src, size_t len)
+{
+	if (len >= ofi_copy_nt_threshold)
+		ofi_memcpy_nt(dst, src, len);
+	else
+		memcpy(dst, src, len);
+}
+
 uint64_t ofi_copy_iov_buf(const struct iovec *iov, size_t iov_count,
 			uint64_t iov_offset, void *buf, uint64_t bufsize,
 			int dir);
 
+/* Returns the number of bytes that fit in a single iov past iov_offset */
+static inline uint64_t
+ofi_iov_copy_len(const struct iovec *iov, uint64_t iov_offset,
+		 uint64_t bufsize)
+{
+	if (iov_offset > iov->iov_len)
+		return 0;
+	return iov->iov_len - iov_offset < bufsize ?
+	       iov->iov_len - iov_offset : bufsize;
+}
+
 static inline uint64_t
 ofi_copy_to_iov(const struct iovec *iov, size_t iov_count,
 		uint64_t iov_offset, void *buf, uint64_t bufsize)
 {
+	uint64_t len;
+
+	if (iov_count == 1) {
+		len = ofi_iov_copy_len(iov, iov_offset, bufsize);
+		ofi_memcpy((char *) iov->iov_base + iov_offset, buf, len);
+		return len;
+	}
 	return ofi_copy_iov_buf(iov, iov_count, iov_offset, buf, bufsize,
 				OFI_COPY_BUF_TO_IOV);
 }
@@ -78,6 +115,13 @@ static inline uint64_t
 ofi_copy_from_iov(void *buf, uint64_t bufsize,
 		  const struct iovec *iov, size_t iov_count, uint64_t iov_offset)
 {
+	uint64_t len;
+
+	if (iov_count == 1) {
+		len = ofi_iov_copy_len(iov, iov_offset, bufsize);
+		ofi_memcpy(buf, (char *) iov->iov_base + iov_offset, len);
+		return len;
+	}
 	return ofi_copy_iov_buf(iov, iov_count, iov_offset, buf, bufsize,
 				OFI_COPY_IOV_TO_BUF);
 }
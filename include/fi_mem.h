@@ -40,6 +40,7 @@
 #include <string.h>
 #include <fi_list.h>
 #include <fi_osd.h>
+#include <fi_topo.h>
 
 
 #ifdef INCLUDE_VALGRIND
@@ -150,6 +151,7 @@ struct util_buf_pool {
 	util_buf_region_alloc_hndlr alloc_hndlr;
 	util_buf_region_free_hndlr free_hndlr;
 	void *ctx;
+	int numa_node;
 };
 
 struct util_buf_region {
@@ -170,12 +172,25 @@ union util_buf {
 	uint8_t data[0];
 };
 
+/* create buffer pool whose regions prefer memory on numa_node */
+struct util_buf_pool *util_buf_pool_create_node_ex(size_t size, size_t alignment,
+						   size_t max_cnt, size_t chunk_cnt,
+						   util_buf_region_alloc_hndlr alloc_hndlr,
+						   util_buf_region_free_hndlr free_hndlr,
+						   void *pool_ctx, int numa_node);
+
 /* create buffer pool with alloc/free handlers */
-struct util_buf_pool *util_buf_pool_create_ex(size_t size, size_t alignment,
-					      size_t max_cnt, size_t chunk_cnt,
-					      util_buf_region_alloc_hndlr alloc_hndlr,
-					      util_buf_region_free_hndlr free_hndlr,
-					      void *pool_ctx);
+static inline struct util_buf_pool *
+util_buf_pool_create_ex(size_t size, size_t alignment,
+			size_t max_cnt, size_t chunk_cnt,
+			util_buf_region_alloc_hndlr alloc_hndlr,
+			util_buf_region_free_hndlr free_hndlr,
+			void *pool_ctx)
+{
+	return util_buf_pool_create_node_ex(size, alignment, max_cnt, chunk_cnt,
+					    alloc_hndlr, free_hndlr, pool_ctx,
+					    OFI_NUMA_ANY);
+}
 
 /* create buffer pool */
 static inline struct util_buf_pool *util_buf_pool_create(size_t size,
@@ -93,6 +93,7 @@ static inline void name ## _free(struct name *cq)		\
 #define ofi_cirque_windex(cq)		((cq)->wcnt & (cq)->size_mask)
 #define ofi_cirque_head(cq)		(&(cq)->buf[ofi_cirque_rindex(cq)])
 #define ofi_cirque_tail(cq)		(&(cq)->buf[ofi_cirque_windex(cq)])
+#define ofi_cirque_get(cq, i)		(&(cq)->buf[((cq)->rcnt + (i)) & (cq)->size_mask])
 #define ofi_cirque_insert(cq, x)	(cq)->buf[(cq)->wcnt++ & (cq)->size_mask] = x
 #define ofi_cirque_remove(cq)		(&(cq)->buf[(cq)->rcnt++ & (cq)->size_mask])
 #define ofi_cirque_discard(cq)		((cq)->rcnt++)
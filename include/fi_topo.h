@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _FI_TOPO_H_
+#define _FI_TOPO_H_
+
+#include "config.h"
+
+#include <stddef.h>
+
+#include <rdma/fabric.h>
+#include <rdma/providers/fi_prov.h>
+
+
+/*
+ * NUMA topology, discovered from sysfs on first use.  Nodes are numbered
+ * as the kernel numbers them.  Hosts with a single node, or where the
+ * topology cannot be read, report one node and placement does nothing.
+ */
+#define OFI_NUMA_ANY	(-1)
+
+/*
+ * FI_THREAD_PLACEMENT selects where provider helper threads run:
+ * none   - leave placement to the OS
+ * buffer - the node of the thread creating the helper, where the
+ *          application is likely to have allocated its buffers
+ * device - the node of the NIC, falling back to buffer if unknown
+ */
+enum ofi_topo_policy {
+	OFI_TOPO_POLICY_NONE,
+	OFI_TOPO_POLICY_BUFFER,
+	OFI_TOPO_POLICY_DEVICE,
+};
+
+int ofi_topo_node_cnt(void);
+int ofi_topo_cpu_node(int cpu);
+int ofi_topo_cur_node(void);
+
+/* NUMA node of a network or RDMA device, or of the interface owning
+ * a local address, OFI_NUMA_ANY if unknown */
+struct sockaddr;
+
+int ofi_topo_dev_node(const char *name);
+int ofi_topo_addr_node(const struct sockaddr *addr);
+int ofi_topo_info_node(const struct fi_info *info);
+
+/* Applies FI_THREAD_PLACEMENT given the node of the device in use */
+int ofi_topo_select_node(int dev_node);
+
+/* Prefer node for pages backing [addr, addr + len) not yet touched */
+int ofi_topo_bind_mem(void *addr, size_t len, int node);
+
+
+/*
+ * Records where a helper thread was asked to run and where it did run.
+ * The creating thread fills in the name and node; the helper calls
+ * ofi_thread_place() when it starts and ofi_thread_report() before it
+ * exits, which logs the CPUs it ran on.
+ */
+struct ofi_thread_place {
+	const char	*name;
+	int		node;
+	int		start_cpu;
+	int		end_cpu;
+};
+
+static inline void ofi_thread_place_init(struct ofi_thread_place *place,
+					 const char *name, int node)
+{
+	place->name = name;
+	place->node = node;
+	place->start_cpu = -1;
+	place->end_cpu = -1;
+}
+
+void ofi_thread_place(const struct fi_provider *prov,
+		      struct ofi_thread_place *place);
+void ofi_thread_report(const struct fi_provider *prov,
+		       struct ofi_thread_place *place);
+
+/* Binds the calling thread to a list of CPUs: "first[-last[:stride]],..." */
+int ofi_thread_set_cpus(const char *cpulist);
+
+#endif /* _FI_TOPO_H_ */
@@ -54,6 +54,7 @@
 #include <fi_mem.h>
 #include <fi_rbuf.h>
 #include <fi_signal.h>
+#include <fi_topo.h>
 #include <fi_enosys.h>
 #include <fi_osd.h>
 #include <fi_indexer.h>
@@ -274,6 +275,9 @@ struct util_cq {
 
 	struct util_comp_cirq	*cirq;
 	fi_addr_t		*src;
+	/* Free cirq slots promised to completions written later, under
+	 * cq_lock.  Writers must leave this many slots free. */
+	size_t			reserved;
 
 	struct slist		err_list;
 	fi_cq_read_func		read_entry;
@@ -336,18 +340,30 @@ int ofi_cntr_cleanup(struct util_cntr *cntr);
 /*
  * AV / addressing
  */
+/*
+ * Reverse (address to index) lookup table used for FI_SOURCE.  Open
+ * addressing with linear probing, keyed by a hash of the address bytes.
+ * The table doubles once it becomes half full.
+ */
 struct util_av_hash_entry {
+	uint32_t		hash;
 	int			index;
-	int			next;
 };
 
 struct util_av_hash {
 	struct util_av_hash_entry *table;
-	int			free_list;
-	int			slots;
-	int			total_count;
+	size_t			size;
+	size_t			used;
 };
 
+/*
+ * Address storage grows on demand by adding chunks, each one as large as
+ * the AV before it was added.  Entries never move once inserted, so an
+ * fi_addr_t and the address pointer returned for it remain valid while
+ * the AV grows.
+ */
+#define UTIL_AV_MAX_CHUNKS	32
+
 struct util_av {
 	struct fid_av		av_fid;
 	struct util_domain	*domain;
@@ -362,13 +378,13 @@ struct util_av {
 	size_t			addrlen;
 	ssize_t			free_list;
 	struct util_av_hash	hash;
-	void			*data;
+	int			chunk_shift;
+	void			*data[UTIL_AV_MAX_CHUNKS];
 	struct dlist_entry	ep_list;
 };
 
 struct util_av_attr {
 	size_t			addrlen;
-	size_t			overhead;
 	uint64_t		flags;
 };
 
@@ -377,9 +393,9 @@ int ofi_av_init(struct util_domain *domain,
 	       struct util_av *av, void *context);
 int ofi_av_close(struct util_av *av);
 
-int ofi_av_insert_addr(struct util_av *av, const void *addr, int slot, int *index);
-int ofi_av_remove_addr(struct util_av *av, int slot, int index);
-int ofi_av_lookup_index(struct util_av *av, const void *addr, int slot);
+int ofi_av_insert_addr(struct util_av *av, const void *addr, int *index);
+int ofi_av_remove_addr(struct util_av *av, int index);
+int ofi_av_lookup_index(struct util_av *av, const void *addr);
 int ofi_av_bind(struct fid *av_fid, struct fid *eq_fid, uint64_t flags);
 void ofi_av_write_event(struct util_av *av, uint64_t data,
 			int err, void *context);
@@ -419,9 +435,26 @@ enum util_cmap_state {
 	CMAP_CONNREQ_RECV,
 	CMAP_ACCEPT,
 	CMAP_CONNECTED,
+	/* Being torn down to make room for other connections */
+	CMAP_EVICTING,
 	CMAP_SHUTDOWN,
 };
 
+/*
+ * Eviction is a handshake so that no data in flight is lost.  The evicting
+ * side sends a request and stops using the connection.  The peer stops as
+ * well, waits for its own operations on the connection to complete and
+ * acks.  Once its own operations complete, the evicting side closes the
+ * connection, which shuts down the peer's end.
+ */
+enum util_cmap_evict_state {
+	CMAP_EVICT_NONE,
+	CMAP_EVICT_REQ_SENT,
+	CMAP_EVICT_ACK_PENDING,
+	CMAP_EVICT_ACK_SENT,
+	CMAP_EVICT_CLOSE_PENDING,
+};
+
 struct util_cmap_handle {
 	struct util_cmap *cmap;
 	enum util_cmap_state state;
@@ -433,6 +466,15 @@ struct util_cmap_handle {
 	uint64_t remote_key;
 	fi_addr_t fi_addr;
 	struct util_cmap_peer *peer;
+	/* On lru_list while connected, on evict_list while evicting.  Sends
+	 * only stamp last_use, the least recently used handle is looked for
+	 * when a connection has to be evicted. */
+	struct dlist_entry lru_entry;
+	uint64_t last_use;
+	enum util_cmap_evict_state evict_state;
+	/* Set if the connection replaces one that was evicted */
+	uint8_t reconnect;
+	uint64_t connect_start;
 };
 
 struct util_cmap_peer {
@@ -449,6 +491,7 @@ typedef int (*ofi_cmap_connect_func)(struct util_ep *cmap,
 typedef void *(*ofi_cmap_event_handler_func)(void *arg);
 typedef int (*ofi_cmap_signal_func)(struct util_ep *ep, void *context,
 				    enum ofi_cmap_signal signal);
+typedef int (*ofi_cmap_handle_query_func)(struct util_cmap_handle *handle);
 
 struct util_cmap_attr {
 	void 				*name;
@@ -458,14 +501,40 @@ struct util_cmap_attr {
 	ofi_cmap_connect_func 		connect;
 	ofi_cmap_event_handler_func	event_handler;
 	ofi_cmap_signal_func		signal;
+	/* Connection cap, 0 for none.  Connections that are not idle are
+	 * never evicted, so the cap may be exceeded until they are. */
+	size_t				max_conn;
+	/* Required if max_conn is set.  idle returns nonzero if the handle
+	 * has no operations in flight.  evict_req and evict_ack send the
+	 * eviction messages to the peer and return 0 on success. */
+	ofi_cmap_handle_query_func	idle;
+	ofi_cmap_handle_query_func	evict_req;
+	ofi_cmap_handle_query_func	evict_ack;
+	/* Node the event handler thread runs on, OFI_NUMA_ANY for any */
+	int				numa_node;
+};
+
+struct util_cmap_stats {
+	uint64_t connects;
+	uint64_t accepts;
+	uint64_t evictions;
+	uint64_t remote_evictions;
+	uint64_t reconnects;
+	/* Time from a connection request to the connection being usable */
+	uint64_t connect_time_us;
+	uint64_t reconnect_time_us;
+	uint64_t reconnect_time_max_us;
 };
 
 struct util_cmap {
 	struct util_ep *ep;
 	struct util_av *av;
 
-	/* cmap handles that correspond to addresses in AV */
+	/* cmap handles that correspond to addresses in AV, grown with it */
 	struct util_cmap_handle **handles_av;
+	/* Set for AV addresses whose connection was evicted */
+	uint8_t *evicted_av;
+	size_t handles_av_cnt;
 
 	/* Store all cmap handles (inclusive of handles_av) in an indexer.
 	 * This allows reverse lookup of the handle using the index. */
@@ -474,8 +543,14 @@ struct util_cmap {
 	struct ofi_key_idx key_idx;
 
 	struct dlist_entry peer_list;
+	struct dlist_entry lru_list;
+	struct dlist_entry evict_list;
+	uint64_t use_cnt;
+	size_t handle_cnt;
+	struct util_cmap_stats stats;
 	struct util_cmap_attr attr;
 	pthread_t event_handler_thread;
+	struct ofi_thread_place place;
 	fastlock_t lock;
 };
 
@@ -492,7 +567,13 @@ int ofi_cmap_process_connreq(struct util_cmap *cmap, void *addr,
 			     struct util_cmap_handle **handle);
 void ofi_cmap_process_shutdown(struct util_cmap *cmap,
 			       struct util_cmap_handle *handle);
+void ofi_cmap_process_evict_req(struct util_cmap *cmap,
+				struct util_cmap_handle *handle);
+void ofi_cmap_process_evict_ack(struct util_cmap *cmap,
+				struct util_cmap_handle *handle);
+void ofi_cmap_progress_evict(struct util_cmap *cmap);
 void ofi_cmap_del_handle(struct util_cmap_handle *handle);
+void ofi_cmap_del_handle_av(struct util_cmap *cmap, fi_addr_t fi_addr);
 void ofi_cmap_free(struct util_cmap *cmap);
 struct util_cmap *ofi_cmap_alloc(struct util_ep *ep,
 				 struct util_cmap_attr *attr);
@@ -532,6 +613,12 @@ struct util_wait {
 	enum fi_wait_obj	wait_obj;
 	fi_wait_signal_func	signal;
 	fi_wait_try_func	try;
+
+	/* Threads blocked (or about to block) in fi_wait.  Signals are
+	 * skipped while this is zero unless the native wait object was
+	 * handed out through FI_GETWAIT. */
+	ofi_atomic32_t		waiters;
+	int			exported;
 };
 
 int fi_wait_init(struct util_fabric *fabric, struct fi_wait_attr *attr,
@@ -547,6 +634,18 @@ struct util_wait_fd {
 int ofi_wait_fd_open(struct fid_fabric *fabric, struct fi_wait_attr *attr,
 		struct fid_wait **waitset);
 
+struct util_wait_cond {
+	struct util_wait	util_wait;
+	pthread_mutex_t		mutex;
+	pthread_cond_t		cond;
+	int			signaled;
+};
+
+int ofi_wait_cond_open(struct fid_fabric *fabric, struct fi_wait_attr *attr,
+		       struct fid_wait **waitset);
+int ofi_wait_open(struct fid_fabric *fabric, struct fi_wait_attr *attr,
+		  struct fid_wait **waitset);
+
 
 /*
  * EQ
@@ -688,6 +787,8 @@ void fid_list_remove(struct dlist_entry *fid_list, fastlock_t *lock,
 void ofi_fabric_insert(struct util_fabric *fabric);
 struct util_fabric *ofi_fabric_find(struct util_fabric_info *fabric_info);
 void ofi_fabric_remove(struct util_fabric *fabric);
+void ofi_fabric_update_gen(void);
+uint32_t ofi_fabric_get_gen(void);
 
 /*
  * Utility Providers
@@ -742,6 +843,10 @@ struct util_ns {
 	ofi_ns_service_cmp_func_t	service_cmp;
 
 	ofi_ns_is_service_wildcard_func_t is_service_wildcard;
+
+	/* Client side: persistent server connections and resolve caches */
+	struct dlist_entry	client_list;
+	pthread_mutex_t		lock;
 };
 
 struct util_ns_attr {
@@ -757,11 +862,17 @@ struct util_ns_attr {
 };
 
 int ofi_ns_init(struct util_ns_attr *attr, struct util_ns *ns);
+void ofi_ns_fini(struct util_ns *ns);
 void ofi_ns_start_server(struct util_ns *ns);
 void ofi_ns_stop_server(struct util_ns *ns);
 int ofi_ns_add_local_name(struct util_ns *ns, void *service, void *name);
+int ofi_ns_add_local_names(struct util_ns *ns, void *services, void *names,
+			   size_t count);
 int ofi_ns_del_local_name(struct util_ns *ns, void *service, void *name);
 void *ofi_ns_resolve_name(struct util_ns *ns, const char *server,
 			  void *service);
+int ofi_ns_resolve_names(struct util_ns *ns, const char *server,
+			 void *services, void *names, int *status,
+			 size_t count);
 
 #endif
@@ -59,6 +59,23 @@ extern void (*ofi_atomic_swap_handlers[OFI_SWAP_OP_LAST][FI_DATATYPE_LAST])
 int ofi_atomic_valid(const struct fi_provider *prov,
 		     enum fi_datatype datatype, enum fi_op op, uint64_t flags);
 
+/*
+ * SIMD level used by the element-wise write and read-write handlers.
+ * ofi_atomic_init() selects the widest level the CPU supports; SCALAR
+ * disables the vector kernels.
+ */
+enum ofi_atomic_isa {
+	OFI_ATOMIC_ISA_SCALAR,
+	OFI_ATOMIC_ISA_BASE,
+	OFI_ATOMIC_ISA_AVX2,
+	OFI_ATOMIC_ISA_AVX512,
+};
+
+extern int ofi_atomic_isa;
+
+void ofi_atomic_init(void);
+int ofi_atomic_isa_supported(enum ofi_atomic_isa isa);
+
 
 #ifdef __cplusplus
 }
@@ -158,6 +158,17 @@ RXM_INI ;
 #  define RXM_INIT NULL
 #endif
 
+#if (HAVE_PERF) && (HAVE_PERF_DL)
+#  define PERF_INI FI_EXT_INI
+#  define PERF_INIT NULL
+#elif (HAVE_PERF)
+#  define PERF_INI INI_SIG(fi_perf_ini)
+#  define PERF_INIT fi_perf_ini()
+PERF_INI ;
+#else
+#  define PERF_INIT NULL
+#endif
+
 #if (HAVE_RXD) && (HAVE_RXD_DL)
 #  define RXD_INI FI_EXT_INI
 #  define RXD_INIT NULL
@@ -176,9 +176,9 @@ enum {
 	FI_ADDR_GNI,
 	FI_ADDR_BGQ,
 	FI_ADDR_MLX,
-    FI_ADDR_DPDK,
 	FI_ADDR_STR,		/* formatted char * */
 	FI_ADDR_PSMX2,		/* uint64_t[2] */
+	FI_ADDR_DPDK,		/* uint8_t[6] MAC, uint16_t queue */
 };
 
 #define FI_ADDR_UNSPEC		((uint64_t) -1)
@@ -275,7 +275,7 @@ enum {
 	FI_PROTO_MLX,
 	FI_PROTO_NETWORKDIRECT,
 	FI_PROTO_PSMX2,
-    FI_PROTO_DPDK,
+	FI_PROTO_DPDK,
 };
 
 /* Mode bits */
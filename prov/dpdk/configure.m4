@@ -0,0 +1,25 @@
+dnl Configury specific to the libfabric dpdk provider
+
+dnl Called to configure this provider
+dnl
+dnl Arguments:
+dnl
+dnl $1: action if configured successfully
+dnl $2: action if not configured successfully
+dnl
+AC_DEFUN([FI_DPDK_CONFIGURE],[
+	# Determine if we can support the dpdk provider
+	dpdk_happy=0
+	AS_IF([test x"$enable_dpdk" != x"no"],
+	      [FI_PKG_CHECK_MODULES([DPDK], [libdpdk >= 19.11],
+			[dpdk_CPPFLAGS=$DPDK_CFLAGS
+			 dpdk_LIBS=$DPDK_LIBS
+			 dpdk_happy=1],
+			[dpdk_happy=0])
+	      ])
+
+	AC_SUBST(dpdk_CPPFLAGS)
+	AC_SUBST(dpdk_LIBS)
+
+	AS_IF([test $dpdk_happy -eq 1], [$1], [$2])
+])
@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef _DPDK_H_
+#define _DPDK_H_
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <rte_config.h>
+#include <rte_eal.h>
+#include <rte_ethdev.h>
+#include <rte_ether.h>
+#include <rte_lcore.h>
+#include <rte_mbuf.h>
+#include <rte_mempool.h>
+#include <rte_ring.h>
+
+#include <rdma/fabric.h>
+#include <rdma/fi_cm.h>
+#include <rdma/fi_domain.h>
+#include <rdma/fi_endpoint.h>
+#include <rdma/fi_eq.h>
+#include <rdma/fi_errno.h>
+
+#include <fi.h>
+#include <fi_enosys.h>
+#include <fi_iov.h>
+#include <fi_list.h>
+#include <fi_rbuf.h>
+#include <fi_util.h>
+
+
+#define DPDK_MAJOR_VERSION 1
+#define DPDK_MINOR_VERSION 0
+
+
+extern struct fi_provider dpdk_prov;
+extern struct util_prov dpdk_util_prov;
+extern struct fi_info dpdk_info;
+
+extern char *dpdk_eal_args;
+extern int dpdk_mbuf_cnt;
+extern int dpdk_rx_ring_size;
+
+
+/*
+ * Datagrams are carried directly in Ethernet frames using the IEEE local
+ * experimental ethertype.  A short header following the Ethernet header
+ * names the destination and source queues, so several endpoints can
+ * share a port, and carries the payload length, since short frames are
+ * padded on the wire.
+ */
+#define DPDK_ETHER_TYPE		0x88B5
+#define DPDK_QID_ANY		UINT16_MAX
+#define DPDK_MAX_QUEUES		64
+#define DPDK_IOV_LIMIT		4
+#define DPDK_BURST		32
+#define DPDK_RING_DESC		1024
+
+struct dpdk_hdr {
+	struct rte_ether_addr	dst;
+	struct rte_ether_addr	src;
+	rte_be16_t		ether_type;
+	rte_be16_t		dst_qid;
+	rte_be16_t		src_qid;
+	rte_be16_t		len;
+};
+
+#define DPDK_MAX_MSG_SIZE \
+	(RTE_ETHER_MTU - sizeof(struct dpdk_hdr) + RTE_ETHER_HDR_LEN)
+
+/* Matches the FI_ADDR_DPDK format: MAC followed by a big endian queue */
+struct dpdk_addr {
+	struct rte_ether_addr	mac;
+	rte_be16_t		qid;
+};
+
+int dpdk_eal_init(void);
+
+int dpdk_fabric(struct fi_fabric_attr *attr, struct fid_fabric **fabric,
+		void *context);
+
+
+/*
+ * A domain owns one ethdev port.  The port has a single receive queue,
+ * polled by whichever endpoint is progressing, which hands packets to
+ * the ring of the endpoint named in the header.  Every endpoint owns a
+ * transmit queue, so threads driving separate endpoints never contend
+ * on transmit.
+ */
+struct dpdk_ep;
+
+struct dpdk_domain {
+	struct util_domain	util_domain;
+	uint16_t		port_id;
+	uint16_t		queue_cnt;
+	struct rte_ether_addr	mac;
+	struct rte_mempool	*pool;
+	fastlock_t		rx_lock;
+	struct dpdk_ep		*ep[DPDK_MAX_QUEUES]; /* protected by rx_lock */
+};
+
+int dpdk_domain_open(struct fid_fabric *fabric, struct fi_info *info,
+		     struct fid_domain **dom, void *context);
+void dpdk_domain_rx(struct dpdk_domain *domain);
+
+int dpdk_av_open(struct fid_domain *domain_fid, struct fi_av_attr *attr,
+		 struct fid_av **av, void *context);
+int dpdk_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
+		 struct fid_cq **cq, void *context);
+
+
+struct dpdk_ep_entry {
+	void			*context;
+	struct iovec		iov[DPDK_IOV_LIMIT];
+	uint8_t			iov_count;
+};
+
+OFI_DECLARE_CIRQUE(struct dpdk_ep_entry, dpdk_rx_cirq);
+
+typedef void (*dpdk_rx_comp_func)(struct dpdk_ep *ep, void *context,
+		size_t len, const struct dpdk_addr *addr);
+typedef void (*dpdk_tx_comp_func)(struct dpdk_ep *ep, void *context);
+
+struct dpdk_ep {
+	struct util_ep		util_ep;
+	struct dpdk_domain	*domain;
+	dpdk_rx_comp_func	rx_comp;
+	dpdk_tx_comp_func	tx_comp;
+	struct dpdk_rx_cirq	*rxq;	 /* protected by rx_cq lock */
+	struct rte_ring		*rx_ring; /* filled by dpdk_domain_rx */
+	struct rte_mbuf		*tx_pkts[DPDK_BURST]; /* protected by tx_cq lock */
+	uint16_t		tx_cnt;
+	struct dpdk_addr	addr;
+	uint16_t		qid;
+	int			is_enabled;
+};
+
+int dpdk_endpoint(struct fid_domain *domain, struct fi_info *info,
+		  struct fid_ep **ep, void *context);
+
+#endif /* _DPDK_H_ */
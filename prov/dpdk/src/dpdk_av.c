@@ -0,0 +1,212 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "dpdk.h"
+
+
+static int dpdk_av_verify_insert(struct util_av *av, uint64_t flags)
+{
+	if ((av->flags & FI_EVENT) && !av->eq) {
+		FI_WARN(av->prov, FI_LOG_AV, "no EQ bound to AV\n");
+		return -FI_ENOEQ;
+	}
+
+	if (flags & ~(FI_MORE)) {
+		FI_WARN(av->prov, FI_LOG_AV, "unsupported flags\n");
+		return -FI_EBADFLAGS;
+	}
+
+	return 0;
+}
+
+static int dpdk_av_insert_addr(struct util_av *av, const struct dpdk_addr *addr,
+			       fi_addr_t *fi_addr)
+{
+	int ret, index = -1;
+
+	if (!rte_is_zero_ether_addr(&addr->mac) &&
+	    rte_be_to_cpu_16(addr->qid) < DPDK_MAX_QUEUES) {
+		fastlock_acquire(&av->lock);
+		ret = ofi_av_insert_addr(av, addr, &index);
+		fastlock_release(&av->lock);
+	} else {
+		ret = -FI_EADDRNOTAVAIL;
+		FI_WARN(av->prov, FI_LOG_AV, "invalid address\n");
+	}
+
+	if (fi_addr)
+		*fi_addr = !ret ? index : FI_ADDR_NOTAVAIL;
+	return ret;
+}
+
+static int dpdk_av_insert(struct fid_av *av_fid, const void *addr, size_t count,
+			  fi_addr_t *fi_addr, uint64_t flags, void *context)
+{
+	const struct dpdk_addr *dpdk_addr = addr;
+	struct util_av *av;
+	int ret, success_cnt = 0;
+	size_t i;
+
+	av = container_of(av_fid, struct util_av, av_fid);
+	ret = dpdk_av_verify_insert(av, flags);
+	if (ret)
+		return ret;
+
+	FI_DBG(av->prov, FI_LOG_AV, "inserting %zu addresses\n", count);
+	for (i = 0; i < count; i++) {
+		ret = dpdk_av_insert_addr(av, &dpdk_addr[i],
+					  fi_addr ? &fi_addr[i] : NULL);
+		if (!ret)
+			success_cnt++;
+		else if (av->eq)
+			ofi_av_write_event(av, i, -ret, context);
+	}
+
+	FI_DBG(av->prov, FI_LOG_AV, "%d addresses successful\n", success_cnt);
+	if (av->eq) {
+		ofi_av_write_event(av, success_cnt, 0, context);
+		ret = 0;
+	} else {
+		ret = success_cnt;
+	}
+	return ret;
+}
+
+static int dpdk_av_remove(struct fid_av *av_fid, fi_addr_t *fi_addr,
+			  size_t count, uint64_t flags)
+{
+	struct util_av *av;
+	int i, index, ret;
+
+	av = container_of(av_fid, struct util_av, av_fid);
+	if (flags) {
+		FI_WARN(av->prov, FI_LOG_AV, "invalid flags\n");
+		return -FI_EINVAL;
+	}
+
+	for (i = count - 1; i >= 0; i--) {
+		index = (int) fi_addr[i];
+		ret = ofi_av_remove_addr(av, index);
+		if (ret) {
+			FI_WARN(av->prov, FI_LOG_AV,
+				"removal of fi_addr %d failed\n", index);
+		}
+	}
+	return 0;
+}
+
+static int dpdk_av_lookup(struct fid_av *av_fid, fi_addr_t fi_addr, void *addr,
+			  size_t *addrlen)
+{
+	struct util_av *av;
+	int index;
+
+	av = container_of(av_fid, struct util_av, av_fid);
+	index = (int) fi_addr;
+	if (index < 0 || (size_t) index >= av->count) {
+		FI_WARN(av->prov, FI_LOG_AV, "unknown address\n");
+		return -FI_EINVAL;
+	}
+
+	memcpy(addr, ofi_av_get_addr(av, index), MIN(*addrlen, av->addrlen));
+	*addrlen = av->addrlen;
+	return 0;
+}
+
+static const char *dpdk_av_straddr(struct fid_av *av, const void *addr,
+				   char *buf, size_t *len)
+{
+	return ofi_straddr(buf, len, FI_ADDR_DPDK, addr);
+}
+
+static struct fi_ops_av dpdk_av_ops = {
+	.size = sizeof(struct fi_ops_av),
+	.insert = dpdk_av_insert,
+	.insertsvc = fi_no_av_insertsvc,
+	.insertsym = fi_no_av_insertsym,
+	.remove = dpdk_av_remove,
+	.lookup = dpdk_av_lookup,
+	.straddr = dpdk_av_straddr,
+};
+
+static int dpdk_av_close(struct fid *av_fid)
+{
+	struct util_av *av;
+	int ret;
+
+	av = container_of(av_fid, struct util_av, av_fid.fid);
+	ret = ofi_av_close(av);
+	if (ret)
+		return ret;
+	free(av);
+	return 0;
+}
+
+static struct fi_ops dpdk_av_fi_ops = {
+	.size = sizeof(struct fi_ops),
+	.close = dpdk_av_close,
+	.bind = ofi_av_bind,
+	.control = fi_no_control,
+	.ops_open = fi_no_ops_open,
+};
+
+int dpdk_av_open(struct fid_domain *domain_fid, struct fi_av_attr *attr,
+		 struct fid_av **av, void *context)
+{
+	struct util_domain *domain;
+	struct util_av_attr util_attr;
+	struct util_av *util_av;
+	int ret;
+
+	domain = container_of(domain_fid, struct util_domain, domain_fid);
+	util_attr.addrlen = sizeof(struct dpdk_addr);
+	util_attr.flags = domain->info_domain_caps & FI_SOURCE ? FI_SOURCE : 0;
+
+	if (attr->type == FI_AV_UNSPEC)
+		attr->type = FI_AV_MAP;
+
+	util_av = calloc(1, sizeof(*util_av));
+	if (!util_av)
+		return -FI_ENOMEM;
+
+	ret = ofi_av_init(domain, attr, &util_attr, util_av, context);
+	if (ret) {
+		free(util_av);
+		return ret;
+	}
+
+	*av = &util_av->av_fid;
+	(*av)->fid.ops = &dpdk_av_fi_ops;
+	(*av)->ops = &dpdk_av_ops;
+	return 0;
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "dpdk.h"
+
+
+/*
+ * Devices driven by DPDK have no interrupt or file descriptor to block
+ * on, so blocking reads spin on the CQ, driving progress, until an entry
+ * arrives or the timeout expires.
+ */
+static ssize_t dpdk_cq_sreadfrom(struct fid_cq *cq_fid, void *buf, size_t count,
+				 fi_addr_t *src_addr, const void *cond,
+				 int timeout)
+{
+	uint64_t endtime;
+	ssize_t ret;
+
+	endtime = timeout < 0 ? 0 : fi_gettime_ms() + timeout;
+	do {
+		ret = ofi_cq_readfrom(cq_fid, buf, count, src_addr);
+		if (ret != -FI_EAGAIN)
+			return ret;
+	} while (timeout < 0 || fi_gettime_ms() < endtime);
+
+	return -FI_EAGAIN;
+}
+
+static ssize_t dpdk_cq_sread(struct fid_cq *cq_fid, void *buf, size_t count,
+			     const void *cond, int timeout)
+{
+	return dpdk_cq_sreadfrom(cq_fid, buf, count, NULL, cond, timeout);
+}
+
+static const char *dpdk_cq_strerror(struct fid_cq *cq, int prov_errno,
+				    const void *err_data, char *buf, size_t len)
+{
+	return fi_strerror(prov_errno);
+}
+
+static struct fi_ops_cq dpdk_cq_ops = {
+	.size = sizeof(struct fi_ops_cq),
+	.read = ofi_cq_read,
+	.readfrom = ofi_cq_readfrom,
+	.readerr = ofi_cq_readerr,
+	.sread = dpdk_cq_sread,
+	.sreadfrom = dpdk_cq_sreadfrom,
+	.signal = fi_no_cq_signal,
+	.strerror = dpdk_cq_strerror,
+};
+
+static int dpdk_cq_close(struct fid *fid)
+{
+	int ret;
+	struct util_cq *cq;
+
+	cq = container_of(fid, struct util_cq, cq_fid.fid);
+	ret = ofi_cq_cleanup(cq);
+	if (ret)
+		return ret;
+	free(cq);
+	return 0;
+}
+
+static struct fi_ops dpdk_cq_fi_ops = {
+	.size = sizeof(struct fi_ops),
+	.close = dpdk_cq_close,
+	.bind = fi_no_bind,
+	.control = fi_no_control,
+	.ops_open = fi_no_ops_open,
+};
+
+int dpdk_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
+		 struct fid_cq **cq_fid, void *context)
+{
+	struct fi_cq_attr cq_attr;
+	struct util_cq *cq;
+	int ret;
+
+	if (attr->wait_obj == FI_WAIT_SET) {
+		FI_WARN(&dpdk_prov, FI_LOG_CQ, "wait sets not supported\n");
+		return -FI_ENOSYS;
+	}
+
+	cq = calloc(1, sizeof(*cq));
+	if (!cq)
+		return -FI_ENOMEM;
+
+	cq_attr = *attr;
+	cq_attr.wait_obj = FI_WAIT_NONE;
+	ret = ofi_cq_init(&dpdk_prov, domain, &cq_attr, cq,
+			  &ofi_cq_progress, context);
+	if (ret) {
+		free(cq);
+		return ret;
+	}
+
+	*cq_fid = &cq->cq_fid;
+	(*cq_fid)->fid.ops = &dpdk_cq_fi_ops;
+	(*cq_fid)->ops = &dpdk_cq_ops;
+	return 0;
+}
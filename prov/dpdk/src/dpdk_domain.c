@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <pthread.h>
+
+#include "dpdk.h"
+
+
+static pthread_mutex_t dpdk_port_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t dpdk_port_used[RTE_MAX_ETHPORTS];
+
+static struct fi_ops_domain dpdk_domain_ops = {
+	.size = sizeof(struct fi_ops_domain),
+	.av_open = dpdk_av_open,
+	.cq_open = dpdk_cq_open,
+	.endpoint = dpdk_endpoint,
+	.scalable_ep = fi_no_scalable_ep,
+	.cntr_open = fi_no_cntr_open,
+	.poll_open = fi_poll_create,
+	.stx_ctx = fi_no_stx_context,
+	.srx_ctx = fi_no_srx_context,
+	.query_atomic = fi_no_query_atomic,
+};
+
+/*
+ * Poll the port's receive queue and hand each packet to the ring of the
+ * endpoint it is addressed to.  Only one thread polls at a time; others
+ * simply drain their own ring.
+ */
+void dpdk_domain_rx(struct dpdk_domain *domain)
+{
+	struct rte_mbuf *pkts[DPDK_BURST];
+	struct dpdk_hdr *hdr;
+	struct dpdk_ep *ep;
+	uint16_t i, cnt, qid;
+
+	if (fastlock_tryacquire(&domain->rx_lock))
+		return;
+
+	cnt = rte_eth_rx_burst(domain->port_id, 0, pkts, DPDK_BURST);
+	for (i = 0; i < cnt; i++) {
+		hdr = rte_pktmbuf_mtod(pkts[i], struct dpdk_hdr *);
+		if (pkts[i]->data_len < sizeof(*hdr) ||
+		    hdr->ether_type != rte_cpu_to_be_16(DPDK_ETHER_TYPE) ||
+		    pkts[i]->data_len < sizeof(*hdr) + rte_be_to_cpu_16(hdr->len))
+			goto drop;
+
+		qid = rte_be_to_cpu_16(hdr->dst_qid);
+		ep = qid < DPDK_MAX_QUEUES ? domain->ep[qid] : NULL;
+		if (ep && !rte_ring_sp_enqueue(ep->rx_ring, pkts[i]))
+			continue;
+drop:
+		rte_pktmbuf_free(pkts[i]);
+	}
+	fastlock_release(&domain->rx_lock);
+}
+
+static int dpdk_port_start(struct dpdk_domain *domain)
+{
+	struct rte_eth_dev_info dev_info;
+	struct rte_eth_conf conf;
+	uint16_t nb_rxd = DPDK_RING_DESC, nb_txd = DPDK_RING_DESC, q;
+	int socket, ret;
+
+	ret = rte_eth_dev_info_get(domain->port_id, &dev_info);
+	if (ret)
+		goto err;
+
+	domain->queue_cnt = MIN(dev_info.max_tx_queues, DPDK_MAX_QUEUES);
+	memset(&conf, 0, sizeof conf);
+	ret = rte_eth_dev_configure(domain->port_id, 1, domain->queue_cnt,
+				    &conf);
+	if (ret)
+		goto err;
+
+	ret = rte_eth_dev_adjust_nb_rx_tx_desc(domain->port_id,
+					       &nb_rxd, &nb_txd);
+	if (ret)
+		goto err;
+
+	socket = rte_eth_dev_socket_id(domain->port_id);
+	ret = rte_eth_rx_queue_setup(domain->port_id, 0, nb_rxd, socket,
+				     NULL, domain->pool);
+	if (ret)
+		goto err;
+
+	for (q = 0; q < domain->queue_cnt; q++) {
+		ret = rte_eth_tx_queue_setup(domain->port_id, q, nb_txd,
+					     socket, NULL);
+		if (ret)
+			goto err;
+	}
+
+	ret = rte_eth_dev_start(domain->port_id);
+	if (ret)
+		goto err;
+
+	ret = rte_eth_macaddr_get(domain->port_id, &domain->mac);
+	if (ret) {
+		rte_eth_dev_stop(domain->port_id);
+		goto err;
+	}
+	return 0;
+err:
+	FI_WARN(&dpdk_prov, FI_LOG_DOMAIN, "unable to start port %u: %s\n",
+		domain->port_id, rte_strerror(-ret));
+	return ret;
+}
+
+static int dpdk_port_get(struct dpdk_domain *domain, const char *name)
+{
+	char pool_name[RTE_MEMPOOL_NAMESIZE];
+	int ret;
+
+	ret = rte_eth_dev_get_port_by_name(name, &domain->port_id);
+	if (ret) {
+		FI_WARN(&dpdk_prov, FI_LOG_DOMAIN, "unknown port %s\n", name);
+		return -FI_ENODEV;
+	}
+
+	pthread_mutex_lock(&dpdk_port_lock);
+	if (dpdk_port_used[domain->port_id]) {
+		FI_WARN(&dpdk_prov, FI_LOG_DOMAIN, "port %s in use\n", name);
+		ret = -FI_EBUSY;
+		goto unlock;
+	}
+
+	snprintf(pool_name, sizeof pool_name, "fi_dpdk_%u", domain->port_id);
+	domain->pool = rte_pktmbuf_pool_create(pool_name, dpdk_mbuf_cnt,
+				MIN(dpdk_mbuf_cnt / 16, RTE_MEMPOOL_CACHE_MAX_SIZE),
+				0, RTE_MBUF_DEFAULT_BUF_SIZE,
+				rte_eth_dev_socket_id(domain->port_id));
+	if (!domain->pool) {
+		FI_WARN(&dpdk_prov, FI_LOG_DOMAIN,
+			"unable to allocate mbuf pool: %s\n",
+			rte_strerror(rte_errno));
+		ret = -FI_ENOMEM;
+		goto unlock;
+	}
+
+	ret = dpdk_port_start(domain);
+	if (ret) {
+		rte_mempool_free(domain->pool);
+		goto unlock;
+	}
+	dpdk_port_used[domain->port_id] = 1;
+unlock:
+	pthread_mutex_unlock(&dpdk_port_lock);
+	return ret;
+}
+
+static void dpdk_port_put(struct dpdk_domain *domain)
+{
+	pthread_mutex_lock(&dpdk_port_lock);
+	rte_eth_dev_stop(domain->port_id);
+	rte_mempool_free(domain->pool);
+	dpdk_port_used[domain->port_id] = 0;
+	pthread_mutex_unlock(&dpdk_port_lock);
+}
+
+static int dpdk_domain_close(fid_t fid)
+{
+	int ret;
+	struct dpdk_domain *domain;
+
+	domain = container_of(fid, struct dpdk_domain, util_domain.domain_fid.fid);
+	ret = ofi_domain_close(&domain->util_domain);
+	if (ret)
+		return ret;
+
+	dpdk_port_put(domain);
+	fastlock_destroy(&domain->rx_lock);
+	free(domain);
+	return 0;
+}
+
+static struct fi_ops dpdk_domain_fi_ops = {
+	.size = sizeof(struct fi_ops),
+	.close = dpdk_domain_close,
+	.bind = fi_no_bind,
+	.control = fi_no_control,
+	.ops_open = fi_no_ops_open,
+};
+
+int dpdk_domain_open(struct fid_fabric *fabric, struct fi_info *info,
+		     struct fid_domain **domain_fid, void *context)
+{
+	struct dpdk_domain *domain;
+	int ret;
+
+	ret = ofi_prov_check_info(&dpdk_util_prov, fabric->api_version, info);
+	if (ret)
+		return ret;
+
+	domain = calloc(1, sizeof(*domain));
+	if (!domain)
+		return -FI_ENOMEM;
+
+	ret = dpdk_port_get(domain, info->domain_attr->name);
+	if (ret)
+		goto err1;
+
+	ret = ofi_domain_init(fabric, info, &domain->util_domain, context);
+	if (ret)
+		goto err2;
+
+	fastlock_init(&domain->rx_lock);
+	*domain_fid = &domain->util_domain.domain_fid;
+	(*domain_fid)->fid.ops = &dpdk_domain_fi_ops;
+	(*domain_fid)->ops = &dpdk_domain_ops;
+	return 0;
+err2:
+	dpdk_port_put(domain);
+err1:
+	free(domain);
+	return ret;
+}
@@ -0,0 +1,639 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "dpdk.h"
+
+
+/*
+ * Must hold domain rx_lock.  Passing DPDK_QID_ANY selects the first
+ * unused queue on the port.
+ */
+static int dpdk_ep_assign_qid(struct dpdk_ep *ep, uint16_t qid)
+{
+	struct dpdk_domain *domain = ep->domain;
+
+	if (qid == DPDK_QID_ANY) {
+		for (qid = 0; qid < domain->queue_cnt && domain->ep[qid]; qid++)
+			;
+		if (qid == domain->queue_cnt)
+			return -FI_ENOSPC;
+	} else if (qid >= domain->queue_cnt) {
+		return -FI_EINVAL;
+	} else if (domain->ep[qid]) {
+		return domain->ep[qid] == ep ? 0 : -FI_EADDRINUSE;
+	}
+
+	if (ep->qid != DPDK_QID_ANY)
+		domain->ep[ep->qid] = NULL;
+	domain->ep[qid] = ep;
+	ep->qid = qid;
+	ep->addr.qid = rte_cpu_to_be_16(qid);
+	return 0;
+}
+
+static int dpdk_ep_set_addr(struct dpdk_ep *ep, const void *addr,
+			    size_t addrlen)
+{
+	const struct dpdk_addr *dpdk_addr = addr;
+	uint16_t qid = DPDK_QID_ANY;
+	int ret;
+
+	if (addr) {
+		if (addrlen < sizeof(*dpdk_addr))
+			return -FI_EINVAL;
+		if (!rte_is_zero_ether_addr(&dpdk_addr->mac) &&
+		    !rte_is_same_ether_addr(&dpdk_addr->mac, &ep->domain->mac))
+			return -FI_EADDRNOTAVAIL;
+		qid = rte_be_to_cpu_16(dpdk_addr->qid);
+	}
+
+	fastlock_acquire(&ep->domain->rx_lock);
+	ret = dpdk_ep_assign_qid(ep, qid);
+	fastlock_release(&ep->domain->rx_lock);
+	if (ret) {
+		FI_WARN(&dpdk_prov, FI_LOG_EP_CTRL, "unable to use queue %u: %s\n",
+			qid, fi_strerror(-ret));
+	}
+	return ret;
+}
+
+static int dpdk_setname(fid_t fid, void *addr, size_t addrlen)
+{
+	struct dpdk_ep *ep;
+
+	ep = container_of(fid, struct dpdk_ep, util_ep.ep_fid.fid);
+	if (ep->is_enabled)
+		return -FI_EOPBADSTATE;
+
+	FI_DBG(&dpdk_prov, FI_LOG_EP_CTRL, "%s\n", ofi_hex_str(addr, addrlen));
+	return dpdk_ep_set_addr(ep, addr, addrlen);
+}
+
+static int dpdk_getname(fid_t fid, void *addr, size_t *addrlen)
+{
+	struct dpdk_ep *ep;
+	size_t len;
+
+	ep = container_of(fid, struct dpdk_ep, util_ep.ep_fid.fid);
+	len = *addrlen;
+	*addrlen = sizeof(ep->addr);
+	if (len < sizeof(ep->addr))
+		return -FI_ETOOSMALL;
+
+	memcpy(addr, &ep->addr, sizeof(ep->addr));
+	return 0;
+}
+
+static struct fi_ops_cm dpdk_cm_ops = {
+	.size = sizeof(struct fi_ops_cm),
+	.setname = dpdk_setname,
+	.getname = dpdk_getname,
+	.getpeer = fi_no_getpeer,
+	.connect = fi_no_connect,
+	.listen = fi_no_listen,
+	.accept = fi_no_accept,
+	.reject = fi_no_reject,
+	.shutdown = fi_no_shutdown,
+	.join = fi_no_join,
+};
+
+static struct fi_ops_ep dpdk_ep_ops = {
+	.size = sizeof(struct fi_ops_ep),
+	.cancel = fi_no_cancel,
+	.getopt = fi_no_getopt,
+	.setopt = fi_no_setopt,
+	.tx_ctx = fi_no_tx_ctx,
+	.rx_ctx = fi_no_rx_ctx,
+	.rx_size_left = fi_no_rx_size_left,
+	.tx_size_left = fi_no_tx_size_left,
+};
+
+
+static void dpdk_tx_comp(struct dpdk_ep *ep, void *context)
+{
+	struct fi_cq_tagged_entry *comp;
+
+	comp = ofi_cirque_tail(ep->util_ep.tx_cq->cirq);
+	comp->op_context = context;
+	comp->flags = FI_SEND;
+	comp->len = 0;
+	comp->buf = NULL;
+	comp->data = 0;
+	ofi_cirque_commit(ep->util_ep.tx_cq->cirq);
+}
+
+static void dpdk_rx_comp(struct dpdk_ep *ep, void *context, size_t len,
+			 const struct dpdk_addr *addr)
+{
+	struct fi_cq_tagged_entry *comp;
+
+	comp = ofi_cirque_tail(ep->util_ep.rx_cq->cirq);
+	comp->op_context = context;
+	comp->flags = FI_RECV;
+	comp->len = len;
+	comp->buf = NULL;
+	comp->data = 0;
+	ofi_cirque_commit(ep->util_ep.rx_cq->cirq);
+}
+
+static void dpdk_rx_src_comp(struct dpdk_ep *ep, void *context, size_t len,
+			     const struct dpdk_addr *addr)
+{
+	int index;
+
+	index = ofi_av_lookup_index(ep->util_ep.av, addr);
+	ep->util_ep.rx_cq->src[ofi_cirque_windex(ep->util_ep.rx_cq->cirq)] =
+			index < 0 ? FI_ADDR_NOTAVAIL : (fi_addr_t) index;
+	dpdk_rx_comp(ep, context, len, addr);
+}
+
+/*
+ * Must hold tx_cq lock.  Packets the device cannot accept remain queued.
+ */
+static void dpdk_flush_tx(struct dpdk_ep *ep)
+{
+	uint16_t sent;
+
+	sent = rte_eth_tx_burst(ep->domain->port_id, ep->qid,
+				ep->tx_pkts, ep->tx_cnt);
+	if (sent) {
+		memmove(&ep->tx_pkts[0], &ep->tx_pkts[sent],
+			sizeof(*ep->tx_pkts) * (ep->tx_cnt - sent));
+		ep->tx_cnt -= sent;
+	}
+}
+
+/*
+ * Must hold tx_cq lock.  The payload is copied into the frame, so the
+ * user's buffer may be reused as soon as this returns.
+ */
+static ssize_t dpdk_queue_tx(struct dpdk_ep *ep, const struct iovec *iov,
+			     size_t iov_count, fi_addr_t dest_addr,
+			     uint64_t flags)
+{
+	const struct dpdk_addr *dest;
+	struct dpdk_hdr *hdr;
+	struct rte_mbuf *m;
+	size_t len;
+
+	if (iov_count > DPDK_IOV_LIMIT)
+		return -FI_EINVAL;
+
+	len = ofi_total_iov_len(iov, iov_count);
+	if (len > DPDK_MAX_MSG_SIZE)
+		return -FI_EMSGSIZE;
+
+	if (ep->tx_cnt == DPDK_BURST) {
+		dpdk_flush_tx(ep);
+		if (ep->tx_cnt == DPDK_BURST)
+			return -FI_EAGAIN;
+	}
+
+	m = rte_pktmbuf_alloc(ep->domain->pool);
+	if (!m)
+		return -FI_EAGAIN;
+
+	hdr = (struct dpdk_hdr *) rte_pktmbuf_append(m, sizeof(*hdr) + len);
+	if (!hdr) {
+		rte_pktmbuf_free(m);
+		return -FI_EMSGSIZE;
+	}
+
+	dest = ofi_av_get_addr(ep->util_ep.av, (int) dest_addr);
+	rte_ether_addr_copy(&dest->mac, &hdr->dst);
+	rte_ether_addr_copy(&ep->addr.mac, &hdr->src);
+	hdr->ether_type = rte_cpu_to_be_16(DPDK_ETHER_TYPE);
+	hdr->dst_qid = dest->qid;
+	hdr->src_qid = ep->addr.qid;
+	hdr->len = rte_cpu_to_be_16((uint16_t) len);
+	ofi_copy_from_iov(hdr + 1, len, iov, iov_count, 0);
+
+	ep->tx_pkts[ep->tx_cnt++] = m;
+	if (!(flags & FI_MORE) || ep->tx_cnt == DPDK_BURST)
+		dpdk_flush_tx(ep);
+	return 0;
+}
+
+/*
+ * Must hold rx_cq lock.  Packets are only taken off the ring when there
+ * is both a posted receive and room in the CQ to complete it.
+ */
+static void dpdk_ep_progress_rx(struct dpdk_ep *ep)
+{
+	struct rte_mbuf *pkts[DPDK_BURST];
+	struct dpdk_ep_entry *entry;
+	struct dpdk_hdr *hdr;
+	struct dpdk_addr src;
+	unsigned int i, cnt;
+	size_t len;
+
+	cnt = MIN(ofi_cirque_usedcnt(ep->rxq),
+		  ofi_cirque_freecnt(ep->util_ep.rx_cq->cirq));
+	if (!cnt)
+		return;
+
+	cnt = rte_ring_sc_dequeue_burst(ep->rx_ring, (void **) pkts,
+					MIN(cnt, DPDK_BURST), NULL);
+	for (i = 0; i < cnt; i++) {
+		hdr = rte_pktmbuf_mtod(pkts[i], struct dpdk_hdr *);
+		entry = ofi_cirque_head(ep->rxq);
+		len = ofi_copy_to_iov(entry->iov, entry->iov_count, 0, hdr + 1,
+				      rte_be_to_cpu_16(hdr->len));
+
+		rte_ether_addr_copy(&hdr->src, &src.mac);
+		src.qid = hdr->src_qid;
+		ep->rx_comp(ep, entry->context, len, &src);
+		ofi_cirque_discard(ep->rxq);
+		rte_pktmbuf_free(pkts[i]);
+	}
+}
+
+static void dpdk_ep_progress(struct util_ep *util_ep)
+{
+	struct dpdk_ep *ep;
+
+	ep = container_of(util_ep, struct dpdk_ep, util_ep);
+	if (ep->tx_cnt) {
+		fastlock_acquire(&ep->util_ep.tx_cq->cq_lock);
+		dpdk_flush_tx(ep);
+		fastlock_release(&ep->util_ep.tx_cq->cq_lock);
+	}
+
+	dpdk_domain_rx(ep->domain);
+	if (ep->util_ep.rx_cq) {
+		fastlock_acquire(&ep->util_ep.rx_cq->cq_lock);
+		dpdk_ep_progress_rx(ep);
+		fastlock_release(&ep->util_ep.rx_cq->cq_lock);
+	}
+}
+
+static ssize_t dpdk_recvmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
+			    uint64_t flags)
+{
+	struct dpdk_ep *ep;
+	struct dpdk_ep_entry *entry;
+	ssize_t ret;
+
+	ep = container_of(ep_fid, struct dpdk_ep, util_ep.ep_fid.fid);
+	if (msg->iov_count > DPDK_IOV_LIMIT)
+		return -FI_EINVAL;
+
+	fastlock_acquire(&ep->util_ep.rx_cq->cq_lock);
+	if (ofi_cirque_isfull(ep->rxq)) {
+		ret = -FI_EAGAIN;
+		goto out;
+	}
+
+	entry = ofi_cirque_tail(ep->rxq);
+	entry->context = msg->context;
+	for (entry->iov_count = 0; entry->iov_count < msg->iov_count;
+	     entry->iov_count++) {
+		entry->iov[entry->iov_count] = msg->msg_iov[entry->iov_count];
+	}
+
+	ofi_cirque_commit(ep->rxq);
+	ret = 0;
+out:
+	fastlock_release(&ep->util_ep.rx_cq->cq_lock);
+	return ret;
+}
+
+static ssize_t dpdk_recvv(struct fid_ep *ep_fid, const struct iovec *iov,
+			  void **desc, size_t count, fi_addr_t src_addr,
+			  void *context)
+{
+	struct dpdk_ep *ep;
+	struct fi_msg msg;
+
+	ep = container_of(ep_fid, struct dpdk_ep, util_ep.ep_fid.fid);
+	msg.msg_iov = iov;
+	msg.iov_count = count;
+	msg.context = context;
+	return dpdk_recvmsg(ep_fid, &msg, ep->util_ep.rx_op_flags);
+}
+
+static ssize_t dpdk_recv(struct fid_ep *ep_fid, void *buf, size_t len,
+			 void *desc, fi_addr_t src_addr, void *context)
+{
+	struct iovec iov;
+
+	iov.iov_base = buf;
+	iov.iov_len = len;
+	return dpdk_recvv(ep_fid, &iov, &desc, 1, src_addr, context);
+}
+
+static ssize_t dpdk_sendmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
+			    uint64_t flags)
+{
+	struct dpdk_ep *ep;
+	ssize_t ret;
+
+	ep = container_of(ep_fid, struct dpdk_ep, util_ep.ep_fid.fid);
+	fastlock_acquire(&ep->util_ep.tx_cq->cq_lock);
+	if (ofi_cirque_isfull(ep->util_ep.tx_cq->cirq)) {
+		ret = -FI_EAGAIN;
+		goto out;
+	}
+
+	ret = dpdk_queue_tx(ep, msg->msg_iov, msg->iov_count, msg->addr, flags);
+	if (!ret)
+		ep->tx_comp(ep, msg->context);
+out:
+	fastlock_release(&ep->util_ep.tx_cq->cq_lock);
+	return ret;
+}
+
+static ssize_t dpdk_sendv(struct fid_ep *ep_fid, const struct iovec *iov,
+			  void **desc, size_t count, fi_addr_t dest_addr,
+			  void *context)
+{
+	struct fi_msg msg;
+
+	msg.msg_iov = iov;
+	msg.iov_count = count;
+	msg.addr = dest_addr;
+	msg.context = context;
+
+	return dpdk_sendmsg(ep_fid, &msg, 0);
+}
+
+static ssize_t dpdk_send(struct fid_ep *ep_fid, const void *buf, size_t len,
+			 void *desc, fi_addr_t dest_addr, void *context)
+{
+	struct iovec iov;
+
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+	return dpdk_sendv(ep_fid, &iov, &desc, 1, dest_addr, context);
+}
+
+static ssize_t dpdk_inject(struct fid_ep *ep_fid, const void *buf, size_t len,
+			   fi_addr_t dest_addr)
+{
+	struct dpdk_ep *ep;
+	struct iovec iov;
+	ssize_t ret;
+
+	ep = container_of(ep_fid, struct dpdk_ep, util_ep.ep_fid.fid);
+	iov.iov_base = (void *) buf;
+	iov.iov_len = len;
+
+	fastlock_acquire(&ep->util_ep.tx_cq->cq_lock);
+	ret = dpdk_queue_tx(ep, &iov, 1, dest_addr, 0);
+	fastlock_release(&ep->util_ep.tx_cq->cq_lock);
+	return ret;
+}
+
+static struct fi_ops_msg dpdk_msg_ops = {
+	.size = sizeof(struct fi_ops_msg),
+	.recv = dpdk_recv,
+	.recvv = dpdk_recvv,
+	.recvmsg = dpdk_recvmsg,
+	.send = dpdk_send,
+	.sendv = dpdk_sendv,
+	.sendmsg = dpdk_sendmsg,
+	.inject = dpdk_inject,
+	.senddata = fi_no_msg_senddata,
+	.injectdata = fi_no_msg_injectdata,
+};
+
+static void dpdk_ep_free_rx_ring(struct dpdk_ep *ep)
+{
+	void *m;
+
+	while (!rte_ring_sc_dequeue(ep->rx_ring, &m))
+		rte_pktmbuf_free(m);
+	rte_ring_free(ep->rx_ring);
+}
+
+static int dpdk_ep_close(struct fid *fid)
+{
+	struct dpdk_ep *ep;
+
+	ep = container_of(fid, struct dpdk_ep, util_ep.ep_fid.fid);
+	if (ep->util_ep.rx_cq) {
+		fid_list_remove(&ep->util_ep.rx_cq->ep_list,
+				&ep->util_ep.rx_cq->ep_list_lock,
+				&ep->util_ep.ep_fid.fid);
+	}
+
+	if (ep->util_ep.tx_cq) {
+		fid_list_remove(&ep->util_ep.tx_cq->ep_list,
+				&ep->util_ep.tx_cq->ep_list_lock,
+				&ep->util_ep.ep_fid.fid);
+		fastlock_acquire(&ep->util_ep.tx_cq->cq_lock);
+		dpdk_flush_tx(ep);
+		while (ep->tx_cnt)
+			rte_pktmbuf_free(ep->tx_pkts[--ep->tx_cnt]);
+		fastlock_release(&ep->util_ep.tx_cq->cq_lock);
+	}
+
+	fastlock_acquire(&ep->domain->rx_lock);
+	ep->domain->ep[ep->qid] = NULL;
+	fastlock_release(&ep->domain->rx_lock);
+
+	dpdk_ep_free_rx_ring(ep);
+	dpdk_rx_cirq_free(ep->rxq);
+	ofi_endpoint_close(&ep->util_ep);
+	free(ep);
+	return 0;
+}
+
+static int dpdk_ep_bind_cq(struct dpdk_ep *ep, struct util_cq *cq,
+			   uint64_t flags)
+{
+	int ret;
+
+	ret = ofi_check_bind_cq_flags(&ep->util_ep, cq, flags);
+	if (ret)
+		return ret;
+
+	if (flags & FI_TRANSMIT) {
+		ep->util_ep.tx_cq = cq;
+		ofi_atomic_inc32(&cq->ref);
+		ep->tx_comp = dpdk_tx_comp;
+
+		/* progress flushes sends queued with FI_MORE */
+		ret = fid_list_insert(&cq->ep_list,
+				      &cq->ep_list_lock,
+				      &ep->util_ep.ep_fid.fid);
+		if (ret)
+			return ret;
+	}
+
+	if (flags & FI_RECV) {
+		ep->util_ep.rx_cq = cq;
+		ofi_atomic_inc32(&cq->ref);
+		ep->rx_comp = (cq->domain->info_domain_caps & FI_SOURCE) ?
+			      dpdk_rx_src_comp : dpdk_rx_comp;
+
+		ret = fid_list_insert(&cq->ep_list,
+				      &cq->ep_list_lock,
+				      &ep->util_ep.ep_fid.fid);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int dpdk_ep_bind(struct fid *ep_fid, struct fid *bfid, uint64_t flags)
+{
+	struct dpdk_ep *ep;
+	struct util_av *av;
+	struct util_eq *eq;
+	int ret;
+
+	ret = ofi_ep_bind_valid(&dpdk_prov, bfid, flags);
+	if (ret)
+		return ret;
+
+	ep = container_of(ep_fid, struct dpdk_ep, util_ep.ep_fid.fid);
+	switch (bfid->fclass) {
+	case FI_CLASS_AV:
+		av = container_of(bfid, struct util_av, av_fid.fid);
+		ret = ofi_ep_bind_av(&ep->util_ep, av);
+		break;
+	case FI_CLASS_CQ:
+		ret = dpdk_ep_bind_cq(ep, container_of(bfid, struct util_cq,
+							cq_fid.fid), flags);
+		break;
+	case FI_CLASS_EQ:
+		eq = container_of(bfid, struct util_eq, eq_fid.fid);
+		ret = ofi_ep_bind_eq(&ep->util_ep, eq);
+		break;
+	default:
+		FI_WARN(&dpdk_prov, FI_LOG_EP_CTRL,
+			"invalid fid class\n");
+		ret = -FI_EINVAL;
+		break;
+	}
+	return ret;
+}
+
+static int dpdk_ep_ctrl(struct fid *fid, int command, void *arg)
+{
+	struct dpdk_ep *ep;
+
+	ep = container_of(fid, struct dpdk_ep, util_ep.ep_fid.fid);
+	switch (command) {
+	case FI_ENABLE:
+		if (!ep->util_ep.rx_cq || !ep->util_ep.tx_cq)
+			return -FI_ENOCQ;
+		if (!ep->util_ep.av)
+			return -FI_ENOAV;
+		ep->is_enabled = 1;
+		break;
+	default:
+		return -FI_ENOSYS;
+	}
+	return 0;
+}
+
+static struct fi_ops dpdk_ep_fi_ops = {
+	.size = sizeof(struct fi_ops),
+	.close = dpdk_ep_close,
+	.bind = dpdk_ep_bind,
+	.control = dpdk_ep_ctrl,
+	.ops_open = fi_no_ops_open,
+};
+
+static int dpdk_ep_init(struct dpdk_ep *ep, struct fi_info *info)
+{
+	char name[RTE_RING_NAMESIZE];
+	int ret;
+
+	ep->qid = DPDK_QID_ANY;
+	ep->addr.mac = ep->domain->mac;
+	ep->rxq = dpdk_rx_cirq_create(info->rx_attr->size);
+	if (!ep->rxq)
+		return -FI_ENOMEM;
+
+	/* rx_ring is filled by dpdk_domain_rx and drained by this endpoint */
+	snprintf(name, sizeof name, "fi_dpdk_%p", (void *) ep);
+	ep->rx_ring = rte_ring_create(name, rte_align32pow2(dpdk_rx_ring_size),
+				      rte_eth_dev_socket_id(ep->domain->port_id),
+				      RING_F_SP_ENQ | RING_F_SC_DEQ);
+	if (!ep->rx_ring) {
+		FI_WARN(&dpdk_prov, FI_LOG_EP_CTRL,
+			"unable to create rx ring: %s\n",
+			rte_strerror(rte_errno));
+		ret = -FI_ENOMEM;
+		goto err1;
+	}
+
+	ret = dpdk_ep_set_addr(ep, info->src_addr, info->src_addrlen);
+	if (ret)
+		goto err2;
+	return 0;
+err2:
+	rte_ring_free(ep->rx_ring);
+err1:
+	dpdk_rx_cirq_free(ep->rxq);
+	return ret;
+}
+
+int dpdk_endpoint(struct fid_domain *domain, struct fi_info *info,
+		  struct fid_ep **ep_fid, void *context)
+{
+	struct dpdk_ep *ep;
+	int ret;
+
+	ep = calloc(1, sizeof(*ep));
+	if (!ep)
+		return -FI_ENOMEM;
+
+	ret = ofi_endpoint_init(domain, &dpdk_util_prov, info, &ep->util_ep,
+				context, dpdk_ep_progress);
+	if (ret)
+		goto err1;
+
+	ep->domain = container_of(domain, struct dpdk_domain,
+				  util_domain.domain_fid);
+	ret = dpdk_ep_init(ep, info);
+	if (ret)
+		goto err2;
+
+	ep->util_ep.ep_fid.fid.ops = &dpdk_ep_fi_ops;
+	ep->util_ep.ep_fid.ops = &dpdk_ep_ops;
+	ep->util_ep.ep_fid.cm = &dpdk_cm_ops;
+	ep->util_ep.ep_fid.msg = &dpdk_msg_ops;
+
+	*ep_fid = &ep->util_ep.ep_fid;
+	return 0;
+err2:
+	ofi_endpoint_close(&ep->util_ep);
+err1:
+	free(ep);
+	return ret;
+}
@@ -0,0 +1,189 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <pthread.h>
+
+#include <prov.h>
+#include "dpdk.h"
+
+char *dpdk_eal_args = NULL;
+int dpdk_mbuf_cnt = 8191;
+int dpdk_rx_ring_size = 1024;
+
+static pthread_mutex_t dpdk_init_lock = PTHREAD_MUTEX_INITIALIZER;
+static int dpdk_eal_ret = 1;
+
+#define DPDK_EAL_MAX_ARGS	64
+
+/*
+ * The EAL is initialized on first use rather than when the provider is
+ * loaded, so applications that never select the provider do not pay for
+ * hugepage setup and device probing.  It can only be initialized once
+ * per process; the result is remembered.
+ */
+int dpdk_eal_init(void)
+{
+	char *argv[DPDK_EAL_MAX_ARGS], *args = NULL, *tok, *save;
+	int argc = 0;
+
+	pthread_mutex_lock(&dpdk_init_lock);
+	if (dpdk_eal_ret <= 0)
+		goto out;
+
+	argv[argc++] = "libfabric";
+	if (dpdk_eal_args) {
+		args = strdup(dpdk_eal_args);
+		if (!args) {
+			dpdk_eal_ret = -FI_ENOMEM;
+			goto out;
+		}
+
+		for (tok = strtok_r(args, " ", &save);
+		     tok && argc < DPDK_EAL_MAX_ARGS - 1;
+		     tok = strtok_r(NULL, " ", &save))
+			argv[argc++] = tok;
+	}
+	argv[argc] = NULL;
+
+	/* args is not freed, the EAL keeps pointers into argv */
+	if (rte_eal_init(argc, argv) < 0) {
+		FI_WARN(&dpdk_prov, FI_LOG_CORE, "rte_eal_init failed: %s\n",
+			rte_strerror(rte_errno));
+		dpdk_eal_ret = -FI_ENODEV;
+	} else {
+		dpdk_eal_ret = 0;
+	}
+out:
+	pthread_mutex_unlock(&dpdk_init_lock);
+	return dpdk_eal_ret;
+}
+
+/* One fi_info per ethdev port, the port named by the domain */
+static int dpdk_init_info(void)
+{
+	struct fi_info *head = NULL, *tail = NULL, *cur;
+	char name[RTE_ETH_NAME_MAX_LEN];
+	uint16_t port;
+
+	RTE_ETH_FOREACH_DEV(port) {
+		if (rte_eth_dev_get_name_by_port(port, name))
+			continue;
+
+		cur = fi_dupinfo(&dpdk_info);
+		if (!cur)
+			goto err;
+
+		free(cur->domain_attr->name);
+		cur->domain_attr->name = strdup(name);
+		if (!cur->domain_attr->name) {
+			fi_freeinfo(cur);
+			goto err;
+		}
+
+		if (!head)
+			head = cur;
+		else
+			tail->next = cur;
+		tail = cur;
+	}
+
+	if (!head) {
+		FI_INFO(&dpdk_prov, FI_LOG_CORE, "no DPDK ports found\n");
+		return -FI_ENODATA;
+	}
+
+	dpdk_util_prov.info = head;
+	return 0;
+err:
+	fi_freeinfo(head);
+	return -FI_ENOMEM;
+}
+
+static int dpdk_getinfo(uint32_t version, const char *node,
+			const char *service, uint64_t flags,
+			struct fi_info *hints, struct fi_info **info)
+{
+	int ret;
+
+	ret = dpdk_eal_init();
+	if (ret)
+		return -FI_ENODATA;
+
+	pthread_mutex_lock(&dpdk_init_lock);
+	ret = (dpdk_util_prov.info == &dpdk_info) ? dpdk_init_info() : 0;
+	pthread_mutex_unlock(&dpdk_init_lock);
+	if (ret)
+		return ret;
+
+	return util_getinfo(&dpdk_util_prov, version, node, service, flags,
+			    hints, info);
+}
+
+static void dpdk_fini(void)
+{
+	if (dpdk_util_prov.info != &dpdk_info)
+		fi_freeinfo((struct fi_info *) dpdk_util_prov.info);
+	dpdk_util_prov.info = &dpdk_info;
+
+	if (!dpdk_eal_ret)
+		rte_eal_cleanup();
+}
+
+struct fi_provider dpdk_prov = {
+	.name = "dpdk",
+	.version = FI_VERSION(DPDK_MAJOR_VERSION, DPDK_MINOR_VERSION),
+	.fi_version = FI_VERSION(1, 5),
+	.getinfo = dpdk_getinfo,
+	.fabric = dpdk_fabric,
+	.cleanup = dpdk_fini
+};
+
+DPDK_INI
+{
+	fi_param_define(&dpdk_prov, "eal_args", FI_PARAM_STRING,
+			"Arguments passed to rte_eal_init, separated by "
+			"spaces, e.g. \"-l 0 --vdev=net_ring0\" "
+			"(default: none)");
+	fi_param_get_str(&dpdk_prov, "eal_args", &dpdk_eal_args);
+	fi_param_define(&dpdk_prov, "mbuf_cnt", FI_PARAM_INT,
+			"Number of packet buffers allocated per domain "
+			"(default: 8191)");
+	fi_param_get_int(&dpdk_prov, "mbuf_cnt", &dpdk_mbuf_cnt);
+	fi_param_define(&dpdk_prov, "rx_ring_size", FI_PARAM_INT,
+			"Number of received packets queued per endpoint "
+			"while no receive is posted, rounded up to a "
+			"power of two (default: 1024)");
+	fi_param_get_int(&dpdk_prov, "rx_ring_size", &dpdk_rx_ring_size);
+
+	return &dpdk_prov;
+}
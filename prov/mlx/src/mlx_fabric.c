@@ -53,7 +53,7 @@ static struct fi_ops_fabric mlx_fabric_ops = {
 	.domain = mlx_domain_open,
 	.passive_ep = fi_no_passive_ep,
 	.eq_open = ofi_eq_create,
-	.wait_open = ofi_wait_fd_open,
+	.wait_open = ofi_wait_open,
 	.trywait = fi_no_trywait,
 };
 
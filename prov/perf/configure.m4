@@ -0,0 +1,16 @@
+dnl Configury specific to the libfabric perf provider
+
+dnl Called to configure this provider
+dnl
+dnl Arguments:
+dnl
+dnl $1: action if configured successfully
+dnl $2: action if not configured successfully
+dnl
+AC_DEFUN([FI_PERF_CONFIGURE],[
+       # Determine if we can support the perf provider
+       perf_h_happy=0
+       AS_IF([test x"$enable_perf" != x"no"], [perf_h_happy=1])
+       AS_IF([test $perf_h_happy -eq 1], [$1], [$2])
+])
+
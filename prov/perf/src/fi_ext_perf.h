@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _FI_EXT_PERF_H_
+#define _FI_EXT_PERF_H_
+
+/*
+ * See the fi_perf.7 man page for information about the ofi_perf provider
+ * extensions provided in this header.
+ */
+
+#include <stdint.h>
+#include <rdma/fabric.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FI_PERF_OPS_1		"perf_ops 1"
+#define FI_PERF_HIST_BUCKETS	32
+
+enum fi_perf_op {
+	FI_PERF_RECV,
+	FI_PERF_RECVV,
+	FI_PERF_RECVMSG,
+	FI_PERF_SEND,
+	FI_PERF_SENDV,
+	FI_PERF_SENDMSG,
+	FI_PERF_INJECT,
+	FI_PERF_SENDDATA,
+	FI_PERF_INJECTDATA,
+	FI_PERF_TRECV,
+	FI_PERF_TRECVV,
+	FI_PERF_TRECVMSG,
+	FI_PERF_TSEND,
+	FI_PERF_TSENDV,
+	FI_PERF_TSENDMSG,
+	FI_PERF_TINJECT,
+	FI_PERF_TSENDDATA,
+	FI_PERF_TINJECTDATA,
+	FI_PERF_READ,
+	FI_PERF_READV,
+	FI_PERF_READMSG,
+	FI_PERF_WRITE,
+	FI_PERF_WRITEV,
+	FI_PERF_WRITEMSG,
+	FI_PERF_INJECT_WRITE,
+	FI_PERF_WRITEDATA,
+	FI_PERF_INJECT_WRITEDATA,
+	FI_PERF_ATOMIC,
+	FI_PERF_ATOMICV,
+	FI_PERF_ATOMICMSG,
+	FI_PERF_INJECT_ATOMIC,
+	FI_PERF_FETCH_ATOMIC,
+	FI_PERF_FETCH_ATOMICV,
+	FI_PERF_FETCH_ATOMICMSG,
+	FI_PERF_COMPARE_ATOMIC,
+	FI_PERF_COMPARE_ATOMICV,
+	FI_PERF_COMPARE_ATOMICMSG,
+	FI_PERF_CQ_READ,
+	FI_PERF_CQ_READFROM,
+	FI_PERF_CQ_READERR,
+	FI_PERF_CQ_SREAD,
+	FI_PERF_CQ_SREADFROM,
+	FI_PERF_CNTR_READ,
+	FI_PERF_CNTR_READERR,
+	FI_PERF_CNTR_ADD,
+	FI_PERF_CNTR_SET,
+	FI_PERF_CNTR_WAIT,
+	FI_PERF_MR_REG,
+	FI_PERF_MR_CLOSE,
+	FI_PERF_AV_INSERT,
+	FI_PERF_AV_REMOVE,
+	FI_PERF_AV_LOOKUP,
+	FI_PERF_EQ_READ,
+	FI_PERF_EQ_SREAD,
+	FI_PERF_DOMAIN_OPEN,
+	FI_PERF_EP_OPEN,
+	FI_PERF_CQ_OPEN,
+	FI_PERF_CNTR_OPEN,
+	FI_PERF_AV_OPEN,
+	FI_PERF_OP_MAX
+};
+
+/*
+ * size is the number of bytes transferred by data operations and the number
+ * of entries returned by reads.  empty counts calls that returned
+ * -FI_EAGAIN, e.g. CQ reads that found no completions.  Bucket i of hist
+ * counts calls that took [2^i, 2^(i+1)) cycles.
+ */
+struct fi_perf_op_stats {
+	uint64_t		count;
+	uint64_t		empty;
+	uint64_t		size;
+	uint64_t		cycles;
+	uint64_t		hist[FI_PERF_HIST_BUCKETS];
+};
+
+struct fi_perf_stats {
+	uint64_t		cycles_per_sec;
+	struct fi_perf_op_stats	op[FI_PERF_OP_MAX];
+};
+
+struct fi_perf_ops {
+	size_t	size;
+	int	(*get_stats)(struct fid *fid, struct fi_perf_stats *stats);
+	int	(*reset)(struct fid *fid);
+	const char *(*op_name)(enum fi_perf_op op);
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FI_EXT_PERF_H_ */
@@ -0,0 +1,238 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _PERF_H_
+#define _PERF_H_
+
+#if HAVE_CONFIG_H
+#  include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <rdma/fabric.h>
+#include <rdma/fi_errno.h>
+#include <rdma/fi_atomic.h>
+#include <rdma/fi_cm.h>
+#include <rdma/fi_domain.h>
+#include <rdma/fi_endpoint.h>
+#include <rdma/fi_eq.h>
+#include <rdma/fi_rma.h>
+#include <rdma/fi_tagged.h>
+
+#include <fi.h>
+#include <fi_enosys.h>
+#include <fi_iov.h>
+#include <fi_list.h>
+#include <fi_lock.h>
+#include <fi_util.h>
+#include <ofi_atomic.h>
+
+#include "fi_ext_perf.h"
+
+#define PERF_MAJOR_VERSION 1
+#define PERF_MINOR_VERSION 0
+
+extern struct fi_provider perf_prov;
+extern struct fi_ops perf_fid_ops;
+extern struct fi_perf_ops perf_ops;
+extern int perf_report;
+
+/*
+ * Every object handed to the application wraps the object of the provider
+ * below.  The wrapped object is opened with the wrapper's fid as its
+ * context, so fids reported by the lower provider, e.g. in EQ events, can
+ * be mapped back to the wrapper.
+ *
+ * Calls are counted in the stats of the object they are made on.  The
+ * stats of endpoints, CQs and counters are private to the object, other
+ * objects count into their domain or fabric.  Counters are not atomic,
+ * so totals are approximate if one object is used by several threads.
+ */
+struct perf_fabric;
+
+struct perf_stats {
+	struct dlist_entry	entry;
+	struct fi_perf_stats	data;
+};
+
+struct perf_obj {
+	struct fid		*hfid;
+	struct perf_fabric	*fabric;
+	struct perf_stats	*stats;
+};
+
+struct perf_fabric {
+	struct fid_fabric	fabric_fid;
+	struct perf_obj		obj;
+	struct perf_stats	stats;
+	fastlock_t		lock;
+	struct dlist_entry	stats_list;
+	struct fi_perf_stats	closed;
+};
+
+struct perf_domain {
+	struct fid_domain	domain_fid;
+	struct perf_obj		obj;
+	struct perf_stats	stats;
+};
+
+struct perf_ep {
+	struct fid_ep		ep_fid;
+	struct perf_obj		obj;
+	struct perf_stats	stats;
+};
+
+struct perf_pep {
+	struct fid_pep		pep_fid;
+	struct perf_obj		obj;
+};
+
+struct perf_cq {
+	struct fid_cq		cq_fid;
+	struct perf_obj		obj;
+	struct perf_stats	stats;
+};
+
+struct perf_cntr {
+	struct fid_cntr		cntr_fid;
+	struct perf_obj		obj;
+	struct perf_stats	stats;
+};
+
+struct perf_av {
+	struct fid_av		av_fid;
+	struct perf_obj		obj;
+};
+
+struct perf_eq {
+	struct fid_eq		eq_fid;
+	struct perf_obj		obj;
+};
+
+struct perf_mr {
+	struct fid_mr		mr_fid;
+	struct perf_obj		obj;
+};
+
+static inline uint64_t perf_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	uint32_t lo, hi;
+
+	__asm__ __volatile__ ("rdtsc" : "=a" (lo), "=d" (hi));
+	return ((uint64_t) hi << 32) | lo;
+#elif defined(__aarch64__)
+	uint64_t cnt;
+
+	__asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (cnt));
+	return cnt;
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+static inline void perf_record(struct perf_stats *stats, enum fi_perf_op op,
+			       uint64_t start, ssize_t ret, size_t size)
+{
+	struct fi_perf_op_stats *op_stats = &stats->data.op[op];
+	uint64_t cycles = perf_cycles() - start;
+	int bucket;
+
+	bucket = cycles ? 63 - __builtin_clzll(cycles) : 0;
+	op_stats->count++;
+	op_stats->cycles += cycles;
+	op_stats->hist[MIN(bucket, FI_PERF_HIST_BUCKETS - 1)]++;
+	if (ret == -FI_EAGAIN)
+		op_stats->empty++;
+	else if (ret >= 0)
+		op_stats->size += size;
+}
+
+/* Time a call returning ssize_t made on behalf of obj and return its
+ * result.  size is only evaluated if the call succeeds. */
+#define PERF_CALL(obj, op, size, call)					\
+	do {								\
+		uint64_t perf_start = perf_cycles();			\
+		ssize_t perf_ret = (call);				\
+		perf_record((obj)->stats, op, perf_start, perf_ret,	\
+			    perf_ret >= 0 ? (size) : 0);		\
+		return perf_ret;					\
+	} while (0)
+
+struct perf_obj *perf_get_obj(struct fid *fid);
+
+static inline struct fid *perf_hfid(struct fid *fid)
+{
+	struct perf_obj *obj;
+
+	obj = fid ? perf_get_obj(fid) : NULL;
+	return obj ? obj->hfid : fid;
+}
+
+/* Map a fid reported by the lower provider back to its wrapper. */
+static inline struct fid *perf_wrapper_fid(struct fid *hfid)
+{
+	return (hfid && hfid->ops != &perf_fid_ops) ? hfid->context : hfid;
+}
+
+void perf_init_obj(struct perf_obj *obj, struct perf_fabric *fabric,
+		   struct fid *fid, size_t fclass, void *context);
+void perf_stats_add(struct perf_fabric *fabric, struct perf_stats *stats);
+void perf_stats_del(struct perf_fabric *fabric, struct perf_stats *stats);
+void perf_stats_report(struct perf_fabric *fabric);
+uint64_t perf_cycles_per_sec(void);
+int perf_info_to_core(struct fi_info *info, struct fi_info **core_info);
+
+int perf_fabric(struct fi_fabric_attr *attr, struct fid_fabric **fabric,
+		void *context);
+int perf_fabric_close(struct perf_fabric *fabric);
+int perf_eq_open(struct fid_fabric *fabric, struct fi_eq_attr *attr,
+		 struct fid_eq **eq, void *context);
+int perf_domain(struct fid_fabric *fabric, struct fi_info *info,
+		struct fid_domain **domain, void *context);
+int perf_passive_ep(struct fid_fabric *fabric, struct fi_info *info,
+		    struct fid_pep **pep, void *context);
+int perf_endpoint(struct fid_domain *domain, struct fi_info *info,
+		  struct fid_ep **ep, void *context);
+int perf_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
+		 struct fid_cq **cq, void *context);
+int perf_cntr_open(struct fid_domain *domain, struct fi_cntr_attr *attr,
+		   struct fid_cntr **cntr, void *context);
+
+#endif /* _PERF_H_ */
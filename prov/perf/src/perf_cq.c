@@ -0,0 +1,266 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "perf.h"
+
+static inline struct fid_cq *perf_hcq(struct perf_cq *cq)
+{
+	return container_of(cq->obj.hfid, struct fid_cq, fid);
+}
+
+static ssize_t perf_cq_read(struct fid_cq *cq, void *buf, size_t count)
+{
+	struct perf_cq *perf_cq = container_of(cq, struct perf_cq, cq_fid);
+
+	PERF_CALL(&perf_cq->obj, FI_PERF_CQ_READ, perf_ret,
+		  fi_cq_read(perf_hcq(perf_cq), buf, count));
+}
+
+static ssize_t perf_cq_readfrom(struct fid_cq *cq, void *buf, size_t count,
+				fi_addr_t *src_addr)
+{
+	struct perf_cq *perf_cq = container_of(cq, struct perf_cq, cq_fid);
+
+	PERF_CALL(&perf_cq->obj, FI_PERF_CQ_READFROM, perf_ret,
+		  fi_cq_readfrom(perf_hcq(perf_cq), buf, count, src_addr));
+}
+
+static ssize_t perf_cq_readerr(struct fid_cq *cq, struct fi_cq_err_entry *buf,
+			       uint64_t flags)
+{
+	struct perf_cq *perf_cq = container_of(cq, struct perf_cq, cq_fid);
+
+	PERF_CALL(&perf_cq->obj, FI_PERF_CQ_READERR, perf_ret,
+		  fi_cq_readerr(perf_hcq(perf_cq), buf, flags));
+}
+
+static ssize_t perf_cq_sread(struct fid_cq *cq, void *buf, size_t count,
+			     const void *cond, int timeout)
+{
+	struct perf_cq *perf_cq = container_of(cq, struct perf_cq, cq_fid);
+
+	PERF_CALL(&perf_cq->obj, FI_PERF_CQ_SREAD, perf_ret,
+		  fi_cq_sread(perf_hcq(perf_cq), buf, count, cond, timeout));
+}
+
+static ssize_t perf_cq_sreadfrom(struct fid_cq *cq, void *buf, size_t count,
+				 fi_addr_t *src_addr, const void *cond,
+				 int timeout)
+{
+	struct perf_cq *perf_cq = container_of(cq, struct perf_cq, cq_fid);
+
+	PERF_CALL(&perf_cq->obj, FI_PERF_CQ_SREADFROM, perf_ret,
+		  fi_cq_sreadfrom(perf_hcq(perf_cq), buf, count, src_addr,
+				  cond, timeout));
+}
+
+static int perf_cq_signal(struct fid_cq *cq)
+{
+	struct perf_cq *perf_cq = container_of(cq, struct perf_cq, cq_fid);
+
+	return fi_cq_signal(perf_hcq(perf_cq));
+}
+
+static const char *perf_cq_strerror(struct fid_cq *cq, int prov_errno,
+				    const void *err_data, char *buf,
+				    size_t len)
+{
+	struct perf_cq *perf_cq = container_of(cq, struct perf_cq, cq_fid);
+
+	return fi_cq_strerror(perf_hcq(perf_cq), prov_errno, err_data, buf,
+			      len);
+}
+
+static struct fi_ops_cq perf_cq_ops = {
+	.size = sizeof(struct fi_ops_cq),
+	.read = perf_cq_read,
+	.readfrom = perf_cq_readfrom,
+	.readerr = perf_cq_readerr,
+	.sread = perf_cq_sread,
+	.sreadfrom = perf_cq_sreadfrom,
+	.signal = perf_cq_signal,
+	.strerror = perf_cq_strerror,
+};
+
+int perf_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
+		 struct fid_cq **cq, void *context)
+{
+	struct perf_domain *perf_domain;
+	struct perf_cq *perf_cq;
+	struct fid_cq *hcq;
+	uint64_t start;
+	int ret;
+
+	perf_domain = container_of(domain, struct perf_domain, domain_fid);
+	perf_cq = calloc(1, sizeof(*perf_cq));
+	if (!perf_cq)
+		return -FI_ENOMEM;
+
+	start = perf_cycles();
+	ret = fi_cq_open(container_of(perf_domain->obj.hfid,
+				      struct fid_domain, fid),
+			 attr, &hcq, &perf_cq->cq_fid.fid);
+	perf_record(&perf_domain->stats, FI_PERF_CQ_OPEN, start, ret, 0);
+	if (ret) {
+		free(perf_cq);
+		return ret;
+	}
+
+	perf_init_obj(&perf_cq->obj, perf_domain->obj.fabric,
+		      &perf_cq->cq_fid.fid, FI_CLASS_CQ, context);
+	perf_cq->cq_fid.ops = &perf_cq_ops;
+	perf_cq->obj.hfid = &hcq->fid;
+	perf_cq->obj.stats = &perf_cq->stats;
+	perf_stats_add(perf_domain->obj.fabric, &perf_cq->stats);
+
+	*cq = &perf_cq->cq_fid;
+	return 0;
+}
+
+static inline struct fid_cntr *perf_hcntr(struct perf_cntr *cntr)
+{
+	return container_of(cntr->obj.hfid, struct fid_cntr, fid);
+}
+
+static uint64_t perf_cntr_read(struct fid_cntr *cntr)
+{
+	struct perf_cntr *perf_cntr;
+	uint64_t start, value;
+
+	perf_cntr = container_of(cntr, struct perf_cntr, cntr_fid);
+	start = perf_cycles();
+	value = fi_cntr_read(perf_hcntr(perf_cntr));
+	perf_record(&perf_cntr->stats, FI_PERF_CNTR_READ, start, 0, 0);
+	return value;
+}
+
+static uint64_t perf_cntr_readerr(struct fid_cntr *cntr)
+{
+	struct perf_cntr *perf_cntr;
+	uint64_t start, value;
+
+	perf_cntr = container_of(cntr, struct perf_cntr, cntr_fid);
+	start = perf_cycles();
+	value = fi_cntr_readerr(perf_hcntr(perf_cntr));
+	perf_record(&perf_cntr->stats, FI_PERF_CNTR_READERR, start, 0, 0);
+	return value;
+}
+
+static int perf_cntr_add(struct fid_cntr *cntr, uint64_t value)
+{
+	struct perf_cntr *perf_cntr;
+
+	perf_cntr = container_of(cntr, struct perf_cntr, cntr_fid);
+	PERF_CALL(&perf_cntr->obj, FI_PERF_CNTR_ADD, 0,
+		  fi_cntr_add(perf_hcntr(perf_cntr), value));
+}
+
+static int perf_cntr_set(struct fid_cntr *cntr, uint64_t value)
+{
+	struct perf_cntr *perf_cntr;
+
+	perf_cntr = container_of(cntr, struct perf_cntr, cntr_fid);
+	PERF_CALL(&perf_cntr->obj, FI_PERF_CNTR_SET, 0,
+		  fi_cntr_set(perf_hcntr(perf_cntr), value));
+}
+
+static int perf_cntr_wait(struct fid_cntr *cntr, uint64_t threshold,
+			  int timeout)
+{
+	struct perf_cntr *perf_cntr;
+
+	perf_cntr = container_of(cntr, struct perf_cntr, cntr_fid);
+	PERF_CALL(&perf_cntr->obj, FI_PERF_CNTR_WAIT, 0,
+		  fi_cntr_wait(perf_hcntr(perf_cntr), threshold, timeout));
+}
+
+static int perf_cntr_adderr(struct fid_cntr *cntr, uint64_t value)
+{
+	struct perf_cntr *perf_cntr;
+
+	perf_cntr = container_of(cntr, struct perf_cntr, cntr_fid);
+	return fi_cntr_adderr(perf_hcntr(perf_cntr), value);
+}
+
+static int perf_cntr_seterr(struct fid_cntr *cntr, uint64_t value)
+{
+	struct perf_cntr *perf_cntr;
+
+	perf_cntr = container_of(cntr, struct perf_cntr, cntr_fid);
+	return fi_cntr_seterr(perf_hcntr(perf_cntr), value);
+}
+
+static struct fi_ops_cntr perf_cntr_ops = {
+	.size = sizeof(struct fi_ops_cntr),
+	.read = perf_cntr_read,
+	.readerr = perf_cntr_readerr,
+	.add = perf_cntr_add,
+	.set = perf_cntr_set,
+	.wait = perf_cntr_wait,
+	.adderr = perf_cntr_adderr,
+	.seterr = perf_cntr_seterr,
+};
+
+int perf_cntr_open(struct fid_domain *domain, struct fi_cntr_attr *attr,
+		   struct fid_cntr **cntr, void *context)
+{
+	struct perf_domain *perf_domain;
+	struct perf_cntr *perf_cntr;
+	struct fid_cntr *hcntr;
+	uint64_t start;
+	int ret;
+
+	perf_domain = container_of(domain, struct perf_domain, domain_fid);
+	perf_cntr = calloc(1, sizeof(*perf_cntr));
+	if (!perf_cntr)
+		return -FI_ENOMEM;
+
+	start = perf_cycles();
+	ret = fi_cntr_open(container_of(perf_domain->obj.hfid,
+					struct fid_domain, fid),
+			   attr, &hcntr, &perf_cntr->cntr_fid.fid);
+	perf_record(&perf_domain->stats, FI_PERF_CNTR_OPEN, start, ret, 0);
+	if (ret) {
+		free(perf_cntr);
+		return ret;
+	}
+
+	perf_init_obj(&perf_cntr->obj, perf_domain->obj.fabric,
+		      &perf_cntr->cntr_fid.fid, FI_CLASS_CNTR, context);
+	perf_cntr->cntr_fid.ops = &perf_cntr_ops;
+	perf_cntr->obj.hfid = &hcntr->fid;
+	perf_cntr->obj.stats = &perf_cntr->stats;
+	perf_stats_add(perf_domain->obj.fabric, &perf_cntr->stats);
+
+	*cntr = &perf_cntr->cntr_fid;
+	return 0;
+}
@@ -0,0 +1,342 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "perf.h"
+
+static int perf_av_insert(struct fid_av *av, const void *addr, size_t count,
+			  fi_addr_t *fi_addr, uint64_t flags, void *context)
+{
+	struct perf_av *perf_av = container_of(av, struct perf_av, av_fid);
+
+	PERF_CALL(&perf_av->obj, FI_PERF_AV_INSERT, perf_ret,
+		  fi_av_insert(container_of(perf_av->obj.hfid, struct fid_av,
+					    fid),
+			       addr, count, fi_addr, flags, context));
+}
+
+static int perf_av_insertsvc(struct fid_av *av, const char *node,
+			     const char *service, fi_addr_t *fi_addr,
+			     uint64_t flags, void *context)
+{
+	struct perf_av *perf_av = container_of(av, struct perf_av, av_fid);
+
+	PERF_CALL(&perf_av->obj, FI_PERF_AV_INSERT, perf_ret,
+		  fi_av_insertsvc(container_of(perf_av->obj.hfid,
+					       struct fid_av, fid),
+				  node, service, fi_addr, flags, context));
+}
+
+static int perf_av_insertsym(struct fid_av *av, const char *node,
+			     size_t nodecnt, const char *service,
+			     size_t svccnt, fi_addr_t *fi_addr,
+			     uint64_t flags, void *context)
+{
+	struct perf_av *perf_av = container_of(av, struct perf_av, av_fid);
+
+	PERF_CALL(&perf_av->obj, FI_PERF_AV_INSERT, perf_ret,
+		  fi_av_insertsym(container_of(perf_av->obj.hfid,
+					       struct fid_av, fid),
+				  node, nodecnt, service, svccnt, fi_addr,
+				  flags, context));
+}
+
+static int perf_av_remove(struct fid_av *av, fi_addr_t *fi_addr, size_t count,
+			  uint64_t flags)
+{
+	struct perf_av *perf_av = container_of(av, struct perf_av, av_fid);
+
+	PERF_CALL(&perf_av->obj, FI_PERF_AV_REMOVE, count,
+		  fi_av_remove(container_of(perf_av->obj.hfid, struct fid_av,
+					    fid),
+			       fi_addr, count, flags));
+}
+
+static int perf_av_lookup(struct fid_av *av, fi_addr_t fi_addr, void *addr,
+			  size_t *addrlen)
+{
+	struct perf_av *perf_av = container_of(av, struct perf_av, av_fid);
+
+	PERF_CALL(&perf_av->obj, FI_PERF_AV_LOOKUP, 1,
+		  fi_av_lookup(container_of(perf_av->obj.hfid, struct fid_av,
+					    fid),
+			       fi_addr, addr, addrlen));
+}
+
+static const char *perf_av_straddr(struct fid_av *av, const void *addr,
+				   char *buf, size_t *len)
+{
+	struct perf_av *perf_av = container_of(av, struct perf_av, av_fid);
+
+	return fi_av_straddr(container_of(perf_av->obj.hfid, struct fid_av,
+					  fid), addr, buf, len);
+}
+
+static struct fi_ops_av perf_av_ops = {
+	.size = sizeof(struct fi_ops_av),
+	.insert = perf_av_insert,
+	.insertsvc = perf_av_insertsvc,
+	.insertsym = perf_av_insertsym,
+	.remove = perf_av_remove,
+	.lookup = perf_av_lookup,
+	.straddr = perf_av_straddr,
+};
+
+static int perf_av_open(struct fid_domain *domain, struct fi_av_attr *attr,
+			struct fid_av **av, void *context)
+{
+	struct perf_domain *perf_domain;
+	struct perf_av *perf_av;
+	struct fid_av *hav;
+	uint64_t start;
+	int ret;
+
+	perf_domain = container_of(domain, struct perf_domain, domain_fid);
+	perf_av = calloc(1, sizeof(*perf_av));
+	if (!perf_av)
+		return -FI_ENOMEM;
+
+	start = perf_cycles();
+	ret = fi_av_open(container_of(perf_domain->obj.hfid,
+				      struct fid_domain, fid),
+			 attr, &hav, &perf_av->av_fid.fid);
+	perf_record(&perf_domain->stats, FI_PERF_AV_OPEN, start, ret, 0);
+	if (ret) {
+		free(perf_av);
+		return ret;
+	}
+
+	perf_init_obj(&perf_av->obj, perf_domain->obj.fabric,
+		      &perf_av->av_fid.fid, FI_CLASS_AV, context);
+	perf_av->av_fid.ops = &perf_av_ops;
+	perf_av->obj.hfid = &hav->fid;
+	perf_av->obj.stats = &perf_domain->stats;
+
+	*av = &perf_av->av_fid;
+	return 0;
+}
+
+static struct perf_mr *perf_mr_alloc(struct perf_domain *domain)
+{
+	struct perf_mr *perf_mr;
+
+	perf_mr = calloc(1, sizeof(*perf_mr));
+	if (perf_mr) {
+		perf_init_obj(&perf_mr->obj, domain->obj.fabric,
+			      &perf_mr->mr_fid.fid, FI_CLASS_MR, NULL);
+		perf_mr->obj.stats = &domain->stats;
+	}
+	return perf_mr;
+}
+
+static void perf_mr_init(struct perf_mr *perf_mr, struct fid_mr *hmr,
+			 void *context, struct fid_mr **mr)
+{
+	perf_mr->mr_fid.fid.context = context;
+	perf_mr->mr_fid.mem_desc = hmr->mem_desc;
+	perf_mr->mr_fid.key = hmr->key;
+	perf_mr->obj.hfid = &hmr->fid;
+	*mr = &perf_mr->mr_fid;
+}
+
+static int perf_mr_reg(struct fid *fid, const void *buf, size_t len,
+		       uint64_t access, uint64_t offset, uint64_t requested_key,
+		       uint64_t flags, struct fid_mr **mr, void *context)
+{
+	struct perf_domain *perf_domain;
+	struct perf_mr *perf_mr;
+	struct fid_mr *hmr;
+	uint64_t start;
+	int ret;
+
+	perf_domain = container_of(fid, struct perf_domain, domain_fid.fid);
+	perf_mr = perf_mr_alloc(perf_domain);
+	if (!perf_mr)
+		return -FI_ENOMEM;
+
+	start = perf_cycles();
+	ret = fi_mr_reg(container_of(perf_domain->obj.hfid, struct fid_domain,
+				     fid),
+			buf, len, access, offset, requested_key, flags, &hmr,
+			&perf_mr->mr_fid.fid);
+	perf_record(&perf_domain->stats, FI_PERF_MR_REG, start, ret, len);
+	if (ret) {
+		free(perf_mr);
+		return ret;
+	}
+
+	perf_mr_init(perf_mr, hmr, context, mr);
+	return 0;
+}
+
+static int perf_mr_regv(struct fid *fid, const struct iovec *iov,
+			size_t count, uint64_t access, uint64_t offset,
+			uint64_t requested_key, uint64_t flags,
+			struct fid_mr **mr, void *context)
+{
+	struct perf_domain *perf_domain;
+	struct perf_mr *perf_mr;
+	struct fid_mr *hmr;
+	uint64_t start;
+	int ret;
+
+	perf_domain = container_of(fid, struct perf_domain, domain_fid.fid);
+	perf_mr = perf_mr_alloc(perf_domain);
+	if (!perf_mr)
+		return -FI_ENOMEM;
+
+	start = perf_cycles();
+	ret = fi_mr_regv(container_of(perf_domain->obj.hfid,
+				      struct fid_domain, fid),
+			 iov, count, access, offset, requested_key, flags,
+			 &hmr, &perf_mr->mr_fid.fid);
+	perf_record(&perf_domain->stats, FI_PERF_MR_REG, start, ret,
+		    ofi_total_iov_len(iov, count));
+	if (ret) {
+		free(perf_mr);
+		return ret;
+	}
+
+	perf_mr_init(perf_mr, hmr, context, mr);
+	return 0;
+}
+
+static int perf_mr_regattr(struct fid *fid, const struct fi_mr_attr *attr,
+			   uint64_t flags, struct fid_mr **mr)
+{
+	struct perf_domain *perf_domain;
+	struct perf_mr *perf_mr;
+	struct fi_mr_attr core_attr;
+	struct fid_mr *hmr;
+	uint64_t start;
+	int ret;
+
+	perf_domain = container_of(fid, struct perf_domain, domain_fid.fid);
+	perf_mr = perf_mr_alloc(perf_domain);
+	if (!perf_mr)
+		return -FI_ENOMEM;
+
+	core_attr = *attr;
+	core_attr.context = &perf_mr->mr_fid.fid;
+
+	start = perf_cycles();
+	ret = fi_mr_regattr(container_of(perf_domain->obj.hfid,
+					 struct fid_domain, fid),
+			    &core_attr, flags, &hmr);
+	perf_record(&perf_domain->stats, FI_PERF_MR_REG, start, ret,
+		    ofi_total_iov_len(attr->mr_iov, attr->iov_count));
+	if (ret) {
+		free(perf_mr);
+		return ret;
+	}
+
+	perf_mr_init(perf_mr, hmr, attr->context, mr);
+	return 0;
+}
+
+static struct fi_ops_mr perf_mr_ops = {
+	.size = sizeof(struct fi_ops_mr),
+	.reg = perf_mr_reg,
+	.regv = perf_mr_regv,
+	.regattr = perf_mr_regattr,
+};
+
+static int perf_query_atomic(struct fid_domain *domain,
+			     enum fi_datatype datatype, enum fi_op op,
+			     struct fi_atomic_attr *attr, uint64_t flags)
+{
+	struct perf_domain *perf_domain;
+
+	perf_domain = container_of(domain, struct perf_domain, domain_fid);
+	return fi_query_atomic(container_of(perf_domain->obj.hfid,
+					    struct fid_domain, fid),
+			       datatype, op, attr, flags);
+}
+
+/* Poll sets, scalable endpoints and shared contexts would need wrapping
+ * of the objects they hold or hand out, and are not supported. */
+static struct fi_ops_domain perf_domain_ops = {
+	.size = sizeof(struct fi_ops_domain),
+	.av_open = perf_av_open,
+	.cq_open = perf_cq_open,
+	.endpoint = perf_endpoint,
+	.scalable_ep = fi_no_scalable_ep,
+	.cntr_open = perf_cntr_open,
+	.poll_open = fi_no_poll_open,
+	.stx_ctx = fi_no_stx_context,
+	.srx_ctx = fi_no_srx_context,
+	.query_atomic = perf_query_atomic,
+};
+
+int perf_domain(struct fid_fabric *fabric, struct fi_info *info,
+		struct fid_domain **domain, void *context)
+{
+	struct perf_fabric *perf_fabric;
+	struct perf_domain *perf_domain;
+	struct fid_domain *hdomain;
+	struct fi_info *core_info;
+	uint64_t start;
+	int ret;
+
+	perf_fabric = container_of(fabric, struct perf_fabric, fabric_fid);
+	ret = perf_info_to_core(info, &core_info);
+	if (ret)
+		return ret;
+
+	perf_domain = calloc(1, sizeof(*perf_domain));
+	if (!perf_domain) {
+		ret = -FI_ENOMEM;
+		goto out;
+	}
+
+	start = perf_cycles();
+	ret = fi_domain(container_of(perf_fabric->obj.hfid, struct fid_fabric,
+				     fid),
+			core_info, &hdomain, &perf_domain->domain_fid.fid);
+	perf_record(&perf_fabric->stats, FI_PERF_DOMAIN_OPEN, start, ret, 0);
+	if (ret) {
+		free(perf_domain);
+		goto out;
+	}
+
+	perf_init_obj(&perf_domain->obj, perf_fabric,
+		      &perf_domain->domain_fid.fid, FI_CLASS_DOMAIN, context);
+	perf_domain->domain_fid.ops = &perf_domain_ops;
+	perf_domain->domain_fid.mr = &perf_mr_ops;
+	perf_domain->obj.hfid = &hdomain->fid;
+	perf_domain->obj.stats = &perf_domain->stats;
+	perf_stats_add(perf_fabric, &perf_domain->stats);
+
+	*domain = &perf_domain->domain_fid;
+out:
+	fi_freeinfo(core_info);
+	return ret;
+}
@@ -0,0 +1,689 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "perf.h"
+
+static inline struct perf_obj *perf_ep_obj(struct fid_ep *ep)
+{
+	return &container_of(ep, struct perf_ep, ep_fid)->obj;
+}
+
+static inline struct fid_ep *perf_hep(struct fid_ep *ep)
+{
+	return container_of(perf_ep_obj(ep)->hfid, struct fid_ep, fid);
+}
+
+static inline struct fid_pep *perf_hpep(struct fid_pep *pep)
+{
+	return container_of(container_of(pep, struct perf_pep, pep_fid)->
+			    obj.hfid, struct fid_pep, fid);
+}
+
+static ssize_t perf_ep_cancel(fid_t fid, void *context)
+{
+	return fi_cancel(perf_hfid(fid), context);
+}
+
+static int perf_ep_getopt(fid_t fid, int level, int optname, void *optval,
+			  size_t *optlen)
+{
+	return fi_getopt(perf_hfid(fid), level, optname, optval, optlen);
+}
+
+static int perf_ep_setopt(fid_t fid, int level, int optname,
+			  const void *optval, size_t optlen)
+{
+	return fi_setopt(perf_hfid(fid), level, optname, optval, optlen);
+}
+
+static ssize_t perf_ep_rx_size_left(struct fid_ep *ep)
+{
+	struct fid_ep *hep = perf_hep(ep);
+
+	return hep->ops->rx_size_left(hep);
+}
+
+static ssize_t perf_ep_tx_size_left(struct fid_ep *ep)
+{
+	struct fid_ep *hep = perf_hep(ep);
+
+	return hep->ops->tx_size_left(hep);
+}
+
+static struct fi_ops_ep perf_ep_ops = {
+	.size = sizeof(struct fi_ops_ep),
+	.cancel = perf_ep_cancel,
+	.getopt = perf_ep_getopt,
+	.setopt = perf_ep_setopt,
+	.tx_ctx = fi_no_tx_ctx,
+	.rx_ctx = fi_no_rx_ctx,
+	.rx_size_left = perf_ep_rx_size_left,
+	.tx_size_left = perf_ep_tx_size_left,
+};
+
+static int perf_cm_setname(fid_t fid, void *addr, size_t addrlen)
+{
+	return fi_setname(perf_hfid(fid), addr, addrlen);
+}
+
+static int perf_cm_getname(fid_t fid, void *addr, size_t *addrlen)
+{
+	return fi_getname(perf_hfid(fid), addr, addrlen);
+}
+
+static int perf_cm_getpeer(struct fid_ep *ep, void *addr, size_t *addrlen)
+{
+	return fi_getpeer(perf_hep(ep), addr, addrlen);
+}
+
+static int perf_cm_connect(struct fid_ep *ep, const void *addr,
+			   const void *param, size_t paramlen)
+{
+	return fi_connect(perf_hep(ep), addr, param, paramlen);
+}
+
+static int perf_cm_listen(struct fid_pep *pep)
+{
+	return fi_listen(perf_hpep(pep));
+}
+
+static int perf_cm_accept(struct fid_ep *ep, const void *param,
+			  size_t paramlen)
+{
+	return fi_accept(perf_hep(ep), param, paramlen);
+}
+
+static int perf_cm_reject(struct fid_pep *pep, fid_t handle,
+			  const void *param, size_t paramlen)
+{
+	return fi_reject(perf_hpep(pep), handle, param, paramlen);
+}
+
+static int perf_cm_shutdown(struct fid_ep *ep, uint64_t flags)
+{
+	return fi_shutdown(perf_hep(ep), flags);
+}
+
+static int perf_cm_join(struct fid_ep *ep, const void *addr, uint64_t flags,
+			struct fid_mc **mc, void *context)
+{
+	return fi_join(perf_hep(ep), addr, flags, mc, context);
+}
+
+static struct fi_ops_cm perf_cm_ops = {
+	.size = sizeof(struct fi_ops_cm),
+	.setname = perf_cm_setname,
+	.getname = perf_cm_getname,
+	.getpeer = perf_cm_getpeer,
+	.connect = perf_cm_connect,
+	.listen = perf_cm_listen,
+	.accept = perf_cm_accept,
+	.reject = perf_cm_reject,
+	.shutdown = perf_cm_shutdown,
+	.join = perf_cm_join,
+};
+
+static ssize_t perf_recv(struct fid_ep *ep, void *buf, size_t len, void *desc,
+			 fi_addr_t src_addr, void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_RECV, len,
+		  fi_recv(perf_hep(ep), buf, len, desc, src_addr, context));
+}
+
+static ssize_t perf_recvv(struct fid_ep *ep, const struct iovec *iov,
+			  void **desc, size_t count, fi_addr_t src_addr,
+			  void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_RECVV,
+		  ofi_total_iov_len(iov, count),
+		  fi_recvv(perf_hep(ep), iov, desc, count, src_addr,
+			   context));
+}
+
+static ssize_t perf_recvmsg(struct fid_ep *ep, const struct fi_msg *msg,
+			    uint64_t flags)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_RECVMSG,
+		  ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+		  fi_recvmsg(perf_hep(ep), msg, flags));
+}
+
+static ssize_t perf_send(struct fid_ep *ep, const void *buf, size_t len,
+			 void *desc, fi_addr_t dest_addr, void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_SEND, len,
+		  fi_send(perf_hep(ep), buf, len, desc, dest_addr, context));
+}
+
+static ssize_t perf_sendv(struct fid_ep *ep, const struct iovec *iov,
+			  void **desc, size_t count, fi_addr_t dest_addr,
+			  void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_SENDV,
+		  ofi_total_iov_len(iov, count),
+		  fi_sendv(perf_hep(ep), iov, desc, count, dest_addr,
+			   context));
+}
+
+static ssize_t perf_sendmsg(struct fid_ep *ep, const struct fi_msg *msg,
+			    uint64_t flags)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_SENDMSG,
+		  ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+		  fi_sendmsg(perf_hep(ep), msg, flags));
+}
+
+static ssize_t perf_inject(struct fid_ep *ep, const void *buf, size_t len,
+			   fi_addr_t dest_addr)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_INJECT, len,
+		  fi_inject(perf_hep(ep), buf, len, dest_addr));
+}
+
+static ssize_t perf_senddata(struct fid_ep *ep, const void *buf, size_t len,
+			     void *desc, uint64_t data, fi_addr_t dest_addr,
+			     void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_SENDDATA, len,
+		  fi_senddata(perf_hep(ep), buf, len, desc, data, dest_addr,
+			      context));
+}
+
+static ssize_t perf_injectdata(struct fid_ep *ep, const void *buf, size_t len,
+			       uint64_t data, fi_addr_t dest_addr)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_INJECTDATA, len,
+		  fi_injectdata(perf_hep(ep), buf, len, data, dest_addr));
+}
+
+static struct fi_ops_msg perf_msg_ops = {
+	.size = sizeof(struct fi_ops_msg),
+	.recv = perf_recv,
+	.recvv = perf_recvv,
+	.recvmsg = perf_recvmsg,
+	.send = perf_send,
+	.sendv = perf_sendv,
+	.sendmsg = perf_sendmsg,
+	.inject = perf_inject,
+	.senddata = perf_senddata,
+	.injectdata = perf_injectdata,
+};
+
+static ssize_t perf_trecv(struct fid_ep *ep, void *buf, size_t len,
+			  void *desc, fi_addr_t src_addr, uint64_t tag,
+			  uint64_t ignore, void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_TRECV, len,
+		  fi_trecv(perf_hep(ep), buf, len, desc, src_addr, tag,
+			   ignore, context));
+}
+
+static ssize_t perf_trecvv(struct fid_ep *ep, const struct iovec *iov,
+			   void **desc, size_t count, fi_addr_t src_addr,
+			   uint64_t tag, uint64_t ignore, void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_TRECVV,
+		  ofi_total_iov_len(iov, count),
+		  fi_trecvv(perf_hep(ep), iov, desc, count, src_addr, tag,
+			    ignore, context));
+}
+
+static ssize_t perf_trecvmsg(struct fid_ep *ep,
+			     const struct fi_msg_tagged *msg, uint64_t flags)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_TRECVMSG,
+		  ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+		  fi_trecvmsg(perf_hep(ep), msg, flags));
+}
+
+static ssize_t perf_tsend(struct fid_ep *ep, const void *buf, size_t len,
+			  void *desc, fi_addr_t dest_addr, uint64_t tag,
+			  void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_TSEND, len,
+		  fi_tsend(perf_hep(ep), buf, len, desc, dest_addr, tag,
+			   context));
+}
+
+static ssize_t perf_tsendv(struct fid_ep *ep, const struct iovec *iov,
+			   void **desc, size_t count, fi_addr_t dest_addr,
+			   uint64_t tag, void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_TSENDV,
+		  ofi_total_iov_len(iov, count),
+		  fi_tsendv(perf_hep(ep), iov, desc, count, dest_addr, tag,
+			    context));
+}
+
+static ssize_t perf_tsendmsg(struct fid_ep *ep,
+			     const struct fi_msg_tagged *msg, uint64_t flags)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_TSENDMSG,
+		  ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+		  fi_tsendmsg(perf_hep(ep), msg, flags));
+}
+
+static ssize_t perf_tinject(struct fid_ep *ep, const void *buf, size_t len,
+			    fi_addr_t dest_addr, uint64_t tag)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_TINJECT, len,
+		  fi_tinject(perf_hep(ep), buf, len, dest_addr, tag));
+}
+
+static ssize_t perf_tsenddata(struct fid_ep *ep, const void *buf, size_t len,
+			      void *desc, uint64_t data, fi_addr_t dest_addr,
+			      uint64_t tag, void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_TSENDDATA, len,
+		  fi_tsenddata(perf_hep(ep), buf, len, desc, data, dest_addr,
+			       tag, context));
+}
+
+static ssize_t perf_tinjectdata(struct fid_ep *ep, const void *buf,
+				size_t len, uint64_t data,
+				fi_addr_t dest_addr, uint64_t tag)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_TINJECTDATA, len,
+		  fi_tinjectdata(perf_hep(ep), buf, len, data, dest_addr,
+				 tag));
+}
+
+static struct fi_ops_tagged perf_tagged_ops = {
+	.size = sizeof(struct fi_ops_tagged),
+	.recv = perf_trecv,
+	.recvv = perf_trecvv,
+	.recvmsg = perf_trecvmsg,
+	.send = perf_tsend,
+	.sendv = perf_tsendv,
+	.sendmsg = perf_tsendmsg,
+	.inject = perf_tinject,
+	.senddata = perf_tsenddata,
+	.injectdata = perf_tinjectdata,
+};
+
+static ssize_t perf_read(struct fid_ep *ep, void *buf, size_t len, void *desc,
+			 fi_addr_t src_addr, uint64_t addr, uint64_t key,
+			 void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_READ, len,
+		  fi_read(perf_hep(ep), buf, len, desc, src_addr, addr, key,
+			  context));
+}
+
+static ssize_t perf_readv(struct fid_ep *ep, const struct iovec *iov,
+			  void **desc, size_t count, fi_addr_t src_addr,
+			  uint64_t addr, uint64_t key, void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_READV,
+		  ofi_total_iov_len(iov, count),
+		  fi_readv(perf_hep(ep), iov, desc, count, src_addr, addr, key,
+			   context));
+}
+
+static ssize_t perf_readmsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
+			    uint64_t flags)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_READMSG,
+		  ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+		  fi_readmsg(perf_hep(ep), msg, flags));
+}
+
+static ssize_t perf_write(struct fid_ep *ep, const void *buf, size_t len,
+			  void *desc, fi_addr_t dest_addr, uint64_t addr,
+			  uint64_t key, void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_WRITE, len,
+		  fi_write(perf_hep(ep), buf, len, desc, dest_addr, addr, key,
+			   context));
+}
+
+static ssize_t perf_writev(struct fid_ep *ep, const struct iovec *iov,
+			   void **desc, size_t count, fi_addr_t dest_addr,
+			   uint64_t addr, uint64_t key, void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_WRITEV,
+		  ofi_total_iov_len(iov, count),
+		  fi_writev(perf_hep(ep), iov, desc, count, dest_addr, addr,
+			    key, context));
+}
+
+static ssize_t perf_writemsg(struct fid_ep *ep, const struct fi_msg_rma *msg,
+			     uint64_t flags)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_WRITEMSG,
+		  ofi_total_iov_len(msg->msg_iov, msg->iov_count),
+		  fi_writemsg(perf_hep(ep), msg, flags));
+}
+
+static ssize_t perf_inject_write(struct fid_ep *ep, const void *buf,
+				 size_t len, fi_addr_t dest_addr,
+				 uint64_t addr, uint64_t key)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_INJECT_WRITE, len,
+		  fi_inject_write(perf_hep(ep), buf, len, dest_addr, addr,
+				  key));
+}
+
+static ssize_t perf_writedata(struct fid_ep *ep, const void *buf, size_t len,
+			      void *desc, uint64_t data, fi_addr_t dest_addr,
+			      uint64_t addr, uint64_t key, void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_WRITEDATA, len,
+		  fi_writedata(perf_hep(ep), buf, len, desc, data, dest_addr,
+			       addr, key, context));
+}
+
+static ssize_t perf_inject_writedata(struct fid_ep *ep, const void *buf,
+				     size_t len, uint64_t data,
+				     fi_addr_t dest_addr, uint64_t addr,
+				     uint64_t key)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_INJECT_WRITEDATA, len,
+		  fi_inject_writedata(perf_hep(ep), buf, len, data, dest_addr,
+				      addr, key));
+}
+
+static struct fi_ops_rma perf_rma_ops = {
+	.size = sizeof(struct fi_ops_rma),
+	.read = perf_read,
+	.readv = perf_readv,
+	.readmsg = perf_readmsg,
+	.write = perf_write,
+	.writev = perf_writev,
+	.writemsg = perf_writemsg,
+	.inject = perf_inject_write,
+	.writedata = perf_writedata,
+	.injectdata = perf_inject_writedata,
+};
+
+static ssize_t perf_atomic(struct fid_ep *ep, const void *buf, size_t count,
+			   void *desc, fi_addr_t dest_addr, uint64_t addr,
+			   uint64_t key, enum fi_datatype datatype,
+			   enum fi_op op, void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_ATOMIC,
+		  count * ofi_datatype_size(datatype),
+		  fi_atomic(perf_hep(ep), buf, count, desc, dest_addr, addr,
+			    key, datatype, op, context));
+}
+
+static ssize_t perf_atomicv(struct fid_ep *ep, const struct fi_ioc *iov,
+			    void **desc, size_t count, fi_addr_t dest_addr,
+			    uint64_t addr, uint64_t key,
+			    enum fi_datatype datatype, enum fi_op op,
+			    void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_ATOMICV,
+		  ofi_total_ioc_cnt(iov, count) * ofi_datatype_size(datatype),
+		  fi_atomicv(perf_hep(ep), iov, desc, count, dest_addr, addr,
+			     key, datatype, op, context));
+}
+
+static ssize_t perf_atomicmsg(struct fid_ep *ep,
+			      const struct fi_msg_atomic *msg, uint64_t flags)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_ATOMICMSG,
+		  ofi_total_ioc_cnt(msg->msg_iov, msg->iov_count) *
+		  ofi_datatype_size(msg->datatype),
+		  fi_atomicmsg(perf_hep(ep), msg, flags));
+}
+
+static ssize_t perf_inject_atomic(struct fid_ep *ep, const void *buf,
+				  size_t count, fi_addr_t dest_addr,
+				  uint64_t addr, uint64_t key,
+				  enum fi_datatype datatype, enum fi_op op)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_INJECT_ATOMIC,
+		  count * ofi_datatype_size(datatype),
+		  fi_inject_atomic(perf_hep(ep), buf, count, dest_addr, addr,
+				   key, datatype, op));
+}
+
+static ssize_t perf_fetch_atomic(struct fid_ep *ep, const void *buf,
+				 size_t count, void *desc, void *result,
+				 void *result_desc, fi_addr_t dest_addr,
+				 uint64_t addr, uint64_t key,
+				 enum fi_datatype datatype, enum fi_op op,
+				 void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_FETCH_ATOMIC,
+		  count * ofi_datatype_size(datatype),
+		  fi_fetch_atomic(perf_hep(ep), buf, count, desc, result,
+				  result_desc, dest_addr, addr, key, datatype,
+				  op, context));
+}
+
+static ssize_t perf_fetch_atomicv(struct fid_ep *ep, const struct fi_ioc *iov,
+				  void **desc, size_t count,
+				  struct fi_ioc *resultv, void **result_desc,
+				  size_t result_count, fi_addr_t dest_addr,
+				  uint64_t addr, uint64_t key,
+				  enum fi_datatype datatype, enum fi_op op,
+				  void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_FETCH_ATOMICV,
+		  ofi_total_ioc_cnt(iov, count) * ofi_datatype_size(datatype),
+		  fi_fetch_atomicv(perf_hep(ep), iov, desc, count, resultv,
+				   result_desc, result_count, dest_addr, addr,
+				   key, datatype, op, context));
+}
+
+static ssize_t perf_fetch_atomicmsg(struct fid_ep *ep,
+				    const struct fi_msg_atomic *msg,
+				    struct fi_ioc *resultv, void **result_desc,
+				    size_t result_count, uint64_t flags)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_FETCH_ATOMICMSG,
+		  ofi_total_ioc_cnt(msg->msg_iov, msg->iov_count) *
+		  ofi_datatype_size(msg->datatype),
+		  fi_fetch_atomicmsg(perf_hep(ep), msg, resultv, result_desc,
+				     result_count, flags));
+}
+
+static ssize_t perf_compare_atomic(struct fid_ep *ep, const void *buf,
+				   size_t count, void *desc,
+				   const void *compare, void *compare_desc,
+				   void *result, void *result_desc,
+				   fi_addr_t dest_addr, uint64_t addr,
+				   uint64_t key, enum fi_datatype datatype,
+				   enum fi_op op, void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_COMPARE_ATOMIC,
+		  count * ofi_datatype_size(datatype),
+		  fi_compare_atomic(perf_hep(ep), buf, count, desc, compare,
+				    compare_desc, result, result_desc,
+				    dest_addr, addr, key, datatype, op,
+				    context));
+}
+
+static ssize_t perf_compare_atomicv(struct fid_ep *ep,
+				    const struct fi_ioc *iov, void **desc,
+				    size_t count, const struct fi_ioc *comparev,
+				    void **compare_desc, size_t compare_count,
+				    struct fi_ioc *resultv, void **result_desc,
+				    size_t result_count, fi_addr_t dest_addr,
+				    uint64_t addr, uint64_t key,
+				    enum fi_datatype datatype, enum fi_op op,
+				    void *context)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_COMPARE_ATOMICV,
+		  ofi_total_ioc_cnt(iov, count) * ofi_datatype_size(datatype),
+		  fi_compare_atomicv(perf_hep(ep), iov, desc, count, comparev,
+				     compare_desc, compare_count, resultv,
+				     result_desc, result_count, dest_addr,
+				     addr, key, datatype, op, context));
+}
+
+static ssize_t perf_compare_atomicmsg(struct fid_ep *ep,
+				      const struct fi_msg_atomic *msg,
+				      const struct fi_ioc *comparev,
+				      void **compare_desc,
+				      size_t compare_count,
+				      struct fi_ioc *resultv,
+				      void **result_desc, size_t result_count,
+				      uint64_t flags)
+{
+	PERF_CALL(perf_ep_obj(ep), FI_PERF_COMPARE_ATOMICMSG,
+		  ofi_total_ioc_cnt(msg->msg_iov, msg->iov_count) *
+		  ofi_datatype_size(msg->datatype),
+		  fi_compare_atomicmsg(perf_hep(ep), msg, comparev,
+				       compare_desc, compare_count, resultv,
+				       result_desc, result_count, flags));
+}
+
+static int perf_atomic_writevalid(struct fid_ep *ep,
+				  enum fi_datatype datatype, enum fi_op op,
+				  size_t *count)
+{
+	return fi_atomicvalid(perf_hep(ep), datatype, op, count);
+}
+
+static int perf_atomic_readwritevalid(struct fid_ep *ep,
+				      enum fi_datatype datatype,
+				      enum fi_op op, size_t *count)
+{
+	return fi_fetch_atomicvalid(perf_hep(ep), datatype, op, count);
+}
+
+static int perf_atomic_compwritevalid(struct fid_ep *ep,
+				      enum fi_datatype datatype,
+				      enum fi_op op, size_t *count)
+{
+	return fi_compare_atomicvalid(perf_hep(ep), datatype, op, count);
+}
+
+static struct fi_ops_atomic perf_atomic_ops = {
+	.size = sizeof(struct fi_ops_atomic),
+	.write = perf_atomic,
+	.writev = perf_atomicv,
+	.writemsg = perf_atomicmsg,
+	.inject = perf_inject_atomic,
+	.readwrite = perf_fetch_atomic,
+	.readwritev = perf_fetch_atomicv,
+	.readwritemsg = perf_fetch_atomicmsg,
+	.compwrite = perf_compare_atomic,
+	.compwritev = perf_compare_atomicv,
+	.compwritemsg = perf_compare_atomicmsg,
+	.writevalid = perf_atomic_writevalid,
+	.readwritevalid = perf_atomic_readwritevalid,
+	.compwritevalid = perf_atomic_compwritevalid,
+};
+
+int perf_endpoint(struct fid_domain *domain, struct fi_info *info,
+		  struct fid_ep **ep, void *context)
+{
+	struct perf_domain *perf_domain;
+	struct perf_ep *perf_ep;
+	struct fi_info *core_info;
+	struct fid_ep *hep;
+	uint64_t start;
+	int ret;
+
+	perf_domain = container_of(domain, struct perf_domain, domain_fid);
+	ret = perf_info_to_core(info, &core_info);
+	if (ret)
+		return ret;
+
+	perf_ep = calloc(1, sizeof(*perf_ep));
+	if (!perf_ep) {
+		ret = -FI_ENOMEM;
+		goto out;
+	}
+
+	start = perf_cycles();
+	ret = fi_endpoint(container_of(perf_domain->obj.hfid,
+				       struct fid_domain, fid),
+			  core_info, &hep, &perf_ep->ep_fid.fid);
+	perf_record(&perf_domain->stats, FI_PERF_EP_OPEN, start, ret, 0);
+	if (ret) {
+		free(perf_ep);
+		goto out;
+	}
+
+	perf_init_obj(&perf_ep->obj, perf_domain->obj.fabric,
+		      &perf_ep->ep_fid.fid, FI_CLASS_EP, context);
+	perf_ep->ep_fid.ops = &perf_ep_ops;
+	perf_ep->ep_fid.cm = &perf_cm_ops;
+	perf_ep->ep_fid.msg = &perf_msg_ops;
+	perf_ep->ep_fid.rma = &perf_rma_ops;
+	perf_ep->ep_fid.tagged = &perf_tagged_ops;
+	perf_ep->ep_fid.atomic = &perf_atomic_ops;
+	perf_ep->obj.hfid = &hep->fid;
+	perf_ep->obj.stats = &perf_ep->stats;
+	perf_stats_add(perf_domain->obj.fabric, &perf_ep->stats);
+
+	*ep = &perf_ep->ep_fid;
+out:
+	fi_freeinfo(core_info);
+	return ret;
+}
+
+int perf_passive_ep(struct fid_fabric *fabric, struct fi_info *info,
+		    struct fid_pep **pep, void *context)
+{
+	struct perf_fabric *perf_fabric;
+	struct perf_pep *perf_pep;
+	struct fi_info *core_info;
+	struct fid_pep *hpep;
+	int ret;
+
+	perf_fabric = container_of(fabric, struct perf_fabric, fabric_fid);
+	ret = perf_info_to_core(info, &core_info);
+	if (ret)
+		return ret;
+
+	perf_pep = calloc(1, sizeof(*perf_pep));
+	if (!perf_pep) {
+		ret = -FI_ENOMEM;
+		goto out;
+	}
+
+	ret = fi_passive_ep(container_of(perf_fabric->obj.hfid,
+					 struct fid_fabric, fid),
+			    core_info, &hpep, &perf_pep->pep_fid.fid);
+	if (ret) {
+		free(perf_pep);
+		goto out;
+	}
+
+	perf_init_obj(&perf_pep->obj, perf_fabric, &perf_pep->pep_fid.fid,
+		      FI_CLASS_PEP, context);
+	perf_pep->pep_fid.ops = &perf_ep_ops;
+	perf_pep->pep_fid.cm = &perf_cm_ops;
+	perf_pep->obj.hfid = &hpep->fid;
+	perf_pep->obj.stats = &perf_fabric->stats;
+
+	*pep = &perf_pep->pep_fid;
+out:
+	fi_freeinfo(core_info);
+	return ret;
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "perf.h"
+
+static int perf_wait_open(struct fid_fabric *fabric, struct fi_wait_attr *attr,
+			  struct fid_wait **waitset)
+{
+	struct perf_fabric *perf_fabric;
+
+	perf_fabric = container_of(fabric, struct perf_fabric, fabric_fid);
+	return fi_wait_open(container_of(perf_fabric->obj.hfid,
+					 struct fid_fabric, fid),
+			    attr, waitset);
+}
+
+static int perf_trywait(struct fid_fabric *fabric, struct fid **fids,
+			int count)
+{
+	struct perf_fabric *perf_fabric;
+	struct fid **hfids;
+	int i, ret;
+
+	perf_fabric = container_of(fabric, struct perf_fabric, fabric_fid);
+	hfids = calloc(count, sizeof(*hfids));
+	if (!hfids)
+		return -FI_ENOMEM;
+
+	for (i = 0; i < count; i++)
+		hfids[i] = perf_hfid(fids[i]);
+
+	ret = fi_trywait(container_of(perf_fabric->obj.hfid,
+				      struct fid_fabric, fid), hfids, count);
+	free(hfids);
+	return ret;
+}
+
+static struct fi_ops_fabric perf_fabric_ops = {
+	.size = sizeof(struct fi_ops_fabric),
+	.domain = perf_domain,
+	.passive_ep = perf_passive_ep,
+	.eq_open = perf_eq_open,
+	.wait_open = perf_wait_open,
+	.trywait = perf_trywait,
+};
+
+int perf_fabric_close(struct perf_fabric *fabric)
+{
+	int ret;
+
+	ret = fi_close(fabric->obj.hfid);
+	if (ret)
+		return ret;
+
+	perf_stats_del(fabric, &fabric->stats);
+	perf_stats_report(fabric);
+	fastlock_destroy(&fabric->lock);
+	free(fabric);
+	return 0;
+}
+
+int perf_fabric(struct fi_fabric_attr *attr, struct fid_fabric **fabric,
+		void *context)
+{
+	struct perf_fabric *perf_fabric;
+	struct fi_fabric_attr core_attr;
+	struct fid_fabric *hfabric;
+	const char *core_name;
+	size_t len;
+	int ret;
+
+	core_name = ofi_core_name(attr->prov_name, &len);
+	if (!core_name)
+		return -FI_EINVAL;
+
+	perf_fabric = calloc(1, sizeof(*perf_fabric));
+	if (!perf_fabric)
+		return -FI_ENOMEM;
+
+	core_attr = *attr;
+	core_attr.prov_name = strndup(core_name, len);
+	if (!core_attr.prov_name) {
+		ret = -FI_ENOMEM;
+		goto err;
+	}
+
+	ret = fi_fabric(&core_attr, &hfabric, &perf_fabric->fabric_fid.fid);
+	free(core_attr.prov_name);
+	if (ret)
+		goto err;
+
+	perf_init_obj(&perf_fabric->obj, perf_fabric,
+		      &perf_fabric->fabric_fid.fid, FI_CLASS_FABRIC, context);
+	perf_fabric->fabric_fid.ops = &perf_fabric_ops;
+	perf_fabric->fabric_fid.api_version = hfabric->api_version;
+	perf_fabric->obj.hfid = &hfabric->fid;
+	perf_fabric->obj.stats = &perf_fabric->stats;
+
+	fastlock_init(&perf_fabric->lock);
+	dlist_init(&perf_fabric->stats_list);
+	perf_stats_add(perf_fabric, &perf_fabric->stats);
+
+	/* calibrate the cycle counter now rather than on first report */
+	perf_cycles_per_sec();
+
+	*fabric = &perf_fabric->fabric_fid;
+	return 0;
+err:
+	free(perf_fabric);
+	return ret;
+}
+
+static void perf_eq_fix_fid(void *buf, size_t len)
+{
+	fid_t *fid = buf;
+
+	if (len >= sizeof(*fid))
+		*fid = perf_wrapper_fid(*fid);
+}
+
+static ssize_t perf_eq_read(struct fid_eq *eq, uint32_t *event, void *buf,
+			    size_t len, uint64_t flags)
+{
+	struct perf_eq *perf_eq = container_of(eq, struct perf_eq, eq_fid);
+	uint64_t start;
+	ssize_t ret;
+
+	start = perf_cycles();
+	ret = fi_eq_read(container_of(perf_eq->obj.hfid, struct fid_eq, fid),
+			 event, buf, len, flags);
+	perf_record(perf_eq->obj.stats, FI_PERF_EQ_READ, start, ret,
+		    ret > 0 ? 1 : 0);
+	if (ret > 0)
+		perf_eq_fix_fid(buf, ret);
+	return ret;
+}
+
+static ssize_t perf_eq_readerr(struct fid_eq *eq, struct fi_eq_err_entry *buf,
+			       uint64_t flags)
+{
+	struct perf_eq *perf_eq = container_of(eq, struct perf_eq, eq_fid);
+	ssize_t ret;
+
+	ret = fi_eq_readerr(container_of(perf_eq->obj.hfid, struct fid_eq,
+					 fid), buf, flags);
+	if (ret > 0)
+		buf->fid = perf_wrapper_fid(buf->fid);
+	return ret;
+}
+
+static ssize_t perf_eq_write(struct fid_eq *eq, uint32_t event,
+			     const void *buf, size_t len, uint64_t flags)
+{
+	struct perf_eq *perf_eq = container_of(eq, struct perf_eq, eq_fid);
+
+	return fi_eq_write(container_of(perf_eq->obj.hfid, struct fid_eq, fid),
+			   event, buf, len, flags);
+}
+
+static ssize_t perf_eq_sread(struct fid_eq *eq, uint32_t *event, void *buf,
+			     size_t len, int timeout, uint64_t flags)
+{
+	struct perf_eq *perf_eq = container_of(eq, struct perf_eq, eq_fid);
+	uint64_t start;
+	ssize_t ret;
+
+	start = perf_cycles();
+	ret = fi_eq_sread(container_of(perf_eq->obj.hfid, struct fid_eq, fid),
+			  event, buf, len, timeout, flags);
+	perf_record(perf_eq->obj.stats, FI_PERF_EQ_SREAD, start, ret,
+		    ret > 0 ? 1 : 0);
+	if (ret > 0)
+		perf_eq_fix_fid(buf, ret);
+	return ret;
+}
+
+static const char *perf_eq_strerror(struct fid_eq *eq, int prov_errno,
+				    const void *err_data, char *buf,
+				    size_t len)
+{
+	struct perf_eq *perf_eq = container_of(eq, struct perf_eq, eq_fid);
+
+	return fi_eq_strerror(container_of(perf_eq->obj.hfid, struct fid_eq,
+					   fid), prov_errno, err_data, buf, len);
+}
+
+static struct fi_ops_eq perf_eq_ops = {
+	.size = sizeof(struct fi_ops_eq),
+	.read = perf_eq_read,
+	.readerr = perf_eq_readerr,
+	.write = perf_eq_write,
+	.sread = perf_eq_sread,
+	.strerror = perf_eq_strerror,
+};
+
+int perf_eq_open(struct fid_fabric *fabric, struct fi_eq_attr *attr,
+		 struct fid_eq **eq, void *context)
+{
+	struct perf_fabric *perf_fabric;
+	struct perf_eq *perf_eq;
+	struct fid_eq *heq;
+	int ret;
+
+	perf_fabric = container_of(fabric, struct perf_fabric, fabric_fid);
+	perf_eq = calloc(1, sizeof(*perf_eq));
+	if (!perf_eq)
+		return -FI_ENOMEM;
+
+	ret = fi_eq_open(container_of(perf_fabric->obj.hfid,
+				      struct fid_fabric, fid),
+			 attr, &heq, &perf_eq->eq_fid.fid);
+	if (ret) {
+		free(perf_eq);
+		return ret;
+	}
+
+	perf_init_obj(&perf_eq->obj, perf_fabric, &perf_eq->eq_fid.fid,
+		      FI_CLASS_EQ, context);
+	perf_eq->eq_fid.ops = &perf_eq_ops;
+	perf_eq->obj.hfid = &heq->fid;
+	perf_eq->obj.stats = &perf_fabric->stats;
+
+	*eq = &perf_eq->eq_fid;
+	return 0;
+}
@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <prov.h>
+#include "perf.h"
+
+int perf_report = 1;
+
+static const char * const perf_op_names[] = {
+	[FI_PERF_RECV] = "recv",
+	[FI_PERF_RECVV] = "recvv",
+	[FI_PERF_RECVMSG] = "recvmsg",
+	[FI_PERF_SEND] = "send",
+	[FI_PERF_SENDV] = "sendv",
+	[FI_PERF_SENDMSG] = "sendmsg",
+	[FI_PERF_INJECT] = "inject",
+	[FI_PERF_SENDDATA] = "senddata",
+	[FI_PERF_INJECTDATA] = "injectdata",
+	[FI_PERF_TRECV] = "trecv",
+	[FI_PERF_TRECVV] = "trecvv",
+	[FI_PERF_TRECVMSG] = "trecvmsg",
+	[FI_PERF_TSEND] = "tsend",
+	[FI_PERF_TSENDV] = "tsendv",
+	[FI_PERF_TSENDMSG] = "tsendmsg",
+	[FI_PERF_TINJECT] = "tinject",
+	[FI_PERF_TSENDDATA] = "tsenddata",
+	[FI_PERF_TINJECTDATA] = "tinjectdata",
+	[FI_PERF_READ] = "read",
+	[FI_PERF_READV] = "readv",
+	[FI_PERF_READMSG] = "readmsg",
+	[FI_PERF_WRITE] = "write",
+	[FI_PERF_WRITEV] = "writev",
+	[FI_PERF_WRITEMSG] = "writemsg",
+	[FI_PERF_INJECT_WRITE] = "inject_write",
+	[FI_PERF_WRITEDATA] = "writedata",
+	[FI_PERF_INJECT_WRITEDATA] = "inject_writedata",
+	[FI_PERF_ATOMIC] = "atomic",
+	[FI_PERF_ATOMICV] = "atomicv",
+	[FI_PERF_ATOMICMSG] = "atomicmsg",
+	[FI_PERF_INJECT_ATOMIC] = "inject_atomic",
+	[FI_PERF_FETCH_ATOMIC] = "fetch_atomic",
+	[FI_PERF_FETCH_ATOMICV] = "fetch_atomicv",
+	[FI_PERF_FETCH_ATOMICMSG] = "fetch_atomicmsg",
+	[FI_PERF_COMPARE_ATOMIC] = "compare_atomic",
+	[FI_PERF_COMPARE_ATOMICV] = "compare_atomicv",
+	[FI_PERF_COMPARE_ATOMICMSG] = "compare_atomicmsg",
+	[FI_PERF_CQ_READ] = "cq_read",
+	[FI_PERF_CQ_READFROM] = "cq_readfrom",
+	[FI_PERF_CQ_READERR] = "cq_readerr",
+	[FI_PERF_CQ_SREAD] = "cq_sread",
+	[FI_PERF_CQ_SREADFROM] = "cq_sreadfrom",
+	[FI_PERF_CNTR_READ] = "cntr_read",
+	[FI_PERF_CNTR_READERR] = "cntr_readerr",
+	[FI_PERF_CNTR_ADD] = "cntr_add",
+	[FI_PERF_CNTR_SET] = "cntr_set",
+	[FI_PERF_CNTR_WAIT] = "cntr_wait",
+	[FI_PERF_MR_REG] = "mr_reg",
+	[FI_PERF_MR_CLOSE] = "mr_close",
+	[FI_PERF_AV_INSERT] = "av_insert",
+	[FI_PERF_AV_REMOVE] = "av_remove",
+	[FI_PERF_AV_LOOKUP] = "av_lookup",
+	[FI_PERF_EQ_READ] = "eq_read",
+	[FI_PERF_EQ_SREAD] = "eq_sread",
+	[FI_PERF_DOMAIN_OPEN] = "domain_open",
+	[FI_PERF_EP_OPEN] = "ep_open",
+	[FI_PERF_CQ_OPEN] = "cq_open",
+	[FI_PERF_CNTR_OPEN] = "cntr_open",
+	[FI_PERF_AV_OPEN] = "av_open",
+};
+
+uint64_t perf_cycles_per_sec(void)
+{
+	static uint64_t freq;
+#if defined(__x86_64__) || defined(__i386__)
+	struct timespec start, end, delay = { 0, 10000000 };
+	uint64_t cycles, nsec;
+
+	if (freq)
+		return freq;
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	cycles = perf_cycles();
+	nanosleep(&delay, NULL);
+	cycles = perf_cycles() - cycles;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	nsec = (end.tv_sec - start.tv_sec) * 1000000000ULL +
+	       end.tv_nsec - start.tv_nsec;
+	freq = nsec ? (uint64_t) ((double) cycles * 1e9 / nsec) : 1;
+#elif defined(__aarch64__)
+	__asm__ __volatile__ ("mrs %0, cntfrq_el0" : "=r" (freq));
+#else
+	freq = 1000000000;
+#endif
+	return freq;
+}
+
+struct perf_obj *perf_get_obj(struct fid *fid)
+{
+	if (fid->ops != &perf_fid_ops)
+		return NULL;
+
+	switch (fid->fclass) {
+	case FI_CLASS_FABRIC:
+		return &container_of(fid, struct perf_fabric,
+				     fabric_fid.fid)->obj;
+	case FI_CLASS_DOMAIN:
+		return &container_of(fid, struct perf_domain,
+				     domain_fid.fid)->obj;
+	case FI_CLASS_EP:
+		return &container_of(fid, struct perf_ep, ep_fid.fid)->obj;
+	case FI_CLASS_PEP:
+		return &container_of(fid, struct perf_pep, pep_fid.fid)->obj;
+	case FI_CLASS_CQ:
+		return &container_of(fid, struct perf_cq, cq_fid.fid)->obj;
+	case FI_CLASS_CNTR:
+		return &container_of(fid, struct perf_cntr, cntr_fid.fid)->obj;
+	case FI_CLASS_AV:
+		return &container_of(fid, struct perf_av, av_fid.fid)->obj;
+	case FI_CLASS_EQ:
+		return &container_of(fid, struct perf_eq, eq_fid.fid)->obj;
+	case FI_CLASS_MR:
+		return &container_of(fid, struct perf_mr, mr_fid.fid)->obj;
+	default:
+		return NULL;
+	}
+}
+
+void perf_init_obj(struct perf_obj *obj, struct perf_fabric *fabric,
+		   struct fid *fid, size_t fclass, void *context)
+{
+	fid->fclass = fclass;
+	fid->context = context;
+	fid->ops = &perf_fid_ops;
+	obj->fabric = fabric;
+}
+
+void perf_stats_add(struct perf_fabric *fabric, struct perf_stats *stats)
+{
+	fastlock_acquire(&fabric->lock);
+	dlist_insert_tail(&stats->entry, &fabric->stats_list);
+	fastlock_release(&fabric->lock);
+}
+
+static void perf_stats_merge(struct fi_perf_stats *dst,
+			     const struct fi_perf_stats *src)
+{
+	int i, j;
+
+	for (i = 0; i < FI_PERF_OP_MAX; i++) {
+		dst->op[i].count += src->op[i].count;
+		dst->op[i].empty += src->op[i].empty;
+		dst->op[i].size += src->op[i].size;
+		dst->op[i].cycles += src->op[i].cycles;
+		for (j = 0; j < FI_PERF_HIST_BUCKETS; j++)
+			dst->op[i].hist[j] += src->op[i].hist[j];
+	}
+}
+
+/* Fold the stats of a closing object into the fabric totals. */
+void perf_stats_del(struct perf_fabric *fabric, struct perf_stats *stats)
+{
+	fastlock_acquire(&fabric->lock);
+	dlist_remove(&stats->entry);
+	perf_stats_merge(&fabric->closed, &stats->data);
+	fastlock_release(&fabric->lock);
+}
+
+static void perf_stats_total(struct perf_fabric *fabric,
+			     struct fi_perf_stats *total)
+{
+	struct perf_stats *stats;
+
+	fastlock_acquire(&fabric->lock);
+	*total = fabric->closed;
+	dlist_foreach_container(&fabric->stats_list, struct perf_stats,
+				stats, entry)
+		perf_stats_merge(total, &stats->data);
+	fastlock_release(&fabric->lock);
+}
+
+/* Upper bound, in cycles, of the bucket holding the given fraction. */
+static uint64_t perf_hist_pct(const struct fi_perf_op_stats *op_stats,
+			      double pct)
+{
+	uint64_t sum = 0;
+	int i;
+
+	for (i = 0; i < FI_PERF_HIST_BUCKETS; i++) {
+		sum += op_stats->hist[i];
+		if (sum >= pct * op_stats->count)
+			break;
+	}
+	return 2ULL << MIN(i, FI_PERF_HIST_BUCKETS - 1);
+}
+
+void perf_stats_report(struct perf_fabric *fabric)
+{
+	struct fi_perf_stats *total;
+	struct fi_perf_op_stats *op_stats;
+	double ns;
+	int i;
+
+	if (!perf_report)
+		return;
+
+	total = malloc(sizeof(*total));
+	if (!total)
+		return;
+
+	perf_stats_total(fabric, total);
+	ns = 1e9 / perf_cycles_per_sec();
+
+	fprintf(stderr, "%s: %-18s %12s %14s %10s %10s %10s %7s\n",
+		perf_prov.name, "op", "count", "size", "avg(ns)",
+		"p50(ns)<", "p99(ns)<", "empty%");
+	for (i = 0; i < FI_PERF_OP_MAX; i++) {
+		op_stats = &total->op[i];
+		if (!op_stats->count)
+			continue;
+
+		fprintf(stderr, "%s: %-18s %12" PRIu64 " %14" PRIu64
+			" %10.1f %10.0f %10.0f %7.2f\n", perf_prov.name,
+			perf_op_names[i], op_stats->count, op_stats->size,
+			ns * op_stats->cycles / op_stats->count,
+			ns * perf_hist_pct(op_stats, 0.5),
+			ns * perf_hist_pct(op_stats, 0.99),
+			100.0 * op_stats->empty / op_stats->count);
+	}
+	free(total);
+}
+
+static int perf_get_stats(struct fid *fid, struct fi_perf_stats *stats)
+{
+	struct perf_obj *obj;
+
+	obj = perf_get_obj(fid);
+	if (!obj)
+		return -FI_EINVAL;
+
+	if (fid->fclass == FI_CLASS_FABRIC)
+		perf_stats_total(obj->fabric, stats);
+	else
+		*stats = obj->stats->data;
+	stats->cycles_per_sec = perf_cycles_per_sec();
+	return 0;
+}
+
+static int perf_reset(struct fid *fid)
+{
+	struct perf_obj *obj;
+	struct perf_stats *stats;
+
+	obj = perf_get_obj(fid);
+	if (!obj)
+		return -FI_EINVAL;
+
+	if (fid->fclass != FI_CLASS_FABRIC) {
+		memset(obj->stats->data.op, 0, sizeof(obj->stats->data.op));
+		return 0;
+	}
+
+	fastlock_acquire(&obj->fabric->lock);
+	memset(&obj->fabric->closed, 0, sizeof(obj->fabric->closed));
+	dlist_foreach_container(&obj->fabric->stats_list, struct perf_stats,
+				stats, entry)
+		memset(stats->data.op, 0, sizeof(stats->data.op));
+	fastlock_release(&obj->fabric->lock);
+	return 0;
+}
+
+static const char *perf_op_name(enum fi_perf_op op)
+{
+	return (op >= 0 && op < FI_PERF_OP_MAX) ? perf_op_names[op] : NULL;
+}
+
+struct fi_perf_ops perf_ops = {
+	.size = sizeof(struct fi_perf_ops),
+	.get_stats = perf_get_stats,
+	.reset = perf_reset,
+	.op_name = perf_op_name,
+};
+
+static int perf_close(struct fid *fid)
+{
+	struct perf_obj *obj;
+	uint64_t start;
+	int ret;
+
+	if (fid->fclass == FI_CLASS_FABRIC)
+		return perf_fabric_close(container_of(fid, struct perf_fabric,
+						      fabric_fid.fid));
+
+	obj = perf_get_obj(fid);
+	start = perf_cycles();
+	ret = fi_close(obj->hfid);
+	if (ret)
+		return ret;
+
+	switch (fid->fclass) {
+	case FI_CLASS_MR:
+		perf_record(obj->stats, FI_PERF_MR_CLOSE, start, ret, 0);
+		break;
+	case FI_CLASS_DOMAIN:
+	case FI_CLASS_EP:
+	case FI_CLASS_CQ:
+	case FI_CLASS_CNTR:
+		perf_stats_del(obj->fabric, obj->stats);
+		break;
+	default:
+		break;
+	}
+	free(fid);
+	return 0;
+}
+
+static int perf_bind(struct fid *fid, struct fid *bfid, uint64_t flags)
+{
+	struct fid *hfid = perf_get_obj(fid)->hfid;
+
+	return hfid->ops->bind(hfid, perf_hfid(bfid), flags);
+}
+
+static int perf_control(struct fid *fid, int command, void *arg)
+{
+	struct perf_obj *obj = perf_get_obj(fid);
+	struct fid_mr *hmr;
+	int ret;
+
+	/* an alias would hand out an unwrapped endpoint */
+	if (command == FI_ALIAS)
+		return -FI_ENOSYS;
+
+	ret = fi_control(obj->hfid, command, arg);
+	if (!ret && fid->fclass == FI_CLASS_MR) {
+		hmr = container_of(obj->hfid, struct fid_mr, fid);
+		container_of(fid, struct fid_mr, fid)->mem_desc = hmr->mem_desc;
+		container_of(fid, struct fid_mr, fid)->key = hmr->key;
+	}
+	return ret;
+}
+
+static int perf_ops_open(struct fid *fid, const char *name, uint64_t flags,
+			 void **ops, void *context)
+{
+	if (!strcasecmp(name, FI_PERF_OPS_1)) {
+		*ops = &perf_ops;
+		return 0;
+	}
+	return fi_open_ops(perf_get_obj(fid)->hfid, name, flags, ops, context);
+}
+
+struct fi_ops perf_fid_ops = {
+	.size = sizeof(struct fi_ops),
+	.close = perf_close,
+	.bind = perf_bind,
+	.control = perf_control,
+	.ops_open = perf_ops_open,
+};
+
+/* Rewrite an application fi_info for the provider below. */
+int perf_info_to_core(struct fi_info *info, struct fi_info **core_info)
+{
+	const char *core_name;
+	size_t len;
+
+	*core_info = fi_dupinfo(info);
+	if (!*core_info)
+		return -FI_ENOMEM;
+
+	if (info->handle)
+		(*core_info)->handle = perf_hfid(info->handle);
+
+	if (info->fabric_attr && info->fabric_attr->fabric)
+		(*core_info)->fabric_attr->fabric =
+			container_of(perf_hfid(&info->fabric_attr->fabric->fid),
+				     struct fid_fabric, fid);
+
+	if (info->domain_attr && info->domain_attr->domain)
+		(*core_info)->domain_attr->domain =
+			container_of(perf_hfid(&info->domain_attr->domain->fid),
+				     struct fid_domain, fid);
+
+	/* the framework reports our version in place of the core's */
+	if (info->fabric_attr)
+		(*core_info)->fabric_attr->prov_version = 0;
+
+	if (info->fabric_attr && info->fabric_attr->prov_name) {
+		free((*core_info)->fabric_attr->prov_name);
+		core_name = ofi_core_name(info->fabric_attr->prov_name, &len);
+		(*core_info)->fabric_attr->prov_name = core_name ?
+			strndup(core_name, len) : NULL;
+	}
+	return 0;
+}
+
+static int perf_requested(struct fi_info *hints)
+{
+	const char *name;
+	size_t len;
+
+	if (!hints || !hints->fabric_attr || !hints->fabric_attr->prov_name)
+		return 0;
+
+	name = ofi_util_name(hints->fabric_attr->prov_name, &len);
+	return name && len == strlen(perf_prov.name) &&
+	       !strncasecmp(name, perf_prov.name, len);
+}
+
+/* Only answer queries that name this provider: it adds nothing but
+ * overhead unless it was asked for. */
+static int perf_getinfo(uint32_t version, const char *node,
+			const char *service, uint64_t flags,
+			struct fi_info *hints, struct fi_info **info)
+{
+	struct fi_info *core_hints, *cur;
+	int ret;
+
+	if (!perf_requested(hints))
+		return -FI_ENODATA;
+
+	ret = perf_info_to_core(hints, &core_hints);
+	if (ret)
+		return ret;
+
+	ret = fi_getinfo(version, node, service, flags | OFI_CORE_PROV_ONLY,
+			 core_hints, info);
+	fi_freeinfo(core_hints);
+	if (ret)
+		return ret;
+
+	for (cur = *info; cur; cur = cur->next) {
+		if (cur->fabric_attr->fabric)
+			cur->fabric_attr->fabric = container_of(
+				perf_wrapper_fid(&cur->fabric_attr->fabric->fid),
+				struct fid_fabric, fid);
+		if (cur->domain_attr->domain)
+			cur->domain_attr->domain = container_of(
+				perf_wrapper_fid(&cur->domain_attr->domain->fid),
+				struct fid_domain, fid);
+	}
+	return 0;
+}
+
+static void perf_fini(void)
+{
+	/* yawn */
+}
+
+struct fi_provider perf_prov = {
+	.name = OFI_UTIL_PREFIX "perf",
+	.version = FI_VERSION(PERF_MAJOR_VERSION, PERF_MINOR_VERSION),
+	.fi_version = FI_VERSION(1, 5),
+	.getinfo = perf_getinfo,
+	.fabric = perf_fabric,
+	.cleanup = perf_fini
+};
+
+PERF_INI
+{
+	fi_param_define(&perf_prov, "report", FI_PARAM_BOOL,
+			"Print the call statistics of a fabric to stderr when "
+			"it is closed (default: yes)");
+	fi_param_get_bool(&perf_prov, "report", &perf_report);
+
+	return &perf_prov;
+}
@@ -246,6 +246,7 @@ static int psmx_getinfo(uint32_t version, const char *node, const char *service,
 			svc = atoi(service);
 		svc0 = svc;
 		dest_addr = (psm_epid_t *)ofi_ns_resolve_name(&ns, node, &svc);
+		ofi_ns_fini(&ns);
 		if (dest_addr) {
 			FI_INFO(&psmx_prov, FI_LOG_CORE,
 				"'%s:%u' resolved to <epid=0x%llx>:%u\n",
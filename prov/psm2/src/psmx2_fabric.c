@@ -58,6 +58,8 @@ static int psmx2_fabric_close(fid_t fid)
 	}
 	assert(fabric == psmx2_active_fabric);
 	psmx2_active_fabric = NULL;
+	if (psmx2_env.name_server)
+		ofi_ns_fini(&fabric->name_server);
 	free(fabric);
 
 	return 0;
@@ -128,8 +130,10 @@ int psmx2_fabric(struct fi_fabric_attr *attr,
 			     &fabric_priv->util_fabric, context);
 	if (ret) {
 		FI_INFO(&psmx2_prov, FI_LOG_CORE, "ofi_fabric_init returns %d\n", ret);
-		if (psmx2_env.name_server)
+		if (psmx2_env.name_server) {
 			ofi_ns_stop_server(&fabric_priv->name_server);
+			ofi_ns_fini(&fabric_priv->name_server);
+		}
 		free(fabric_priv);
 		return ret;
 	}
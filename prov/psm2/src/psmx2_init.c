@@ -307,6 +307,7 @@ static int psmx2_getinfo(uint32_t version, const char *node,
 		svc0 = svc;
 		dest_addr = (struct psmx2_ep_name *)
 			ofi_ns_resolve_name(&ns, node, &svc);
+		ofi_ns_fini(&ns);
 		if (dest_addr) {
 			FI_INFO(&psmx2_prov, FI_LOG_CORE,
 				"'%s:%u' resolved to <epid=0x%llx, vl=%d>:%d\n",
@@ -87,8 +87,10 @@
 
 #define RXD_MAX_PKT_RETRY	50
 
+#define RXD_MAX_CTX_BITS	6
+#define RXD_MAX_EP_CTX		(1 << RXD_MAX_CTX_BITS)
+
 extern int rxd_progress_spin_count;
-extern int rxd_reposted_bufs;
 
 extern struct fi_provider rxd_prov;
 extern struct fi_info rxd_info;
@@ -119,14 +121,29 @@ struct rxd_domain {
 	struct ofi_mr_map mr_map;
 };
 
+/*
+ * When opened with rx_ctx_bits, each AV entry references the datagram
+ * addresses of all receive contexts of a remote scalable endpoint.  The
+ * fi_addr_table maps datagram addresses back to AV entries without
+ * taking the AV lock on the receive path.
+ */
 struct rxd_av {
 	struct util_av util_av;
 	struct fid_av *dg_av;
 
 	int dg_av_used;
 	size_t dg_addrlen;
+
+	int rx_ctx_bits;
+	size_t dg_av_count;
+	fi_addr_t *fi_addr_table;
 };
 
+static inline size_t rxd_av_ctx_cnt(struct rxd_av *av)
+{
+	return (size_t) 1 << av->rx_ctx_bits;
+}
+
 struct rxd_cq;
 typedef int (*rxd_cq_write_fn)(struct rxd_cq *cq,
 			       struct fi_cq_tagged_entry *cq_entry);
@@ -145,11 +162,19 @@ struct rxd_peer {
 	uint16_t		active_tx_cnt;
 };
 
+struct rxd_sep;
+
 struct rxd_ep {
 	struct util_ep util_ep;
 	struct fid_ep *dg_ep;
 	struct fid_cq *dg_cq;
 
+	/* set when this endpoint is a context of a scalable endpoint */
+	struct rxd_sep *sep;
+	int ctx_ref;
+	int enabled;
+	size_t posted_bufs;
+
 	struct rxd_peer *peer_info;
 	size_t max_peers;
 
@@ -185,6 +210,26 @@ struct rxd_ep {
 	fastlock_t lock;
 };
 
+/*
+ * A scalable endpoint is a set of independent contexts.  Each context is a
+ * complete rxd endpoint with its own datagram endpoint, CQ, peer state and
+ * buffer pools, so contexts driven from different threads never contend.
+ * Transmit and receive context i share the same underlying endpoint, which
+ * lets the peer identify the sender from the receive context addresses.
+ */
+struct rxd_sep {
+	struct fid_ep ep_fid;
+	struct rxd_domain *domain;
+	struct fi_info *info;
+	struct rxd_av *av;
+	fastlock_t lock;
+
+	size_t tx_ctx_cnt;
+	size_t rx_ctx_cnt;
+	size_t ctx_cnt;
+	struct rxd_ep **ctx;
+};
+
 static inline struct rxd_domain *rxd_ep_domain(struct rxd_ep *ep)
 {
 	return container_of(ep->util_ep.domain, struct rxd_domain, util_domain);
@@ -358,6 +403,8 @@ int rxd_av_create(struct fid_domain *domain_fid, struct fi_av_attr *attr,
 		  struct fid_av **av, void *context);
 int rxd_endpoint(struct fid_domain *domain, struct fi_info *info,
 		 struct fid_ep **ep, void *context);
+int rxd_scalable_ep(struct fid_domain *domain, struct fi_info *info,
+		    struct fid_ep **sep, void *context);
 int rxd_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
 		struct fid_cq **cq_fid, void *context);
 int rxd_cntr_open(struct fid_domain *domain, struct fi_cntr_attr *attr,
@@ -371,8 +418,11 @@ fi_addr_t rxd_av_dg_addr(struct rxd_av *av, fi_addr_t fi_addr);
 fi_addr_t rxd_av_fi_addr(struct rxd_av *av, fi_addr_t dg_fiaddr);
 int rxd_av_dg_reverse_lookup(struct rxd_av *av, uint64_t start_idx,
 			     const void *addr, fi_addr_t *dg_fiaddr);
+int rxd_av_get_dg_addrlen(struct rxd_av *av, const void *addr, size_t *addrlen);
 
 /* EP sub-functions */
+int rxd_ep_bind_av(struct rxd_ep *ep, struct rxd_av *av);
+int rxd_ep_free(struct rxd_ep *ep);
 void rxd_handle_send_comp(struct fi_cq_msg_entry *comp);
 void rxd_handle_recv_comp(struct rxd_ep *ep, struct fi_cq_msg_entry *comp);
 int rxd_ep_repost_buff(struct rxd_rx_buf *rx_buf);
@@ -33,7 +33,7 @@
 #include "rxd.h"
 
 #define RXD_EP_CAPS (FI_MSG | FI_TAGGED | FI_DIRECTED_RECV |	\
-		     FI_RECV | FI_SEND | FI_SOURCE)
+		     FI_RECV | FI_SEND | FI_SOURCE | FI_NAMED_RX_CTX)
 
 struct fi_tx_attr rxd_tx_attr = {
 	.caps = RXD_EP_CAPS,
@@ -70,10 +70,10 @@ struct fi_domain_attr rxd_domain_attr = {
 	.mr_key_size = sizeof(uint64_t),
 	.cq_cnt = 128,
 	.ep_cnt = 128,
-	.tx_ctx_cnt = 1,
-	.rx_ctx_cnt = 1,
-	.max_ep_tx_ctx = 1,
-	.max_ep_rx_ctx = 1,
+	.tx_ctx_cnt = RXD_MAX_EP_CTX,
+	.rx_ctx_cnt = RXD_MAX_EP_CTX,
+	.max_ep_tx_ctx = RXD_MAX_EP_CTX,
+	.max_ep_rx_ctx = RXD_MAX_EP_CTX,
 	.mr_iov_limit = 1,
 };
 
@@ -88,17 +88,42 @@ close:
 fi_addr_t rxd_av_dg_addr(struct rxd_av *av, fi_addr_t fi_addr)
 {
 	uint64_t *dg_idx;
+	int ctx = 0;
+
+	if (av->rx_ctx_bits) {
+		ctx = (int) (fi_addr >> (64 - av->rx_ctx_bits));
+		fi_addr &= (1ULL << (64 - av->rx_ctx_bits)) - 1;
+	}
 
 	dg_idx = ofi_av_get_addr(&av->util_av, (int) fi_addr);
-	return *dg_idx;
+	return dg_idx[ctx];
+}
+
+int rxd_av_get_dg_addrlen(struct rxd_av *av, const void *addr, size_t *addrlen)
+{
+	int ret = 0;
+
+	fastlock_acquire(&av->util_av.lock);
+	if (!av->dg_addrlen)
+		ret = rxd_av_set_addrlen(av, addr);
+	*addrlen = av->dg_addrlen;
+	fastlock_release(&av->util_av.lock);
+	return ret;
+}
+
+static fi_addr_t rxd_av_ctx_addr(struct rxd_av *av, fi_addr_t fi_addr,
+				 size_t ctx)
+{
+	return av->rx_ctx_bits ?
+		fi_rx_addr(fi_addr, (int) ctx, av->rx_ctx_bits) : fi_addr;
 }
 
 fi_addr_t rxd_av_fi_addr(struct rxd_av *av, fi_addr_t dg_fiaddr)
 {
-	int ret;
+	if (dg_fiaddr >= av->dg_av_count)
+		return FI_ADDR_UNSPEC;
 
-	ret = ofi_av_lookup_index(&av->util_av, &dg_fiaddr, (int) dg_fiaddr);
-	return (ret < 0) ? FI_ADDR_UNSPEC : ret;
+	return av->fi_addr_table[dg_fiaddr];
 }
 
 int rxd_av_dg_reverse_lookup(struct rxd_av *av, uint64_t start_idx,
@@ -112,7 +137,7 @@ int rxd_av_dg_reverse_lookup(struct rxd_av *av, uint64_t start_idx,
 		len = sizeof curr_addr;
 		ret = fi_av_lookup(av->dg_av, (i + start_idx) % av->dg_av_used,
 				   curr_addr, &len);
-		if (!ret) {
+		if (!ret && !memcmp(curr_addr, addr, av->dg_addrlen)) {
 			*dg_fiaddr = (i + start_idx) % av->dg_av_used;
 			FI_DBG(&rxd_prov, FI_LOG_AV, "found: %" PRIu64 "\n",
 				*dg_fiaddr);
@@ -150,12 +175,17 @@ out:
 	return ret;
 }
 
+/*
+ * Addresses inserted into an AV opened with rx_ctx_bits are scalable
+ * endpoint names: the datagram addresses of 2^rx_ctx_bits receive contexts.
+ */
 static int rxd_av_insert(struct fid_av *av_fid, const void *addr, size_t count,
 			fi_addr_t *fi_addr, uint64_t flags, void *context)
 {
 	struct rxd_av *av;
 	int i = 0, index, ret = 0, success_cnt = 0, lookup = 1;
-	uint64_t dg_fiaddr;
+	uint64_t dg_fiaddr[1 << RXD_MAX_CTX_BITS];
+	size_t ctx;
 
 	av = container_of(av_fid, struct rxd_av, util_av.av_fid);
 	fastlock_acquire(&av->util_av.lock);
@@ -167,20 +197,38 @@ static int rxd_av_insert(struct fid_av *av_fid, const void *addr, size_t count,
 		lookup = 0;
 	}
 
-	for (; i < count; i++, addr = (uint8_t *) addr + av->dg_addrlen) {
-		ret = lookup ? rxd_av_dg_reverse_lookup(av, i, addr, &dg_fiaddr) :
-				-FI_ENODATA;
-		if (ret) {
-			ret = fi_av_insert(av->dg_av, addr, 1, &dg_fiaddr,
-					   flags, context);
-			if (ret != 1)
-				break;
+	for (; i < count; i++) {
+		for (ctx = 0; ctx < rxd_av_ctx_cnt(av); ctx++,
+		     addr = (uint8_t *) addr + av->dg_addrlen) {
+			ret = lookup ? rxd_av_dg_reverse_lookup(av, i, addr,
+								&dg_fiaddr[ctx]) :
+					-FI_ENODATA;
+			if (ret) {
+				/* peer tables are sized to the initial count */
+				if (av->dg_av_used >= av->dg_av_count) {
+					ret = -FI_ENOSPC;
+					break;
+				}
+				ret = fi_av_insert(av->dg_av, addr, 1,
+						   &dg_fiaddr[ctx], flags, context);
+				if (ret != 1)
+					break;
+				av->dg_av_used++;
+				ret = 0;
+			}
 		}
+		if (ret)
+			break;
 
-		ret = ofi_av_insert_addr(&av->util_av, &dg_fiaddr, dg_fiaddr, &index);
+		ret = ofi_av_insert_addr(&av->util_av, dg_fiaddr, &index);
 		if (ret)
 			break;
 
+		for (ctx = 0; ctx < rxd_av_ctx_cnt(av); ctx++) {
+			if (dg_fiaddr[ctx] < av->dg_av_count)
+				av->fi_addr_table[dg_fiaddr[ctx]] = index;
+		}
+
 		success_cnt++;
 		if (fi_addr)
 			fi_addr[i] = index;
@@ -197,7 +245,6 @@ static int rxd_av_insert(struct fid_av *av_fid, const void *addr, size_t count,
 		i++;
 	}
 out:
-	av->dg_av_used += success_cnt;
 	fastlock_release(&av->util_av.lock);
 
 	for (; i < count; i++) {
@@ -233,19 +280,25 @@ static int rxd_av_remove(struct fid_av *av_fid, fi_addr_t *fi_addr, size_t count
 			uint64_t flags)
 {
 	int ret = 0;
-	size_t i;
+	size_t i, ctx;
 	fi_addr_t dg_fiaddr;
 	struct rxd_av *av;
 
 	av = container_of(av_fid, struct rxd_av, util_av.av_fid);
 	fastlock_acquire(&av->util_av.lock);
 	for (i = 0; i < count; i++) {
-		dg_fiaddr = rxd_av_dg_addr(av, fi_addr[i]);
-		ret = fi_av_remove(av->dg_av, &dg_fiaddr, 1, flags);
-		if (ret)
-			break;
-		av->dg_av_used--;
+		for (ctx = 0; ctx < rxd_av_ctx_cnt(av); ctx++) {
+			dg_fiaddr = rxd_av_dg_addr(av,
+					rxd_av_ctx_addr(av, fi_addr[i], ctx));
+			ret = fi_av_remove(av->dg_av, &dg_fiaddr, 1, flags);
+			if (ret)
+				goto out;
+			if (dg_fiaddr < av->dg_av_count)
+				av->fi_addr_table[dg_fiaddr] = FI_ADDR_UNSPEC;
+			av->dg_av_used--;
+		}
 	}
+out:
 	fastlock_release(&av->util_av.lock);
 	return ret;
 }
@@ -263,10 +316,28 @@ static int rxd_av_lookup(struct fid_av *av, fi_addr_t fi_addr, void *addr,
 {
 	struct rxd_av *rxd_av;
 	fi_addr_t dg_addr;
+	uint8_t ctx_addr[RXD_MAX_DGRAM_ADDR];
+	size_t ctx, len, total = 0;
+	int ret;
 
 	rxd_av = container_of(av, struct rxd_av, util_av.av_fid);
-	dg_addr = rxd_av_dg_addr(rxd_av, fi_addr);
-	return fi_av_lookup(rxd_av->dg_av, dg_addr, addr, addrlen);
+	for (ctx = 0; ctx < rxd_av_ctx_cnt(rxd_av); ctx++) {
+		dg_addr = rxd_av_dg_addr(rxd_av,
+				rxd_av_ctx_addr(rxd_av, fi_addr, ctx));
+		len = sizeof ctx_addr;
+		ret = fi_av_lookup(rxd_av->dg_av, dg_addr, ctx_addr, &len);
+		if (ret)
+			return ret;
+
+		if (total < *addrlen)
+			memcpy((uint8_t *) addr + total, ctx_addr,
+			       MIN(len, *addrlen - total));
+		total += len;
+	}
+
+	ret = (total > *addrlen) ? -FI_ETOOSMALL : 0;
+	*addrlen = total;
+	return ret;
 }
 
 static struct fi_ops_av rxd_av_ops = {
@@ -293,6 +364,7 @@ static int rxd_av_close(struct fid *fid)
 	if (ret)
 		return ret;
 
+	free(av->fi_addr_table);
 	free(av);
 	return 0;
 }
@@ -318,6 +390,7 @@ int rxd_av_create(struct fid_domain *domain_fid, struct fi_av_attr *attr,
 	struct rxd_domain *domain;
 	struct util_av_attr util_attr;
 	struct fi_av_attr av_attr;
+	size_t i;
 
 	if (!attr)
 		return -FI_EINVAL;
@@ -325,14 +398,17 @@ int rxd_av_create(struct fid_domain *domain_fid, struct fi_av_attr *attr,
 	if (attr->name)
 		return -FI_ENOSYS;
 
+	if (attr->rx_ctx_bits < 0 || attr->rx_ctx_bits > RXD_MAX_CTX_BITS)
+		return -FI_EINVAL;
+
 	domain = container_of(domain_fid, struct rxd_domain, util_domain.domain_fid);
 	av = calloc(1, sizeof(*av));
 	if (!av)
 		return -FI_ENOMEM;
 
-	util_attr.addrlen = sizeof(fi_addr_t);
-	util_attr.overhead = attr->count;
-	util_attr.flags = FI_SOURCE;
+	av->rx_ctx_bits = attr->rx_ctx_bits;
+	util_attr.addrlen = sizeof(fi_addr_t) * rxd_av_ctx_cnt(av);
+	util_attr.flags = 0;
 	if (attr->type == FI_AV_UNSPEC)
 		attr->type = FI_AV_TABLE;
 
@@ -341,19 +417,31 @@ int rxd_av_create(struct fid_domain *domain_fid, struct fi_av_attr *attr,
 	if (ret)
 		goto err1;
 
+	av->dg_av_count = av->util_av.count * rxd_av_ctx_cnt(av);
+	av->fi_addr_table = malloc(av->dg_av_count * sizeof(fi_addr_t));
+	if (!av->fi_addr_table) {
+		ret = -FI_ENOMEM;
+		goto err2;
+	}
+	for (i = 0; i < av->dg_av_count; i++)
+		av->fi_addr_table[i] = FI_ADDR_UNSPEC;
+
 	av_attr = *attr;
 	av_attr.type = FI_AV_TABLE;
-	av_attr.count = 0;
+	av_attr.count = av->dg_av_count;
+	av_attr.rx_ctx_bits = 0;
 	av_attr.flags = 0;
 	ret = fi_av_open(domain->dg_domain, &av_attr, &av->dg_av, context);
 	if (ret)
-		goto err2;
+		goto err3;
 
 	av->util_av.av_fid.fid.ops = &rxd_av_fi_ops;
 	av->util_av.av_fid.ops = &rxd_av_ops;
 	*av_fid = &av->util_av.av_fid;
 	return 0;
 
+err3:
+	free(av->fi_addr_table);
 err2:
 	ofi_av_close(&av->util_av);
 err1:
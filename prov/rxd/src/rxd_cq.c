@@ -1069,7 +1069,7 @@ static void rxd_handle_start_data(struct rxd_ep *ep, struct rxd_peer *peer,
 repost:
 	rxd_ep_repost_buff(rx_buf);
 out:
-	assert(rxd_reposted_bufs);
+	assert(ep->posted_bufs);
 	return;
 }
 
@@ -1081,8 +1081,8 @@ void rxd_handle_recv_comp(struct rxd_ep *ep, struct fi_cq_msg_entry *comp)
 
 	FI_DBG(&rxd_prov, FI_LOG_EP_CTRL, "got recv completion\n");
 
-	assert(rxd_reposted_bufs);
-	rxd_reposted_bufs--;
+	assert(ep->posted_bufs);
+	ep->posted_bufs--;
 
 	rx_buf = container_of(comp->op_context, struct rxd_rx_buf, context);
 	ctrl = (struct ofi_ctrl_hdr *) rx_buf->buf;
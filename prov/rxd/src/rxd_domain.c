@@ -42,7 +42,7 @@ static struct fi_ops_domain rxd_domain_ops = {
 	.av_open = rxd_av_create,
 	.cq_open = rxd_cq_open,
 	.endpoint = rxd_endpoint,
-	.scalable_ep = fi_no_scalable_ep,
+	.scalable_ep = rxd_scalable_ep,
 	.cntr_open = rxd_cntr_open,
 	.poll_open = fi_poll_create,
 	.stx_ctx = fi_no_stx_context,
@@ -37,7 +37,6 @@
 #include "rxd.h"
 
 int rxd_progress_spin_count = 1000;
-int rxd_reposted_bufs = 0;
 
 static ssize_t rxd_ep_cancel(fid_t fid, void *context)
 {
@@ -193,7 +192,7 @@ int rxd_ep_repost_buff(struct rxd_rx_buf *buf)
 	if (ret)
 		FI_WARN(&rxd_prov, FI_LOG_EP_CTRL, "failed to repost\n");
 	else
-		rxd_reposted_bufs++;
+		buf->ep->posted_bufs++;
 	return ret;
 }
 
@@ -228,6 +227,10 @@ static int rxd_ep_enable(struct rxd_ep *ep)
 	void *mr = NULL;
 	struct rxd_rx_buf *rx_buf;
 
+	/* Transmit and receive contexts of a scalable EP share the endpoint */
+	if (ep->enabled)
+		return 0;
+
 	ret = fi_enable(ep->dg_ep);
 	if (ret)
 		return ret;
@@ -251,6 +254,7 @@ static int rxd_ep_enable(struct rxd_ep *ep)
 			goto out;
 		slist_insert_tail(&rx_buf->entry, &ep->rx_pkt_list);
 	}
+	ep->enabled = 1;
 out:
 	fastlock_release(&ep->lock);
 	return ret;
@@ -1287,14 +1291,12 @@ static void rxd_ep_free_buf_pools(struct rxd_ep *ep)
 		rxd_trecv_fs_free(ep->trecv_fs);
 }
 
-static int rxd_ep_close(struct fid *fid)
+int rxd_ep_free(struct rxd_ep *ep)
 {
 	int ret;
-	struct rxd_ep *ep;
 	struct slist_entry *entry;
 	struct rxd_rx_buf *buf;
 
-	ep = container_of(fid, struct rxd_ep, util_ep.ep_fid.fid);
 	ret = fi_close(&ep->dg_ep->fid);
 	if (ret)
 		return ret;
@@ -1333,6 +1335,22 @@ static int rxd_ep_close(struct fid *fid)
 	return 0;
 }
 
+static int rxd_ep_close(struct fid *fid)
+{
+	struct rxd_ep *ep;
+
+	ep = container_of(fid, struct rxd_ep, util_ep.ep_fid.fid);
+	if (ep->sep) {
+		/* Contexts are released when the scalable EP is closed */
+		fastlock_acquire(&ep->sep->lock);
+		ep->ctx_ref--;
+		fastlock_release(&ep->sep->lock);
+		return 0;
+	}
+
+	return rxd_ep_free(ep);
+}
+
 static int rxd_ep_bind_cq(struct rxd_ep *ep, struct rxd_cq *cq, uint64_t flags)
 {
 	int ret;
@@ -1369,6 +1387,26 @@ static int rxd_ep_bind_cq(struct rxd_ep *ep, struct rxd_cq *cq, uint64_t flags)
 	return 0;
 }
 
+int rxd_ep_bind_av(struct rxd_ep *ep, struct rxd_av *av)
+{
+	int ret;
+
+	ret = ofi_ep_bind_av(&ep->util_ep, &av->util_av);
+	if (ret)
+		return ret;
+
+	ret = fi_ep_bind(ep->dg_ep, &av->dg_av->fid, 0);
+	if (ret)
+		return ret;
+
+	/* Peer state is private to the endpoint, indexed by datagram address */
+	ep->peer_info = calloc(av->dg_av_count, sizeof(struct rxd_peer));
+	ep->max_peers = av->dg_av_count;
+	if (!ep->peer_info)
+		return -FI_ENOMEM;
+	return 0;
+}
+
 static int rxd_ep_bind(struct fid *ep_fid, struct fid *bfid, uint64_t flags)
 {
 	struct rxd_ep *ep;
@@ -1379,18 +1417,7 @@ static int rxd_ep_bind(struct fid *ep_fid, struct fid *bfid, uint64_t flags)
 	switch (bfid->fclass) {
 	case FI_CLASS_AV:
 		av = container_of(bfid, struct rxd_av, util_av.av_fid.fid);
-		ret = ofi_ep_bind_av(&ep->util_ep, &av->util_av);
-		if (ret)
-			return ret;
-
-		ret = fi_ep_bind(ep->dg_ep, &av->dg_av->fid, flags);
-		if (ret)
-			return ret;
-
-		ep->peer_info = calloc(av->util_av.count, sizeof(struct rxd_peer));
-		ep->max_peers = av->util_av.count;
-		if (!ep->peer_info)
-			return -FI_ENOMEM;
+		ret = rxd_ep_bind_av(ep, av);
 		break;
 	case FI_CLASS_CQ:
 		ret = rxd_ep_bind_cq(ep, container_of(bfid, struct rxd_cq,
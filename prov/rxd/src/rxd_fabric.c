@@ -40,7 +40,7 @@ static struct fi_ops_fabric rxd_fabric_ops = {
 	.domain = &rxd_domain_open,
 	.passive_ep = fi_no_passive_ep,
 	.eq_open = ofi_eq_create,
-	.wait_open = ofi_wait_fd_open,
+	.wait_open = ofi_wait_open,
 	.trywait = ofi_trywait
 };
 
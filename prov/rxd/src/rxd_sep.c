@@ -0,0 +1,349 @@
+/*
+ * Copyright (c) 2017 Intel Corporation, Inc.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rxd.h"
+
+
+static int rxd_sep_ctx_bits(size_t ctx_cnt)
+{
+	int bits = 0;
+
+	while (((size_t) 1 << bits) < ctx_cnt)
+		bits++;
+	return bits;
+}
+
+static void rxd_sep_free_ctx(struct rxd_sep *sep)
+{
+	size_t i;
+
+	for (i = 0; i < sep->ctx_cnt; i++) {
+		if (sep->ctx[i] && !rxd_ep_free(sep->ctx[i]))
+			sep->ctx[i] = NULL;
+	}
+}
+
+static int rxd_sep_close(struct fid *fid)
+{
+	struct rxd_sep *sep;
+	size_t i;
+
+	sep = container_of(fid, struct rxd_sep, ep_fid.fid);
+	fastlock_acquire(&sep->lock);
+	for (i = 0; i < sep->ctx_cnt; i++) {
+		if (sep->ctx[i] && sep->ctx[i]->ctx_ref) {
+			fastlock_release(&sep->lock);
+			FI_WARN(&rxd_prov, FI_LOG_EP_CTRL,
+				"context %zu still open\n", i);
+			return -FI_EBUSY;
+		}
+	}
+	fastlock_release(&sep->lock);
+
+	rxd_sep_free_ctx(sep);
+	for (i = 0; i < sep->ctx_cnt; i++) {
+		if (sep->ctx[i])
+			return -FI_EBUSY;
+	}
+
+	fastlock_destroy(&sep->lock);
+	fi_freeinfo(sep->info);
+	free(sep->ctx);
+	free(sep);
+	return 0;
+}
+
+static int rxd_sep_bind(struct fid *fid, struct fid *bfid, uint64_t flags)
+{
+	struct rxd_sep *sep;
+	struct rxd_av *av;
+	size_t i;
+	int ret;
+
+	sep = container_of(fid, struct rxd_sep, ep_fid.fid);
+	switch (bfid->fclass) {
+	case FI_CLASS_AV:
+		av = container_of(bfid, struct rxd_av, util_av.av_fid.fid);
+		for (i = 0; i < sep->ctx_cnt; i++) {
+			ret = rxd_ep_bind_av(sep->ctx[i], av);
+			if (ret)
+				return ret;
+		}
+		sep->av = av;
+		return 0;
+	case FI_CLASS_EQ:
+		return 0;
+	default:
+		FI_WARN(&rxd_prov, FI_LOG_EP_CTRL,
+			"CQs and counters must be bound to the contexts\n");
+		return -FI_EINVAL;
+	}
+}
+
+static int rxd_sep_control(struct fid *fid, int command, void *arg)
+{
+	switch (command) {
+	case FI_ENABLE:
+		/* Each transmit and receive context is enabled separately */
+		return 0;
+	default:
+		return -FI_ENOSYS;
+	}
+}
+
+static struct fi_ops rxd_sep_fi_ops = {
+	.size = sizeof(struct fi_ops),
+	.close = rxd_sep_close,
+	.bind = rxd_sep_bind,
+	.control = rxd_sep_control,
+	.ops_open = fi_no_ops_open,
+};
+
+static int rxd_sep_get_ctx(struct rxd_sep *sep, int index,
+			   struct fid_ep **ctx_ep, void *context)
+{
+	struct rxd_ep *ep;
+
+	fastlock_acquire(&sep->lock);
+	ep = sep->ctx[index];
+	ep->ctx_ref++;
+	ep->util_ep.ep_fid.fid.context = context;
+	fastlock_release(&sep->lock);
+
+	*ctx_ep = &ep->util_ep.ep_fid;
+	return 0;
+}
+
+static int rxd_sep_tx_ctx(struct fid_ep *ep, int index, struct fi_tx_attr *attr,
+			  struct fid_ep **tx_ep, void *context)
+{
+	struct rxd_sep *sep;
+
+	sep = container_of(ep, struct rxd_sep, ep_fid);
+	if (index < 0 || (size_t) index >= sep->tx_ctx_cnt)
+		return -FI_EINVAL;
+
+	return rxd_sep_get_ctx(sep, index, tx_ep, context);
+}
+
+static int rxd_sep_rx_ctx(struct fid_ep *ep, int index, struct fi_rx_attr *attr,
+			  struct fid_ep **rx_ep, void *context)
+{
+	struct rxd_sep *sep;
+
+	sep = container_of(ep, struct rxd_sep, ep_fid);
+	if (index < 0 || (size_t) index >= sep->rx_ctx_cnt)
+		return -FI_EINVAL;
+
+	return rxd_sep_get_ctx(sep, index, rx_ep, context);
+}
+
+static struct fi_ops_ep rxd_sep_ops = {
+	.size = sizeof(struct fi_ops_ep),
+	.cancel = fi_no_cancel,
+	.getopt = fi_no_getopt,
+	.setopt = fi_no_setopt,
+	.tx_ctx = rxd_sep_tx_ctx,
+	.rx_ctx = rxd_sep_rx_ctx,
+	.rx_size_left = fi_no_rx_size_left,
+	.tx_size_left = fi_no_tx_size_left,
+};
+
+/*
+ * The name of a scalable endpoint is the list of its receive context
+ * datagram addresses, padded to a power of two by repeating contexts.
+ * Each address occupies the size used by the datagram AV, so peers can
+ * insert the name into an AV opened with the matching rx_ctx_bits.
+ */
+static int rxd_sep_getname(fid_t fid, void *addr, size_t *addrlen)
+{
+	struct rxd_sep *sep;
+	uint8_t ctx_addr[RXD_MAX_DGRAM_ADDR];
+	size_t i, len, dg_addrlen, total;
+	int ret;
+
+	sep = container_of(fid, struct rxd_sep, ep_fid.fid);
+	if (!sep->av)
+		return -FI_EOPBADSTATE;
+
+	total = 0;
+	dg_addrlen = 0;
+	for (i = 0; i < (1 << rxd_sep_ctx_bits(sep->rx_ctx_cnt)); i++) {
+		memset(ctx_addr, 0, sizeof ctx_addr);
+		len = sizeof ctx_addr;
+		ret = fi_getname(&sep->ctx[i % sep->rx_ctx_cnt]->dg_ep->fid,
+				 ctx_addr, &len);
+		if (ret)
+			return ret;
+
+		if (!dg_addrlen) {
+			ret = rxd_av_get_dg_addrlen(sep->av, ctx_addr,
+						    &dg_addrlen);
+			if (ret)
+				return ret;
+		}
+
+		if (len > dg_addrlen)
+			return -FI_EINVAL;
+
+		if (total < *addrlen)
+			memcpy((uint8_t *) addr + total, ctx_addr,
+			       MIN(dg_addrlen, *addrlen - total));
+		total += dg_addrlen;
+	}
+
+	ret = (total > *addrlen) ? -FI_ETOOSMALL : 0;
+	*addrlen = total;
+	return ret;
+}
+
+static struct fi_ops_cm rxd_sep_cm = {
+	.size = sizeof(struct fi_ops_cm),
+	.setname = fi_no_setname,
+	.getname = rxd_sep_getname,
+	.getpeer = fi_no_getpeer,
+	.connect = fi_no_connect,
+	.listen = fi_no_listen,
+	.accept = fi_no_accept,
+	.reject = fi_no_reject,
+	.shutdown = fi_no_shutdown,
+	.join = fi_no_join,
+};
+
+static int rxd_sep_open_ctx(struct rxd_sep *sep, size_t index, void *context)
+{
+	struct fi_info *ctx_info;
+	struct fid_ep *ep_fid;
+	int ret;
+
+	ctx_info = fi_dupinfo(sep->info);
+	if (!ctx_info)
+		return -FI_ENOMEM;
+
+	ctx_info->ep_attr->tx_ctx_cnt = 1;
+	ctx_info->ep_attr->rx_ctx_cnt = 1;
+
+	/* Only the first context may claim a user specified address */
+	if (index) {
+		free(ctx_info->src_addr);
+		ctx_info->src_addr = NULL;
+		ctx_info->src_addrlen = 0;
+	}
+
+	ret = rxd_endpoint(&sep->domain->util_domain.domain_fid, ctx_info,
+			   &ep_fid, context);
+	fi_freeinfo(ctx_info);
+	if (ret)
+		return ret;
+
+	sep->ctx[index] = container_of(ep_fid, struct rxd_ep, util_ep.ep_fid);
+	sep->ctx[index]->sep = sep;
+	return 0;
+}
+
+int rxd_scalable_ep(struct fid_domain *domain, struct fi_info *info,
+		    struct fid_ep **sep_fid, void *context)
+{
+	struct rxd_sep *sep;
+	size_t i;
+	int ret;
+
+	if (!info || !info->ep_attr || info->ep_attr->type != FI_EP_RDM)
+		return -FI_EINVAL;
+
+	sep = calloc(1, sizeof(*sep));
+	if (!sep)
+		return -FI_ENOMEM;
+
+	sep->domain = container_of(domain, struct rxd_domain,
+				   util_domain.domain_fid);
+	sep->tx_ctx_cnt = info->ep_attr->tx_ctx_cnt ?
+			  info->ep_attr->tx_ctx_cnt : 1;
+	sep->rx_ctx_cnt = info->ep_attr->rx_ctx_cnt ?
+			  info->ep_attr->rx_ctx_cnt : 1;
+	if (sep->tx_ctx_cnt > RXD_MAX_EP_CTX ||
+	    sep->rx_ctx_cnt > RXD_MAX_EP_CTX) {
+		FI_WARN(&rxd_prov, FI_LOG_EP_CTRL,
+			"requested context count exceeds supported\n");
+		ret = -FI_EINVAL;
+		goto err1;
+	}
+	/* The name only lists receive contexts, so peers could not resolve
+	 * the source of a transmit context without a matching one */
+	if (sep->tx_ctx_cnt > sep->rx_ctx_cnt) {
+		FI_WARN(&rxd_prov, FI_LOG_EP_CTRL,
+			"tx_ctx_cnt may not exceed rx_ctx_cnt\n");
+		ret = -FI_EINVAL;
+		goto err1;
+	}
+	sep->ctx_cnt = sep->rx_ctx_cnt;
+
+	sep->info = fi_dupinfo(info);
+	if (!sep->info) {
+		ret = -FI_ENOMEM;
+		goto err1;
+	}
+
+	sep->ctx = calloc(sep->ctx_cnt, sizeof(*sep->ctx));
+	if (!sep->ctx) {
+		ret = -FI_ENOMEM;
+		goto err2;
+	}
+
+	for (i = 0; i < sep->ctx_cnt; i++) {
+		ret = rxd_sep_open_ctx(sep, i, context);
+		if (ret)
+			goto err3;
+	}
+
+	fastlock_init(&sep->lock);
+	sep->ep_fid.fid.fclass = FI_CLASS_SEP;
+	sep->ep_fid.fid.context = context;
+	sep->ep_fid.fid.ops = &rxd_sep_fi_ops;
+	sep->ep_fid.ops = &rxd_sep_ops;
+	sep->ep_fid.cm = &rxd_sep_cm;
+
+	*sep_fid = &sep->ep_fid;
+	return 0;
+
+err3:
+	rxd_sep_free_ctx(sep);
+	free(sep->ctx);
+err2:
+	fi_freeinfo(sep->info);
+err1:
+	free(sep);
+	return ret;
+}
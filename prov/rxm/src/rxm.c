@@ -30,56 +30,345 @@
  * SOFTWARE.
  */
 
+#include <inttypes.h>
+#include <fasthash.h>
+
 #include "rxm.h"
 
-#define rxm_entry_pop(queue, entry)			\
-	do {						\
-		fastlock_acquire(&queue->lock);		\
-		entry = freestack_isempty(queue->fs) ?	\
-			NULL : freestack_pop(queue->fs);\
-		fastlock_release(&queue->lock);		\
-	} while (0)
+#define RXM_MATCH_HASH_SEED 0x4f46494d
 
 #define rxm_entry_push(queue, entry)			\
 	do {						\
-		fastlock_acquire(&queue->lock);		\
+		rxm_lock(&queue->lock, queue->thread_safe);	\
 		freestack_push(queue->fs, entry);	\
-		fastlock_release(&queue->lock);		\
+		rxm_unlock(&queue->lock, queue->thread_safe);	\
 	} while (0)
 
 char *rxm_proto_state_str[] = {
 	RXM_PROTO_STATES(OFI_STR)
 };
 
-struct rxm_tx_entry *rxm_tx_entry_get(struct rxm_send_queue *queue)
+/*
+ * The tx entry, its buffer and the message id are taken in a single
+ * critical section.  The id is only used by the large message and
+ * segmentation protocols but costs no more than an increment here.
+ */
+struct rxm_tx_entry *rxm_tx_entry_get(struct rxm_ep *rxm_ep,
+				      struct rxm_conn *rxm_conn, int tx_buf)
 {
+	struct rxm_send_queue *queue = &rxm_ep->send_queue;
 	struct rxm_tx_entry *entry;
-	rxm_entry_pop(queue, entry);
-	if (!entry) {
+	struct rxm_tx_buf *buf = NULL;
+
+	rxm_lock(&queue->lock, queue->thread_safe);
+	if (freestack_isempty(queue->fs)) {
+		rxm_unlock(&queue->lock, queue->thread_safe);
 		FI_WARN(&rxm_prov, FI_LOG_CQ, "Exhausted tx_entry freestack\n");
 		return NULL;
 	}
+	if (tx_buf) {
+		buf = (struct rxm_tx_buf *)rxm_buf_get(&rxm_ep->tx_pool);
+		if (!buf) {
+			rxm_unlock(&queue->lock, queue->thread_safe);
+			FI_WARN(&rxm_prov, FI_LOG_CQ, "TX queue full!\n");
+			return NULL;
+		}
+	}
+	entry = freestack_pop(queue->fs);
+	entry->msg_id = ofi_idx2key(&queue->tx_key_idx,
+				    rxm_txe_fs_index(queue->fs, entry));
+	rxm_unlock(&queue->lock, queue->thread_safe);
+
 	entry->state = RXM_NONE;
+	entry->tx_buf = buf;
+	entry->conn = rxm_conn;
+	if (rxm_conn)
+		ofi_atomic_inc32(&rxm_conn->inflight);
 	return entry;
 }
 
-void rxm_tx_entry_release(struct rxm_send_queue *queue, struct rxm_tx_entry *entry)
+/* Releases the entry's buffer along with it */
+void rxm_tx_entry_release(struct rxm_ep *rxm_ep, struct rxm_tx_entry *entry)
+{
+	struct rxm_send_queue *queue = &rxm_ep->send_queue;
+	struct rxm_conn *rxm_conn = entry->conn;
+
+	rxm_lock(&queue->lock, queue->thread_safe);
+	if (entry->tx_buf)
+		rxm_buf_release(&rxm_ep->tx_pool, &entry->tx_buf->hdr);
+	freestack_push(queue->fs, entry);
+	rxm_unlock(&queue->lock, queue->thread_safe);
+
+	if (!rxm_conn)
+		return;
+
+	/* A connection already deleted from the cmap is freed here.  Otherwise
+	 * the connection must not be touched after the decrement, the cmap may
+	 * free it at any time.  Eviction of an idle connection is picked up
+	 * by progress. */
+	if (!ofi_atomic_dec32(&rxm_conn->inflight))
+		free(rxm_conn);
+}
+
+struct rxm_tx_buf *rxm_tx_buf_get(struct rxm_ep *rxm_ep)
+{
+	struct rxm_send_queue *queue = &rxm_ep->send_queue;
+	struct rxm_tx_buf *buf;
+
+	rxm_lock(&queue->lock, queue->thread_safe);
+	buf = (struct rxm_tx_buf *)rxm_buf_get(&rxm_ep->tx_pool);
+	rxm_unlock(&queue->lock, queue->thread_safe);
+	return buf;
+}
+
+void rxm_tx_buf_release(struct rxm_ep *rxm_ep, struct rxm_tx_buf *tx_buf)
+{
+	struct rxm_send_queue *queue = &rxm_ep->send_queue;
+
+	rxm_lock(&queue->lock, queue->thread_safe);
+	rxm_buf_release(&rxm_ep->tx_pool, &tx_buf->hdr);
+	rxm_unlock(&queue->lock, queue->thread_safe);
+}
+
+void rxm_recv_entry_release(struct rxm_recv_queue *queue, struct rxm_recv_entry *entry)
 {
 	rxm_entry_push(queue, entry);
 }
 
-struct rxm_recv_entry *rxm_recv_entry_get(struct rxm_recv_queue *queue)
+static inline struct dlist_entry *
+rxm_match_bucket(struct dlist_entry *hash, fi_addr_t addr, uint64_t tag)
+{
+	uint64_t key[2] = { addr, tag };
+
+	return &hash[fasthash64(key, sizeof(key), RXM_MATCH_HASH_SEED) &
+		     (RXM_MATCH_BUCKETS - 1)];
+}
+
+static inline int rxm_recv_entry_exact(struct rxm_recv_queue *queue,
+				       struct rxm_recv_entry *recv_entry)
 {
-	struct rxm_recv_entry *entry;
-	rxm_entry_pop(queue, entry);
-	if (!entry) {
-		FI_WARN(&rxm_prov, FI_LOG_CQ, "Exhausted recv_entry freestack\n");
+	return !recv_entry->ignore && (!queue->directed_recv ||
+				       recv_entry->addr != FI_ADDR_UNSPEC);
+}
+
+static inline void rxm_match_stats_update(struct rxm_match_stats *stats,
+					  uint64_t scanned, int hit)
+{
+	stats->lookups++;
+	stats->hits += hit;
+	stats->scanned += scanned;
+	if (scanned > stats->max_scan)
+		stats->max_scan = scanned;
+}
+
+void rxm_recv_queue_insert(struct rxm_recv_queue *queue,
+			   struct rxm_recv_entry *recv_entry)
+{
+	recv_entry->seq = queue->seq++;
+	if (rxm_recv_entry_exact(queue, recv_entry))
+		dlist_insert_tail(&recv_entry->entry,
+				  rxm_match_bucket(queue->recv_hash,
+						   recv_entry->addr,
+						   recv_entry->tag));
+	else
+		dlist_insert_tail(&recv_entry->entry, &queue->recv_wild_list);
+}
+
+static struct rxm_recv_entry *
+rxm_recv_bucket_match(struct dlist_entry *bucket,
+		      struct rxm_recv_match_attr *attr, uint64_t *scanned)
+{
+	struct rxm_recv_entry *recv_entry;
+	struct dlist_entry *item;
+
+	dlist_foreach(bucket, item) {
+		recv_entry = container_of(item, struct rxm_recv_entry, entry);
+		(*scanned)++;
+		if (rxm_match_addr(recv_entry->addr, attr->addr) &&
+		    recv_entry->tag == attr->tag)
+			return recv_entry;
+	}
+	return NULL;
+}
+
+/*
+ * Finds the earliest posted receive for an incoming message.  The wildcard
+ * list only needs to be searched up to the exact match found, if any.
+ */
+struct rxm_recv_entry *
+rxm_recv_queue_match(struct rxm_recv_queue *queue,
+		     struct rxm_recv_match_attr *attr)
+{
+	struct rxm_recv_entry *recv_entry, *match = NULL;
+	struct dlist_entry *item;
+	uint64_t scanned = 0;
+	int i;
+
+	if (queue->directed_recv && attr->addr == FI_ADDR_UNSPEC) {
+		/* Unknown source: the receive could be in any bucket */
+		for (i = 0; i < RXM_MATCH_BUCKETS; i++) {
+			recv_entry = rxm_recv_bucket_match(&queue->recv_hash[i],
+							   attr, &scanned);
+			if (recv_entry && (!match || recv_entry->seq < match->seq))
+				match = recv_entry;
+		}
+	} else {
+		match = rxm_recv_bucket_match(rxm_match_bucket(queue->recv_hash,
+							       attr->addr,
+							       attr->tag),
+					      attr, &scanned);
+	}
+
+	dlist_foreach(&queue->recv_wild_list, item) {
+		recv_entry = container_of(item, struct rxm_recv_entry, entry);
+		if (match && recv_entry->seq > match->seq)
+			break;
+		scanned++;
+		if (rxm_match_addr(recv_entry->addr, attr->addr) &&
+		    rxm_match_tag(recv_entry->tag, recv_entry->ignore,
+				  attr->tag)) {
+			match = recv_entry;
+			break;
+		}
+	}
+
+	rxm_match_stats_update(&queue->recv_stats, scanned, match != NULL);
+	if (match)
+		dlist_remove(&match->entry);
+	return match;
+}
+
+static struct rxm_recv_entry *
+rxm_recv_list_remove_context(struct dlist_entry *list, void *context)
+{
+	struct rxm_recv_entry *recv_entry;
+	struct dlist_entry *item;
+
+	dlist_foreach(list, item) {
+		recv_entry = container_of(item, struct rxm_recv_entry, entry);
+		if (recv_entry->context == context) {
+			dlist_remove(item);
+			return recv_entry;
+		}
+	}
+	return NULL;
+}
+
+struct rxm_recv_entry *
+rxm_recv_queue_remove_context(struct rxm_recv_queue *queue, void *context)
+{
+	struct rxm_recv_entry *recv_entry;
+	int i;
+
+	recv_entry = rxm_recv_list_remove_context(&queue->recv_wild_list,
+						  context);
+	for (i = 0; !recv_entry && i < RXM_MATCH_BUCKETS; i++)
+		recv_entry = rxm_recv_list_remove_context(&queue->recv_hash[i],
+							  context);
+	return recv_entry;
+}
+
+void rxm_unexp_insert(struct rxm_recv_queue *queue, struct rxm_rx_buf *rx_buf)
+{
+	struct rxm_unexp_msg *unexp_msg = &rx_buf->unexp_msg;
+
+	unexp_msg->seq = queue->unexp_seq++;
+	if (queue->directed_recv && unexp_msg->addr == FI_ADDR_UNSPEC)
+		queue->unexp_unspec_cnt++;
+	dlist_insert_tail(&unexp_msg->entry,
+			  rxm_match_bucket(queue->unexp_hash, unexp_msg->addr,
+					   unexp_msg->tag));
+	dlist_insert_tail(&unexp_msg->all_entry, &queue->unexp_msg_list);
+}
+
+static struct rxm_unexp_msg *
+rxm_unexp_bucket_match(struct dlist_entry *bucket, fi_addr_t addr,
+		       uint64_t tag, uint64_t *scanned)
+{
+	struct rxm_unexp_msg *unexp_msg;
+	struct dlist_entry *item;
+
+	dlist_foreach(bucket, item) {
+		unexp_msg = container_of(item, struct rxm_unexp_msg, entry);
+		(*scanned)++;
+		if (unexp_msg->addr == addr && unexp_msg->tag == tag)
+			return unexp_msg;
+	}
+	return NULL;
+}
+
+/* Finds the earliest unexpected message that a new receive matches */
+struct rxm_rx_buf *rxm_unexp_match(struct rxm_recv_queue *queue,
+				   struct rxm_recv_entry *recv_entry)
+{
+	struct rxm_unexp_msg *unexp_msg, *match = NULL;
+	struct dlist_entry *item;
+	uint64_t scanned = 0;
+
+	if (dlist_empty(&queue->unexp_msg_list))
 		return NULL;
+
+	if (rxm_recv_entry_exact(queue, recv_entry)) {
+		match = rxm_unexp_bucket_match(
+				rxm_match_bucket(queue->unexp_hash,
+						 recv_entry->addr,
+						 recv_entry->tag),
+				recv_entry->addr, recv_entry->tag, &scanned);
+		if (queue->unexp_unspec_cnt) {
+			unexp_msg = rxm_unexp_bucket_match(
+					rxm_match_bucket(queue->unexp_hash,
+							 FI_ADDR_UNSPEC,
+							 recv_entry->tag),
+					FI_ADDR_UNSPEC, recv_entry->tag,
+					&scanned);
+			if (unexp_msg && (!match || unexp_msg->seq < match->seq))
+				match = unexp_msg;
+		}
+	} else {
+		dlist_foreach(&queue->unexp_msg_list, item) {
+			unexp_msg = container_of(item, struct rxm_unexp_msg,
+						 all_entry);
+			scanned++;
+			if (rxm_match_addr(recv_entry->addr, unexp_msg->addr) &&
+			    rxm_match_tag(recv_entry->tag, recv_entry->ignore,
+					  unexp_msg->tag)) {
+				match = unexp_msg;
+				break;
+			}
+		}
 	}
-	return entry;
+
+	rxm_match_stats_update(&queue->unexp_stats, scanned, match != NULL);
+	if (!match)
+		return NULL;
+
+	if (queue->directed_recv && match->addr == FI_ADDR_UNSPEC)
+		queue->unexp_unspec_cnt--;
+	dlist_remove(&match->entry);
+	dlist_remove(&match->all_entry);
+	return container_of(match, struct rxm_rx_buf, unexp_msg);
 }
 
-void rxm_recv_entry_release(struct rxm_recv_queue *queue, struct rxm_recv_entry *entry)
+static void rxm_match_stats_log(const char *name, struct rxm_match_stats *stats)
 {
-	rxm_entry_push(queue, entry);
+	if (!stats->lookups)
+		return;
+
+	FI_INFO(&rxm_prov, FI_LOG_EP_DATA, "%s: %" PRIu64 " lookups, %" PRIu64
+		" hits, %.2f entries scanned per lookup, %" PRIu64 " max\n",
+		name, stats->lookups, stats->hits,
+		(double)stats->scanned / stats->lookups, stats->max_scan);
+}
+
+void rxm_recv_queue_log_stats(struct rxm_recv_queue *queue)
+{
+	const char *type = queue->type == RXM_RECV_QUEUE_TAGGED ?
+			   "tagged" : "msg";
+
+	if (!queue->recv_stats.lookups && !queue->unexp_stats.lookups)
+		return;
+
+	FI_INFO(&rxm_prov, FI_LOG_EP_DATA, "%s receive matching:\n", type);
+	rxm_match_stats_log("posted receives", &queue->recv_stats);
+	rxm_match_stats_log("unexpected messages", &queue->unexp_stats);
 }
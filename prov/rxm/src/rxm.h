@@ -62,6 +62,29 @@
 #define RXM_BUF_SIZE 16384
 #define RXM_IOV_LIMIT 4
 
+/* Receive buffer size classes used when messages are copied out of
+ * FI_MULTI_RECV slabs.  The last class is the eager buffer size. */
+#define RXM_RX_CLASS_CNT	3
+#define RXM_RX_CLASS_MIN	256
+
+#define RXM_MULTI_RECV_SIZE	(1 << 19)
+#define RXM_MULTI_RECV_COUNT	4
+
+#define RXM_CQ_BATCH		16
+
+#define RXM_SAR_LIMIT		(1 << 18)
+
+#define RXM_LMT_CHUNK_SIZE	(1 << 20)
+#define RXM_LMT_MAX_INFLIGHT	4
+
+/* Auto progress thread: busy poll this long (us) after the last completion
+ * before sleeping, and never sleep longer than RXM_PROGRESS_WAIT_MS */
+#define RXM_PROGRESS_SPIN	100
+#define RXM_PROGRESS_WAIT_MS	100
+
+/* Hash buckets for exact (source, tag) matches, must be a power of 2 */
+#define RXM_MATCH_BUCKETS	256
+
 #define RXM_MR_LOCAL(info) \
 	((FI_VERSION_LT(info->fabric_attr->api_version, FI_VERSION(1, 5)) && \
 	  (info->mode & FI_LOCAL_MR)) || (info->domain_attr->mr_mode & FI_MR_LOCAL))
@@ -72,6 +95,12 @@
 #define RXM_MR_PROV_KEY(info) ((info->domain_attr->mr_mode == FI_MR_BASIC) ||\
 			       info->domain_attr->mr_mode & FI_MR_PROV_KEY)
 
+#ifdef __GNUC__
+#define rxm_prefetch(addr) __builtin_prefetch(addr)
+#else
+#define rxm_prefetch(addr)
+#endif
+
 #define RXM_LOG_STATE(subsystem, pkt, prev_state, next_state) 			\
 	FI_DBG(&rxm_prov, subsystem, "[LMT] msg_id: 0x%" PRIx64 " %s -> %s\n",	\
 	       pkt.ctrl_hdr.msg_id, rxm_proto_state_str[prev_state],		\
@@ -96,6 +125,10 @@ struct rxm_fabric {
 
 struct rxm_conn {
 	struct fid_ep *msg_ep;
+	/* One reference held by the cmap plus one per tx entry using the
+	 * connection.  It is not evicted while any entries are outstanding and
+	 * is freed when the last reference is dropped */
+	ofi_atomic32_t inflight;
 	struct util_cmap_handle handle;
 };
 
@@ -149,7 +182,14 @@ struct rxm_rma_iov {
 	FUNC(RXM_LMT_READ),	\
 	FUNC(RXM_LMT_ACK_SENT), \
 	FUNC(RXM_LMT_ACK_RECVD),\
-	FUNC(RXM_LMT_FINISH),
+	FUNC(RXM_LMT_CTS_SENT),	\
+	FUNC(RXM_LMT_WRITE_WAIT),\
+	FUNC(RXM_LMT_WRITE),	\
+	FUNC(RXM_LMT_FIN_SENT),	\
+	FUNC(RXM_LMT_FINISH),	\
+	FUNC(RXM_SAR_TX),	\
+	FUNC(RXM_SAR_RX),	\
+	FUNC(RXM_RX_SLAB),
 
 enum rxm_proto_state {
 	RXM_PROTO_STATES(OFI_ENUM_VAL)
@@ -157,6 +197,26 @@ enum rxm_proto_state {
 
 extern char *rxm_proto_state_str[];
 
+/*
+ * Large message transfer variants, carried in ofi_op_hdr::op_data.
+ *
+ * READ: the receiver pulls the data with RMA reads and replies with an ACK.
+ * WRITE: the receiver replies with an ACK (clear-to-send) describing its
+ *        registered buffer; the sender pushes the data with RMA writes and
+ *        sends a FIN once they have completed.
+ */
+enum rxm_lmt_op {
+	RXM_LMT_OP_READ,
+	RXM_LMT_OP_WRITE,
+	RXM_LMT_OP_FIN,
+};
+
+/* Connection eviction handshake, carried in ofi_op_hdr::op_data */
+enum rxm_evict_op {
+	RXM_EVICT_OP_REQ,
+	RXM_EVICT_OP_ACK,
+};
+
 struct rxm_pkt {
 	struct ofi_ctrl_hdr ctrl_hdr;
 	struct ofi_op_hdr hdr;
@@ -170,9 +230,13 @@ struct rxm_recv_match_attr {
 };
 
 struct rxm_unexp_msg {
+	/* Bucket of the message's (source, tag) */
 	struct dlist_entry entry;
+	/* All unexpected messages in arrival order, for wildcard receives */
+	struct dlist_entry all_entry;
 	fi_addr_t addr;
 	uint64_t tag;
+	uint64_t seq;
 };
 
 struct rxm_iov {
@@ -181,14 +245,42 @@ struct rxm_iov {
 	uint8_t count;
 };
 
+/* Splits a large message transfer into chunked RMA operations */
+struct rxm_lmt {
+	struct dlist_entry entry;
+	struct fid_ep *msg_ep;
+	void *context;
+	int write;
+
+	/* Remote buffer cursor */
+	struct rxm_rma_iov *rma_iov;
+	size_t rma_index;
+	uint64_t rma_offset;
+
+	/* Local buffer cursor */
+	struct iovec *iov;
+	void **desc;
+	size_t count;
+	size_t iov_index;
+	size_t iov_offset;
+
+	size_t inflight;
+	/* Set on a hard error; the transfer fails once nothing is in flight */
+	int err;
+};
+
 struct rxm_buf {
 	/* Must stay at top */
 	enum rxm_proto_state state;
 
-	struct dlist_entry entry;
 	void *desc;
-	/* MSG EP / shared context to which bufs would be posted to */
+	/* MSG EP / shared context to which bufs would be posted to.  Receive
+	 * buffers holding a message copied out of a slab have none and go
+	 * back to their pool instead. */
 	struct fid_ep *msg_ep;
+	struct rxm_buf_pool *pool;
+	/* Only looked at when the pool is destroyed */
+	uint8_t in_use;
 };
 
 struct rxm_rx_buf {
@@ -197,24 +289,46 @@ struct rxm_rx_buf {
 
 	struct rxm_ep *ep;
 	struct rxm_conn *conn;
+	/* Source snapshot: the connection may be evicted while the message
+	 * sits in the unexpected queue */
+	fi_addr_t src_addr;
 	struct rxm_recv_queue *recv_queue;
 	struct rxm_recv_entry *recv_entry;
 	struct rxm_unexp_msg unexp_msg;
 	uint64_t comp_flags;
 
 	/* Used for large messages */
-	struct rxm_iov match_iov[RXM_IOV_LIMIT];
+	struct rxm_iov match_iov;
 	struct rxm_rma_iov *rma_iov;
-	size_t index;
+	struct rxm_lmt lmt;
 	struct fid_mr *mr[RXM_IOV_LIMIT];
 
+	/* Used for segmented messages.  The first segment's buffer holds the
+	 * reassembly state and queues segments that arrive before the
+	 * message is matched. */
+	struct dlist_entry sar_entry;
+	struct dlist_entry sar_segs;
+	uint64_t sar_offset;
+
 	struct rxm_pkt pkt;
 };
 
+/* Large receive buffer posted with FI_MULTI_RECV */
+struct rxm_rx_slab {
+	/* Must stay at top */
+	struct rxm_buf hdr;
+
+	struct rxm_ep *ep;
+	char buf[];
+};
+
 struct rxm_tx_buf {
 	/* Must stay at top */
 	struct rxm_buf hdr;
 
+	/* Owning message of a segment */
+	struct rxm_tx_entry *tx_entry;
+
 	struct rxm_pkt pkt;
 };
 
@@ -223,15 +337,27 @@ struct rxm_tx_entry {
 	enum rxm_proto_state state;
 
 	struct rxm_ep *ep;
+	struct rxm_conn *conn;
 	uint8_t count;
 	void *context;
 	uint64_t flags;
 	uint64_t comp_flags;
+	uint64_t msg_id;
 	struct rxm_tx_buf *tx_buf;
 
 	/* Used for large messages */
 	struct fid_mr *mr[RXM_IOV_LIMIT];
 	struct rxm_rx_buf *rx_buf;
+	struct iovec iov[RXM_IOV_LIMIT];
+	void *desc[RXM_IOV_LIMIT];
+	struct rxm_lmt lmt;
+
+	/* Used for segmented messages */
+	struct dlist_entry sar_entry;
+	uint64_t sar_offset;
+	size_t sar_inflight;
+	/* Set on a hard error; the send fails once nothing is in flight */
+	int sar_err;
 };
 DECLARE_FREESTACK(struct rxm_tx_entry, rxm_txe_fs);
 
@@ -245,12 +371,17 @@ struct rxm_recv_entry {
 	uint64_t flags;
 	uint64_t tag;
 	uint64_t ignore;
+	/* Posting order, used to pick between an exact and a wildcard match */
+	uint64_t seq;
 };
 DECLARE_FREESTACK(struct rxm_recv_entry, rxm_recv_fs);
 
+/* The lock also protects the EP's tx_pool so that a tx entry and its
+ * buffer are allocated and released together */
 struct rxm_send_queue {
 	struct rxm_txe_fs *fs;
 	struct ofi_key_idx tx_key_idx;
+	int thread_safe;
 	fastlock_t lock;
 };
 
@@ -259,20 +390,50 @@ enum rxm_recv_queue_type {
 	RXM_RECV_QUEUE_TAGGED,
 };
 
+struct rxm_match_stats {
+	uint64_t lookups;
+	uint64_t hits;
+	/* Entries compared across all lookups */
+	uint64_t scanned;
+	uint64_t max_scan;
+};
+
+/*
+ * Posted receives that name a source and have no ignore bits are hashed on
+ * (source, tag).  Without FI_DIRECTED_RECV every source is FI_ADDR_UNSPEC so
+ * receives are hashed on tag alone.  All other receives are wildcards and
+ * kept on a single list.  Both are kept in posting order and a message
+ * takes whichever match was posted first.
+ *
+ * Unexpected messages sit in the bucket of their (source, tag) as well as
+ * on an arrival ordered list which wildcard receives search.
+ *
+ * With FI_DIRECTED_RECV, messages from peers that are not in the AV have
+ * an FI_ADDR_UNSPEC source and may match any receive.  These are rare and
+ * take a slower path.
+ */
 struct rxm_recv_queue {
 	enum rxm_recv_queue_type type;
 	struct rxm_recv_fs *fs;
-	struct dlist_entry recv_list;
+	struct dlist_entry recv_hash[RXM_MATCH_BUCKETS];
+	struct dlist_entry recv_wild_list;
+	struct dlist_entry unexp_hash[RXM_MATCH_BUCKETS];
 	struct dlist_entry unexp_msg_list;
-	dlist_func_t *match_recv;
-	dlist_func_t *match_unexp;
+	uint64_t seq;
+	uint64_t unexp_seq;
+	/* Unexpected messages from unknown peers, FI_DIRECTED_RECV only */
+	size_t unexp_unspec_cnt;
+	int directed_recv;
+	struct rxm_match_stats recv_stats;
+	struct rxm_match_stats unexp_stats;
+	int thread_safe;
 	fastlock_t lock;
 };
 
 struct rxm_buf_pool {
 	struct util_buf_pool *pool;
-	struct dlist_entry buf_list;
 	uint8_t local_mr;
+	int thread_safe;
 	fastlock_t lock;
 };
 
@@ -287,11 +448,38 @@ struct rxm_ep {
 	size_t comp_per_progress;
 
 	struct rxm_buf_pool tx_pool;
-	struct rxm_buf_pool rx_pool;
+	/* Without multi_recv only the last (eager) class is used and its
+	 * buffers are posted to srx_ctx directly */
+	struct rxm_buf_pool rx_pool[RXM_RX_CLASS_CNT];
+	size_t rx_class_size[RXM_RX_CLASS_CNT];
+	struct rxm_buf_pool slab_pool;
+	int multi_recv;
 
 	struct rxm_send_queue send_queue;
 	struct rxm_recv_queue recv_queue;
 	struct rxm_recv_queue trecv_queue;
+
+	/* Zero if the application serializes access to the domain
+	 * (FI_THREAD_DOMAIN), in which case rxm's own locks are elided.  The
+	 * cmap lock and util CQ lock are still taken: the cmap event thread
+	 * adds and frees connections, and util CQs may be shared by several
+	 * endpoints. */
+	int thread_safe;
+	/* Protects chunked LMT and SAR transfer state */
+	fastlock_t proto_lock;
+	/* Transfers waiting for MSG EP queue space */
+	struct dlist_entry lmt_deferred_list;
+	struct dlist_entry sar_deferred_list;
+	/* Segmented messages being reassembled */
+	struct dlist_entry sar_rx_list;
+
+	/* FI_PROGRESS_AUTO: the cmap event thread also drives the MSG CQ.
+	 * progress_lock keeps it and application threads from progressing
+	 * the endpoint at the same time. */
+	int auto_progress;
+	fastlock_t progress_lock;
+	/* Node for the cmap thread and buffer pools, per thread_placement */
+	int numa_node;
 };
 
 extern struct fi_provider rxm_prov;
@@ -301,6 +489,17 @@ extern struct fi_domain_attr rxm_domain_attr;
 extern struct fi_tx_attr rxm_tx_attr;
 extern struct fi_rx_attr rxm_rx_attr;
 
+extern size_t rxm_buffer_size;
+extern size_t rxm_buffer_count;
+extern size_t rxm_multi_recv_size;
+extern size_t rxm_sar_limit;
+extern size_t rxm_lmt_chunk_size;
+extern size_t rxm_lmt_max_inflight;
+extern int rxm_lmt_write;
+extern size_t rxm_max_conn;
+extern int rxm_progress_cpu;
+extern size_t rxm_progress_spin;
+
 // TODO move to common code?
 static inline int rxm_match_addr(fi_addr_t addr, fi_addr_t match_addr)
 {
@@ -313,6 +512,24 @@ static inline int rxm_match_tag(uint64_t tag, uint64_t ignore, uint64_t match_ta
 	return ((tag | ignore) == (match_tag | ignore));
 }
 
+/* The segment length has to fit ofi_ctrl_hdr::seg_size */
+static inline size_t rxm_sar_seg_size(struct rxm_ep *rxm_ep)
+{
+	return MIN(rxm_ep->rxm_info->tx_attr->inject_size, UINT16_MAX);
+}
+
+static inline void rxm_lock(fastlock_t *lock, int thread_safe)
+{
+	if (thread_safe)
+		fastlock_acquire(lock);
+}
+
+static inline void rxm_unlock(fastlock_t *lock, int thread_safe)
+{
+	if (thread_safe)
+		fastlock_release(lock);
+}
+
 static inline uint64_t rxm_ep_tx_flags(struct fid_ep *ep_fid) {
 	struct util_ep *util_ep = container_of(ep_fid, struct util_ep,
 					       ep_fid);
@@ -335,15 +552,20 @@ int rxm_domain_open(struct fid_fabric *fabric, struct fi_info *info,
 			     struct fid_domain **dom, void *context);
 int rxm_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
 			 struct fid_cq **cq_fid, void *context);
-void rxm_cq_progress(struct rxm_ep *rxm_ep);
-int rxm_cq_comp(struct util_cq *util_cq, void *context, uint64_t flags, size_t len,
-		void *buf, uint64_t data, uint64_t tag);
+int rxm_cq_progress(struct rxm_ep *rxm_ep);
+void rxm_lmt_progress_deferred(struct rxm_ep *rxm_ep);
+int rxm_sar_send(struct rxm_tx_entry *tx_entry);
+void rxm_sar_progress_deferred(struct rxm_ep *rxm_ep);
+int rxm_cq_comp(struct util_cq *util_cq, fi_addr_t src, void *context,
+		uint64_t flags, size_t len, void *buf, uint64_t data,
+		uint64_t tag);
 int rxm_cq_handle_data(struct rxm_rx_buf *rx_buf);
 
 int rxm_endpoint(struct fid_domain *domain, struct fi_info *info,
 			  struct fid_ep **ep, void *context);
 
 void *rxm_conn_event_handler(void *arg);
+void *rxm_conn_progress_handler(void *arg);
 int rxm_conn_connect(struct util_ep *util_ep, struct util_cmap_handle *handle,
 		    fi_addr_t fi_addr);
 int rxm_conn_process_connreq(struct rxm_ep *rxm_ep, struct fi_info *msg_info,
@@ -353,19 +575,42 @@ void rxm_conn_close(struct util_cmap_handle *handle);
 void rxm_conn_free(struct util_cmap_handle *handle);
 int rxm_conn_signal(struct util_ep *util_ep, void *context,
 		    enum ofi_cmap_signal signal);
+int rxm_conn_idle(struct util_cmap_handle *handle);
+int rxm_conn_evict_req(struct util_cmap_handle *handle);
+int rxm_conn_evict_ack(struct util_cmap_handle *handle);
 
 int rxm_ep_repost_buf(struct rxm_rx_buf *buf);
+int rxm_ep_repost_slab(struct rxm_rx_slab *slab);
+struct rxm_rx_buf *rxm_ep_rx_buf_get(struct rxm_ep *rxm_ep, size_t len);
 int ofi_match_addr(fi_addr_t addr, fi_addr_t match_addr);
 int ofi_match_tag(uint64_t tag, uint64_t ignore, uint64_t match_tag);
 void rxm_pkt_init(struct rxm_pkt *pkt);
 int rxm_ep_msg_mr_regv(struct rxm_ep *rxm_ep, const struct iovec *iov,
 		       size_t count, uint64_t access, struct fid_mr **mr);
 void rxm_ep_msg_mr_closev(struct fid_mr **mr, size_t count);
+ssize_t rxm_rma_iov_init(struct rxm_ep *rxm_ep, void *buf,
+			 const struct iovec *iov, size_t count,
+			 struct fid_mr **mr);
 struct rxm_buf *rxm_buf_get(struct rxm_buf_pool *pool);
 void rxm_buf_release(struct rxm_buf_pool *pool, struct rxm_buf *buf);
 
-struct rxm_tx_entry *rxm_tx_entry_get(struct rxm_send_queue *queue);
-struct rxm_recv_entry *rxm_recv_entry_get(struct rxm_recv_queue *queue);
+struct rxm_tx_entry *rxm_tx_entry_get(struct rxm_ep *rxm_ep,
+				      struct rxm_conn *rxm_conn, int tx_buf);
+struct rxm_tx_buf *rxm_tx_buf_get(struct rxm_ep *rxm_ep);
 
-void rxm_tx_entry_release(struct rxm_send_queue *queue, struct rxm_tx_entry *entry);
+void rxm_tx_entry_release(struct rxm_ep *rxm_ep, struct rxm_tx_entry *entry);
+void rxm_tx_buf_release(struct rxm_ep *rxm_ep, struct rxm_tx_buf *tx_buf);
 void rxm_recv_entry_release(struct rxm_recv_queue *queue, struct rxm_recv_entry *entry);
+
+/* Matching routines, caller must hold the queue's lock */
+void rxm_recv_queue_insert(struct rxm_recv_queue *queue,
+			   struct rxm_recv_entry *recv_entry);
+struct rxm_recv_entry *
+rxm_recv_queue_match(struct rxm_recv_queue *queue,
+		     struct rxm_recv_match_attr *attr);
+struct rxm_recv_entry *
+rxm_recv_queue_remove_context(struct rxm_recv_queue *queue, void *context);
+void rxm_unexp_insert(struct rxm_recv_queue *queue, struct rxm_rx_buf *rx_buf);
+struct rxm_rx_buf *rxm_unexp_match(struct rxm_recv_queue *queue,
+				   struct rxm_recv_entry *recv_entry);
+void rxm_recv_queue_log_stats(struct rxm_recv_queue *queue);
@@ -32,6 +32,8 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include <fi.h>
 #include <fi_util.h>
@@ -100,14 +102,54 @@ void rxm_conn_close(struct util_cmap_handle *handle)
 
 void rxm_conn_free(struct util_cmap_handle *handle)
 {
+	struct rxm_conn *rxm_conn = container_of(handle, struct rxm_conn, handle);
+
 	rxm_conn_close(handle);
-	free(container_of(handle, struct rxm_conn, handle));
+	/* Completions of tx entries still referring to the connection may be
+	 * reported after the handle is deleted, the last one frees it */
+	if (!ofi_atomic_dec32(&rxm_conn->inflight))
+		free(rxm_conn);
 }
 
 struct util_cmap_handle *rxm_conn_alloc(void)
 {
 	struct rxm_conn *rxm_conn = calloc(1, sizeof(*rxm_conn));
-	return rxm_conn ? &rxm_conn->handle : NULL;
+	if (!rxm_conn)
+		return NULL;
+	ofi_atomic_initialize32(&rxm_conn->inflight, 1);
+	return &rxm_conn->handle;
+}
+
+int rxm_conn_idle(struct util_cmap_handle *handle)
+{
+	struct rxm_conn *rxm_conn = container_of(handle, struct rxm_conn, handle);
+	return ofi_atomic_get32(&rxm_conn->inflight) == 1;
+}
+
+static int rxm_conn_send_evict(struct util_cmap_handle *handle,
+			       enum rxm_evict_op op)
+{
+	struct rxm_conn *rxm_conn = container_of(handle, struct rxm_conn, handle);
+	struct rxm_pkt pkt;
+
+	if (!rxm_conn->msg_ep)
+		return -FI_ENOTCONN;
+
+	rxm_pkt_init(&pkt);
+	pkt.ctrl_hdr.type = ofi_ctrl_evict;
+	pkt.ctrl_hdr.conn_id = handle->remote_key;
+	pkt.hdr.op_data = op;
+	return (int)fi_inject(rxm_conn->msg_ep, &pkt, sizeof(pkt), 0);
+}
+
+int rxm_conn_evict_req(struct util_cmap_handle *handle)
+{
+	return rxm_conn_send_evict(handle, RXM_EVICT_OP_REQ);
+}
+
+int rxm_conn_evict_ack(struct util_cmap_handle *handle)
+{
+	return rxm_conn_send_evict(handle, RXM_EVICT_OP_ACK);
 }
 
 int rxm_msg_process_connreq(struct rxm_ep *rxm_ep, struct fi_info *msg_info,
@@ -184,13 +226,54 @@ static void rxm_conn_handle_eq_err(struct rxm_ep *rxm_ep, ssize_t rd)
 	}
 }
 
+/* Returns 1 when the event handler should exit */
+static int rxm_conn_handle_event(struct rxm_ep *rxm_ep, uint32_t event,
+				 struct fi_eq_cm_entry *entry, ssize_t rd,
+				 size_t len)
+{
+	struct rxm_cm_data *cm_data;
+
+	switch(event) {
+	case FI_NOTIFY:
+		return rxm_conn_handle_notify((struct fi_eq_entry *)entry);
+	case FI_CONNREQ:
+		FI_DBG(&rxm_prov, FI_LOG_FABRIC, "Got new connection\n");
+		if (rd != len) {
+			FI_WARN(&rxm_prov, FI_LOG_FABRIC,
+				"Received size (%d) not matching "
+				"expected (%d)\n", rd, len);
+			return 1;
+		}
+		rxm_msg_process_connreq(rxm_ep, entry->info, entry->data);
+		return 0;
+	case FI_CONNECTED:
+		FI_DBG(&rxm_prov, FI_LOG_FABRIC,
+		       "Connection successful\n");
+		cm_data = (void *)entry->data;
+		ofi_cmap_process_connect(rxm_ep->util_ep.cmap,
+					 entry->fid->context,
+					 (rd - sizeof(*entry)) ?
+					 &cm_data->conn_id : NULL);
+		return 0;
+	case FI_SHUTDOWN:
+		FI_DBG(&rxm_prov, FI_LOG_FABRIC,
+		       "Received connection shutdown\n");
+		ofi_cmap_process_shutdown(rxm_ep->util_ep.cmap,
+					  entry->fid->context);
+		return 0;
+	default:
+		FI_WARN(&rxm_prov, FI_LOG_FABRIC,
+			"Unknown event: %u\n", event);
+		return 1;
+	}
+}
+
 void *rxm_conn_event_handler(void *arg)
 {
 	struct fi_eq_cm_entry *entry;
 	size_t datalen = sizeof(struct rxm_cm_data);
 	size_t len = sizeof(*entry) + datalen;
 	struct rxm_ep *rxm_ep = container_of(arg, struct rxm_ep, util_ep);
-	struct rxm_cm_data *cm_data;
 	uint32_t event;
 	ssize_t rd;
 
@@ -208,45 +291,140 @@ void *rxm_conn_event_handler(void *arg)
 			rxm_conn_handle_eq_err(rxm_ep, rd);
 			continue;
 		}
-
-		switch(event) {
-		case FI_NOTIFY:
-			if (rxm_conn_handle_notify((struct fi_eq_entry *)entry))
-				goto exit;
-			break;
-		case FI_CONNREQ:
-			FI_DBG(&rxm_prov, FI_LOG_FABRIC, "Got new connection\n");
-			if (rd != len) {
-				FI_WARN(&rxm_prov, FI_LOG_FABRIC,
-					"Received size (%d) not matching "
-					"expected (%d)\n", rd, len);
-				goto exit;
-			}
-			cm_data = (void *)entry->data;
-			rxm_msg_process_connreq(rxm_ep, entry->info, entry->data);
-			break;
-		case FI_CONNECTED:
-			FI_DBG(&rxm_prov, FI_LOG_FABRIC,
-			       "Connection successful\n");
-			cm_data = (void *)entry->data;
-			ofi_cmap_process_connect(rxm_ep->util_ep.cmap,
-						 entry->fid->context,
-						 (rd - sizeof(*entry)) ?
-						 &cm_data->conn_id : NULL);
-			break;
-		case FI_SHUTDOWN:
-			FI_DBG(&rxm_prov, FI_LOG_FABRIC,
-			       "Received connection shutdown\n");
-			ofi_cmap_process_shutdown(rxm_ep->util_ep.cmap,
-						  entry->fid->context);
+		if (rxm_conn_handle_event(rxm_ep, event, entry, rd, len))
 			break;
-		default:
-			FI_WARN(&rxm_prov, FI_LOG_FABRIC,
-				"Unknown event: %u\n", event);
-			goto exit;
+	}
+	free(entry);
+	return NULL;
+}
+
+static void rxm_conn_progress_set_affinity(void)
+{
+#if !defined __APPLE__ && !defined _WIN32
+	cpu_set_t cpuset;
+
+	if (rxm_progress_cpu < 0)
+		return;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(rxm_progress_cpu, &cpuset);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset))
+		FI_WARN(&rxm_prov, FI_LOG_FABRIC,
+			"Unable to pin progress thread to CPU %d\n",
+			rxm_progress_cpu);
+#else
+	if (rxm_progress_cpu >= 0)
+		FI_WARN(&rxm_prov, FI_LOG_FABRIC,
+			"Progress thread pinning is not supported\n");
+#endif
+}
+
+static int rxm_conn_progress_wait_init(struct rxm_ep *rxm_ep,
+				       fi_epoll_t *epfd)
+{
+	int fd, ret;
+
+	ret = fi_epoll_create(epfd);
+	if (ret)
+		return ret;
+
+	ret = fi_control(&rxm_ep->msg_cq->fid, FI_GETWAIT, &fd);
+	if (ret)
+		goto err;
+	ret = fi_epoll_add(*epfd, fd, rxm_ep->msg_cq);
+	if (ret)
+		goto err;
+
+	ret = fi_control(&rxm_ep->msg_eq->fid, FI_GETWAIT, &fd);
+	if (ret)
+		goto err;
+	ret = fi_epoll_add(*epfd, fd, rxm_ep->msg_eq);
+	if (ret)
+		goto err;
+	return 0;
+err:
+	fi_epoll_close(*epfd);
+	return ret;
+}
+
+/*
+ * FI_PROGRESS_AUTO: handles connection events like rxm_conn_event_handler
+ * and also drives the MSG CQ, so that protocol steps (LMT acks, RMA reads,
+ * SAR segments) advance while the application is busy elsewhere.  After
+ * the last completion the thread keeps polling for rxm_progress_spin us
+ * before it blocks on both the CQ and EQ fds.
+ */
+void *rxm_conn_progress_handler(void *arg)
+{
+	struct fi_eq_cm_entry *entry;
+	size_t datalen = sizeof(struct rxm_cm_data);
+	size_t len = sizeof(*entry) + datalen;
+	struct rxm_ep *rxm_ep = container_of(arg, struct rxm_ep, util_ep);
+	struct rxm_fabric *rxm_fabric;
+	struct fid *fids[2];
+	fi_epoll_t epfd;
+	uint64_t last_comp;
+	uint32_t event;
+	int can_wait, comp;
+	ssize_t rd;
+
+	entry = calloc(1, len);
+	if (!entry) {
+		FI_WARN(&rxm_prov, FI_LOG_FABRIC, "Unable to allocate memory!\n");
+		return NULL;
+	}
+
+	rxm_fabric = container_of(rxm_ep->util_ep.domain->fabric,
+				  struct rxm_fabric, util_fabric);
+	fids[0] = &rxm_ep->msg_cq->fid;
+	fids[1] = &rxm_ep->msg_eq->fid;
+
+	can_wait = !rxm_conn_progress_wait_init(rxm_ep, &epfd);
+	if (!can_wait)
+		FI_WARN(&rxm_prov, FI_LOG_FABRIC, "MSG provider has no wait "
+			"objects, progress thread will poll\n");
+
+	rxm_conn_progress_set_affinity();
+
+	FI_DBG(&rxm_prov, FI_LOG_FABRIC, "Starting progress thread\n");
+	last_comp = fi_gettime_us();
+	while (1) {
+		rd = fi_eq_read(rxm_ep->msg_eq, &event, entry, len, 0);
+		if (rd != -FI_EAGAIN) {
+			if (rd < 0)
+				rxm_conn_handle_eq_err(rxm_ep, rd);
+			else if (rxm_conn_handle_event(rxm_ep, event, entry,
+							rd, len))
+				break;
+			continue;
+		}
+
+		fastlock_acquire(&rxm_ep->progress_lock);
+		comp = rxm_cq_progress(rxm_ep);
+		fastlock_release(&rxm_ep->progress_lock);
+
+		if (comp) {
+			last_comp = fi_gettime_us();
+			continue;
+		}
+		if (fi_gettime_us() - last_comp < rxm_progress_spin)
+			continue;
+
+		if (!can_wait) {
+			sched_yield();
+			continue;
 		}
+		/* Deferred LMT and SAR work is retried on the next
+		 * completion, so it's safe to sleep with it queued. The
+		 * bounded wait covers MSG providers whose fds aren't
+		 * signalled for every event. */
+		if (!fi_trywait(rxm_fabric->msg_fabric, fids, 2))
+			fi_epoll_wait(epfd, RXM_PROGRESS_WAIT_MS);
+		last_comp = fi_gettime_us();
 	}
-exit:
+
+	if (can_wait)
+		fi_epoll_close(epfd);
 	free(entry);
 	return NULL;
 }
@@ -103,26 +103,135 @@ static void rxm_cq_log_comp(uint64_t flags)
 }
 #endif
 
-int rxm_cq_comp(struct util_cq *util_cq, void *context, uint64_t flags, size_t len,
-		void *buf, uint64_t data, uint64_t tag)
+/*
+ * Completions generated while processing a batch of MSG CQ entries are
+ * staged here and written to the util CQs with one lock acquisition per
+ * batch.  Other threads and endpoints keep writing to the same util CQ in
+ * the meantime, so slots are reserved before the MSG CQ entries are read.
+ * Completions written outside of progress (e.g. a posted receive matching
+ * an unexpected message) go directly to the util CQ.
+ */
+struct rxm_cq_stage {
+	struct util_cq *util_cq;
+	size_t count;
+	size_t reserved;
+	struct fi_cq_tagged_entry comp[RXM_CQ_BATCH];
+	fi_addr_t src[RXM_CQ_BATCH];
+};
+
+struct rxm_cq_batch {
+	struct rxm_cq_stage stage[2];	/* EP rx and tx CQ */
+};
+
+static __thread struct rxm_cq_batch *rxm_cq_batch;
+
+static void rxm_cq_flush_stage(struct rxm_cq_stage *stage)
 {
-	struct fi_cq_tagged_entry *comp;
-	int ret = 0;
+	struct util_cq *util_cq = stage->util_cq;
+	size_t i;
+
+	if (!stage->reserved)
+		return;
 
 	fastlock_acquire(&util_cq->cq_lock);
-	if (ofi_cirque_isfull(util_cq->cirq)) {
-		FI_DBG(&rxm_prov, FI_LOG_CQ, "util_cq cirq is full!\n");
-		ret = -FI_EAGAIN;
-		goto out;
+	for (i = 0; i < stage->count; i++) {
+		if (util_cq->src)
+			util_cq->src[ofi_cirque_windex(util_cq->cirq)] =
+				stage->src[i];
+		ofi_cirque_insert(util_cq->cirq, stage->comp[i]);
+	}
+	util_cq->reserved -= stage->reserved;
+	fastlock_release(&util_cq->cq_lock);
+	stage->count = 0;
+	stage->reserved = 0;
+}
+
+static void rxm_cq_flush_batch(struct rxm_cq_batch *batch)
+{
+	rxm_cq_flush_stage(&batch->stage[0]);
+	rxm_cq_flush_stage(&batch->stage[1]);
+}
+
+/* Reserves up to cnt slots for the stage, as many as the util CQ has free */
+static int rxm_cq_stage_reserve(struct rxm_cq_stage *stage, size_t cnt)
+{
+	struct util_cq *util_cq = stage->util_cq;
+	size_t avail;
+
+	fastlock_acquire(&util_cq->cq_lock);
+	avail = ofi_cirque_freecnt(util_cq->cirq);
+	avail = avail > util_cq->reserved ? avail - util_cq->reserved : 0;
+	avail = MIN(avail, cnt > stage->reserved ? cnt - stage->reserved : 0);
+	util_cq->reserved += avail;
+	stage->reserved += avail;
+	fastlock_release(&util_cq->cq_lock);
+	return stage->reserved > stage->count ? 0 : -FI_EAGAIN;
+}
+
+static struct rxm_cq_stage *rxm_cq_get_stage(struct util_cq *util_cq)
+{
+	struct rxm_cq_stage *stage;
+	int i;
+
+	if (!rxm_cq_batch)
+		return NULL;
+
+	for (i = 0; i < 2; i++) {
+		stage = &rxm_cq_batch->stage[i];
+		if (!stage->util_cq)
+			stage->util_cq = util_cq;
+		if (stage->util_cq == util_cq) {
+			if (stage->count == RXM_CQ_BATCH)
+				rxm_cq_flush_stage(stage);
+			return stage;
+		}
 	}
+	return NULL;
+}
 
-	comp = ofi_cirque_tail(util_cq->cirq);
+static void rxm_cq_fill_comp(struct fi_cq_tagged_entry *comp, void *context,
+			     uint64_t flags, size_t len, void *buf,
+			     uint64_t data, uint64_t tag)
+{
 	comp->op_context = context;
 	comp->flags = flags;
 	comp->len = len;
 	comp->buf = buf;
 	comp->data = data;
 	comp->tag = tag;
+}
+
+int rxm_cq_comp(struct util_cq *util_cq, fi_addr_t src, void *context,
+		uint64_t flags, size_t len, void *buf, uint64_t data,
+		uint64_t tag)
+{
+	struct rxm_cq_stage *stage;
+	int ret = 0;
+
+	stage = rxm_cq_get_stage(util_cq);
+	if (stage) {
+		if (stage->count == stage->reserved &&
+		    rxm_cq_stage_reserve(stage, RXM_CQ_BATCH)) {
+			FI_DBG(&rxm_prov, FI_LOG_CQ, "util_cq cirq is full!\n");
+			return -FI_EAGAIN;
+		}
+		stage->src[stage->count] = src;
+		rxm_cq_fill_comp(&stage->comp[stage->count++], context, flags,
+				 len, buf, data, tag);
+		return 0;
+	}
+
+	fastlock_acquire(&util_cq->cq_lock);
+	if (ofi_cirque_freecnt(util_cq->cirq) <= util_cq->reserved) {
+		FI_DBG(&rxm_prov, FI_LOG_CQ, "util_cq cirq is full!\n");
+		ret = -FI_EAGAIN;
+		goto out;
+	}
+
+	if (util_cq->src)
+		util_cq->src[ofi_cirque_windex(util_cq->cirq)] = src;
+	rxm_cq_fill_comp(ofi_cirque_tail(util_cq->cirq), context, flags, len,
+			 buf, data, tag);
 	ofi_cirque_commit(util_cq->cirq);
 out:
 	fastlock_release(&util_cq->cq_lock);
@@ -136,6 +245,8 @@ int rxm_finish_recv(struct rxm_rx_buf *rx_buf)
 	if (rx_buf->recv_entry->flags & FI_COMPLETION) {
 		FI_DBG(&rxm_prov, FI_LOG_CQ, "writing recv completion\n");
 		ret = rxm_cq_comp(rx_buf->ep->util_ep.rx_cq,
+				  (rx_buf->ep->rxm_info->caps & FI_SOURCE) ?
+				  rx_buf->src_addr : FI_ADDR_NOTAVAIL,
 				  rx_buf->recv_entry->context,
 				  rx_buf->comp_flags | FI_RECV,
 				  rx_buf->pkt.hdr.size, NULL,
@@ -156,8 +267,9 @@ static int rxm_finish_send_nobuf(struct rxm_tx_entry *tx_entry)
 	int ret;
 
 	if (tx_entry->flags & FI_COMPLETION) {
-		ret = rxm_cq_comp(tx_entry->ep->util_ep.tx_cq, tx_entry->context,
-				tx_entry->comp_flags, 0, NULL, 0, 0);
+		ret = rxm_cq_comp(tx_entry->ep->util_ep.tx_cq, FI_ADDR_NOTAVAIL,
+				  tx_entry->context, tx_entry->comp_flags, 0,
+				  NULL, 0, 0);
 		if (ret) {
 			FI_WARN(&rxm_prov, FI_LOG_CQ,
 					"Unable to report completion\n");
@@ -165,13 +277,12 @@ static int rxm_finish_send_nobuf(struct rxm_tx_entry *tx_entry)
 		}
 		rxm_cq_log_comp(tx_entry->comp_flags);
 	}
-	rxm_tx_entry_release(&tx_entry->ep->send_queue, tx_entry);
+	rxm_tx_entry_release(tx_entry->ep, tx_entry);
 	return 0;
 }
 
 int rxm_finish_send(struct rxm_tx_entry *tx_entry)
 {
-	rxm_buf_release(&tx_entry->ep->tx_pool, (struct rxm_buf *)tx_entry->tx_buf);
 	return rxm_finish_send_nobuf(tx_entry);
 }
 
@@ -206,49 +317,463 @@ static int rxm_match_iov(const struct iovec *iov, void **desc,
 	return 0;
 }
 
-static int rxm_match_rma_iov(struct rxm_recv_entry *recv_entry,
-			     struct rxm_rma_iov *rma_iov,
-			     struct rxm_iov *match_iov)
+static void rxm_lmt_init(struct rxm_lmt *lmt, struct fid_ep *msg_ep,
+			 void *context, int write, struct rxm_rma_iov *rma_iov,
+			 struct iovec *iov, void **desc, size_t count)
 {
-	uint64_t offset = 0;
-	size_t i, j;
-	uint8_t count;
-	int ret;
+	memset(lmt, 0, sizeof(*lmt));
+	dlist_init(&lmt->entry);
+	lmt->msg_ep = msg_ep;
+	lmt->context = context;
+	lmt->write = write;
+	lmt->rma_iov = rma_iov;
+	lmt->iov = iov;
+	lmt->desc = desc;
+	lmt->count = count;
+}
+
+static int rxm_lmt_issued(struct rxm_lmt *lmt)
+{
+	return (lmt->rma_index >= lmt->rma_iov->count) ||
+		(lmt->iov_index >= lmt->count);
+}
 
-	assert(rma_iov->count <= RXM_IOV_LIMIT);
+/* Describe up to len bytes of the local buffer starting at the cursor */
+static size_t rxm_lmt_local_iov(struct rxm_lmt *lmt, size_t *len,
+				struct iovec *iov, void **desc)
+{
+	size_t i, index = lmt->iov_index, offset = lmt->iov_offset;
+	size_t left = *len;
+
+	for (i = 0; i < RXM_IOV_LIMIT && left && index < lmt->count; i++) {
+		iov[i].iov_base = (char *)lmt->iov[index].iov_base + offset;
+		iov[i].iov_len = MIN(lmt->iov[index].iov_len - offset, left);
+		desc[i] = lmt->desc[index];
+		left -= iov[i].iov_len;
+		index++;
+		offset = 0;
+	}
+	*len -= left;
+	return i;
+}
+
+static void rxm_lmt_advance(struct rxm_lmt *lmt, size_t len)
+{
+	size_t seg;
+
+	lmt->rma_offset += len;
+	if (lmt->rma_offset == lmt->rma_iov->iov[lmt->rma_index].len) {
+		lmt->rma_index++;
+		lmt->rma_offset = 0;
+	}
+
+	while (len) {
+		seg = MIN(lmt->iov[lmt->iov_index].iov_len - lmt->iov_offset, len);
+		lmt->iov_offset += seg;
+		len -= seg;
+		if (lmt->iov_offset == lmt->iov[lmt->iov_index].iov_len) {
+			lmt->iov_index++;
+			lmt->iov_offset = 0;
+		}
+	}
+}
+
+/* Caller must hold rxm_ep->proto_lock */
+static int rxm_lmt_issue(struct rxm_lmt *lmt)
+{
+	struct iovec iov[RXM_IOV_LIMIT];
+	void *desc[RXM_IOV_LIMIT];
+	struct ofi_rma_iov *rma;
+	size_t count, len;
+	ssize_t ret;
 
-	for (i = 0, j = 0; i < rma_iov->count; i++) {
-		ret = rxm_match_iov(&recv_entry->iov[j],
-			      &recv_entry->desc[j], recv_entry->count,
-			      offset, rma_iov->iov[i].len, &match_iov[i]);
+	while (lmt->inflight < rxm_lmt_max_inflight && !rxm_lmt_issued(lmt)) {
+		rma = &lmt->rma_iov->iov[lmt->rma_index];
+		len = MIN(rma->len - lmt->rma_offset, rxm_lmt_chunk_size);
+		count = rxm_lmt_local_iov(lmt, &len, iov, desc);
+		if (!len) {
+			if (lmt->rma_offset == rma->len) {
+				lmt->rma_index++;
+				lmt->rma_offset = 0;
+			} else {
+				lmt->iov_index = lmt->count;
+			}
+			continue;
+		}
+
+		if (lmt->write)
+			ret = fi_writev(lmt->msg_ep, iov, desc, count, 0,
+					rma->addr + lmt->rma_offset, rma->key,
+					lmt->context);
+		else
+			ret = fi_readv(lmt->msg_ep, iov, desc, count, 0,
+				       rma->addr + lmt->rma_offset, rma->key,
+				       lmt->context);
 		if (ret)
 			return ret;
-		count = match_iov[i].count;
-		offset = match_iov[i].iov[match_iov[i].count].iov_len;
 
-		if (offset == recv_entry->iov[j + count - 1].iov_len) {
-			/* This iov has been completely used */
-			j += count;
-			offset = 0;
+		lmt->inflight++;
+		rxm_lmt_advance(lmt, len);
+	}
+	return 0;
+}
+
+/*
+ * Report a transfer that can no longer make progress and release what it
+ * holds.  The peer is not notified, so its side of the transfer stays
+ * pending until the connection goes away.
+ */
+static int rxm_lmt_fail(struct rxm_lmt *lmt)
+{
+	struct rxm_tx_entry *tx_entry = lmt->context;
+	struct rxm_rx_buf *rx_buf = lmt->context;
+	struct fi_cq_err_entry err_entry;
+	int ret;
+
+	FI_WARN(&rxm_prov, FI_LOG_CQ, "Large message transfer failed: %s\n",
+		fi_strerror(-lmt->err));
+	memset(&err_entry, 0, sizeof(err_entry));
+	err_entry.err = -lmt->err;
+
+	if (lmt->write) {
+		err_entry.op_context = tx_entry->context;
+		err_entry.flags = tx_entry->comp_flags | FI_SEND;
+		ret = ofi_cq_write_error(tx_entry->ep->util_ep.tx_cq,
+					 &err_entry);
+		if (!RXM_MR_LOCAL(tx_entry->ep->rxm_info))
+			rxm_ep_msg_mr_closev(tx_entry->mr, tx_entry->count);
+		if (rxm_ep_repost_buf(tx_entry->rx_buf))
+			ret = ret ? ret : -FI_EOTHER;
+		rxm_tx_entry_release(tx_entry->ep, tx_entry);
+	} else {
+		err_entry.op_context = rx_buf->recv_entry->context;
+		err_entry.flags = rx_buf->comp_flags | FI_RECV;
+		err_entry.data = rx_buf->pkt.hdr.data;
+		err_entry.tag = rx_buf->pkt.hdr.tag;
+		ret = ofi_cq_write_error(rx_buf->ep->util_ep.rx_cq, &err_entry);
+		if (!RXM_MR_LOCAL(rx_buf->ep->rxm_info))
+			rxm_ep_msg_mr_closev(rx_buf->mr, RXM_IOV_LIMIT);
+		rxm_recv_entry_release(rx_buf->recv_queue, rx_buf->recv_entry);
+		if (rxm_ep_repost_buf(rx_buf))
+			ret = ret ? ret : -FI_EOTHER;
+	}
+	return ret;
+}
+
+/*
+ * Keep up to rxm_lmt_max_inflight chunks outstanding.  Returns 1 once all
+ * chunks of the transfer have completed, 0 if some are still pending.  A
+ * transfer that failed is reported and released here, and returns 0.
+ */
+static int rxm_lmt_progress(struct rxm_ep *rxm_ep, struct rxm_lmt *lmt,
+			    int chunk_done)
+{
+	int ret;
+
+	rxm_lock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+	if (chunk_done)
+		lmt->inflight--;
+
+	ret = lmt->err ? lmt->err : rxm_lmt_issue(lmt);
+	if (ret == -FI_EAGAIN) {
+		/* Nothing in flight would drive this transfer forward */
+		if (!lmt->inflight && dlist_empty(&lmt->entry))
+			dlist_insert_tail(&lmt->entry, &rxm_ep->lmt_deferred_list);
+		ret = 0;
+	} else if (ret) {
+		/* Let the chunks in flight drain before failing */
+		lmt->err = ret;
+		if (lmt->inflight)
+			ret = 0;
+	} else {
+		ret = rxm_lmt_issued(lmt) && !lmt->inflight;
+	}
+	rxm_unlock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+
+	return ret < 0 ? rxm_lmt_fail(lmt) : ret;
+}
+
+void rxm_lmt_progress_deferred(struct rxm_ep *rxm_ep)
+{
+	struct dlist_entry *item, *next;
+	struct rxm_lmt *lmt;
+	struct dlist_entry failed;
+	int ret;
+
+	dlist_init(&failed);
+	rxm_lock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+	for (item = rxm_ep->lmt_deferred_list.next;
+	     item != &rxm_ep->lmt_deferred_list; item = next) {
+		next = item->next;
+		lmt = container_of(item, struct rxm_lmt, entry);
+
+		ret = rxm_lmt_issue(lmt);
+		if (ret == -FI_EAGAIN && !lmt->inflight)
+			continue;
+
+		dlist_remove(item);
+		if (ret && ret != -FI_EAGAIN) {
+			lmt->err = ret;
+			/* Otherwise the last chunk completion fails it */
+			if (!lmt->inflight) {
+				dlist_insert_tail(item, &failed);
+				continue;
+			}
+		}
+		dlist_init(item);
+	}
+	rxm_unlock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+
+	while (!dlist_empty(&failed)) {
+		dlist_pop_front(&failed, struct rxm_lmt, lmt, entry);
+		dlist_init(&lmt->entry);
+		rxm_lmt_fail(lmt);
+	}
+}
+
+/* Caller must hold rxm_ep->proto_lock */
+static int rxm_sar_issue(struct rxm_tx_entry *tx_entry)
+{
+	struct rxm_ep *rxm_ep = tx_entry->ep;
+	struct rxm_tx_buf *tx_buf;
+	uint64_t size = tx_entry->tx_buf->pkt.hdr.size;
+	size_t seg_size;
+	ssize_t ret;
+
+	while (tx_entry->sar_offset < size) {
+		/* The first segment goes out in the message's own buffer,
+		 * which also serves as the header template for the rest */
+		if (!tx_entry->sar_offset) {
+			tx_buf = tx_entry->tx_buf;
 		} else {
-			j += count - 1;
+			tx_buf = rxm_tx_buf_get(rxm_ep);
+			if (!tx_buf)
+				return -FI_EAGAIN;
+			tx_buf->hdr.msg_ep = tx_entry->tx_buf->hdr.msg_ep;
+			tx_buf->pkt = tx_entry->tx_buf->pkt;
 		}
+		tx_buf->hdr.state = RXM_SAR_TX;
+		tx_buf->tx_entry = tx_entry;
+
+		seg_size = MIN(rxm_sar_seg_size(rxm_ep), size - tx_entry->sar_offset);
+		tx_buf->pkt.ctrl_hdr.seg_no = tx_entry->sar_offset /
+					      rxm_sar_seg_size(rxm_ep);
+		tx_buf->pkt.ctrl_hdr.seg_size = seg_size;
+		ofi_copy_from_iov(tx_buf->pkt.data, seg_size, tx_entry->iov,
+				  tx_entry->count, tx_entry->sar_offset);
+
+		ret = fi_send(tx_buf->hdr.msg_ep, &tx_buf->pkt,
+			      sizeof(tx_buf->pkt) + seg_size, tx_buf->hdr.desc,
+			      0, tx_buf);
+		if (ret) {
+			if (tx_buf != tx_entry->tx_buf)
+				rxm_tx_buf_release(rxm_ep, tx_buf);
+			return ret;
+		}
+		tx_entry->sar_offset += seg_size;
+		tx_entry->sar_inflight++;
 	}
 	return 0;
 }
 
-static int rxm_lmt_rma_read(struct rxm_rx_buf *rx_buf)
+/* As for large messages, the peer's partial reassembly is left pending */
+static int rxm_sar_fail(struct rxm_tx_entry *tx_entry)
+{
+	struct fi_cq_err_entry err_entry;
+	int ret;
+
+	FI_WARN(&rxm_prov, FI_LOG_CQ, "Segmented send failed: %s\n",
+		fi_strerror(-tx_entry->sar_err));
+	memset(&err_entry, 0, sizeof(err_entry));
+	err_entry.op_context = tx_entry->context;
+	err_entry.flags = tx_entry->comp_flags;
+	err_entry.err = -tx_entry->sar_err;
+
+	ret = ofi_cq_write_error(tx_entry->ep->util_ep.tx_cq, &err_entry);
+	rxm_tx_entry_release(tx_entry->ep, tx_entry);
+	return ret;
+}
+
+/*
+ * Returns an error only if the first segment could not be sent.  Once part
+ * of the message is on the wire, segment completions resume the send.
+ */
+int rxm_sar_send(struct rxm_tx_entry *tx_entry)
+{
+	struct rxm_ep *rxm_ep = tx_entry->ep;
+	int ret;
+
+	tx_entry->state = RXM_SAR_TX;
+	tx_entry->sar_offset = 0;
+	tx_entry->sar_inflight = 0;
+	tx_entry->sar_err = 0;
+	dlist_init(&tx_entry->sar_entry);
+
+	rxm_lock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+	ret = rxm_sar_issue(tx_entry);
+	if (ret && tx_entry->sar_offset) {
+		/* The last segment completion reports it */
+		if (ret != -FI_EAGAIN)
+			tx_entry->sar_err = ret;
+		ret = 0;
+	}
+	rxm_unlock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+	return ret;
+}
+
+static int rxm_sar_handle_send_comp(struct rxm_tx_buf *tx_buf)
+{
+	struct rxm_tx_entry *tx_entry = tx_buf->tx_entry;
+	struct rxm_ep *rxm_ep = tx_entry->ep;
+	int ret, done;
+
+	if (tx_buf != tx_entry->tx_buf)
+		rxm_tx_buf_release(rxm_ep, tx_buf);
+
+	rxm_lock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+	tx_entry->sar_inflight--;
+	ret = tx_entry->sar_err ? tx_entry->sar_err : rxm_sar_issue(tx_entry);
+	if (ret == -FI_EAGAIN) {
+		if (!tx_entry->sar_inflight && dlist_empty(&tx_entry->sar_entry))
+			dlist_insert_tail(&tx_entry->sar_entry,
+					  &rxm_ep->sar_deferred_list);
+		ret = 0;
+	} else if (ret) {
+		tx_entry->sar_err = ret;
+		if (tx_entry->sar_inflight)
+			ret = 0;
+	}
+	done = !tx_entry->sar_inflight &&
+	       (tx_entry->sar_offset == tx_entry->tx_buf->pkt.hdr.size);
+	rxm_unlock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+
+	if (ret)
+		return rxm_sar_fail(tx_entry);
+	return done ? rxm_finish_send(tx_entry) : 0;
+}
+
+void rxm_sar_progress_deferred(struct rxm_ep *rxm_ep)
 {
-	struct rxm_iov *match_iov = &rx_buf->match_iov[rx_buf->index];
+	struct dlist_entry *item, *next;
+	struct rxm_tx_entry *tx_entry;
+	struct dlist_entry failed;
 	int ret;
 
-	ret = fi_readv(rx_buf->conn->msg_ep, match_iov->iov, match_iov->desc,
-		       match_iov->count, 0, rx_buf->rma_iov->iov[0].addr,
-		       rx_buf->rma_iov->iov[0].key, rx_buf);
+	dlist_init(&failed);
+	rxm_lock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+	for (item = rxm_ep->sar_deferred_list.next;
+	     item != &rxm_ep->sar_deferred_list; item = next) {
+		next = item->next;
+		tx_entry = container_of(item, struct rxm_tx_entry, sar_entry);
+
+		ret = rxm_sar_issue(tx_entry);
+		if (ret == -FI_EAGAIN && !tx_entry->sar_inflight)
+			continue;
+
+		dlist_remove(item);
+		if (ret && ret != -FI_EAGAIN) {
+			tx_entry->sar_err = ret;
+			/* Otherwise the last segment completion fails it */
+			if (!tx_entry->sar_inflight) {
+				dlist_insert_tail(item, &failed);
+				continue;
+			}
+		}
+		dlist_init(item);
+	}
+	rxm_unlock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+
+	while (!dlist_empty(&failed)) {
+		dlist_pop_front(&failed, struct rxm_tx_entry, tx_entry,
+				sar_entry);
+		dlist_init(&tx_entry->sar_entry);
+		rxm_sar_fail(tx_entry);
+	}
+}
+
+static int rxm_sar_match_rx(struct dlist_entry *item, const void *arg)
+{
+	const struct rxm_pkt *pkt = arg;
+	struct rxm_rx_buf *rx_buf;
+
+	rx_buf = container_of(item, struct rxm_rx_buf, sar_entry);
+	return (rx_buf->pkt.ctrl_hdr.conn_id == pkt->ctrl_hdr.conn_id) &&
+	       (rx_buf->pkt.ctrl_hdr.msg_id == pkt->ctrl_hdr.msg_id);
+}
+
+/* Caller must hold rxm_ep->proto_lock.  Returns 1 once all data arrived */
+static int rxm_sar_copy_seg(struct rxm_rx_buf *head, struct rxm_rx_buf *seg)
+{
+	ofi_copy_to_iov(head->recv_entry->iov, head->recv_entry->count,
+			head->sar_offset, seg->pkt.data,
+			seg->pkt.ctrl_hdr.seg_size);
+	head->sar_offset += seg->pkt.ctrl_hdr.seg_size;
+	return head->sar_offset >= head->pkt.hdr.size;
+}
+
+/* Segments of a message arrive in order over its MSG EP */
+static int rxm_sar_handle_seg(struct rxm_rx_buf *rx_buf)
+{
+	struct rxm_ep *rxm_ep = rx_buf->ep;
+	struct rxm_rx_buf *head;
+	struct dlist_entry *entry;
+	int ret, done;
+
+	rxm_lock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+	entry = dlist_find_first_match(&rxm_ep->sar_rx_list, rxm_sar_match_rx,
+				       &rx_buf->pkt);
+	if (!entry) {
+		rxm_unlock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+		FI_WARN(&rxm_prov, FI_LOG_CQ,
+			"No message found for segment of msg_id: 0x%" PRIx64 "\n",
+			rx_buf->pkt.ctrl_hdr.msg_id);
+		return -FI_EOTHER;
+	}
+
+	head = container_of(entry, struct rxm_rx_buf, sar_entry);
+	if (head->hdr.state != RXM_SAR_RX) {
+		/* Message not matched yet, hold on to the segment */
+		dlist_insert_tail(&rx_buf->sar_entry, &head->sar_segs);
+		rxm_unlock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+		return 0;
+	}
+
+	done = rxm_sar_copy_seg(head, rx_buf);
+	if (done)
+		dlist_remove(&head->sar_entry);
+	rxm_unlock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+
+	ret = rxm_ep_repost_buf(rx_buf);
 	if (ret)
 		return ret;
-	rx_buf->index++;
-	return 0;
+	return done ? rxm_finish_recv(head) : 0;
+}
+
+static int rxm_sar_handle_data(struct rxm_rx_buf *rx_buf)
+{
+	struct rxm_ep *rxm_ep = rx_buf->ep;
+	struct rxm_rx_buf *seg;
+	int ret = 0, done;
+
+	rxm_lock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+	RXM_LOG_STATE_RX(FI_LOG_CQ, rx_buf, RXM_SAR_RX);
+	rx_buf->hdr.state = RXM_SAR_RX;
+
+	done = rxm_sar_copy_seg(rx_buf, rx_buf);
+	while (!dlist_empty(&rx_buf->sar_segs)) {
+		dlist_pop_front(&rx_buf->sar_segs, struct rxm_rx_buf, seg,
+				sar_entry);
+		done = rxm_sar_copy_seg(rx_buf, seg);
+		if (rxm_ep_repost_buf(seg))
+			ret = -FI_EOTHER;
+	}
+	if (done)
+		dlist_remove(&rx_buf->sar_entry);
+	rxm_unlock(&rxm_ep->proto_lock, rxm_ep->thread_safe);
+
+	if (ret)
+		return ret;
+	return done ? rxm_finish_recv(rx_buf) : 0;
 }
 
 static int rxm_lmt_tx_finish(struct rxm_tx_entry *tx_entry)
@@ -269,6 +794,50 @@ static int rxm_lmt_tx_finish(struct rxm_tx_entry *tx_entry)
 	return rxm_ep_repost_buf(tx_entry->rx_buf);
 }
 
+static int rxm_lmt_send_fin(struct rxm_tx_entry *tx_entry)
+{
+	struct rxm_tx_buf *tx_buf = tx_entry->tx_buf;
+	int ret;
+
+	RXM_LOG_STATE_TX(FI_LOG_CQ, tx_entry, RXM_LMT_FIN_SENT);
+	tx_entry->state = RXM_LMT_FIN_SENT;
+
+	/* The request has been consumed by the peer, so reuse its buffer */
+	tx_buf->pkt.ctrl_hdr.type = ofi_ctrl_ack;
+	tx_buf->pkt.ctrl_hdr.rx_key = tx_entry->rx_buf->pkt.ctrl_hdr.rx_key;
+	tx_buf->pkt.hdr.op_data = RXM_LMT_OP_FIN;
+
+	ret = fi_send(tx_buf->hdr.msg_ep, &tx_buf->pkt, sizeof(tx_buf->pkt),
+		      tx_buf->hdr.desc, 0, tx_entry);
+	if (ret)
+		FI_WARN(&rxm_prov, FI_LOG_CQ, "Unable to send FIN\n");
+	return ret;
+}
+
+static int rxm_lmt_write_start(struct rxm_tx_entry *tx_entry)
+{
+	int ret;
+
+	RXM_LOG_STATE_TX(FI_LOG_CQ, tx_entry, RXM_LMT_WRITE);
+	tx_entry->state = RXM_LMT_WRITE;
+
+	rxm_lmt_init(&tx_entry->lmt, tx_entry->tx_buf->hdr.msg_ep, tx_entry, 1,
+		     (struct rxm_rma_iov *)tx_entry->rx_buf->pkt.data,
+		     tx_entry->iov, tx_entry->desc, tx_entry->count);
+	ret = rxm_lmt_progress(tx_entry->ep, &tx_entry->lmt, 0);
+	if (ret <= 0)
+		return ret;
+	return rxm_lmt_send_fin(tx_entry);
+}
+
+/* The request went out and the peer's ACK is in: finish or start writing */
+static int rxm_lmt_tx_acked(struct rxm_tx_entry *tx_entry)
+{
+	if (tx_entry->tx_buf->pkt.hdr.op_data == RXM_LMT_OP_WRITE)
+		return rxm_lmt_write_start(tx_entry);
+	return rxm_lmt_tx_finish(tx_entry);
+}
+
 static int rxm_lmt_handle_ack(struct rxm_rx_buf *rx_buf)
 {
 	struct rxm_tx_entry *tx_entry;
@@ -277,18 +846,17 @@ static int rxm_lmt_handle_ack(struct rxm_rx_buf *rx_buf)
 	FI_DBG(&rxm_prov, FI_LOG_CQ, "Got ACK for msg_id: 0x%" PRIx64 "\n",
 			rx_buf->pkt.ctrl_hdr.msg_id);
 
-	fastlock_acquire(&rx_buf->ep->send_queue.lock);
+	/* The entry is ours until the ACK arrives, so no lock is needed */
 	index = ofi_key2idx(&rx_buf->ep->send_queue.tx_key_idx,
 			    rx_buf->pkt.ctrl_hdr.msg_id);
 	tx_entry = &rx_buf->ep->send_queue.fs->buf[index];
-	fastlock_release(&rx_buf->ep->send_queue.lock);
 
 	assert(tx_entry->tx_buf->pkt.ctrl_hdr.msg_id == rx_buf->pkt.ctrl_hdr.msg_id);
 
 	tx_entry->rx_buf = rx_buf;
 
 	if (tx_entry->state == RXM_LMT_ACK_WAIT) {
-		return rxm_lmt_tx_finish(tx_entry);
+		return rxm_lmt_tx_acked(tx_entry);
 	} else {
 		assert(tx_entry->state == RXM_LMT_TX);
 		RXM_LOG_STATE_TX(FI_LOG_CQ, tx_entry, RXM_LMT_ACK_RECVD);
@@ -297,10 +865,98 @@ static int rxm_lmt_handle_ack(struct rxm_rx_buf *rx_buf)
 	}
 }
 
+static int rxm_lmt_handle_fin(struct rxm_rx_buf *rx_buf)
+{
+	struct rxm_rx_buf *recv_buf;
+	int ret;
+
+	recv_buf = (struct rxm_rx_buf *)(uintptr_t)rx_buf->pkt.ctrl_hdr.rx_key;
+
+	FI_DBG(&rxm_prov, FI_LOG_CQ, "Got FIN for msg_id: 0x%" PRIx64 "\n",
+			recv_buf->pkt.ctrl_hdr.msg_id);
+	assert(recv_buf->hdr.state == RXM_LMT_WRITE_WAIT);
+
+	RXM_LOG_STATE_RX(FI_LOG_CQ, recv_buf, RXM_LMT_FINISH);
+	recv_buf->hdr.state = RXM_LMT_FINISH;
+	if (!RXM_MR_LOCAL(recv_buf->ep->rxm_info))
+		rxm_ep_msg_mr_closev(recv_buf->mr, RXM_IOV_LIMIT);
+
+	ret = rxm_finish_recv(recv_buf);
+	if (ret)
+		return ret;
+	return rxm_ep_repost_buf(rx_buf);
+}
+
+/*
+ * Reply to a large message request.  For the read protocol this tells the
+ * sender that the data has been pulled; for the write protocol it carries
+ * the registered receive buffer the sender should write into.
+ */
+static int rxm_lmt_send_ack(struct rxm_rx_buf *rx_buf, uint8_t lmt_op)
+{
+	struct rxm_tx_entry *tx_entry;
+	struct rxm_tx_buf *tx_buf;
+	enum rxm_proto_state state;
+	size_t pkt_size;
+	ssize_t size;
+	int ret;
+
+	assert(rx_buf->conn);
+
+	if (!(tx_entry = rxm_tx_entry_get(rx_buf->ep, rx_buf->conn, 1)))
+		return -FI_EAGAIN;
+	tx_buf = tx_entry->tx_buf;
+
+	rxm_pkt_init(&tx_buf->pkt);
+	tx_buf->pkt.ctrl_hdr.type 	= ofi_ctrl_ack;
+	tx_buf->pkt.ctrl_hdr.conn_id 	= rx_buf->conn->handle.remote_key;
+	tx_buf->pkt.ctrl_hdr.msg_id 	= rx_buf->pkt.ctrl_hdr.msg_id;
+	tx_buf->pkt.hdr.op 		= rx_buf->pkt.hdr.op;
+	tx_buf->pkt.hdr.op_data 	= lmt_op;
+	pkt_size = sizeof(tx_buf->pkt);
+
+	if (lmt_op == RXM_LMT_OP_WRITE) {
+		tx_buf->pkt.ctrl_hdr.rx_key = (uintptr_t)rx_buf;
+		size = rxm_rma_iov_init(rx_buf->ep, tx_buf->pkt.data,
+					rx_buf->match_iov.iov,
+					rx_buf->match_iov.count,
+					(struct fid_mr **)rx_buf->match_iov.desc);
+		if (size < 0) {
+			ret = size;
+			goto err;
+		}
+		pkt_size += size;
+		state = RXM_LMT_WRITE_WAIT;
+		tx_entry->state = RXM_LMT_CTS_SENT;
+	} else {
+		state = RXM_LMT_ACK_SENT;
+		tx_entry->state = RXM_LMT_ACK_SENT;
+	}
+
+	RXM_LOG_STATE_RX(FI_LOG_CQ, rx_buf, state);
+	rx_buf->hdr.state = state;
+
+	tx_entry->ep 		= rx_buf->ep;
+	tx_entry->context 	= rx_buf;
+
+	ret = fi_send(rx_buf->conn->msg_ep, &tx_buf->pkt, pkt_size,
+		      tx_buf->hdr.desc, 0, tx_entry);
+	if (ret) {
+		FI_WARN(&rxm_prov, FI_LOG_CQ, "Unable to send ACK\n");
+		rx_buf->hdr.state = RXM_NONE;
+		goto err;
+	}
+	return 0;
+err:
+	rxm_tx_entry_release(rx_buf->ep, tx_entry);
+	return ret;
+}
+
 int rxm_cq_handle_data(struct rxm_rx_buf *rx_buf)
 {
-	struct rxm_iov mr_match_iov;
+	struct rxm_iov *match_iov = &rx_buf->match_iov;
 	size_t i, rma_total_len = 0;
+	uint8_t lmt_op;
 	int ret;
 
 	if (rx_buf->pkt.ctrl_hdr.type == ofi_ctrl_large_data) {
@@ -315,10 +971,10 @@ int rxm_cq_handle_data(struct rxm_rx_buf *rx_buf)
 		       rx_buf->pkt.ctrl_hdr.msg_id);
 
 		rx_buf->rma_iov = (struct rxm_rma_iov *)rx_buf->pkt.data;
-		rx_buf->index = 0;
+		lmt_op = rx_buf->pkt.hdr.op_data;
 
 		for (i = 0; i < rx_buf->rma_iov->count; i++)
-			rma_total_len += rx_buf->rma_iov->iov->len;
+			rma_total_len += rx_buf->rma_iov->iov[i].len;
 
 		if (rma_total_len > ofi_total_iov_len(rx_buf->recv_entry->iov,
 				      rx_buf->recv_entry->count)) {
@@ -327,37 +983,44 @@ int rxm_cq_handle_data(struct rxm_rx_buf *rx_buf)
 			return -FI_ETRUNC; // TODO copy data and write to CQ error
 		}
 
-		if (!RXM_MR_LOCAL(rx_buf->ep->rxm_info)) {
-			ret = rxm_match_iov(rx_buf->recv_entry->iov,
-					    rx_buf->recv_entry->desc,
-					    rx_buf->recv_entry->count, 0,
-					    rma_total_len, &mr_match_iov);
-			if (ret)
-				return ret;
+		ret = rxm_match_iov(rx_buf->recv_entry->iov,
+				    rx_buf->recv_entry->desc,
+				    rx_buf->recv_entry->count, 0,
+				    rma_total_len, match_iov);
+		if (ret)
+			return ret;
 
-			ret = rxm_ep_msg_mr_regv(rx_buf->ep, mr_match_iov.iov,
-						 mr_match_iov.count, FI_WRITE,
+		if (!RXM_MR_LOCAL(rx_buf->ep->rxm_info)) {
+			ret = rxm_ep_msg_mr_regv(rx_buf->ep, match_iov->iov,
+						 match_iov->count,
+						 lmt_op == RXM_LMT_OP_WRITE ?
+						 FI_REMOTE_WRITE : FI_WRITE,
 						 rx_buf->mr);
 			if (ret)
 				return ret;
 
-			rx_buf->recv_entry->count = mr_match_iov.count;
-
-			for (i = 0; i < rx_buf->recv_entry->count; i++)
-				rx_buf->recv_entry->desc[i] = rx_buf->mr[i];
+			for (i = 0; i < match_iov->count; i++)
+				match_iov->desc[i] = rx_buf->mr[i];
 		}
 
-		for (i = 0; i < rx_buf->recv_entry->count; i++)
-			rx_buf->recv_entry->desc[i] = fi_mr_desc(rx_buf->recv_entry->desc[i]);
+		if (lmt_op == RXM_LMT_OP_WRITE)
+			return rxm_lmt_send_ack(rx_buf, RXM_LMT_OP_WRITE);
 
-		ret = rxm_match_rma_iov(rx_buf->recv_entry, rx_buf->rma_iov,
-				    rx_buf->match_iov);
-		if (ret)
-			return ret;
+		for (i = 0; i < match_iov->count; i++)
+			match_iov->desc[i] = fi_mr_desc(match_iov->desc[i]);
 
 		RXM_LOG_STATE_RX(FI_LOG_CQ, rx_buf, RXM_LMT_READ);
 		rx_buf->hdr.state = RXM_LMT_READ;
-		return rxm_lmt_rma_read(rx_buf);
+
+		rxm_lmt_init(&rx_buf->lmt, rx_buf->conn->msg_ep, rx_buf, 0,
+			     rx_buf->rma_iov, match_iov->iov, match_iov->desc,
+			     match_iov->count);
+		ret = rxm_lmt_progress(rx_buf->ep, &rx_buf->lmt, 0);
+		if (ret <= 0)
+			return ret;
+		return rxm_lmt_send_ack(rx_buf, RXM_LMT_OP_READ);
+	} else if (rx_buf->pkt.ctrl_hdr.type == ofi_ctrl_seg_data) {
+		return rxm_sar_handle_data(rx_buf);
 	} else {
 		ofi_copy_to_iov(rx_buf->recv_entry->iov, rx_buf->recv_entry->count, 0,
 				rx_buf->pkt.data, rx_buf->pkt.hdr.size);
@@ -365,31 +1028,41 @@ int rxm_cq_handle_data(struct rxm_rx_buf *rx_buf)
 	}
 }
 
-int rxm_handle_recv_comp(struct rxm_rx_buf *rx_buf)
+/* The payload of an eager message received into a slab is still in the
+ * slab (slab_data) and is only copied into rx_buf if the message is
+ * unexpected.  Otherwise it goes straight into the posted receive. */
+static int rxm_match_recv(struct rxm_rx_buf *rx_buf, void *slab_data)
 {
 	struct rxm_recv_match_attr match_attr = {0};
-	struct dlist_entry *entry;
 	struct rxm_recv_queue *recv_queue;
-	struct util_cq *util_cq;
-
-	util_cq = rx_buf->ep->util_ep.rx_cq;
 
 	if ((rx_buf->ep->rxm_info->caps & FI_SOURCE) ||
 			(rx_buf->ep->rxm_info->caps & FI_DIRECTED_RECV)) {
-		if (!rx_buf->conn) {
+		if (!rx_buf->conn)
 			rx_buf->conn = rxm_key2conn(rx_buf->ep, rx_buf->pkt.ctrl_hdr.conn_id);
-			if (!rx_buf->conn)
-				return -FI_EOTHER;
-		}
+		/* A remote shutdown may delete the connection before the last
+		 * messages received on it are processed.  Only directed
+		 * receives need the source to match them */
+		if (rx_buf->conn)
+			rx_buf->src_addr = rx_buf->conn->handle.fi_addr;
+		else if (rx_buf->ep->rxm_info->caps & FI_DIRECTED_RECV)
+			return -FI_EOTHER;
+		else
+			rx_buf->src_addr = FI_ADDR_NOTAVAIL;
 	}
 
 	if (rx_buf->ep->rxm_info->caps & FI_DIRECTED_RECV)
-		match_attr.addr = rx_buf->conn->handle.fi_addr;
+		match_attr.addr = rx_buf->src_addr;
 	else
 		match_attr.addr = FI_ADDR_UNSPEC;
 
-	if (rx_buf->ep->rxm_info->caps & FI_SOURCE)
-		util_cq->src[ofi_cirque_windex(util_cq->cirq)] = rx_buf->conn->handle.fi_addr;
+	/* First segment of a message: track it for the segments to follow */
+	if (rx_buf->pkt.ctrl_hdr.type == ofi_ctrl_seg_data) {
+		dlist_init(&rx_buf->sar_segs);
+		rxm_lock(&rx_buf->ep->proto_lock, rx_buf->ep->thread_safe);
+		dlist_insert_tail(&rx_buf->sar_entry, &rx_buf->ep->sar_rx_list);
+		rxm_unlock(&rx_buf->ep->proto_lock, rx_buf->ep->thread_safe);
+	}
 
 	switch(rx_buf->pkt.hdr.op) {
 	case ofi_op_msg:
@@ -411,96 +1084,131 @@ int rxm_handle_recv_comp(struct rxm_rx_buf *rx_buf)
 
 	rx_buf->recv_queue = recv_queue;
 
-	fastlock_acquire(&recv_queue->lock);
-	entry = dlist_remove_first_match(&recv_queue->recv_list,
-					 recv_queue->match_recv, &match_attr);
-	if (!entry) {
+	rxm_lock(&recv_queue->lock, recv_queue->thread_safe);
+	rx_buf->recv_entry = rxm_recv_queue_match(recv_queue, &match_attr);
+	if (!rx_buf->recv_entry) {
 		FI_DBG(&rxm_prov, FI_LOG_CQ,
 				"No matching recv found. Enqueueing msg to unexpected queue\n");
+		if (slab_data)
+			memcpy(rx_buf->pkt.data, slab_data,
+			       rx_buf->pkt.hdr.size);
 		rx_buf->unexp_msg.addr = match_attr.addr;
 		rx_buf->unexp_msg.tag = match_attr.tag;
-		dlist_insert_tail(&rx_buf->unexp_msg.entry, &recv_queue->unexp_msg_list);
-		fastlock_release(&recv_queue->lock);
+		rxm_unexp_insert(recv_queue, rx_buf);
+		rxm_unlock(&recv_queue->lock, recv_queue->thread_safe);
 		return 0;
 	}
-	fastlock_release(&recv_queue->lock);
+	rxm_unlock(&recv_queue->lock, recv_queue->thread_safe);
 
-	rx_buf->recv_entry = container_of(entry, struct rxm_recv_entry, entry);
+	if (slab_data) {
+		ofi_copy_to_iov(rx_buf->recv_entry->iov,
+				rx_buf->recv_entry->count, 0, slab_data,
+				rx_buf->pkt.hdr.size);
+		return rxm_finish_recv(rx_buf);
+	}
 	return rxm_cq_handle_data(rx_buf);
 }
 
-static int rxm_lmt_send_ack(struct rxm_rx_buf *rx_buf)
+int rxm_handle_recv_comp(struct rxm_rx_buf *rx_buf)
 {
-	struct rxm_tx_entry *tx_entry;
-	struct rxm_tx_buf *tx_buf;
-	int ret;
-
-	assert(rx_buf->conn);
-
-	tx_buf = (struct rxm_tx_buf *)rxm_buf_get(&rx_buf->ep->tx_pool);
-	if (!tx_buf) {
-		FI_WARN(&rxm_prov, FI_LOG_CQ, "TX queue full!\n");
-		return -FI_EAGAIN;
-	}
-
-	if (!(tx_entry = rxm_tx_entry_get(&rx_buf->ep->send_queue))) {
-		ret = -FI_EAGAIN;
-		goto err1;
-	}
-
-	RXM_LOG_STATE(FI_LOG_CQ, rx_buf->pkt, RXM_LMT_READ, RXM_LMT_ACK_SENT);
-	rx_buf->hdr.state = RXM_LMT_ACK_SENT;
-
-	tx_entry->state 	= rx_buf->hdr.state;
-	tx_entry->ep 		= rx_buf->ep;
-	tx_entry->context 	= rx_buf;
-	tx_entry->tx_buf 	= tx_buf;
-
-	rxm_pkt_init(&tx_buf->pkt);
-	tx_buf->pkt.ctrl_hdr.type 	= ofi_ctrl_ack;
-	tx_buf->pkt.ctrl_hdr.conn_id 	= rx_buf->conn->handle.remote_key;
-	tx_buf->pkt.ctrl_hdr.msg_id 	= rx_buf->pkt.ctrl_hdr.msg_id;
-	tx_buf->pkt.hdr.op 		= rx_buf->pkt.hdr.op;
-
-	ret = fi_send(rx_buf->conn->msg_ep, &tx_buf->pkt, sizeof(tx_buf->pkt),
-		      tx_buf->hdr.desc, 0, tx_entry);
-	if (ret) {
-		FI_WARN(&rxm_prov, FI_LOG_CQ, "Unable to send ACK\n");
-		rx_buf->hdr.state = RXM_NONE;
-		goto err2;
-	}
-	return 0;
-err2:
-	rxm_tx_entry_release(&rx_buf->ep->send_queue, tx_entry);
-err1:
-	rxm_buf_release(&rx_buf->ep->tx_pool, (struct rxm_buf *)tx_buf);
-	return ret;
+	return rxm_match_recv(rx_buf, NULL);
 }
 
 static int rxm_handle_remote_write(struct rxm_ep *rxm_ep,
-				   struct fi_cq_tagged_entry *comp)
+				   struct fi_cq_data_entry *comp)
 {
 	int ret;
 
 	FI_DBG(&rxm_prov, FI_LOG_CQ, "writing remote write completion\n");
-	ret = rxm_cq_comp(rxm_ep->util_ep.rx_cq, NULL,
+	ret = rxm_cq_comp(rxm_ep->util_ep.rx_cq, FI_ADDR_NOTAVAIL, NULL,
 			  comp->flags, 0, NULL, comp->data, 0);
 	if (ret) {
 		FI_WARN(&rxm_prov, FI_LOG_CQ,
 				"Unable to write remote write completion\n");
 		return ret;
 	}
-	if (comp->op_context)
-		return rxm_ep_repost_buf((struct rxm_rx_buf *)comp->op_context);
-	return 0;
+	if (!comp->op_context)
+		return 0;
+	if (*(enum rxm_proto_state *)comp->op_context == RXM_RX_SLAB)
+		return (comp->flags & FI_MULTI_RECV) ?
+			rxm_ep_repost_slab(comp->op_context) : 0;
+	return rxm_ep_repost_buf((struct rxm_rx_buf *)comp->op_context);
+}
+
+static int rxm_handle_evict(struct rxm_rx_buf *rx_buf)
+{
+	struct util_cmap *cmap = rx_buf->ep->util_ep.cmap;
+	struct rxm_conn *rxm_conn;
+
+	rxm_conn = rxm_key2conn(rx_buf->ep, rx_buf->pkt.ctrl_hdr.conn_id);
+	if (!rxm_conn)
+		return -FI_EOTHER;
+
+	if (rx_buf->pkt.hdr.op_data == RXM_EVICT_OP_REQ)
+		ofi_cmap_process_evict_req(cmap, &rxm_conn->handle);
+	else
+		ofi_cmap_process_evict_ack(cmap, &rxm_conn->handle);
+	return rxm_ep_repost_buf(rx_buf);
+}
+
+static int rxm_handle_rx_buf(struct rxm_rx_buf *rx_buf)
+{
+	if ((rx_buf->pkt.ctrl_hdr.type == ofi_ctrl_seg_data) &&
+	    rx_buf->pkt.ctrl_hdr.seg_no)
+		return rxm_sar_handle_seg(rx_buf);
+	else if (rx_buf->pkt.ctrl_hdr.type == ofi_ctrl_evict)
+		return rxm_handle_evict(rx_buf);
+	else if (rx_buf->pkt.ctrl_hdr.type != ofi_ctrl_ack)
+		return rxm_handle_recv_comp(rx_buf);
+	else if (rx_buf->pkt.hdr.op_data == RXM_LMT_OP_FIN)
+		return rxm_lmt_handle_fin(rx_buf);
+	else
+		return rxm_lmt_handle_ack(rx_buf);
+}
+
+/* Nothing may refer to the slab once the MSG provider releases it, so
+ * that it can be reposted right away.  Eager messages are matched in place;
+ * other packets are copied out whole since their state outlives the
+ * completion. */
+static int rxm_handle_slab_comp(struct rxm_ep *rxm_ep,
+				struct fi_cq_data_entry *comp)
+{
+	struct rxm_rx_slab *slab = comp->op_context;
+	struct rxm_pkt *pkt = comp->buf;
+	struct rxm_rx_buf *rx_buf;
+	int ret = 0;
+
+	if (comp->len) {
+		assert(comp->len >= sizeof(*pkt));
+		rx_buf = rxm_ep_rx_buf_get(rxm_ep, comp->len - sizeof(*pkt));
+		if (!rx_buf) {
+			FI_WARN(&rxm_prov, FI_LOG_CQ,
+				"Unable to allocate receive buffer\n");
+			return -FI_ENOMEM;
+		}
+		if (pkt->ctrl_hdr.type == ofi_ctrl_data) {
+			memcpy(&rx_buf->pkt, pkt, sizeof(*pkt));
+			ret = rxm_match_recv(rx_buf, pkt->data);
+		} else {
+			memcpy(&rx_buf->pkt, pkt, comp->len);
+			ret = rxm_handle_rx_buf(rx_buf);
+		}
+	}
+
+	if (comp->flags & FI_MULTI_RECV) {
+		if (rxm_ep_repost_slab(slab))
+			ret = ret ? ret : -FI_EOTHER;
+	}
+	return ret;
 }
 
 static int rxm_cq_handle_comp(struct rxm_ep *rxm_ep,
-			      struct fi_cq_tagged_entry *comp)
+			      struct fi_cq_data_entry *comp)
 {
 	enum rxm_proto_state *state = comp->op_context;
 	struct rxm_rx_buf *rx_buf = comp->op_context;
 	struct rxm_tx_entry *tx_entry = comp->op_context;
+	int ret;
 
 	/* Remote write events may not consume a posted recv so op context
 	 * and hence state would be NULL */
@@ -516,11 +1224,10 @@ static int rxm_cq_handle_comp(struct rxm_ep *rxm_ep,
 		return rxm_finish_send(tx_entry);
 	case RXM_RX:
 		assert(!(comp->flags & FI_REMOTE_READ));
-
-		if (rx_buf->pkt.ctrl_hdr.type == ofi_ctrl_ack)
-			return rxm_lmt_handle_ack(rx_buf);
-		else
-			return rxm_handle_recv_comp(comp->op_context);
+		return rxm_handle_rx_buf(rx_buf);
+	case RXM_RX_SLAB:
+		assert(!(comp->flags & FI_REMOTE_READ));
+		return rxm_handle_slab_comp(rxm_ep, comp);
 	case RXM_LMT_TX:
 		assert(comp->flags & FI_SEND);
 		RXM_LOG_STATE_TX(FI_LOG_CQ, tx_entry, RXM_LMT_ACK_WAIT);
@@ -528,18 +1235,33 @@ static int rxm_cq_handle_comp(struct rxm_ep *rxm_ep,
 		return 0;
 	case RXM_LMT_ACK_RECVD:
 		assert(comp->flags & FI_SEND);
-		return rxm_lmt_tx_finish(tx_entry);
+		return rxm_lmt_tx_acked(tx_entry);
 	case RXM_LMT_READ:
 		assert(comp->flags & FI_READ);
-		if (rx_buf->index < rx_buf->rma_iov->count)
-			return rxm_lmt_rma_read(rx_buf);
-		else
-			return rxm_lmt_send_ack(rx_buf);
+		ret = rxm_lmt_progress(rxm_ep, &rx_buf->lmt, 1);
+		if (ret <= 0)
+			return ret;
+		return rxm_lmt_send_ack(rx_buf, RXM_LMT_OP_READ);
+	case RXM_LMT_WRITE:
+		assert(comp->flags & FI_WRITE);
+		ret = rxm_lmt_progress(rxm_ep, &tx_entry->lmt, 1);
+		if (ret <= 0)
+			return ret;
+		return rxm_lmt_send_fin(tx_entry);
+	case RXM_LMT_FIN_SENT:
+		assert(comp->flags & FI_SEND);
+		return rxm_lmt_tx_finish(tx_entry);
+	case RXM_SAR_TX:
+		assert(comp->flags & FI_SEND);
+		return rxm_sar_handle_send_comp(comp->op_context);
+	case RXM_LMT_CTS_SENT:
+		assert(comp->flags & FI_SEND);
+		rxm_tx_entry_release(tx_entry->ep, tx_entry);
+		return 0;
 	case RXM_LMT_ACK_SENT:
 		assert(comp->flags & FI_SEND);
 		rx_buf = tx_entry->context;
-		rxm_tx_entry_release(&tx_entry->ep->send_queue, tx_entry);
-		rxm_buf_release(&rx_buf->ep->tx_pool, (struct rxm_buf *)tx_entry->tx_buf);
+		rxm_tx_entry_release(tx_entry->ep, tx_entry);
 
 		RXM_LOG_STATE_RX(FI_LOG_CQ, rx_buf, RXM_LMT_FINISH);
 		rx_buf->hdr.state = RXM_LMT_FINISH;
@@ -553,16 +1275,18 @@ static int rxm_cq_handle_comp(struct rxm_ep *rxm_ep,
 	}
 }
 
-static ssize_t rxm_cq_read(struct fid_cq *msg_cq, struct fi_cq_tagged_entry *comp)
+static ssize_t rxm_cq_read(struct fid_cq *msg_cq, struct fi_cq_data_entry *comp,
+			   size_t count)
 {
 	struct rxm_tx_entry *tx_entry;
+	struct rxm_tx_buf *tx_buf;
 	struct rxm_rx_buf *rx_buf;
 	struct fi_cq_err_entry err_entry;
 	struct util_cq *util_cq;
 	void *op_context;
 	ssize_t ret;
 
-	ret = fi_cq_read(msg_cq, comp, 1);
+	ret = fi_cq_read(msg_cq, comp, count);
 	if (ret >= 0 || ret == -FI_EAGAIN)
 		return ret;
 
@@ -581,10 +1305,17 @@ static ssize_t rxm_cq_read(struct fid_cq *msg_cq, struct fi_cq_tagged_entry *com
 	switch (*(enum rxm_proto_state *)op_context) {
 	case RXM_TX:
 	case RXM_LMT_TX:
+	case RXM_LMT_WRITE:
+	case RXM_LMT_FIN_SENT:
 		tx_entry = (struct rxm_tx_entry *)op_context;
 		util_cq = tx_entry->ep->util_ep.tx_cq;
 		break;
+	case RXM_SAR_TX:
+		tx_buf = (struct rxm_tx_buf *)op_context;
+		util_cq = tx_buf->tx_entry->ep->util_ep.tx_cq;
+		break;
 	case RXM_LMT_ACK_SENT:
+	case RXM_LMT_CTS_SENT:
 		tx_entry = (struct rxm_tx_entry *)op_context;
 		util_cq = tx_entry->ep->util_ep.rx_cq;
 		break;
@@ -593,6 +1324,9 @@ static ssize_t rxm_cq_read(struct fid_cq *msg_cq, struct fi_cq_tagged_entry *com
 		rx_buf = (struct rxm_rx_buf *)op_context;
 		util_cq = rx_buf->ep->util_ep.rx_cq;
 		break;
+	case RXM_RX_SLAB:
+		util_cq = ((struct rxm_rx_slab *)op_context)->ep->util_ep.rx_cq;
+		break;
 	default:
 		FI_WARN(&rxm_prov, FI_LOG_CQ, "Invalid state!\n");
 		FI_WARN(&rxm_prov, FI_LOG_CQ, "msg cq readerr: %s\n",
@@ -601,33 +1335,91 @@ static ssize_t rxm_cq_read(struct fid_cq *msg_cq, struct fi_cq_tagged_entry *com
 		assert(0);
 		return err_entry.err;
 	}
+	/* The error is written outside of the batch's reserved slots */
+	if (rxm_cq_batch)
+		rxm_cq_flush_batch(rxm_cq_batch);
 	return ofi_cq_write_error(util_cq, &err_entry);
 }
 
-void rxm_cq_progress(struct rxm_ep *rxm_ep)
+/*
+ * Each MSG completion writes at most one completion to the EP's util CQs.
+ * Returns how many MSG completions (up to cnt) may be read with the util
+ * CQ slots reserved for them, 0 if a util CQ is full.
+ */
+static size_t rxm_cq_batch_reserve(struct rxm_ep *rxm_ep, size_t cnt)
 {
-	struct fi_cq_tagged_entry comp;
-	ssize_t ret, comp_read = 0;
+	struct util_cq *util_cq[2] = {
+		rxm_ep->util_ep.rx_cq, rxm_ep->util_ep.tx_cq
+	};
+	struct rxm_cq_stage *stage;
+	int i;
+
+	for (i = 0; i < 2 && cnt; i++) {
+		if (!util_cq[i])
+			continue;
+		stage = rxm_cq_get_stage(util_cq[i]);
+		rxm_cq_stage_reserve(stage, cnt);
+		cnt = MIN(cnt, stage->reserved - stage->count);
+	}
+	return cnt;
+}
+
+/* Returns the number of MSG completions handled */
+int rxm_cq_progress(struct rxm_ep *rxm_ep)
+{
+	struct fi_cq_data_entry comp[RXM_CQ_BATCH];
+	struct rxm_cq_batch batch;
+	ssize_t ret, i, cnt, comp_read = 0;
+
+	if (!dlist_empty(&rxm_ep->lmt_deferred_list))
+		rxm_lmt_progress_deferred(rxm_ep);
+	if (!dlist_empty(&rxm_ep->sar_deferred_list))
+		rxm_sar_progress_deferred(rxm_ep);
+	if (rxm_ep->util_ep.cmap &&
+	    !dlist_empty(&rxm_ep->util_ep.cmap->evict_list))
+		ofi_cmap_progress_evict(rxm_ep->util_ep.cmap);
+
+	memset(&batch, 0, sizeof(batch));
+	rxm_cq_batch = &batch;
 
 	do {
-		ret = rxm_cq_read(rxm_ep->msg_cq, &comp);
-		if (ret == -FI_EAGAIN)
+		/* Leave the MSG completions queued until the application
+		 * makes room in the util CQ */
+		cnt = rxm_cq_batch_reserve(rxm_ep,
+				MIN(RXM_CQ_BATCH,
+				    rxm_ep->comp_per_progress - comp_read));
+		if (!cnt)
 			break;
 
-		if (ret < 0)
-			goto err;
+		cnt = rxm_cq_read(rxm_ep->msg_cq, comp, cnt);
+		if (cnt == -FI_EAGAIN)
+			break;
 
-		if (ret) {
-			comp_read += ret;
-			ret = rxm_cq_handle_comp(rxm_ep, &comp);
+		if (cnt < 0) {
+			// TODO report error on RXM EP/domain since EP/CQ is broken.
+			break;
+		}
+
+		for (i = 0; i < cnt; i++)
+			rxm_prefetch(comp[i].op_context);
+
+		/* The entries are off the MSG CQ, so a failure to handle one
+		 * must not keep the others from being handled */
+		for (i = 0; i < cnt; i++) {
+			ret = rxm_cq_handle_comp(rxm_ep, &comp[i]);
 			if (ret)
-				goto err;
+				FI_WARN(&rxm_prov, FI_LOG_CQ,
+					"Unable to handle MSG completion: %s\n",
+					fi_strerror((int) -ret));
 		}
+		comp_read += cnt;
+
+		rxm_cq_flush_batch(&batch);
 	} while (comp_read < rxm_ep->comp_per_progress);
-	return;
-err:
-	// TODO report error on RXM EP/domain since EP/CQ is broken.
-	return;
+
+	rxm_cq_flush_batch(&batch);
+	rxm_cq_batch = NULL;
+	return (int)comp_read;
 }
 
 static int rxm_cq_close(struct fid *fid)
@@ -112,11 +112,10 @@ static int rxm_mr_reg(struct fid *domain_fid, const void *buf, size_t len,
 	if (!(rxm_mr = calloc(1, sizeof(*rxm_mr))))
 		return -FI_ENOMEM;
 
-	/* Additional flags to use RMA read for large message transfers */
-	access |= FI_READ | FI_REMOTE_READ;
-
-	if (rxm_domain->mr_local)
-		access |= FI_WRITE;
+	/* Additional flags to use RMA read or write for large message
+	 * transfers.  The sender picks the protocol, so the receive side
+	 * must be prepared for either. */
+	access |= FI_READ | FI_WRITE | FI_REMOTE_READ | FI_REMOTE_WRITE;
 
 	ret = fi_mr_reg(rxm_domain->msg_domain, buf, len, access, offset, requested_key,
 			flags, &rxm_mr->msg_mr, context);
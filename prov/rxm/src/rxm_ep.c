@@ -38,52 +38,6 @@
 
 #include "rxm.h"
 
-static int rxm_match_recv_entry(struct dlist_entry *item, const void *arg)
-{
-	struct rxm_recv_match_attr *attr = (struct rxm_recv_match_attr *) arg;
-	struct rxm_recv_entry *recv_entry;
-
-	recv_entry = container_of(item, struct rxm_recv_entry, entry);
-	return rxm_match_addr(recv_entry->addr, attr->addr);
-}
-
-static int rxm_match_recv_entry_tagged(struct dlist_entry *item, const void *arg)
-{
-	struct rxm_recv_match_attr *attr = (struct rxm_recv_match_attr *)arg;
-	struct rxm_recv_entry *recv_entry;
-
-	recv_entry = container_of(item, struct rxm_recv_entry, entry);
-	return rxm_match_addr(recv_entry->addr, attr->addr) &&
-		rxm_match_tag(recv_entry->tag, recv_entry->ignore, attr->tag);
-}
-
-static int rxm_match_recv_entry_context(struct dlist_entry *item, const void *context)
-{
-	struct rxm_recv_entry *recv_entry;
-
-	recv_entry = container_of(item, struct rxm_recv_entry, entry);
-	return recv_entry->context == context;
-}
-
-static int rxm_match_unexp_msg(struct dlist_entry *item, const void *arg)
-{
-	struct rxm_recv_match_attr *attr = (struct rxm_recv_match_attr *)arg;
-	struct rxm_unexp_msg *unexp_msg;
-
-	unexp_msg = container_of(item, struct rxm_unexp_msg, entry);
-	return rxm_match_addr(unexp_msg->addr, attr->addr);
-}
-
-static int rxm_match_unexp_msg_tagged(struct dlist_entry *item, const void *arg)
-{
-	struct rxm_recv_match_attr *attr = (struct rxm_recv_match_attr *)arg;
-	struct rxm_unexp_msg *unexp_msg;
-
-	unexp_msg = container_of(item, struct rxm_unexp_msg, entry);
-	return rxm_match_addr(attr->tag, unexp_msg->addr) &&
-		rxm_match_tag(attr->tag, attr->ignore, unexp_msg->tag);
-}
-
 static void rxm_mr_buf_close(void *pool_ctx, void *context)
 {
 	/* We would get a (fid_mr *) in context but it is safe to cast it into (fid *) */
@@ -104,10 +58,10 @@ static int rxm_mr_buf_reg(void *pool_ctx, void *addr, size_t len, void **context
 
 void rxm_buf_release(struct rxm_buf_pool *pool, struct rxm_buf *buf)
 {
-	fastlock_acquire(&pool->lock);
-	dlist_remove(&buf->entry);
+	buf->in_use = 0;
+	rxm_lock(&pool->lock, pool->thread_safe);
 	util_buf_release(pool->pool, buf);
-	fastlock_release(&pool->lock);
+	rxm_unlock(&pool->lock, pool->thread_safe);
 }
 
 struct rxm_buf *rxm_buf_get(struct rxm_buf_pool *pool)
@@ -115,83 +69,104 @@ struct rxm_buf *rxm_buf_get(struct rxm_buf_pool *pool)
 	struct rxm_buf *buf;
 	struct fid_mr *mr = NULL;
 
-	fastlock_acquire(&pool->lock);
+	rxm_lock(&pool->lock, pool->thread_safe);
 	if (pool->local_mr)
 		buf = util_buf_alloc_ex(pool->pool, (void **)&mr);
 	else
 		buf = util_buf_alloc(pool->pool);
-	if (!buf) {
-		fastlock_release(&pool->lock);
+	rxm_unlock(&pool->lock, pool->thread_safe);
+	if (!buf)
 		return NULL;
-	}
-	memset(buf, 0, sizeof(*buf));
 
-	dlist_insert_tail(&buf->entry, &pool->buf_list);
-	fastlock_release(&pool->lock);
-
-	if (pool->local_mr && mr)
-		buf->desc = fi_mr_desc(mr);
+	buf->state = RXM_NONE;
+	buf->desc = mr ? fi_mr_desc(mr) : NULL;
+	buf->msg_ep = NULL;
+	buf->pool = pool;
+	buf->in_use = 1;
 	return buf;
 }
 
+/* Buffers are not tracked while in use, so find the ones that are still
+ * out by walking the pool's regions.  A free buffer's first word is
+ * overwritten by the pool's free list, which does not reach in_use. */
 static void rxm_buf_pool_destroy(struct rxm_buf_pool *pool)
 {
-	struct dlist_entry *entry;
+	struct util_buf_region *region;
+	struct slist_entry *entry, *prev;
 	struct rxm_buf *buf;
+	size_t i;
 
-	while(!dlist_empty(&pool->buf_list)) {
-		entry = pool->buf_list.next;
-		buf = container_of(entry, struct rxm_buf, entry);
-		rxm_buf_release(pool, buf);
+	slist_foreach(&pool->pool->region_list, entry, prev) {
+		region = container_of(entry, struct util_buf_region, entry);
+		for (i = 0; i < pool->pool->chunk_cnt; i++) {
+			buf = (struct rxm_buf *)(region->mem_region +
+						 i * pool->pool->entry_sz);
+			if (buf->in_use)
+				rxm_buf_release(pool, buf);
+		}
 	}
+	(void) prev;
 	fastlock_destroy(&pool->lock);
 	util_buf_pool_destroy(pool->pool);
 }
 
-static int rxm_buf_pool_create(int local_mr, size_t count, size_t size,
-		struct rxm_buf_pool *pool, void *pool_ctx)
+static int rxm_buf_pool_create(int local_mr, int thread_safe, size_t count,
+			       size_t size, struct rxm_buf_pool *pool,
+			       void *pool_ctx, int numa_node)
 {
-	pool->pool = local_mr ? util_buf_pool_create_ex(RXM_BUF_SIZE + size, 16, 0, count,
-				rxm_mr_buf_reg, rxm_mr_buf_close, pool_ctx) :
-		util_buf_pool_create(RXM_BUF_SIZE, 16, 0, count);
+	pool->pool = local_mr ?
+		util_buf_pool_create_node_ex(size, 16, 0, count, rxm_mr_buf_reg,
+					     rxm_mr_buf_close, pool_ctx,
+					     numa_node) :
+		util_buf_pool_create_node_ex(size, 16, 0, count, NULL, NULL,
+					     NULL, numa_node);
 	if (!pool->pool) {
 		FI_WARN(&rxm_prov, FI_LOG_EP_DATA, "Unable to create buf pool\n");
 		return -FI_ENOMEM;
 	}
-	dlist_init(&pool->buf_list);
 	pool->local_mr = local_mr;
+	pool->thread_safe = thread_safe;
 	fastlock_init(&pool->lock);
 	return 0;
 }
 
-static int rxm_send_queue_init(struct rxm_send_queue *send_queue, size_t size)
+static int rxm_send_queue_init(struct rxm_send_queue *send_queue, size_t size,
+			       int thread_safe)
 {
 	send_queue->fs = rxm_txe_fs_create(size);
 	if (!send_queue->fs)
 		return -FI_ENOMEM;
 
 	ofi_key_idx_init(&send_queue->tx_key_idx, fi_size_bits(size));
+	send_queue->thread_safe = thread_safe;
 	fastlock_init(&send_queue->lock);
 	return 0;
 }
 
 static int rxm_recv_queue_init(struct rxm_recv_queue *recv_queue, size_t size,
-			       enum rxm_recv_queue_type type)
+			       enum rxm_recv_queue_type type, int directed_recv,
+			       int thread_safe)
 {
+	int i;
+
 	recv_queue->type = type;
 	recv_queue->fs = rxm_recv_fs_create(size);
 	if (!recv_queue->fs)
 		return -FI_ENOMEM;
 
-	dlist_init(&recv_queue->recv_list);
-	dlist_init(&recv_queue->unexp_msg_list);
-	if (type == RXM_RECV_QUEUE_MSG) {
-		recv_queue->match_recv = rxm_match_recv_entry;
-		recv_queue->match_unexp = rxm_match_unexp_msg;
-	} else {
-		recv_queue->match_recv = rxm_match_recv_entry_tagged;
-		recv_queue->match_unexp = rxm_match_unexp_msg_tagged;
+	for (i = 0; i < RXM_MATCH_BUCKETS; i++) {
+		dlist_init(&recv_queue->recv_hash[i]);
+		dlist_init(&recv_queue->unexp_hash[i]);
 	}
+	dlist_init(&recv_queue->recv_wild_list);
+	dlist_init(&recv_queue->unexp_msg_list);
+	recv_queue->seq = 0;
+	recv_queue->unexp_seq = 0;
+	recv_queue->unexp_unspec_cnt = 0;
+	recv_queue->directed_recv = directed_recv;
+	memset(&recv_queue->recv_stats, 0, sizeof(recv_queue->recv_stats));
+	memset(&recv_queue->unexp_stats, 0, sizeof(recv_queue->unexp_stats));
+	recv_queue->thread_safe = thread_safe;
 	fastlock_init(&recv_queue->lock);
 	return 0;
 }
@@ -205,50 +180,148 @@ static void rxm_send_queue_close(struct rxm_send_queue *send_queue)
 
 static void rxm_recv_queue_close(struct rxm_recv_queue *recv_queue)
 {
+	rxm_recv_queue_log_stats(recv_queue);
 	if (recv_queue->fs)
 		rxm_recv_fs_free(recv_queue->fs);
 	fastlock_destroy(&recv_queue->lock);
 	// TODO cleanup recv_list and unexp msg list
 }
 
+/* Slabs are only used if the MSG provider can hold back a slab until
+ * less than a full buffer fits in it */
+static int rxm_ep_multi_recv_init(struct rxm_ep *rxm_ep)
+{
+	size_t min_multi_recv = rxm_buffer_size;
+
+	if (!rxm_multi_recv_size || !(rxm_ep->msg_info->caps & FI_MULTI_RECV))
+		return 0;
+
+	return !fi_setopt(&rxm_ep->srx_ctx->fid, FI_OPT_ENDPOINT,
+			  FI_OPT_MIN_MULTI_RECV, &min_multi_recv,
+			  sizeof(min_multi_recv));
+}
+
+static void rxm_ep_rx_pools_destroy(struct rxm_ep *rxm_ep)
+{
+	int i;
+
+	for (i = 0; i < RXM_RX_CLASS_CNT; i++) {
+		if (rxm_ep->rx_pool[i].pool)
+			rxm_buf_pool_destroy(&rxm_ep->rx_pool[i]);
+	}
+	if (rxm_ep->slab_pool.pool)
+		rxm_buf_pool_destroy(&rxm_ep->slab_pool);
+}
+
+static int rxm_ep_rx_pools_create(struct rxm_ep *rxm_ep,
+				  struct rxm_domain *rxm_domain)
+{
+	size_t count, size = RXM_RX_CLASS_MIN;
+	int i, ret;
+
+	rxm_ep->multi_recv = rxm_ep_multi_recv_init(rxm_ep);
+	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL, "Using multi-recv buffers: %d\n",
+	       rxm_ep->multi_recv);
+
+	if (rxm_ep->multi_recv) {
+		count = rxm_buffer_count ? rxm_buffer_count : RXM_MULTI_RECV_COUNT;
+		ret = rxm_buf_pool_create(RXM_MR_LOCAL(rxm_ep->msg_info),
+					  rxm_ep->thread_safe, count,
+					  sizeof(struct rxm_rx_slab) +
+					  rxm_multi_recv_size,
+					  &rxm_ep->slab_pool,
+					  rxm_domain->msg_domain,
+					  rxm_ep->numa_node);
+		if (ret)
+			return ret;
+
+		/* Messages are copied out of the slabs into buffers of the
+		 * smallest class that fits.  These are never posted to the
+		 * MSG provider so they need no registration. */
+		for (i = 0; i < RXM_RX_CLASS_CNT - 1; i++, size *= 16) {
+			rxm_ep->rx_class_size[i] = MIN(size, rxm_buffer_size);
+			ret = rxm_buf_pool_create(0, rxm_ep->thread_safe, 64,
+						  sizeof(struct rxm_rx_buf) +
+						  rxm_ep->rx_class_size[i],
+						  &rxm_ep->rx_pool[i], NULL,
+						  rxm_ep->numa_node);
+			if (ret)
+				goto err;
+		}
+		count = 64;
+	} else {
+		count = rxm_buffer_count ? rxm_buffer_count :
+			rxm_ep->msg_info->rx_attr->size;
+	}
+
+	rxm_ep->rx_class_size[RXM_RX_CLASS_CNT - 1] = rxm_buffer_size;
+	ret = rxm_buf_pool_create(!rxm_ep->multi_recv &&
+				  RXM_MR_LOCAL(rxm_ep->msg_info),
+				  rxm_ep->thread_safe, count,
+				  sizeof(struct rxm_rx_buf) + rxm_buffer_size,
+				  &rxm_ep->rx_pool[RXM_RX_CLASS_CNT - 1],
+				  rxm_domain->msg_domain, rxm_ep->numa_node);
+	if (ret)
+		goto err;
+	return 0;
+err:
+	rxm_ep_rx_pools_destroy(rxm_ep);
+	return ret;
+}
+
 static int rxm_ep_txrx_res_open(struct rxm_ep *rxm_ep)
 {
 	struct rxm_domain *rxm_domain;
-	int ret;
+	int directed_recv, ret;
 
 	rxm_domain = container_of(rxm_ep->util_ep.domain, struct rxm_domain, util_domain);
 
 	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL, "MSG provider mr_mode & FI_MR_LOCAL: %d\n",
 			RXM_MR_LOCAL(rxm_ep->msg_info));
 
-	ret = rxm_buf_pool_create(RXM_MR_LOCAL(rxm_ep->msg_info),
+	rxm_ep->thread_safe = rxm_ep->rxm_info->domain_attr->threading !=
+			      FI_THREAD_DOMAIN || rxm_ep->auto_progress;
+	rxm_ep->numa_node =
+		ofi_topo_select_node(ofi_topo_info_node(rxm_ep->msg_info));
+	FI_DBG(&rxm_prov, FI_LOG_EP_CTRL, "Using NUMA node: %d\n",
+	       rxm_ep->numa_node);
+
+	/* Protected by the send queue lock */
+	ret = rxm_buf_pool_create(RXM_MR_LOCAL(rxm_ep->msg_info), 0,
 				  rxm_ep->msg_info->tx_attr->size,
-				  sizeof(struct rxm_tx_buf), &rxm_ep->tx_pool,
-				  rxm_domain->msg_domain);
+				  sizeof(struct rxm_tx_buf) + rxm_buffer_size,
+				  &rxm_ep->tx_pool, rxm_domain->msg_domain,
+				  rxm_ep->numa_node);
 	if (ret)
 	        return ret;
 
-	ret = rxm_buf_pool_create(RXM_MR_LOCAL(rxm_ep->msg_info),
-				  rxm_ep->msg_info->rx_attr->size,
-				  sizeof(struct rxm_rx_buf), &rxm_ep->rx_pool,
-				  rxm_domain->msg_domain);
+	ret = rxm_ep_rx_pools_create(rxm_ep, rxm_domain);
 	if (ret)
 		goto err1;
 
-	ret = rxm_send_queue_init(&rxm_ep->send_queue, rxm_ep->rxm_info->tx_attr->size);
+	ret = rxm_send_queue_init(&rxm_ep->send_queue, rxm_ep->rxm_info->tx_attr->size,
+				  rxm_ep->thread_safe);
 	if (ret)
 		goto err2;
 
+	directed_recv = !!(rxm_ep->rxm_info->caps & FI_DIRECTED_RECV);
 	ret = rxm_recv_queue_init(&rxm_ep->recv_queue, rxm_ep->rxm_info->rx_attr->size,
-				  RXM_RECV_QUEUE_MSG);
+				  RXM_RECV_QUEUE_MSG, directed_recv,
+				  rxm_ep->thread_safe);
 	if (ret)
 		goto err3;
 
 	ret = rxm_recv_queue_init(&rxm_ep->trecv_queue, rxm_ep->rxm_info->rx_attr->size,
-				  RXM_RECV_QUEUE_TAGGED);
+				  RXM_RECV_QUEUE_TAGGED, directed_recv,
+				  rxm_ep->thread_safe);
 	if (ret)
 		goto err4;
 
+	fastlock_init(&rxm_ep->proto_lock);
+	fastlock_init(&rxm_ep->progress_lock);
+	dlist_init(&rxm_ep->lmt_deferred_list);
+	dlist_init(&rxm_ep->sar_deferred_list);
+	dlist_init(&rxm_ep->sar_rx_list);
 	return 0;
 err4:
 	rxm_recv_queue_close(&rxm_ep->recv_queue);
@@ -257,18 +330,20 @@ err3:
 err2:
 	rxm_buf_pool_destroy(&rxm_ep->tx_pool);
 err1:
-	rxm_buf_pool_destroy(&rxm_ep->rx_pool);
+	rxm_ep_rx_pools_destroy(rxm_ep);
 	return ret;
 }
 
 static void rxm_ep_txrx_res_close(struct rxm_ep *rxm_ep)
 {
+	fastlock_destroy(&rxm_ep->progress_lock);
+	fastlock_destroy(&rxm_ep->proto_lock);
 
 	rxm_recv_queue_close(&rxm_ep->trecv_queue);
 	rxm_recv_queue_close(&rxm_ep->recv_queue);
 	rxm_send_queue_close(&rxm_ep->send_queue);
 
-	rxm_buf_pool_destroy(&rxm_ep->rx_pool);
+	rxm_ep_rx_pools_destroy(rxm_ep);
 	rxm_buf_pool_destroy(&rxm_ep->tx_pool);
 }
 
@@ -278,32 +353,111 @@ int rxm_ep_repost_buf(struct rxm_rx_buf *rx_buf)
 	struct rxm_ep *rxm_ep = rx_buf->ep;
 	int ret;
 
+	if (!hdr.msg_ep) {
+		rxm_buf_release(hdr.pool, &rx_buf->hdr);
+		return 0;
+	}
+
 	memset(rx_buf, 0, sizeof(*rx_buf));
 	rx_buf->hdr = hdr;
 	rx_buf->hdr.state = RXM_RX;
 	rx_buf->ep = rxm_ep;
 
-	ret = fi_recv(rx_buf->ep->srx_ctx, &rx_buf->pkt, RXM_BUF_SIZE,
+	ret = fi_recv(rx_buf->ep->srx_ctx, &rx_buf->pkt, rxm_buffer_size,
 		      rx_buf->hdr.desc, FI_ADDR_UNSPEC, rx_buf);
 	if (ret)
 		FI_WARN(&rxm_prov, FI_LOG_EP_CTRL, "Unable to repost buf\n");
 	return ret;
 }
 
+int rxm_ep_repost_slab(struct rxm_rx_slab *slab)
+{
+	struct iovec iov;
+	struct fi_msg msg;
+	int ret;
+
+	iov.iov_base = slab->buf;
+	iov.iov_len = rxm_multi_recv_size;
+
+	msg.msg_iov = &iov;
+	msg.desc = &slab->hdr.desc;
+	msg.iov_count = 1;
+	msg.addr = FI_ADDR_UNSPEC;
+	msg.context = slab;
+	msg.data = 0;
+
+	ret = fi_recvmsg(slab->hdr.msg_ep, &msg, FI_MULTI_RECV);
+	if (ret)
+		FI_WARN(&rxm_prov, FI_LOG_EP_CTRL, "Unable to repost slab\n");
+	return ret;
+}
+
+/* Returns a buffer for a message copied out of a slab */
+struct rxm_rx_buf *rxm_ep_rx_buf_get(struct rxm_ep *rxm_ep, size_t len)
+{
+	struct rxm_rx_buf *rx_buf;
+	int i;
+
+	for (i = 0; i < RXM_RX_CLASS_CNT - 1; i++) {
+		if (len <= rxm_ep->rx_class_size[i])
+			break;
+	}
+
+	rx_buf = (struct rxm_rx_buf *)rxm_buf_get(&rxm_ep->rx_pool[i]);
+	if (!rx_buf)
+		return NULL;
+
+	memset(&rx_buf->ep, 0, sizeof(*rx_buf) - sizeof(rx_buf->hdr));
+	rx_buf->hdr.state = RXM_RX;
+	rx_buf->ep = rxm_ep;
+	return rx_buf;
+}
+
+static int rxm_ep_prepost_slab(struct rxm_ep *rxm_ep)
+{
+	struct rxm_rx_slab *slab;
+	size_t i, count;
+	int ret;
+
+	count = rxm_buffer_count ? rxm_buffer_count : RXM_MULTI_RECV_COUNT;
+	for (i = 0; i < count; i++) {
+		slab = (struct rxm_rx_slab *)rxm_buf_get(&rxm_ep->slab_pool);
+		if (!slab)
+			return -FI_ENOMEM;
+		slab->hdr.state = RXM_RX_SLAB;
+		slab->hdr.msg_ep = rxm_ep->srx_ctx;
+		slab->ep = rxm_ep;
+		ret = rxm_ep_repost_slab(slab);
+		if (ret) {
+			rxm_buf_release(&rxm_ep->slab_pool, &slab->hdr);
+			return ret;
+		}
+	}
+	return 0;
+}
+
 int rxm_ep_prepost_buf(struct rxm_ep *rxm_ep)
 {
+	struct rxm_buf_pool *pool = &rxm_ep->rx_pool[RXM_RX_CLASS_CNT - 1];
 	struct rxm_rx_buf *rx_buf;
+	size_t i, count;
 	int ret;
-	size_t i;
 
-	for (i = 0; i < rxm_ep->msg_info->rx_attr->size; i++) {
-		rx_buf = (struct rxm_rx_buf *)rxm_buf_get(&rxm_ep->rx_pool);
+	if (rxm_ep->multi_recv)
+		return rxm_ep_prepost_slab(rxm_ep);
+
+	count = rxm_buffer_count ? rxm_buffer_count :
+		rxm_ep->msg_info->rx_attr->size;
+	for (i = 0; i < count; i++) {
+		rx_buf = (struct rxm_rx_buf *)rxm_buf_get(pool);
+		if (!rx_buf)
+			return -FI_ENOMEM;
 		rx_buf->hdr.state = RXM_RX,
 		rx_buf->hdr.msg_ep = rxm_ep->srx_ctx;
 		rx_buf->ep = rxm_ep;
 		ret = rxm_ep_repost_buf(rx_buf);
 		if (ret) {
-			rxm_buf_release(&rxm_ep->rx_pool, (struct rxm_buf *)rx_buf);
+			rxm_buf_release(pool, (struct rxm_buf *)rx_buf);
 			return ret;
 		}
 	}
@@ -356,15 +510,11 @@ static int rxm_ep_cancel_recv(struct rxm_ep *rxm_ep,
 {
 	struct fi_cq_err_entry err_entry;
 	struct rxm_recv_entry *recv_entry;
-	struct dlist_entry *entry;
-
-	fastlock_acquire(&recv_queue->lock);
-	entry = dlist_remove_first_match(&recv_queue->recv_list,
-					 rxm_match_recv_entry_context,
-					 context);
-	fastlock_release(&recv_queue->lock);
-	if (entry) {
-		recv_entry = container_of(entry, struct rxm_recv_entry, entry);
+
+	rxm_lock(&recv_queue->lock, recv_queue->thread_safe);
+	recv_entry = rxm_recv_queue_remove_context(recv_queue, context);
+	rxm_unlock(&recv_queue->lock, recv_queue->thread_safe);
+	if (recv_entry) {
 		memset(&err_entry, 0, sizeof(err_entry));
 		err_entry.op_context = recv_entry->context;
 		if (recv_queue->type == RXM_RECV_QUEUE_TAGGED) {
@@ -408,34 +558,6 @@ static struct fi_ops_ep rxm_ops_ep = {
 	.tx_size_left = fi_no_tx_size_left,
 };
 
-/* Caller must hold recv_queue->lock */
-static int rxm_check_unexp_msg_list(struct rxm_ep *rxm_ep,
-				    struct rxm_recv_queue *recv_queue,
-				    struct rxm_recv_entry *recv_entry,
-				    struct rxm_rx_buf **rx_buf)
-{
-	struct rxm_recv_match_attr match_attr;
-	struct dlist_entry *entry;
-
-	if (dlist_empty(&recv_queue->unexp_msg_list))
-		return -FI_EAGAIN;
-
-	match_attr.addr = recv_entry->addr;
-	if (recv_queue->type == RXM_RECV_QUEUE_TAGGED)
-		match_attr.tag = recv_entry->tag;
-	match_attr.ignore = recv_entry->ignore;
-
-	entry = dlist_remove_first_match(&recv_queue->unexp_msg_list,
-					 recv_queue->match_unexp, &match_attr);
-	if (!entry)
-		return -FI_EAGAIN;
-
-	FI_DBG(&rxm_prov, FI_LOG_EP_DATA,
-	       "Match for posted recv found in unexp msg list\n");
-	*rx_buf = container_of(entry, struct rxm_rx_buf, unexp_msg.entry);
-	return 0;
-}
-
 static int rxm_ep_recv_common(struct rxm_ep *rxm_ep, const struct iovec *iov,
 			      void **desc, size_t count, fi_addr_t src_addr,
 			      uint64_t tag, uint64_t ignore, void *context,
@@ -443,11 +565,16 @@ static int rxm_ep_recv_common(struct rxm_ep *rxm_ep, const struct iovec *iov,
 {
 	struct rxm_recv_entry *recv_entry;
 	struct rxm_rx_buf *rx_buf;
-	int ret;
 	size_t i;
 
-	if (!(recv_entry = rxm_recv_entry_get(recv_queue)))
+	/* Take the entry and search the unexpected list under one lock */
+	rxm_lock(&recv_queue->lock, recv_queue->thread_safe);
+	if (freestack_isempty(recv_queue->fs)) {
+		rxm_unlock(&recv_queue->lock, recv_queue->thread_safe);
+		FI_WARN(&rxm_prov, FI_LOG_CQ, "Exhausted recv_entry freestack\n");
 		return -FI_EAGAIN;
+	}
+	recv_entry = freestack_pop(recv_queue->fs);
 
 	for (i = 0; i < count; i++) {
 		recv_entry->iov[i].iov_base = iov[i].iov_base;
@@ -461,28 +588,21 @@ static int rxm_ep_recv_common(struct rxm_ep *rxm_ep, const struct iovec *iov,
 	recv_entry->context 	= context;
 	recv_entry->flags 	= flags;
 	recv_entry->ignore 	= ignore;
-	if (recv_queue->type == RXM_RECV_QUEUE_TAGGED)
-		recv_entry->tag = tag;
-
-	fastlock_acquire(&recv_queue->lock);
-	ret = rxm_check_unexp_msg_list(rxm_ep, recv_queue, recv_entry, &rx_buf);
-	if (ret) {
-		if (ret == -FI_EAGAIN) {
-			dlist_insert_tail(&recv_entry->entry,
-					  &recv_queue->recv_list);
-			ret = 0;
-		} else {
-			FI_WARN(&rxm_prov, FI_LOG_EP_DATA,
-					"Unable to check unexp msg list\n");
-			freestack_push(recv_queue->fs, recv_entry);
-		}
-		fastlock_release(&recv_queue->lock);
-	} else {
-		fastlock_release(&recv_queue->lock);
-		rx_buf->recv_entry = recv_entry;
-		ret = rxm_cq_handle_data(rx_buf);
+	/* Untagged receives match with a zero tag */
+	recv_entry->tag 	= tag;
+
+	rx_buf = rxm_unexp_match(recv_queue, recv_entry);
+	if (!rx_buf) {
+		rxm_recv_queue_insert(recv_queue, recv_entry);
+		rxm_unlock(&recv_queue->lock, recv_queue->thread_safe);
+		return 0;
 	}
-	return ret;
+	rxm_unlock(&recv_queue->lock, recv_queue->thread_safe);
+
+	FI_DBG(&rxm_prov, FI_LOG_EP_DATA,
+	       "Match for posted recv found in unexp msg list\n");
+	rx_buf->recv_entry = recv_entry;
+	return rxm_cq_handle_data(rx_buf);
 }
 
 static ssize_t rxm_ep_recvmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
@@ -570,8 +690,8 @@ int rxm_ep_msg_mr_regv(struct rxm_ep *rxm_ep, const struct iovec *iov,
 
 	// TODO do fi_mr_regv if provider supports it
 	for (i = 0; i < count; i++) {
-		ret = fi_mr_reg(rxm_domain->msg_domain, iov->iov_base,
-				iov->iov_len, access, 0, 0, 0, &mr[i], NULL);
+		ret = fi_mr_reg(rxm_domain->msg_domain, iov[i].iov_base,
+				iov[i].iov_len, access, 0, 0, 0, &mr[i], NULL);
 		if (ret)
 			goto err;
 	}
@@ -581,17 +701,17 @@ err:
 	return ret;
 }
 
-static ssize_t rxm_rma_iov_init(struct rxm_ep *rxm_ep, void *buf,
-				const struct iovec *iov, size_t count,
-				struct fid_mr **mr)
+ssize_t rxm_rma_iov_init(struct rxm_ep *rxm_ep, void *buf,
+			 const struct iovec *iov, size_t count,
+			 struct fid_mr **mr)
 {
 	struct rxm_rma_iov *rma_iov = (struct rxm_rma_iov *)buf;
 	size_t i;
 
 	for (i = 0; i < count; i++) {
 		rma_iov->iov[i].addr = RXM_MR_VIRT_ADDR(rxm_ep->msg_info) ?
-			(uintptr_t)iov->iov_base : 0;
-		rma_iov->iov[i].len = (uint64_t)iov->iov_len;
+			(uintptr_t)iov[i].iov_base : 0;
+		rma_iov->iov[i].len = (uint64_t)iov[i].iov_len;
 		rma_iov->iov[i].key = fi_mr_key(mr[i]);
 	}
 	rma_iov->count = count;
@@ -610,7 +730,7 @@ static ssize_t rxm_ep_send_common(struct fid_ep *ep_fid, const struct iovec *iov
 	struct rxm_tx_buf *tx_buf;
 	struct rxm_pkt *pkt;
 	struct fid_mr **mr_iov;
-	size_t pkt_size = 0;
+	size_t i, pkt_size = 0;
 	ssize_t size;
 	int ret;
 
@@ -621,20 +741,14 @@ static ssize_t rxm_ep_send_common(struct fid_ep *ep_fid, const struct iovec *iov
 		return ret;
 	rxm_conn = container_of(handle, struct rxm_conn, handle);
 
-	tx_buf = (struct rxm_tx_buf *)rxm_buf_get(&rxm_ep->tx_pool);
-	if (!tx_buf) {
-		FI_WARN(&rxm_prov, FI_LOG_CQ, "TX queue full!\n");
-		return -FI_EAGAIN;
-	}
-
-	if (!(tx_entry = rxm_tx_entry_get(&rxm_ep->send_queue)))
+	if (!(tx_entry = rxm_tx_entry_get(rxm_ep, rxm_conn, 1)))
 		return -FI_EAGAIN;
+	tx_buf = tx_entry->tx_buf;
 
 	tx_entry->ep = rxm_ep;
 	tx_entry->count = count;
 	tx_entry->context = context;
 	tx_entry->flags = flags;
-	tx_entry->tx_buf = tx_buf;
 
 	tx_buf->hdr.msg_ep = rxm_conn->msg_ep;
 
@@ -663,15 +777,23 @@ static ssize_t rxm_ep_send_common(struct fid_ep *ep_fid, const struct iovec *iov
 			ret = -FI_EMSGSIZE;
 			goto done;
 		}
-		fastlock_acquire(&rxm_ep->send_queue.lock);
-		pkt->ctrl_hdr.msg_id = ofi_idx2key(&rxm_ep->send_queue.tx_key_idx,
-						   rxm_txe_fs_index(rxm_ep->send_queue.fs,
-								    tx_entry));
-		fastlock_release(&rxm_ep->send_queue.lock);
+		pkt->ctrl_hdr.msg_id = tx_entry->msg_id;
+
+		if (pkt->hdr.size <= rxm_sar_limit) {
+			pkt->ctrl_hdr.type = ofi_ctrl_seg_data;
+			for (i = 0; i < count; i++)
+				tx_entry->iov[i] = iov[i];
+			ret = rxm_sar_send(tx_entry);
+			if (ret)
+				goto done;
+			return 0;
+		}
+
 		pkt->ctrl_hdr.type = ofi_ctrl_large_data;
 
 		if (!RXM_MR_LOCAL(rxm_ep->rxm_info)) {
 			ret = rxm_ep_msg_mr_regv(rxm_ep, iov, tx_entry->count,
+						 rxm_lmt_write ? FI_WRITE :
 						 FI_REMOTE_READ, tx_entry->mr);
 			if (ret)
 				goto done;
@@ -680,6 +802,15 @@ static ssize_t rxm_ep_send_common(struct fid_ep *ep_fid, const struct iovec *iov
 			/* desc is msg fid_mr * array */
 			mr_iov = (struct fid_mr **)desc;
 		}
+
+		if (rxm_lmt_write) {
+			/* Keep the source buffer around for the RMA writes */
+			pkt->hdr.op_data = RXM_LMT_OP_WRITE;
+			for (i = 0; i < count; i++) {
+				tx_entry->iov[i] = iov[i];
+				tx_entry->desc[i] = fi_mr_desc(mr_iov[i]);
+			}
+		}
 		size = rxm_rma_iov_init(rxm_ep, &tx_entry->tx_buf->pkt.data, iov,
 					count, mr_iov);
 		if (size < 0) {
@@ -726,8 +857,7 @@ static ssize_t rxm_ep_send_common(struct fid_ep *ep_fid, const struct iovec *iov
 	}
 	return 0;
 done:
-	rxm_buf_release(&rxm_ep->tx_pool, (struct rxm_buf *)tx_buf);
-	rxm_tx_entry_release(&rxm_ep->send_queue, tx_entry);
+	rxm_tx_entry_release(rxm_ep, tx_entry);
 	return ret;
 }
 
@@ -1025,8 +1155,15 @@ static int rxm_ep_bind(struct fid *ep_fid, struct fid *bfid, uint64_t flags)
 		attr.close 		= rxm_conn_close;
 		attr.free 		= rxm_conn_free;
 		attr.connect 		= rxm_conn_connect;
-		attr.event_handler	= rxm_conn_event_handler;
+		attr.event_handler	= rxm_ep->auto_progress ?
+					  rxm_conn_progress_handler :
+					  rxm_conn_event_handler;
 		attr.signal		= rxm_conn_signal;
+		attr.max_conn		= rxm_max_conn;
+		attr.idle		= rxm_conn_idle;
+		attr.evict_req		= rxm_conn_evict_req;
+		attr.evict_ack		= rxm_conn_evict_ack;
+		attr.numa_node		= rxm_ep->numa_node;
 
 		rxm_ep->util_ep.cmap = ofi_cmap_alloc(&rxm_ep->util_ep, &attr);
 		free(name);
@@ -1149,6 +1286,9 @@ static int rxm_ep_msg_res_open(struct fi_info *rxm_fi_info,
 	memset(&cq_attr, 0, sizeof(cq_attr));
 	cq_attr.size = rxm_fi_info->tx_attr->size + rxm_fi_info->rx_attr->size;
 	cq_attr.format = FI_CQ_FORMAT_DATA;
+	/* The progress thread sleeps on the CQ's fd */
+	if (rxm_ep->auto_progress)
+		cq_attr.wait_obj = FI_WAIT_FD;
 
 	ret = fi_cq_open(rxm_domain->msg_domain, &cq_attr, &rxm_ep->msg_cq, NULL);
 	if (ret) {
@@ -1190,7 +1330,15 @@ void rxm_ep_progress(struct util_ep *util_ep)
 	struct rxm_ep *rxm_ep;
 
 	rxm_ep = container_of(util_ep, struct rxm_ep, util_ep);
+	if (!rxm_ep->auto_progress) {
+		rxm_cq_progress(rxm_ep);
+		return;
+	}
+	/* The progress thread is already at it */
+	if (fastlock_tryacquire(&rxm_ep->progress_lock))
+		return;
 	rxm_cq_progress(rxm_ep);
+	fastlock_release(&rxm_ep->progress_lock);
 }
 
 int rxm_endpoint(struct fid_domain *domain, struct fi_info *info,
@@ -1208,6 +1356,8 @@ int rxm_endpoint(struct fid_domain *domain, struct fi_info *info,
 		ret = -FI_ENOMEM;
 		goto err1;
 	}
+	rxm_ep->auto_progress =
+		info->domain_attr->data_progress == FI_PROGRESS_AUTO;
 
 	ret = ofi_endpoint_init(domain, &rxm_util_prov, info, &rxm_ep->util_ep,
 				context, &rxm_ep_progress);
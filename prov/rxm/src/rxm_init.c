@@ -35,6 +35,17 @@
 #include <prov.h>
 #include "rxm.h"
 
+size_t rxm_buffer_size = RXM_BUF_SIZE;
+size_t rxm_buffer_count;
+size_t rxm_multi_recv_size = RXM_MULTI_RECV_SIZE;
+size_t rxm_sar_limit = RXM_SAR_LIMIT;
+size_t rxm_lmt_chunk_size = RXM_LMT_CHUNK_SIZE;
+size_t rxm_lmt_max_inflight = RXM_LMT_MAX_INFLIGHT;
+int rxm_lmt_write;
+size_t rxm_max_conn;
+int rxm_progress_cpu = -1;
+size_t rxm_progress_spin = RXM_PROGRESS_SPIN;
+
 int rxm_info_to_core(uint32_t version, struct fi_info *hints,
 		     struct fi_info *core_info)
 {
@@ -116,15 +127,93 @@ static int rxm_init_info(void)
 
 	if (!fi_param_get_int(&rxm_prov, "buffer_size", &param)) {
 		if (param > sizeof(struct rxm_pkt)) {
-			rxm_info.tx_attr->inject_size = param;
+			rxm_buffer_size = param;
 		} else {
 			FI_WARN(&rxm_prov, FI_LOG_CORE,
 				"Requested buffer size too small\n");
 			return -FI_EINVAL;
 		}
-	} else {
-		rxm_info.tx_attr->inject_size = RXM_BUF_SIZE;
 	}
+	rxm_info.tx_attr->inject_size = rxm_buffer_size;
+
+	if (!fi_param_get_int(&rxm_prov, "buffer_count", &param)) {
+		if (param > 0) {
+			rxm_buffer_count = param;
+		} else {
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Invalid receive buffer count\n");
+			return -FI_EINVAL;
+		}
+	}
+
+	if (!fi_param_get_int(&rxm_prov, "multi_recv_size", &param)) {
+		if (!param || (param > 0 &&
+		    (size_t)param >= 2 * rxm_buffer_size)) {
+			rxm_multi_recv_size = param;
+		} else {
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Multi-receive buffer size must be at least "
+				"twice the buffer size\n");
+			return -FI_EINVAL;
+		}
+	} else if (rxm_multi_recv_size < 2 * rxm_buffer_size) {
+		rxm_multi_recv_size = 2 * rxm_buffer_size;
+	}
+
+	if (!fi_param_get_int(&rxm_prov, "sar_limit", &param)) {
+		if (param >= 0) {
+			rxm_sar_limit = param;
+		} else {
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Invalid SAR limit\n");
+			return -FI_EINVAL;
+		}
+	}
+
+	if (!fi_param_get_int(&rxm_prov, "lmt_chunk_size", &param)) {
+		if (param > 0) {
+			rxm_lmt_chunk_size = param;
+		} else {
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Invalid LMT chunk size\n");
+			return -FI_EINVAL;
+		}
+	}
+
+	if (!fi_param_get_int(&rxm_prov, "lmt_max_inflight", &param)) {
+		if (param > 0) {
+			rxm_lmt_max_inflight = param;
+		} else {
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Invalid LMT inflight chunk count\n");
+			return -FI_EINVAL;
+		}
+	}
+
+	fi_param_get_bool(&rxm_prov, "lmt_write", &rxm_lmt_write);
+
+	if (!fi_param_get_int(&rxm_prov, "max_conn", &param)) {
+		if (param >= 0) {
+			rxm_max_conn = param;
+		} else {
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Invalid connection cap\n");
+			return -FI_EINVAL;
+		}
+	}
+
+	fi_param_get_int(&rxm_prov, "progress_cpu", &rxm_progress_cpu);
+
+	if (!fi_param_get_int(&rxm_prov, "progress_spin", &param)) {
+		if (param >= 0) {
+			rxm_progress_spin = param;
+		} else {
+			FI_WARN(&rxm_prov, FI_LOG_CORE,
+				"Invalid progress spin time\n");
+			return -FI_EINVAL;
+		}
+	}
+
 	rxm_info.tx_attr->inject_size -= sizeof(struct rxm_pkt);
 	rxm_util_prov.info = &rxm_info;
 	return 0;
@@ -168,6 +257,13 @@ static int rxm_getinfo(uint32_t version, const char *node, const char *service,
 				cur->domain_attr->mr_mode &= ~FI_MR_LOCAL;
 		}
 	}
+
+	/* Auto progress costs a thread per endpoint, only use it when asked */
+	if (!hints || !hints->domain_attr ||
+	    hints->domain_attr->data_progress != FI_PROGRESS_AUTO) {
+		for (cur = *info; cur; cur = cur->next)
+			cur->domain_attr->data_progress = FI_PROGRESS_MANUAL;
+	}
 	return 0;
 }
 
@@ -191,7 +287,58 @@ RXM_INI
 	fi_param_define(&rxm_prov, "buffer_size", FI_PARAM_INT,
 			"Defines the transmit buffer size. Transmit data would "
 			"be copied upto this size (default: ~16k). This would "
-			"also affect the supported inject size");
+			"also affect the supported inject size. Receive "
+			"buffers are sized accordingly, so all peers should "
+			"use the same value");
+
+	fi_param_define(&rxm_prov, "buffer_count", FI_PARAM_INT,
+			"Number of receive buffers posted per endpoint. When "
+			"multi-receive buffers are in use this is the number "
+			"of those (default: MSG provider rx size, or 4 "
+			"multi-receive buffers)");
+
+	fi_param_define(&rxm_prov, "multi_recv_size", FI_PARAM_INT,
+			"Size of the FI_MULTI_RECV buffers posted when the "
+			"MSG provider supports them. Incoming messages are "
+			"packed into these and copied out to receive buffers "
+			"sized to the message. Set to 0 to always post "
+			"buffer_size receive buffers instead (default: 512k)");
+
+	fi_param_define(&rxm_prov, "sar_limit", FI_PARAM_INT,
+			"Messages larger than the transmit buffer and up to "
+			"this size are sent as a sequence of buffered "
+			"segments instead of using the rendezvous protocol. "
+			"Set to 0 to disable (default: 256k)");
+
+	fi_param_define(&rxm_prov, "lmt_chunk_size", FI_PARAM_INT,
+			"Size of the RMA operations a large message transfer "
+			"is split into (default: 1M)");
+
+	fi_param_define(&rxm_prov, "lmt_max_inflight", FI_PARAM_INT,
+			"Maximum number of RMA operations outstanding per "
+			"large message transfer (default: 4)");
+
+	fi_param_define(&rxm_prov, "lmt_write", FI_PARAM_BOOL,
+			"Transfer large messages with RMA writes issued by "
+			"the sender instead of RMA reads issued by the "
+			"receiver. Useful with MSG providers where RMA write "
+			"is cheaper than read (default: no)");
+
+	fi_param_define(&rxm_prov, "max_conn", FI_PARAM_INT,
+			"Maximum number of MSG connections per endpoint. "
+			"When a new connection is needed, the least recently "
+			"used idle connection is shut down and transparently "
+			"re-established on the next send to that peer. Set "
+			"to 0 for no limit (default: 0)");
+
+	fi_param_define(&rxm_prov, "progress_cpu", FI_PARAM_INT,
+			"CPU to pin the progress thread of FI_PROGRESS_AUTO "
+			"endpoints to (default: -1, not pinned)");
+
+	fi_param_define(&rxm_prov, "progress_spin", FI_PARAM_INT,
+			"Time in microseconds the FI_PROGRESS_AUTO progress "
+			"thread keeps polling after its last completion "
+			"before it sleeps waiting for events (default: 100)");
 
 	if (rxm_init_info()) {
 		FI_WARN(&rxm_prov, FI_LOG_CORE, "Unable to initialize rxm_info\n");
@@ -36,7 +36,7 @@
 typedef ssize_t rxm_rma_msg_fn(struct fid_ep *ep_fid,
 			       const struct fi_msg_rma *msg, uint64_t flags);
 
-static int rxm_ep_rma_common(struct fid_ep *msg_ep, struct rxm_ep *rxm_ep,
+static int rxm_ep_rma_common(struct rxm_conn *rxm_conn, struct rxm_ep *rxm_ep,
 			     const struct fi_msg_rma *msg, uint64_t flags,
 			     rxm_rma_msg_fn rma_msg, uint64_t comp_flags)
 {
@@ -46,10 +46,9 @@ static int rxm_ep_rma_common(struct fid_ep *msg_ep, struct rxm_ep *rxm_ep,
 	size_t i;
 	int ret;
 
-	if (!(tx_entry = rxm_tx_entry_get(&rxm_ep->send_queue)))
+	if (!(tx_entry = rxm_tx_entry_get(rxm_ep, rxm_conn, 0)))
 		return -FI_EAGAIN;
 
-	memset(tx_entry, 0, sizeof(*tx_entry));
 	tx_entry->state = RXM_TX_NOBUF;
 	tx_entry->ep = rxm_ep;
 	tx_entry->context = msg->context;
@@ -74,9 +73,13 @@ static int rxm_ep_rma_common(struct fid_ep *msg_ep, struct rxm_ep *rxm_ep,
 		for (i = 0; i < msg_rma.iov_count; i++)
 			msg_rma.desc[i] = fi_mr_desc(msg_rma.desc[i]);
 	}
-	return rma_msg(msg_ep, &msg_rma, flags);
+	ret = rma_msg(rxm_conn->msg_ep, &msg_rma, flags);
+	if (!ret)
+		return 0;
+	if (rxm_domain->mr_local)
+		rxm_ep_msg_mr_closev(tx_entry->mr, msg->iov_count);
 err:
-	rxm_tx_entry_release(&rxm_ep->send_queue, tx_entry);
+	rxm_tx_entry_release(rxm_ep, tx_entry);
 	return ret;
 }
 
@@ -95,7 +98,7 @@ ssize_t	rxm_ep_readmsg(struct fid_ep *ep_fid, const struct fi_msg_rma *msg,
 		return ret;
 	rxm_conn = container_of(handle, struct rxm_conn, handle);
 
-	return rxm_ep_rma_common(rxm_conn->msg_ep, rxm_ep, msg, flags,
+	return rxm_ep_rma_common(rxm_conn, rxm_ep, msg, flags,
 				 fi_readmsg, FI_READ);
 }
 
@@ -149,9 +152,10 @@ static ssize_t rxm_ep_readv(struct fid_ep *ep_fid, const struct iovec *iov,
 	return rxm_ep_readmsg(ep_fid, &msg, rxm_ep_tx_flags(ep_fid));
 }
 
-static int rxm_ep_rma_inject(struct fid_ep *msg_ep, struct rxm_ep *rxm_ep,
+static int rxm_ep_rma_inject(struct rxm_conn *rxm_conn, struct rxm_ep *rxm_ep,
 			     const struct fi_msg_rma *msg, uint64_t flags)
 {
+	struct fid_ep *msg_ep = rxm_conn->msg_ep;
 	struct rxm_tx_entry *tx_entry;
 	struct rxm_tx_buf *tx_buf;
 	struct fi_msg_rma msg_rma;
@@ -180,23 +184,15 @@ static int rxm_ep_rma_inject(struct fid_ep *msg_ep, struct rxm_ep *rxm_ep,
 					       msg->rma_iov->key);
 	}
 
-	tx_buf = (struct rxm_tx_buf *)rxm_buf_get(&rxm_ep->tx_pool);
-	if (!tx_buf) {
-		FI_WARN(&rxm_prov, FI_LOG_CQ, "TX queue full!\n");
+	if (!(tx_entry = rxm_tx_entry_get(rxm_ep, rxm_conn, 1)))
 		return -FI_EAGAIN;
-	}
-
-	if (!(tx_entry = rxm_tx_entry_get(&rxm_ep->send_queue))) {
-		ret = -FI_EAGAIN;
-		goto err1;
-	}
+	tx_buf = tx_entry->tx_buf;
 
-	memset(tx_entry, 0, sizeof(*tx_entry));
 	tx_entry->state = RXM_TX;
 	tx_entry->ep = rxm_ep;
+	tx_entry->context = msg->context;
 	tx_entry->flags = flags;
 	tx_entry->comp_flags = FI_RMA | FI_WRITE;
-	tx_entry->tx_buf = tx_buf;
 
 	tx_buf->hdr.msg_ep = msg_ep;
 	ofi_copy_from_iov(tx_buf->pkt.data, size, msg->msg_iov,
@@ -217,12 +213,7 @@ static int rxm_ep_rma_inject(struct fid_ep *msg_ep, struct rxm_ep *rxm_ep,
 
 	ret = fi_writemsg(msg_ep, &msg_rma, flags);
 	if (ret)
-		goto err2;
-	return 0;
-err2:
-	rxm_tx_entry_release(&rxm_ep->send_queue, tx_entry);
-err1:
-	rxm_buf_release(&rxm_ep->tx_pool, (struct rxm_buf *)tx_buf);
+		rxm_tx_entry_release(rxm_ep, tx_entry);
 	return ret;
 }
 
@@ -242,9 +233,9 @@ ssize_t	rxm_ep_writemsg(struct fid_ep *ep_fid, const struct fi_msg_rma *msg,
 	rxm_conn = container_of(handle, struct rxm_conn, handle);
 
 	if (flags & FI_INJECT)
-		return rxm_ep_rma_inject(rxm_conn->msg_ep, rxm_ep, msg, flags);
+		return rxm_ep_rma_inject(rxm_conn, rxm_ep, msg, flags);
 	else
-		return rxm_ep_rma_common(rxm_conn->msg_ep, rxm_ep, msg, flags,
+		return rxm_ep_rma_common(rxm_conn, rxm_ep, msg, flags,
 					 fi_writemsg, FI_WRITE);
 }
 
@@ -852,6 +852,7 @@ struct sock_pe {
 	struct dlist_entry rx_list;
 
 	pthread_t progress_thread;
+	struct ofi_thread_place place;
 	volatile int do_progress;
 	struct sock_pe_entry *pe_atomic;
 	struct sock_epoll_set epoll_set;
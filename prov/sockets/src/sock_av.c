@@ -389,7 +389,7 @@ static int sock_av_remove(struct fid_av *av, fi_addr_t *fi_addr, size_t count,
 	struct fid_list_entry *fid_entry;
 	struct sock_ep *sock_ep;
 	struct sock_conn *conn;
-	uint16_t idx;
+	uint64_t idx;
 
 	_av = container_of(av, struct sock_av, av_fid);
 	fastlock_acquire(&_av->list_lock);
@@ -726,6 +726,10 @@ static int sock_ep_close(struct fid *fid)
 		 * sock_eq_clean_err_data_list when EQ is closed */
 		sock_ep_clear_eq_list(&sock_ep->attr->eq->err_list,
 				      &sock_ep->ep);
+		/* Error entries also signal the event list, clear that signal
+		 * if the errors dropped above were the only events left */
+		if (dlistfd_empty(&sock_ep->attr->eq->err_list))
+			dlistfd_reset(&sock_ep->attr->eq->list);
 		fastlock_release(&sock_ep->attr->eq->lock);
 	}
 
@@ -1814,7 +1818,7 @@ struct sock_conn *sock_ep_lookup_conn(struct sock_ep_attr *attr, fi_addr_t index
 					struct sockaddr_in *addr)
 {
 	int i;
-	uint16_t idx;
+	uint64_t idx;
 	struct sock_conn *conn;
 
 	idx = (attr->ep_type == FI_EP_MSG) ? index : index & attr->av->mask;
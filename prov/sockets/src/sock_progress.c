@@ -1159,13 +1159,13 @@ static int sock_pe_progress_buffered_rx(struct sock_rx_ctx *rx_ctx)
 		pe_entry.data_len = 0;
 		pe_entry.buf = 0L;
 		for (i = 0; i < rx_posted->rx_op.dest_iov_len && rem > 0; i++) {
-			if (used_len >= rx_posted->rx_op.dest_iov_len) {
-				used_len -= rx_posted->rx_op.dest_iov_len;
+			if (used_len >= rx_posted->iov[i].iov.len) {
+				used_len -= rx_posted->iov[i].iov.len;
 				continue;
 			}
 
 			dst_offset = used_len;
-			len = MIN(rx_posted->iov[i].iov.len, rem);
+			len = MIN(rx_posted->iov[i].iov.len - dst_offset, rem);
 			pe_entry.buf = rx_posted->iov[i].iov.addr + dst_offset;
 
 			src = (char *) (uintptr_t)
@@ -1208,6 +1208,7 @@ static int sock_pe_progress_buffered_rx(struct sock_rx_ctx *rx_ctx)
 				pe_entry.flags |= FI_MULTI_RECV;
 				dlist_remove(&rx_posted->entry);
 			}
+			rx_posted->is_busy = 0;
 		} else {
 			dlist_remove(&rx_posted->entry);
 		}
@@ -2483,61 +2484,20 @@ static void sock_pe_wait(struct sock_pe *pe)
 	pe->waittime = fi_gettime_ms();
 }
 
-#if !defined __APPLE__ && !defined _WIN32
-static void sock_thread_set_affinity(char *s)
-{
-	char *saveptra = NULL, *saveptrb = NULL, *saveptrc = NULL;
-	char *a, *b, *c;
-	int j, first, last, stride;
-	cpu_set_t mycpuset;
-	pthread_t mythread;
-
-	mythread = pthread_self();
-	CPU_ZERO(&mycpuset);
-
-	a = strtok_r(s, ",", &saveptra);
-	while (a) {
-		first = last = -1;
-		stride = 1;
-		b = strtok_r(a, "-", &saveptrb);
-		assert(b);
-		first = atoi(b);
-		/* Check for range delimiter */
-		b = strtok_r(NULL, "-", &saveptrb);
-		if (b) {
-			c = strtok_r(b, ":", &saveptrc);
-			assert(c);
-			last = atoi(c);
-			/* Check for stride */
-			c = strtok_r(NULL, ":", &saveptrc);
-			if (c)
-				stride = atoi(c);
-		}
-
-		if (last == -1)
-			last = first;
-
-		for (j = first; j <= last; j += stride)
-			CPU_SET(j, &mycpuset);
-		a =  strtok_r(NULL, ",", &saveptra);
-	}
-
-	j = pthread_setaffinity_np(mythread, sizeof(cpu_set_t), &mycpuset);
-	if (j != 0)
-		SOCK_LOG_ERROR("pthread_setaffinity_np failed\n");
-}
-#endif
-
-static void sock_pe_set_affinity(void)
+/* FI_SOCKETS_PE_AFFINITY overrides FI_THREAD_PLACEMENT */
+static void sock_pe_set_affinity(struct sock_pe *pe)
 {
-	if (sock_pe_affinity_str == NULL)
-		return;
+	int ret;
 
-#if !defined __APPLE__ && !defined _WIN32
-	sock_thread_set_affinity(sock_pe_affinity_str);
-#else
-	SOCK_LOG_ERROR("*** FI_SOCKETS_PE_AFFINITY is not supported on OS X\n");
-#endif
+	if (sock_pe_affinity_str) {
+		pe->place.node = OFI_NUMA_ANY;
+		ret = ofi_thread_set_cpus(sock_pe_affinity_str);
+		if (ret)
+			SOCK_LOG_ERROR("Unable to apply FI_SOCKETS_PE_AFFINITY "
+				       "%s: %s\n", sock_pe_affinity_str,
+				       fi_strerror(-ret));
+	}
+	ofi_thread_place(&sock_prov, &pe->place);
 }
 
 static void *sock_pe_progress_thread(void *data)
@@ -2549,7 +2509,7 @@ static void *sock_pe_progress_thread(void *data)
 	struct sock_pe *pe = (struct sock_pe *)data;
 
 	SOCK_LOG_DBG("Progress thread started\n");
-	sock_pe_set_affinity();
+	sock_pe_set_affinity(pe);
 	while (*((volatile int *)&pe->do_progress)) {
 		pthread_mutex_lock(&pe->list_lock);
 		if (pe->domain->progress_mode == FI_PROGRESS_AUTO &&
@@ -2589,6 +2549,7 @@ static void *sock_pe_progress_thread(void *data)
 		pthread_mutex_unlock(&pe->list_lock);
 	}
 
+	ofi_thread_report(&sock_prov, &pe->place);
 	SOCK_LOG_DBG("Progress thread terminated\n");
 	return NULL;
 }
@@ -2630,15 +2591,20 @@ struct sock_pe *sock_pe_init(struct sock_domain *domain)
 	fastlock_init(&pe->signal_lock);
 	pthread_mutex_init(&pe->list_lock, NULL);
 	pe->domain = domain;
+	ofi_thread_place_init(&pe->place, "progress", ofi_topo_select_node(
+			      ofi_topo_info_node(&domain->info)));
 
-	pe->pe_rx_pool = util_buf_pool_create(sizeof(struct sock_pe_entry), 16, 0, 1024);
+	pe->pe_rx_pool = util_buf_pool_create_node_ex(sizeof(struct sock_pe_entry),
+						      16, 0, 1024, NULL, NULL,
+						      NULL, pe->place.node);
 	if (!pe->pe_rx_pool) {
 		SOCK_LOG_ERROR("failed to create buffer pool\n");
 		goto err1;
 	}
 
-	pe->atomic_rx_pool = util_buf_pool_create(SOCK_EP_MAX_ATOMIC_SZ,
-						  16, 0, 32);
+	pe->atomic_rx_pool = util_buf_pool_create_node_ex(SOCK_EP_MAX_ATOMIC_SZ,
+							  16, 0, 32, NULL, NULL,
+							  NULL, pe->place.node);
 	if (!pe->atomic_rx_pool) {
 		SOCK_LOG_ERROR("failed to create atomic rx buffer pool\n");
 		goto err2;
@@ -15,6 +15,13 @@ AC_DEFUN([FI_UDP_CONFIGURE],[
 	      [AC_CHECK_HEADER([sys/socket.h], [udp_h_happy=1],
 	                       [udp_h_happy=0])
 
+	       # batched datagram calls are optional
+	       AC_CHECK_FUNCS([recvmmsg sendmmsg])
+
+	       # segmentation offload is used when the kernel supports it
+	       AC_CHECK_DECLS([UDP_SEGMENT, UDP_GRO], [], [],
+			      [#include <netinet/in.h>
+			       #include <netinet/udp.h>])
 
 	       # check if shm_open is already present
 	       AC_CHECK_FUNC([shm_open],
@@ -41,6 +41,7 @@
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
+#include <netinet/udp.h>
 
 #include <rdma/fabric.h>
 #include <rdma/fi_atomic.h>
@@ -59,6 +60,7 @@
 #include <fi_list.h>
 #include <fi_signal.h>
 #include <fi_util.h>
+#include <fi_iov.h>
 
 #ifndef _UDPX_H_
 #define _UDPX_H_
@@ -83,6 +85,17 @@ int udpx_eq_open(struct fid_fabric *fabric, struct fi_eq_attr *attr,
 
 #define UDPX_FLAG_MULTI_RECV	1
 #define UDPX_IOV_LIMIT		4
+#define UDPX_RX_BATCH		16
+#define UDPX_TX_BATCH		16
+#define UDPX_GSO_MAX_SEGS	64
+#define UDPX_GSO_MAX_SIZE	65507
+
+#if !HAVE_RECVMMSG && !HAVE_SENDMMSG
+struct mmsghdr {
+	struct msghdr		msg_hdr;
+	unsigned int		msg_len;
+};
+#endif
 
 struct udpx_ep_entry {
 	void			*context;
@@ -94,7 +107,40 @@ struct udpx_ep_entry {
 
 OFI_DECLARE_CIRQUE(struct udpx_ep_entry, udpx_rx_cirq);
 
+/*
+ * Provider owned receive buffers.  When enabled, datagrams that arrive
+ * while no receive is posted are staged here and copied out as soon as
+ * the application reposts, instead of being left to overflow the socket.
+ */
+struct udpx_rx_buf {
+	void			*data;
+	size_t			len;
+	size_t			seg_size; /* UDP_GRO coalesced datagrams */
+	size_t			offset;
+	struct sockaddr_in6	addr;
+};
+
+OFI_DECLARE_CIRQUE(struct udpx_rx_buf, udpx_rx_pool);
+
+extern int udpx_rx_pool_size;
+
+/*
+ * Sends posted with FI_MORE are queued and transmitted together with a
+ * single sendmmsg() call once the batch is full, a send without FI_MORE
+ * is posted, or the endpoint is progressed.  Consecutive queued sends to
+ * the same peer are coalesced into one UDP_SEGMENT datagram if possible.
+ */
+struct udpx_tx_entry {
+	void			*context;
+	struct iovec		iov[UDPX_IOV_LIMIT];
+	size_t			len;
+	uint8_t			iov_count;
+	socklen_t		addrlen;
+	struct sockaddr_in6	addr;
+};
+
 struct udpx_ep;
+struct udpx_sep;
 typedef void (*udpx_rx_comp_func)(struct udpx_ep *ep, void *context,
 		uint64_t flags, size_t len, void *buf, void *addr);
 typedef void (*udpx_tx_comp_func)(struct udpx_ep *ep, void *context);
@@ -104,13 +150,54 @@ struct udpx_ep {
 	udpx_rx_comp_func	rx_comp;
 	udpx_tx_comp_func	tx_comp;
 	struct udpx_rx_cirq	*rxq;    /* protected by rx_cq lock */
+	struct udpx_rx_pool	*rx_pool; /* protected by rx_cq lock */
+	void			*rx_pool_mem;
+	size_t			rx_buf_size;
+	size_t			min_multi_recv;
+	int			tx_gso;
+	int			rx_gro;
+	struct udpx_tx_entry	txq[UDPX_TX_BATCH]; /* protected by tx_cq lock */
+	int			tx_cnt;
 	int			sock;
 	int			is_bound;
 	ofi_atomic32_t		ref;
+	struct udpx_sep		*sep;
+	int			ctx_ref; /* protected by sep lock */
 };
 
+#define UDPX_EP_REUSEPORT	(1ULL << 0)
+
 int udpx_endpoint(struct fid_domain *domain, struct fi_info *info,
 		  struct fid_ep **ep, void *context);
+int udpx_ep_open(struct fid_domain *domain, struct fi_info *info,
+		 uint64_t flags, struct udpx_ep **ep, void *context);
+int udpx_ep_free(struct udpx_ep *ep);
+void udpx_bind_src_addr(struct udpx_ep *ep);
+int udpx_getname(fid_t fid, void *addr, size_t *addrlen);
+
+/*
+ * A scalable endpoint is a group of independent endpoints whose sockets
+ * share one address through SO_REUSEPORT.  The kernel spreads incoming
+ * flows across the sockets, and each context has its own receive queue
+ * and completion queues, so receive processing scales with the number
+ * of contexts.  Transmit context i and receive context i are the same
+ * underlying endpoint.
+ */
+#define UDPX_MAX_EP_CTX		64
+
+struct udpx_sep {
+	struct fid_ep		ep_fid;
+	struct util_domain	*domain;
+	fastlock_t		lock;
+	size_t			tx_ctx_cnt;
+	size_t			rx_ctx_cnt;
+	size_t			ctx_cnt;
+	struct udpx_ep		**ctx;
+};
+
+int udpx_scalable_ep(struct fid_domain *domain, struct fi_info *info,
+		     struct fid_ep **sep, void *context);
+extern int udpx_incoming_cpu;
 
 
 int udpx_cq_open(struct fid_domain *domain, struct fi_cq_attr *attr,
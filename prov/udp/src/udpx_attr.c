@@ -42,7 +42,7 @@ struct fi_tx_attr udpx_tx_attr = {
 };
 
 struct fi_rx_attr udpx_rx_attr = {
-	.caps = FI_MSG | FI_RECV | FI_SOURCE | FI_MULTICAST,
+	.caps = FI_MSG | FI_RECV | FI_SOURCE | FI_MULTICAST | FI_MULTI_RECV,
 	.comp_order = FI_ORDER_STRICT,
 	.total_buffered_recv = (1 << 16),
 	.size = 1024,
@@ -70,8 +70,8 @@ struct fi_domain_attr udpx_domain_attr = {
 	.ep_cnt = 256,
 	.tx_ctx_cnt = 256,
 	.rx_ctx_cnt = 256,
-	.max_ep_tx_ctx = 1,
-	.max_ep_rx_ctx = 1
+	.max_ep_tx_ctx = UDPX_MAX_EP_CTX,
+	.max_ep_rx_ctx = UDPX_MAX_EP_CTX
 };
 
 struct fi_fabric_attr udpx_fabric_attr = {
@@ -80,7 +80,8 @@ struct fi_fabric_attr udpx_fabric_attr = {
 };
 
 struct fi_info udpx_info = {
-	.caps = FI_MSG | FI_SEND | FI_RECV | FI_SOURCE | FI_MULTICAST,
+	.caps = FI_MSG | FI_SEND | FI_RECV | FI_SOURCE | FI_MULTICAST |
+		FI_MULTI_RECV,
 	.addr_format = FI_SOCKADDR,
 	.tx_attr = &udpx_tx_attr,
 	.rx_attr = &udpx_rx_attr,
@@ -195,13 +195,42 @@ static struct fi_ops_cm udpx_cm_ops = {
 int udpx_getopt(fid_t fid, int level, int optname,
 		void *optval, size_t *optlen)
 {
-	return -FI_ENOPROTOOPT;
+	struct udpx_ep *ep;
+
+	ep = container_of(fid, struct udpx_ep, util_ep.ep_fid.fid);
+	if (level != FI_OPT_ENDPOINT)
+		return -FI_ENOPROTOOPT;
+
+	switch (optname) {
+	case FI_OPT_MIN_MULTI_RECV:
+		*(size_t *) optval = ep->min_multi_recv;
+		*optlen = sizeof(size_t);
+		break;
+	default:
+		return -FI_ENOPROTOOPT;
+	}
+	return 0;
 }
 
 int udpx_setopt(fid_t fid, int level, int optname,
 		const void *optval, size_t optlen)
 {
-	return -FI_ENOPROTOOPT;
+	struct udpx_ep *ep;
+
+	ep = container_of(fid, struct udpx_ep, util_ep.ep_fid.fid);
+	if (level != FI_OPT_ENDPOINT)
+		return -FI_ENOPROTOOPT;
+
+	switch (optname) {
+	case FI_OPT_MIN_MULTI_RECV:
+		if (!*(size_t *) optval)
+			return -FI_EINVAL;
+		ep->min_multi_recv = *(size_t *) optval;
+		break;
+	default:
+		return -FI_ENOPROTOOPT;
+	}
+	return 0;
 }
 
 static struct fi_ops_ep udpx_ep_ops = {
@@ -216,6 +245,16 @@ static struct fi_ops_ep udpx_ep_ops = {
 };
 
 
+/*
+ * Must hold the CQ lock.  Slots reserved for queued sends are not free.
+ */
+static size_t udpx_cq_freecnt(struct util_cq *cq)
+{
+	size_t freecnt = ofi_cirque_freecnt(cq->cirq);
+
+	return freecnt > cq->reserved ? freecnt - cq->reserved : 0;
+}
+
 static void udpx_tx_comp(struct udpx_ep *ep, void *context)
 {
 	struct fi_cq_tagged_entry *comp;
@@ -271,38 +310,412 @@ static void udpx_rx_src_comp_signal(struct udpx_ep *ep, void *context,
 	ep->util_ep.rx_cq->wait->signal(ep->util_ep.rx_cq->wait);
 }
 
-void udpx_ep_progress(struct util_ep *util_ep)
+#if !HAVE_RECVMMSG
+static int recvmmsg(int sock, struct mmsghdr *msgvec, unsigned int vlen,
+		    int flags, struct timespec *timeout)
+{
+	unsigned int i;
+	ssize_t ret;
+
+	for (i = 0; i < vlen; i++) {
+		ret = recvmsg(sock, &msgvec[i].msg_hdr, flags);
+		if (ret < 0)
+			return i ? (int) i : -1;
+		msgvec[i].msg_len = (unsigned int) ret;
+	}
+	return (int) i;
+}
+#endif
+
+#if !HAVE_SENDMMSG
+static int sendmmsg(int sock, struct mmsghdr *msgvec, unsigned int vlen,
+		    int flags)
+{
+	unsigned int i;
+	ssize_t ret;
+
+	for (i = 0; i < vlen; i++) {
+		ret = sendmsg(sock, &msgvec[i].msg_hdr, flags);
+		if (ret < 0)
+			return i ? (int) i : -1;
+		msgvec[i].msg_len = (unsigned int) ret;
+	}
+	return (int) i;
+}
+#endif
+
+static void udpx_init_msghdr(struct msghdr *hdr, void *addr, socklen_t addrlen,
+			     struct iovec *iov, size_t iov_count)
+{
+	hdr->msg_name = addr;
+	hdr->msg_namelen = addrlen;
+	hdr->msg_iov = iov;
+	hdr->msg_iovlen = iov_count;
+	hdr->msg_control = NULL;
+	hdr->msg_controllen = 0;
+	hdr->msg_flags = 0;
+}
+
+union udpx_ctrl {
+	char			buf[CMSG_SPACE(sizeof(uint16_t))];
+	struct cmsghdr		align;
+};
+
+/*
+ * Returns the number of queued sends, starting at first, that can be
+ * carried by a single UDP_SEGMENT datagram: same destination, every
+ * segment but the last exactly seg_size bytes.
+ */
+static int udpx_gso_seg_cnt(struct udpx_ep *ep, int first)
+{
+	struct udpx_tx_entry *entry = &ep->txq[first];
+	size_t total;
+	int i;
+
+	if (!ep->tx_gso || !entry->len)
+		return 1;
+
+	total = entry->len;
+	for (i = first + 1; i < ep->tx_cnt &&
+	     i - first < UDPX_GSO_MAX_SEGS; i++) {
+		if (ep->txq[i].addrlen != entry->addrlen ||
+		    memcmp(&ep->txq[i].addr, &entry->addr, entry->addrlen) ||
+		    !ep->txq[i].len || ep->txq[i].len > entry->len ||
+		    total + ep->txq[i].len > UDPX_GSO_MAX_SIZE)
+			break;
+
+		total += ep->txq[i].len;
+		if (ep->txq[i].len < entry->len)
+			return i - first + 1;
+	}
+	return i - first;
+}
+
+static void udpx_set_gso(struct msghdr *hdr, union udpx_ctrl *ctrl,
+			 size_t seg_size)
+{
+#if HAVE_DECL_UDP_SEGMENT
+	struct cmsghdr *cmsg;
+	uint16_t size = (uint16_t) seg_size;
+
+	hdr->msg_control = ctrl->buf;
+	hdr->msg_controllen = sizeof(ctrl->buf);
+	cmsg = CMSG_FIRSTHDR(hdr);
+	cmsg->cmsg_level = SOL_UDP;
+	cmsg->cmsg_type = UDP_SEGMENT;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(size));
+	memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+#endif
+}
+
+/*
+ * Builds the message headers for queued sends starting at first.  Each
+ * header may carry several sends; segs[] records how many.
+ */
+static int udpx_build_tx_msgs(struct udpx_ep *ep, int first,
+			      struct mmsghdr *msgs, union udpx_ctrl *ctrl,
+			      struct iovec *iov, int *segs)
+{
+	struct udpx_tx_entry *entry;
+	struct msghdr *hdr;
+	int i, m, iov_cnt = 0;
+
+	for (m = 0; first < ep->tx_cnt; m++) {
+		entry = &ep->txq[first];
+		hdr = &msgs[m].msg_hdr;
+		udpx_init_msghdr(hdr, &entry->addr, entry->addrlen,
+				 &iov[iov_cnt], 0);
+
+		segs[m] = udpx_gso_seg_cnt(ep, first);
+		for (i = 0; i < segs[m]; i++, first++) {
+			memcpy(&iov[iov_cnt], ep->txq[first].iov,
+			       sizeof(*iov) * ep->txq[first].iov_count);
+			iov_cnt += ep->txq[first].iov_count;
+			hdr->msg_iovlen += ep->txq[first].iov_count;
+		}
+
+		if (segs[m] > 1)
+			udpx_set_gso(hdr, &ctrl[m], entry->len);
+	}
+	return m;
+}
+
+/*
+ * Must hold tx_cq lock.  Writes the error completion of a queued send into
+ * the slot reserved for it.
+ */
+static void udpx_tx_err_comp(struct udpx_ep *ep, void *context, int err)
+{
+	struct util_cq *cq = ep->util_ep.tx_cq;
+	struct util_cq_err_entry *entry;
+	struct fi_cq_tagged_entry *comp;
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry) {
+		FI_WARN(&udpx_prov, FI_LOG_EP_DATA,
+			"unable to report send error\n");
+		return;
+	}
+
+	entry->err_entry.op_context = context;
+	entry->err_entry.flags = FI_SEND;
+	entry->err_entry.err = err;
+	entry->err_entry.prov_errno = err;
+	slist_insert_tail(&entry->list_entry, &cq->err_list);
+	comp = ofi_cirque_tail(cq->cirq);
+	comp->flags = UTIL_FLAG_ERROR;
+	ofi_cirque_commit(cq->cirq);
+	if (cq->wait)
+		cq->wait->signal(cq->wait);
+}
+
+/*
+ * Must hold tx_cq lock.  Sends that would block remain queued.  Each send
+ * leaving the queue releases its reserved completion slot.
+ */
+static ssize_t udpx_flush_tx(struct udpx_ep *ep)
+{
+	struct mmsghdr msgs[UDPX_TX_BATCH];
+	union udpx_ctrl ctrl[UDPX_TX_BATCH];
+	struct iovec iov[UDPX_TX_BATCH * UDPX_IOV_LIMIT];
+	int segs[UDPX_TX_BATCH];
+	int i, j, msg_cnt, sent = 0, ret = 0;
+
+	while (sent < ep->tx_cnt) {
+		msg_cnt = udpx_build_tx_msgs(ep, sent, msgs, ctrl, iov, segs);
+		ret = sendmmsg(ep->sock, msgs, msg_cnt, 0);
+		if (ret < 0) {
+			ret = -errno;
+			if (ret == -FI_EAGAIN)
+				break;
+
+			if (segs[0] > 1) {
+				FI_INFO(&udpx_prov, FI_LOG_EP_DATA,
+					"UDP_SEGMENT send failed (%s), "
+					"disabling GSO\n", strerror(-ret));
+				ep->tx_gso = 0;
+				continue;
+			}
+
+			FI_WARN(&udpx_prov, FI_LOG_EP_DATA,
+				"sendmmsg %d (%s)\n", -ret, strerror(-ret));
+			ep->util_ep.tx_cq->reserved--;
+			udpx_tx_err_comp(ep, ep->txq[sent++].context, -ret);
+			continue;
+		}
+
+		for (i = 0; i < ret; i++) {
+			for (j = 0; j < segs[i]; j++) {
+				ep->util_ep.tx_cq->reserved--;
+				ep->tx_comp(ep, ep->txq[sent++].context);
+			}
+		}
+	}
+
+	if (sent) {
+		memmove(&ep->txq[0], &ep->txq[sent],
+			sizeof(*ep->txq) * (ep->tx_cnt - sent));
+		ep->tx_cnt -= sent;
+	}
+	return ep->tx_cnt ? -FI_EAGAIN : 0;
+}
+
+/*
+ * Must hold rx_cq lock.  A multi-receive buffer is carved into consecutive
+ * datagrams and released once the remaining space drops below the
+ * FI_OPT_MIN_MULTI_RECV threshold.
+ */
+static void udpx_rx_comp_entry(struct udpx_ep *ep, struct udpx_ep_entry *entry,
+			       size_t len, void *addr)
+{
+	void *buf;
+
+	if (!(entry->flags & UDPX_FLAG_MULTI_RECV)) {
+		ep->rx_comp(ep, entry->context, 0, len, NULL, addr);
+		ofi_cirque_discard(ep->rxq);
+		return;
+	}
+
+	buf = entry->iov[0].iov_base;
+	entry->iov[0].iov_base = (char *) buf + len;
+	entry->iov[0].iov_len -= len;
+	if (entry->iov[0].iov_len < ep->min_multi_recv) {
+		ep->rx_comp(ep, entry->context, FI_MULTI_RECV, len, buf, addr);
+		ofi_cirque_discard(ep->rxq);
+	} else {
+		ep->rx_comp(ep, entry->context, 0, len, buf, addr);
+	}
+}
+
+/*
+ * Must hold rx_cq lock.  Copies staged datagrams into posted receives.
+ */
+static void udpx_rx_pool_match(struct udpx_ep *ep)
 {
-	struct udpx_ep *ep;
 	struct udpx_ep_entry *entry;
-	struct msghdr hdr;
-	struct sockaddr_in6 addr;
+	struct udpx_rx_buf *buf;
+	size_t len;
+
+	while (!ofi_cirque_isempty(ep->rx_pool) &&
+	       !ofi_cirque_isempty(ep->rxq) &&
+	       udpx_cq_freecnt(ep->util_ep.rx_cq)) {
+		buf = ofi_cirque_head(ep->rx_pool);
+		entry = ofi_cirque_head(ep->rxq);
+		len = MIN(buf->seg_size, buf->len - buf->offset);
+		len = ofi_copy_to_iov(entry->iov, entry->iov_count, 0,
+				      (char *) buf->data + buf->offset, len);
+		udpx_rx_comp_entry(ep, entry, len, &buf->addr);
+
+		buf->offset += MIN(buf->seg_size, buf->len - buf->offset);
+		if (buf->offset >= buf->len)
+			ofi_cirque_discard(ep->rx_pool);
+	}
+}
+
+/*
+ * Returns the segment size of a UDP_GRO coalesced receive, or len if the
+ * datagram was not coalesced.
+ */
+static size_t udpx_gro_seg_size(struct msghdr *hdr, size_t len)
+{
+#if HAVE_DECL_UDP_GRO
+	struct cmsghdr *cmsg;
+	int size;
+
+	for (cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+		if (cmsg->cmsg_level == SOL_UDP &&
+		    cmsg->cmsg_type == UDP_GRO) {
+			memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+			return size > 0 ? (size_t) size : len;
+		}
+	}
+#endif
+	return len;
+}
+
+/*
+ * Must hold rx_cq lock.  Stages arriving datagrams in provider buffers.
+ */
+static void udpx_rx_pool_fill(struct udpx_ep *ep)
+{
+	struct mmsghdr msgs[UDPX_RX_BATCH];
+	struct iovec iov[UDPX_RX_BATCH];
+	union {
+		char buf[CMSG_SPACE(sizeof(int))];
+		struct cmsghdr align;
+	} ctrl[UDPX_RX_BATCH];
+	struct udpx_rx_buf *buf;
+	size_t i, used, cnt;
 	int ret;
 
-	ep = container_of(util_ep, struct udpx_ep, util_ep);
-	hdr.msg_name = &addr;
-	hdr.msg_namelen = sizeof(addr);
-	hdr.msg_control = NULL;
-	hdr.msg_controllen = 0;
-	hdr.msg_flags = 0;
+	used = ofi_cirque_usedcnt(ep->rx_pool);
+	cnt = MIN(ofi_cirque_freecnt(ep->rx_pool), UDPX_RX_BATCH);
+	for (i = 0; i < cnt; i++) {
+		buf = ofi_cirque_get(ep->rx_pool, used + i);
+		iov[i].iov_base = buf->data;
+		iov[i].iov_len = ep->rx_buf_size;
+		udpx_init_msghdr(&msgs[i].msg_hdr, &buf->addr,
+				 sizeof(buf->addr), &iov[i], 1);
+		if (ep->rx_gro) {
+			msgs[i].msg_hdr.msg_control = ctrl[i].buf;
+			msgs[i].msg_hdr.msg_controllen = sizeof(ctrl[i].buf);
+		}
+	}
 
-	fastlock_acquire(&ep->util_ep.rx_cq->cq_lock);
-	if (ofi_cirque_isempty(ep->rxq))
-		goto out;
+	ret = cnt ? recvmmsg(ep->sock, msgs, (unsigned int) cnt, 0, NULL) : 0;
+	for (i = 0; ret > 0 && i < (size_t) ret; i++) {
+		buf = ofi_cirque_tail(ep->rx_pool);
+		buf->len = msgs[i].msg_len;
+		buf->seg_size = ep->rx_gro ?
+			udpx_gro_seg_size(&msgs[i].msg_hdr, buf->len) :
+			buf->len;
+		buf->offset = 0;
+		ofi_cirque_commit(ep->rx_pool);
+	}
+}
 
-	entry = ofi_cirque_head(ep->rxq);
-	hdr.msg_iov = entry->iov;
-	hdr.msg_iovlen = entry->iov_count;
+/*
+ * Must hold rx_cq lock.  Receives directly into posted buffers, batching
+ * consecutive single datagram receives into one recvmmsg() call.
+ */
+static void udpx_rx_posted(struct udpx_ep *ep)
+{
+	struct udpx_ep_entry *entry;
+	struct mmsghdr msgs[UDPX_RX_BATCH];
+	struct sockaddr_in6 addr[UDPX_RX_BATCH];
+	size_t i, cnt;
+	ssize_t ret;
 
-	ret = recvmsg(ep->sock, &hdr, 0);
-	if (ret >= 0) {
-		ep->rx_comp(ep, entry->context, 0, ret, NULL, &addr);
-		ofi_cirque_discard(ep->rxq);
+	cnt = MIN(ofi_cirque_usedcnt(ep->rxq),
+		  udpx_cq_freecnt(ep->util_ep.rx_cq));
+	cnt = MIN(cnt, UDPX_RX_BATCH);
+	if (!cnt)
+		return;
+
+	if (ofi_cirque_head(ep->rxq)->flags & UDPX_FLAG_MULTI_RECV) {
+		for (i = 0; i < cnt; i++) {
+			entry = ofi_cirque_head(ep->rxq);
+			udpx_init_msghdr(&msgs[0].msg_hdr, &addr[0],
+					 sizeof(addr[0]), entry->iov,
+					 entry->iov_count);
+			ret = recvmsg(ep->sock, &msgs[0].msg_hdr, 0);
+			if (ret < 0)
+				break;
+			udpx_rx_comp_entry(ep, entry, ret, &addr[0]);
+		}
+		return;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		entry = ofi_cirque_get(ep->rxq, i);
+		if (entry->flags & UDPX_FLAG_MULTI_RECV)
+			break;
+		udpx_init_msghdr(&msgs[i].msg_hdr, &addr[i], sizeof(addr[i]),
+				 entry->iov, entry->iov_count);
+	}
+
+	ret = recvmmsg(ep->sock, msgs, (unsigned int) i, 0, NULL);
+	for (i = 0; ret > 0 && i < (size_t) ret; i++) {
+		udpx_rx_comp_entry(ep, ofi_cirque_head(ep->rxq),
+				   msgs[i].msg_len, &addr[i]);
+	}
+}
+
+static void udpx_ep_progress_rx(struct udpx_ep *ep)
+{
+	fastlock_acquire(&ep->util_ep.rx_cq->cq_lock);
+	if (ep->rx_gro) {
+		/* coalesced datagrams only fit in the pool buffers */
+		udpx_rx_pool_fill(ep);
+		udpx_rx_pool_match(ep);
+	} else if (ep->rx_pool) {
+		udpx_rx_pool_match(ep);
+		if (ofi_cirque_isempty(ep->rx_pool))
+			udpx_rx_posted(ep);
+		if (ofi_cirque_isempty(ep->rxq))
+			udpx_rx_pool_fill(ep);
+	} else {
+		udpx_rx_posted(ep);
 	}
-out:
 	fastlock_release(&ep->util_ep.rx_cq->cq_lock);
 }
 
+void udpx_ep_progress(struct util_ep *util_ep)
+{
+	struct udpx_ep *ep;
+
+	ep = container_of(util_ep, struct udpx_ep, util_ep);
+	if (ep->util_ep.tx_cq) {
+		fastlock_acquire(&ep->util_ep.tx_cq->cq_lock);
+		if (ep->tx_cnt)
+			udpx_flush_tx(ep);
+		fastlock_release(&ep->util_ep.tx_cq->cq_lock);
+	}
+
+	if (ep->util_ep.rx_cq)
+		udpx_ep_progress_rx(ep);
+}
+
 ssize_t udpx_recvmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
 		uint64_t flags)
 {
@@ -311,6 +724,9 @@ ssize_t udpx_recvmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
 	ssize_t ret;
 
 	ep = container_of(ep_fid, struct udpx_ep, util_ep.ep_fid.fid);
+	if ((flags & FI_MULTI_RECV) && msg->iov_count != 1)
+		return -FI_EINVAL;
+
 	fastlock_acquire(&ep->util_ep.rx_cq->cq_lock);
 	if (ofi_cirque_isfull(ep->rxq)) {
 		ret = -FI_EAGAIN;
@@ -323,9 +739,11 @@ ssize_t udpx_recvmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
 	     entry->iov_count++) {
 		entry->iov[entry->iov_count] = msg->msg_iov[entry->iov_count];
 	}
-	entry->flags = 0;
+	entry->flags = (flags & FI_MULTI_RECV) ? UDPX_FLAG_MULTI_RECV : 0;
 
 	ofi_cirque_commit(ep->rxq);
+	if (ep->rx_pool)
+		udpx_rx_pool_match(ep);
 	ret = 0;
 out:
 	fastlock_release(&ep->util_ep.rx_cq->cq_lock);
@@ -335,12 +753,14 @@ out:
 ssize_t udpx_recvv(struct fid_ep *ep_fid, const struct iovec *iov, void **desc,
 		size_t count, fi_addr_t src_addr, void *context)
 {
+	struct udpx_ep *ep;
 	struct fi_msg msg;
 
+	ep = container_of(ep_fid, struct udpx_ep, util_ep.ep_fid.fid);
 	msg.msg_iov = iov;
 	msg.iov_count = count;
 	msg.context = context;
-	return udpx_recvmsg(ep_fid, &msg, 0);
+	return udpx_recvmsg(ep_fid, &msg, ep->util_ep.rx_op_flags);
 }
 
 ssize_t udpx_recv(struct fid_ep *ep_fid, void *buf, size_t len, void *desc,
@@ -362,9 +782,12 @@ ssize_t udpx_recv(struct fid_ep *ep_fid, void *buf, size_t len, void *desc,
 	entry->iov_count = 1;
 	entry->iov[0].iov_base = buf;
 	entry->iov[0].iov_len = len;
-	entry->flags = 0;
+	entry->flags = (ep->util_ep.rx_op_flags & FI_MULTI_RECV) ?
+		       UDPX_FLAG_MULTI_RECV : 0;
 
 	ofi_cirque_commit(ep->rxq);
+	if (ep->rx_pool)
+		udpx_rx_pool_match(ep);
 	ret = 0;
 out:
 	fastlock_release(&ep->util_ep.rx_cq->cq_lock);
@@ -386,17 +809,63 @@ udpx_dest_addrlen(struct udpx_ep *ep, fi_addr_t addr, uint64_t flags)
 		ep->util_ep.av->addrlen;
 }
 
+/*
+ * Must hold tx_cq lock.  Each queued send reserves a tx CQ slot for its
+ * completion, so that neither this endpoint's receives nor other endpoints
+ * sharing the CQ can take it before the send is flushed.
+ */
+static ssize_t udpx_queue_tx(struct udpx_ep *ep, const struct iovec *iov,
+			     size_t iov_count, const void *addr, size_t addrlen,
+			     void *context, uint64_t flags)
+{
+	struct udpx_tx_entry *entry;
+	ssize_t ret;
+
+	if (ep->tx_cnt == UDPX_TX_BATCH) {
+		ret = udpx_flush_tx(ep);
+		if (ret)
+			return ret;
+	}
+
+	if (iov_count > UDPX_IOV_LIMIT || addrlen > sizeof(entry->addr))
+		return ep->tx_cnt ? -FI_EAGAIN : -FI_EINVAL;
+	if (!udpx_cq_freecnt(ep->util_ep.tx_cq))
+		return -FI_EAGAIN;
+
+	ep->util_ep.tx_cq->reserved++;
+	entry = &ep->txq[ep->tx_cnt++];
+	entry->context = context;
+	memcpy(entry->iov, iov, sizeof(*iov) * iov_count);
+	entry->iov_count = (uint8_t) iov_count;
+	entry->len = ofi_total_iov_len(iov, iov_count);
+	memcpy(&entry->addr, addr, addrlen);
+	entry->addrlen = (socklen_t) addrlen;
+
+	if (!(flags & FI_MORE) || ep->tx_cnt == UDPX_TX_BATCH)
+		udpx_flush_tx(ep);
+	return 0;
+}
+
 static ssize_t udpx_sendto(struct udpx_ep *ep, const void *buf, size_t len,
 			   const void *addr, size_t addrlen, void *context)
 {
+	struct iovec iov;
 	ssize_t ret;
 
 	fastlock_acquire(&ep->util_ep.tx_cq->cq_lock);
-	if (ofi_cirque_isfull(ep->util_ep.tx_cq->cirq)) {
+	if (!udpx_cq_freecnt(ep->util_ep.tx_cq)) {
 		ret = -FI_EAGAIN;
 		goto out;
 	}
 
+	/* Preserve ordering behind sends queued with FI_MORE */
+	if (ep->tx_cnt) {
+		iov.iov_base = (void *) buf;
+		iov.iov_len = len;
+		ret = udpx_queue_tx(ep, &iov, 1, addr, addrlen, context, 0);
+		goto out;
+	}
+
 	ret = sendto(ep->sock, buf, len, 0, addr, addrlen);
 	if (ret == len) {
 		ep->tx_comp(ep, context);
@@ -438,20 +907,23 @@ static ssize_t udpx_sendmsg(struct fid_ep *ep_fid, const struct fi_msg *msg,
 	ssize_t ret;
 
 	ep = container_of(ep_fid, struct udpx_ep, util_ep.ep_fid.fid);
-	hdr.msg_name = (void *) udpx_dest_addr(ep, msg->addr, flags);
-	hdr.msg_namelen = udpx_dest_addrlen(ep, msg->addr, flags);
-	hdr.msg_iov = (struct iovec *) msg->msg_iov;
-	hdr.msg_iovlen = msg->iov_count;
-	hdr.msg_control = NULL;
-	hdr.msg_controllen = 0;
-	hdr.msg_flags = 0;
+	udpx_init_msghdr(&hdr, (void *) udpx_dest_addr(ep, msg->addr, flags),
+			 udpx_dest_addrlen(ep, msg->addr, flags),
+			 (struct iovec *) msg->msg_iov, msg->iov_count);
 
 	fastlock_acquire(&ep->util_ep.tx_cq->cq_lock);
-	if (ofi_cirque_isfull(ep->util_ep.tx_cq->cirq)) {
+	if (!udpx_cq_freecnt(ep->util_ep.tx_cq)) {
 		ret = -FI_EAGAIN;
 		goto out;
 	}
 
+	if ((flags & FI_MORE) || ep->tx_cnt) {
+		ret = udpx_queue_tx(ep, msg->msg_iov, msg->iov_count,
+				    hdr.msg_name, hdr.msg_namelen,
+				    msg->context, flags);
+		goto out;
+	}
+
 	ret = sendmsg(ep->sock, &hdr, 0);
 	if (ret >= 0) {
 		ep->tx_comp(ep, msg->context);
@@ -491,6 +963,16 @@ ssize_t udpx_sendv_mc(struct fid_ep *ep_fid, const struct iovec *iov,
 	return udpx_sendmsg(ep_fid, &msg, FI_MULTICAST);
 }
 
+static ssize_t udpx_inject_flush(struct udpx_ep *ep)
+{
+	ssize_t ret;
+
+	fastlock_acquire(&ep->util_ep.tx_cq->cq_lock);
+	ret = udpx_flush_tx(ep);
+	fastlock_release(&ep->util_ep.tx_cq->cq_lock);
+	return ret;
+}
+
 static ssize_t udpx_inject(struct fid_ep *ep_fid, const void *buf, size_t len,
 			   fi_addr_t dest_addr)
 {
@@ -498,6 +980,9 @@ static ssize_t udpx_inject(struct fid_ep *ep_fid, const void *buf, size_t len,
 	ssize_t ret;
 
 	ep = container_of(ep_fid, struct udpx_ep, util_ep.ep_fid.fid);
+	if (ep->tx_cnt && udpx_inject_flush(ep))
+		return -FI_EAGAIN;
+
 	ret = sendto(ep->sock, buf, len, 0,
 		     ip_av_get_addr(ep->util_ep.av, dest_addr),
 		     ep->util_ep.av->addrlen);
@@ -511,6 +996,9 @@ static ssize_t udpx_inject_mc(struct fid_ep *ep_fid, const void *buf,
 	ssize_t ret;
 
 	ep = container_of(ep_fid, struct udpx_ep, util_ep.ep_fid.fid);
+	if (ep->tx_cnt && udpx_inject_flush(ep))
+		return -FI_EAGAIN;
+
 	ret = sendto(ep->sock, buf, len, 0, (const void *) (uintptr_t) dest_addr,
 		     ofi_sizeofaddr((const void *) (uintptr_t) dest_addr));
 	return ret == len ? 0 : -errno;
@@ -542,12 +1030,10 @@ static struct fi_ops_msg udpx_msg_mcast_ops = {
 	.injectdata = fi_no_msg_injectdata,
 };
 
-static int udpx_ep_close(struct fid *fid)
+int udpx_ep_free(struct udpx_ep *ep)
 {
-	struct udpx_ep *ep;
 	struct util_wait_fd *wait;
 
-	ep = container_of(fid, struct udpx_ep, util_ep.ep_fid.fid);
 	if (ofi_atomic_get32(&ep->ref)) {
 		FI_WARN(&udpx_prov, FI_LOG_EP_CTRL, "EP busy\n");
 		return -FI_EBUSY;
@@ -564,13 +1050,45 @@ static int udpx_ep_close(struct fid *fid)
 				&ep->util_ep.ep_fid.fid);
 	}
 
+	/* Once off both lists no CQ progress can reach the endpoint */
+	if (ep->util_ep.tx_cq) {
+		fid_list_remove(&ep->util_ep.tx_cq->ep_list,
+				&ep->util_ep.tx_cq->ep_list_lock,
+				&ep->util_ep.ep_fid.fid);
+		fastlock_acquire(&ep->util_ep.tx_cq->cq_lock);
+		udpx_flush_tx(ep);
+		/* sends still blocked are dropped with their slots */
+		ep->util_ep.tx_cq->reserved -= ep->tx_cnt;
+		ep->tx_cnt = 0;
+		fastlock_release(&ep->util_ep.tx_cq->cq_lock);
+	}
+
 	udpx_rx_cirq_free(ep->rxq);
+	if (ep->rx_pool) {
+		udpx_rx_pool_free(ep->rx_pool);
+		free(ep->rx_pool_mem);
+	}
 	ofi_close_socket(ep->sock);
 	ofi_endpoint_close(&ep->util_ep);
 	free(ep);
 	return 0;
 }
 
+static int udpx_ep_close(struct fid *fid)
+{
+	struct udpx_ep *ep;
+
+	ep = container_of(fid, struct udpx_ep, util_ep.ep_fid.fid);
+	if (ep->sep) {
+		/* contexts are released with their scalable endpoint */
+		fastlock_acquire(&ep->sep->lock);
+		ep->ctx_ref--;
+		fastlock_release(&ep->sep->lock);
+		return 0;
+	}
+	return udpx_ep_free(ep);
+}
+
 static int udpx_ep_bind_cq(struct udpx_ep *ep, struct util_cq *cq,
 			   uint64_t flags)
 {
@@ -586,6 +1104,13 @@ static int udpx_ep_bind_cq(struct udpx_ep *ep, struct util_cq *cq,
 		ofi_atomic_inc32(&cq->ref);
 		ep->tx_comp = cq->wait ? udpx_tx_comp_signal :
 					 udpx_tx_comp;
+
+		/* progress flushes sends queued with FI_MORE */
+		ret = fid_list_insert(&cq->ep_list,
+				      &cq->ep_list_lock,
+				      &ep->util_ep.ep_fid.fid);
+		if (ret)
+			return ret;
 	}
 
 	if (flags & FI_RECV) {
@@ -654,7 +1179,7 @@ static int udpx_ep_bind(struct fid *ep_fid, struct fid *bfid, uint64_t flags)
 	return ret;
 }
 
-static void udpx_bind_src_addr(struct udpx_ep *ep)
+void udpx_bind_src_addr(struct udpx_ep *ep)
 {
 	int ret;
 	struct addrinfo ai, *rai = NULL;
@@ -686,7 +1211,9 @@ static int udpx_ep_ctrl(struct fid *fid, int command, void *arg)
 	ep = container_of(fid, struct udpx_ep, util_ep.ep_fid.fid);
 	switch (command) {
 	case FI_ENABLE:
-		if (!ep->util_ep.rx_cq || !ep->util_ep.tx_cq)
+		/* a scalable endpoint context may be used in one direction */
+		if (ep->sep ? !ep->util_ep.rx_cq && !ep->util_ep.tx_cq :
+			      !ep->util_ep.rx_cq || !ep->util_ep.tx_cq)
 			return -FI_ENOCQ;
 		if (!ep->util_ep.av)
 			return -FI_ENOAV;
@@ -708,12 +1235,65 @@ static struct fi_ops udpx_ep_fi_ops = {
 	.ops_open = fi_no_ops_open,
 };
 
-static int udpx_ep_init(struct udpx_ep *ep, struct fi_info *info)
+/*
+ * Segmentation offload is enabled only if the running kernel accepts the
+ * socket options.  Coalesced receives need buffers large enough to hold
+ * a full super-datagram, so GRO is limited to the provider receive pool.
+ */
+static void udpx_ep_init_offload(struct udpx_ep *ep)
+{
+	int val = 0;
+
+#if HAVE_DECL_UDP_SEGMENT
+	ep->tx_gso = !setsockopt(ep->sock, SOL_UDP, UDP_SEGMENT,
+				 &val, sizeof(val));
+#endif
+#if HAVE_DECL_UDP_GRO
+	if (udpx_rx_pool_size > 0) {
+		val = 1;
+		ep->rx_gro = !setsockopt(ep->sock, SOL_UDP, UDP_GRO,
+					 &val, sizeof(val));
+		if (ep->rx_gro)
+			ep->rx_buf_size = UDPX_GSO_MAX_SIZE;
+	}
+#endif
+	FI_INFO(&udpx_prov, FI_LOG_EP_CTRL, "GSO %s, GRO %s\n",
+		ep->tx_gso ? "enabled" : "disabled",
+		ep->rx_gro ? "enabled" : "disabled");
+	(void) val;
+}
+
+static int udpx_ep_init_rx_pool(struct udpx_ep *ep)
+{
+	size_t i;
+
+	ep->rx_pool = udpx_rx_pool_create(udpx_rx_pool_size);
+	if (!ep->rx_pool)
+		return -FI_ENOMEM;
+
+	ep->rx_pool_mem = calloc(ep->rx_pool->size, ep->rx_buf_size);
+	if (!ep->rx_pool_mem) {
+		udpx_rx_pool_free(ep->rx_pool);
+		ep->rx_pool = NULL;
+		return -FI_ENOMEM;
+	}
+
+	for (i = 0; i < ep->rx_pool->size; i++) {
+		ep->rx_pool->buf[i].data = (char *) ep->rx_pool_mem +
+					   i * ep->rx_buf_size;
+	}
+	return 0;
+}
+
+static int udpx_ep_init(struct udpx_ep *ep, struct fi_info *info,
+			uint64_t flags)
 {
-	int family;
+	int family, val;
 	int ret;
 
 	ofi_atomic_initialize32(&ep->ref, 0);
+	ep->rx_buf_size = info->ep_attr->max_msg_size;
+	ep->min_multi_recv = ep->rx_buf_size;
 	ep->rxq = udpx_rx_cirq_create(info->rx_attr->size);
 	if (!ep->rxq) {
 		ret = -FI_ENOMEM;
@@ -728,6 +1308,26 @@ static int udpx_ep_init(struct udpx_ep *ep, struct fi_info *info)
 		goto err1;
 	}
 
+	if (flags & UDPX_EP_REUSEPORT) {
+		val = 1;
+		ret = setsockopt(ep->sock, SOL_SOCKET, SO_REUSEPORT,
+				 &val, sizeof(val));
+		if (ret) {
+			FI_WARN(&udpx_prov, FI_LOG_EP_CTRL,
+				"SO_REUSEPORT %d (%s)\n", errno,
+				strerror(errno));
+			ret = -errno;
+			goto err2;
+		}
+	}
+
+	udpx_ep_init_offload(ep);
+	if (udpx_rx_pool_size > 0) {
+		ret = udpx_ep_init_rx_pool(ep);
+		if (ret)
+			goto err2;
+	}
+
 	if (info->src_addr) {
 		ret = udpx_setname(&ep->util_ep.ep_fid.fid, info->src_addr,
 				   info->src_addrlen);
@@ -743,12 +1343,16 @@ static int udpx_ep_init(struct udpx_ep *ep, struct fi_info *info)
 err2:
 	ofi_close_socket(ep->sock);
 err1:
+	if (ep->rx_pool) {
+		udpx_rx_pool_free(ep->rx_pool);
+		free(ep->rx_pool_mem);
+	}
 	udpx_rx_cirq_free(ep->rxq);
 	return ret;
 }
 
-int udpx_endpoint(struct fid_domain *domain, struct fi_info *info,
-		  struct fid_ep **ep_fid, void *context)
+int udpx_ep_open(struct fid_domain *domain, struct fi_info *info,
+		 uint64_t flags, struct udpx_ep **udp_ep, void *context)
 {
 	struct udpx_ep *ep;
 	int ret;
@@ -762,21 +1366,35 @@ int udpx_endpoint(struct fid_domain *domain, struct fi_info *info,
 	if (ret)
 		goto err;
 
-	ret = udpx_ep_init(ep, info);
+	ret = udpx_ep_init(ep, info, flags);
 	if (ret) {
 		free(ep);
 		return ret;
 	}
 
-	*ep_fid = &ep->util_ep.ep_fid;
-	(*ep_fid)->fid.ops = &udpx_ep_fi_ops;
-	(*ep_fid)->ops = &udpx_ep_ops;
-	(*ep_fid)->cm = &udpx_cm_ops;
-	(*ep_fid)->msg = (info->tx_attr->op_flags & FI_MULTICAST) ?
-			 &udpx_msg_mcast_ops : &udpx_msg_ops;
+	ep->util_ep.ep_fid.fid.ops = &udpx_ep_fi_ops;
+	ep->util_ep.ep_fid.ops = &udpx_ep_ops;
+	ep->util_ep.ep_fid.cm = &udpx_cm_ops;
+	ep->util_ep.ep_fid.msg = (info->tx_attr->op_flags & FI_MULTICAST) ?
+				 &udpx_msg_mcast_ops : &udpx_msg_ops;
 
+	*udp_ep = ep;
 	return 0;
 err:
 	free(ep);
 	return ret;
 }
+
+int udpx_endpoint(struct fid_domain *domain, struct fi_info *info,
+		  struct fid_ep **ep_fid, void *context)
+{
+	struct udpx_ep *ep;
+	int ret;
+
+	ret = udpx_ep_open(domain, info, 0, &ep, context);
+	if (ret)
+		return ret;
+
+	*ep_fid = &ep->util_ep.ep_fid;
+	return 0;
+}
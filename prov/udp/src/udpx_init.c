@@ -39,6 +39,8 @@
 #include <ifaddrs.h>
 #include <net/if.h>
 
+int udpx_rx_pool_size = 0;
+int udpx_incoming_cpu = 0;
 
 #if HAVE_GETIFADDRS
 static void udpx_getinfo_ifs(struct fi_info **info)
@@ -143,5 +145,15 @@ struct fi_provider udpx_prov = {
 
 UDP_INI
 {
+	fi_param_define(&udpx_prov, "rx_pool_size", FI_PARAM_INT,
+			"Number of provider owned buffers used to stage "
+			"datagrams that arrive while no receive is posted "
+			"(default: 0, disabled)");
+	fi_param_get_int(&udpx_prov, "rx_pool_size", &udpx_rx_pool_size);
+	fi_param_define(&udpx_prov, "incoming_cpu", FI_PARAM_BOOL,
+			"Steer flows for scalable endpoint receive context i "
+			"to CPU i using SO_INCOMING_CPU (default: no)");
+	fi_param_get_bool(&udpx_prov, "incoming_cpu", &udpx_incoming_cpu);
+
 	return &udpx_prov;
 }
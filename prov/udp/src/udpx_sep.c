@@ -0,0 +1,321 @@
+/*
+ * Copyright (c) 2017 Intel Corporation, Inc.  All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "udpx.h"
+
+
+static void udpx_sep_free_ctx(struct udpx_sep *sep)
+{
+	size_t i;
+
+	for (i = 0; i < sep->ctx_cnt; i++) {
+		if (sep->ctx[i] && !udpx_ep_free(sep->ctx[i]))
+			sep->ctx[i] = NULL;
+	}
+}
+
+static int udpx_sep_close(struct fid *fid)
+{
+	struct udpx_sep *sep;
+	size_t i;
+
+	sep = container_of(fid, struct udpx_sep, ep_fid.fid);
+	fastlock_acquire(&sep->lock);
+	for (i = 0; i < sep->ctx_cnt; i++) {
+		if (sep->ctx[i] && sep->ctx[i]->ctx_ref) {
+			fastlock_release(&sep->lock);
+			FI_WARN(&udpx_prov, FI_LOG_EP_CTRL,
+				"context %zu still open\n", i);
+			return -FI_EBUSY;
+		}
+	}
+	fastlock_release(&sep->lock);
+
+	udpx_sep_free_ctx(sep);
+	for (i = 0; i < sep->ctx_cnt; i++) {
+		if (sep->ctx[i])
+			return -FI_EBUSY;
+	}
+
+	fastlock_destroy(&sep->lock);
+	free(sep->ctx);
+	free(sep);
+	return 0;
+}
+
+static int udpx_sep_bind(struct fid *fid, struct fid *bfid, uint64_t flags)
+{
+	struct udpx_sep *sep;
+	size_t i;
+	int ret;
+
+	sep = container_of(fid, struct udpx_sep, ep_fid.fid);
+	switch (bfid->fclass) {
+	case FI_CLASS_AV:
+	case FI_CLASS_EQ:
+		for (i = 0; i < sep->ctx_cnt; i++) {
+			ret = fi_ep_bind(&sep->ctx[i]->util_ep.ep_fid, bfid,
+					 flags);
+			if (ret)
+				return ret;
+		}
+		return 0;
+	default:
+		FI_WARN(&udpx_prov, FI_LOG_EP_CTRL,
+			"CQs must be bound to the contexts\n");
+		return -FI_EINVAL;
+	}
+}
+
+static int udpx_sep_control(struct fid *fid, int command, void *arg)
+{
+	switch (command) {
+	case FI_ENABLE:
+		/* Each transmit and receive context is enabled separately */
+		return 0;
+	default:
+		return -FI_ENOSYS;
+	}
+}
+
+static struct fi_ops udpx_sep_fi_ops = {
+	.size = sizeof(struct fi_ops),
+	.close = udpx_sep_close,
+	.bind = udpx_sep_bind,
+	.control = udpx_sep_control,
+	.ops_open = fi_no_ops_open,
+};
+
+static int udpx_sep_get_ctx(struct udpx_sep *sep, int index,
+			    struct fid_ep **ctx_ep, void *context)
+{
+	struct udpx_ep *ep;
+
+	fastlock_acquire(&sep->lock);
+	ep = sep->ctx[index];
+	ep->ctx_ref++;
+	ep->util_ep.ep_fid.fid.context = context;
+	fastlock_release(&sep->lock);
+
+	*ctx_ep = &ep->util_ep.ep_fid;
+	return 0;
+}
+
+static int udpx_sep_tx_ctx(struct fid_ep *ep, int index,
+			   struct fi_tx_attr *attr, struct fid_ep **tx_ep,
+			   void *context)
+{
+	struct udpx_sep *sep;
+
+	sep = container_of(ep, struct udpx_sep, ep_fid);
+	if (index < 0 || (size_t) index >= sep->tx_ctx_cnt)
+		return -FI_EINVAL;
+
+	return udpx_sep_get_ctx(sep, index, tx_ep, context);
+}
+
+static int udpx_sep_rx_ctx(struct fid_ep *ep, int index,
+			   struct fi_rx_attr *attr, struct fid_ep **rx_ep,
+			   void *context)
+{
+	struct udpx_sep *sep;
+
+	sep = container_of(ep, struct udpx_sep, ep_fid);
+	if (index < 0 || (size_t) index >= sep->rx_ctx_cnt)
+		return -FI_EINVAL;
+
+	return udpx_sep_get_ctx(sep, index, rx_ep, context);
+}
+
+static struct fi_ops_ep udpx_sep_ops = {
+	.size = sizeof(struct fi_ops_ep),
+	.cancel = fi_no_cancel,
+	.getopt = fi_no_getopt,
+	.setopt = fi_no_setopt,
+	.tx_ctx = udpx_sep_tx_ctx,
+	.rx_ctx = udpx_sep_rx_ctx,
+	.rx_size_left = fi_no_rx_size_left,
+	.tx_size_left = fi_no_tx_size_left,
+};
+
+/* All contexts share the address of the first one */
+static int udpx_sep_getname(fid_t fid, void *addr, size_t *addrlen)
+{
+	struct udpx_sep *sep;
+
+	sep = container_of(fid, struct udpx_sep, ep_fid.fid);
+	return udpx_getname(&sep->ctx[0]->util_ep.ep_fid.fid, addr, addrlen);
+}
+
+static struct fi_ops_cm udpx_sep_cm = {
+	.size = sizeof(struct fi_ops_cm),
+	.setname = fi_no_setname,
+	.getname = udpx_sep_getname,
+	.getpeer = fi_no_getpeer,
+	.connect = fi_no_connect,
+	.listen = fi_no_listen,
+	.accept = fi_no_accept,
+	.reject = fi_no_reject,
+	.shutdown = fi_no_shutdown,
+	.join = fi_no_join,
+};
+
+static void udpx_sep_set_cpu(struct udpx_ep *ep, int cpu)
+{
+#ifdef SO_INCOMING_CPU
+	if (setsockopt(ep->sock, SOL_SOCKET, SO_INCOMING_CPU,
+		       &cpu, sizeof(cpu))) {
+		FI_WARN(&udpx_prov, FI_LOG_EP_CTRL,
+			"SO_INCOMING_CPU %d (%s)\n", errno, strerror(errno));
+	}
+#endif
+}
+
+/*
+ * The first context picks the address, either the one requested by the
+ * application or a default one, and the remaining contexts join it.
+ */
+static int udpx_sep_open_ctx(struct udpx_sep *sep, struct fi_info *info,
+			     void *context)
+{
+	struct sockaddr_storage addr;
+	struct fi_info *ctx_info;
+	size_t i, addrlen;
+	int ret;
+
+	ctx_info = fi_dupinfo(info);
+	if (!ctx_info)
+		return -FI_ENOMEM;
+
+	ctx_info->ep_attr->tx_ctx_cnt = 1;
+	ctx_info->ep_attr->rx_ctx_cnt = 1;
+
+	for (i = 0; i < sep->ctx_cnt; i++) {
+		ret = udpx_ep_open(&sep->domain->domain_fid, ctx_info,
+				   UDPX_EP_REUSEPORT, &sep->ctx[i], context);
+		if (ret)
+			goto out;
+
+		sep->ctx[i]->sep = sep;
+		if (udpx_incoming_cpu)
+			udpx_sep_set_cpu(sep->ctx[i], (int) i);
+
+		if (i)
+			continue;
+
+		if (!sep->ctx[0]->is_bound) {
+			udpx_bind_src_addr(sep->ctx[0]);
+			if (!sep->ctx[0]->is_bound) {
+				ret = -FI_EADDRNOTAVAIL;
+				goto out;
+			}
+		}
+
+		addrlen = sizeof addr;
+		ret = udpx_getname(&sep->ctx[0]->util_ep.ep_fid.fid,
+				   &addr, &addrlen);
+		if (ret)
+			goto out;
+
+		free(ctx_info->src_addr);
+		ctx_info->src_addr = mem_dup(&addr, addrlen);
+		if (!ctx_info->src_addr) {
+			ret = -FI_ENOMEM;
+			goto out;
+		}
+		ctx_info->src_addrlen = addrlen;
+	}
+	ret = 0;
+out:
+	fi_freeinfo(ctx_info);
+	return ret;
+}
+
+int udpx_scalable_ep(struct fid_domain *domain, struct fi_info *info,
+		     struct fid_ep **sep_fid, void *context)
+{
+	struct udpx_sep *sep;
+	int ret;
+
+	if (!info || !info->ep_attr || info->ep_attr->type != FI_EP_DGRAM)
+		return -FI_EINVAL;
+
+	sep = calloc(1, sizeof(*sep));
+	if (!sep)
+		return -FI_ENOMEM;
+
+	sep->domain = container_of(domain, struct util_domain, domain_fid);
+	sep->tx_ctx_cnt = info->ep_attr->tx_ctx_cnt ?
+			  info->ep_attr->tx_ctx_cnt : 1;
+	sep->rx_ctx_cnt = info->ep_attr->rx_ctx_cnt ?
+			  info->ep_attr->rx_ctx_cnt : 1;
+	if (sep->tx_ctx_cnt > UDPX_MAX_EP_CTX ||
+	    sep->rx_ctx_cnt > UDPX_MAX_EP_CTX) {
+		FI_WARN(&udpx_prov, FI_LOG_EP_CTRL,
+			"requested context count exceeds supported\n");
+		ret = -FI_EINVAL;
+		goto err1;
+	}
+	sep->ctx_cnt = MAX(sep->tx_ctx_cnt, sep->rx_ctx_cnt);
+
+	sep->ctx = calloc(sep->ctx_cnt, sizeof(*sep->ctx));
+	if (!sep->ctx) {
+		ret = -FI_ENOMEM;
+		goto err1;
+	}
+
+	fastlock_init(&sep->lock);
+	ret = udpx_sep_open_ctx(sep, info, context);
+	if (ret)
+		goto err2;
+
+	sep->ep_fid.fid.fclass = FI_CLASS_SEP;
+	sep->ep_fid.fid.context = context;
+	sep->ep_fid.fid.ops = &udpx_sep_fi_ops;
+	sep->ep_fid.ops = &udpx_sep_ops;
+	sep->ep_fid.cm = &udpx_sep_cm;
+
+	*sep_fid = &sep->ep_fid;
+	return 0;
+
+err2:
+	udpx_sep_free_ctx(sep);
+	fastlock_destroy(&sep->lock);
+	free(sep->ctx);
+err1:
+	free(sep);
+	return ret;
+}
@@ -100,6 +100,117 @@ size_t ofi_datatype_size(enum fi_datatype datatype)
 #define OFI_OP_CSWAP_NE_COMPLEX(type,dst,src,cmp) \
 			if (!ofi_complex_eq_##type(dst,cmp)) (dst) = (src)
 
+/*
+ * Vector versions of the element-wise operations.  The kernels below use
+ * the compiler's generic vector types at the native width of each SIMD
+ * level: 16 bytes for the base level (SSE2 on x86-64, NEON on aarch64),
+ * plus 32 bytes (AVX2) and 64 bytes (AVX-512) on x86, compiled with the
+ * matching target attribute.  ofi_atomic_init() selects the widest level
+ * supported by the CPU.  Each vector operation performs the same IEEE
+ * operation per element as the scalar macro, so results are bit-identical
+ * to the scalar loop.  Complex and long double types stay scalar.
+ */
+int ofi_atomic_isa = OFI_ATOMIC_ISA_BASE;
+
+#if defined(__GNUC__)
+
+#define OFI_DEF_VEC(isa, size, type, bits)				\
+	typedef type ofi_vec_##isa##_##type				\
+		__attribute__((vector_size(size)));			\
+	typedef type ofi_uvec_##isa##_##type				\
+		__attribute__((vector_size(size), aligned(1), may_alias)); \
+	typedef bits ofi_vbits_##isa##_##type				\
+		__attribute__((vector_size(size)));
+
+#define OFI_DEF_VEC_ALL(isa, size)					\
+	OFI_DEF_VEC(isa, size, int8_t, uint8_t)				\
+	OFI_DEF_VEC(isa, size, uint8_t, uint8_t)			\
+	OFI_DEF_VEC(isa, size, int16_t, uint16_t)			\
+	OFI_DEF_VEC(isa, size, uint16_t, uint16_t)			\
+	OFI_DEF_VEC(isa, size, int32_t, uint32_t)			\
+	OFI_DEF_VEC(isa, size, uint32_t, uint32_t)			\
+	OFI_DEF_VEC(isa, size, int64_t, uint64_t)			\
+	OFI_DEF_VEC(isa, size, uint64_t, uint64_t)			\
+	OFI_DEF_VEC(isa, size, float, uint32_t)				\
+	OFI_DEF_VEC(isa, size, double, uint64_t)
+
+#define OFI_VEC_TARGET_base
+OFI_DEF_VEC_ALL(base, 16)
+
+#if HAVE_X86_SIMD_DISPATCH
+#define OFI_VEC_TARGET_avx2	__attribute__((target("avx2")))
+#define OFI_VEC_TARGET_avx512	__attribute__((target("avx512bw")))
+OFI_DEF_VEC_ALL(avx2, 32)
+OFI_DEF_VEC_ALL(avx512, 64)
+#define OFI_VEC_X86(x) x
+#else
+#define OFI_VEC_X86(x)
+#endif
+
+/* Expands to its argument only for types that have a vector type */
+#define OFI_VEC_int8_t(x)	x
+#define OFI_VEC_uint8_t(x)	x
+#define OFI_VEC_int16_t(x)	x
+#define OFI_VEC_uint16_t(x)	x
+#define OFI_VEC_int32_t(x)	x
+#define OFI_VEC_uint32_t(x)	x
+#define OFI_VEC_int64_t(x)	x
+#define OFI_VEC_uint64_t(x)	x
+#define OFI_VEC_float(x)	x
+#define OFI_VEC_double(x)	x
+#define OFI_VEC_long_double(x)
+
+#define OFI_VEC_CNT(isa, type) \
+	(sizeof(ofi_vec_##isa##_##type) / sizeof(type))
+#define OFI_VEC_LOAD(isa, type, ptr) \
+	(*(const ofi_uvec_##isa##_##type *) (ptr))
+#define OFI_VEC_STORE(isa, type, ptr, v) \
+	(*(ofi_uvec_##isa##_##type *) (ptr) = (v))
+
+/* Select b where the comparison mask is set, a elsewhere */
+#define OFI_VEC_BLEND(isa, type, mask, a, b)				\
+	((ofi_vec_##isa##_##type)					\
+	 (((ofi_vbits_##isa##_##type) (a) &				\
+	   ~(ofi_vbits_##isa##_##type) (mask)) |			\
+	  ((ofi_vbits_##isa##_##type) (b) &				\
+	   (ofi_vbits_##isa##_##type) (mask))))
+
+/* Run the widest selected kernel, returning the number of elements done */
+#define OFI_VEC_DISPATCH(func, ...)					\
+	(OFI_VEC_X86(ofi_atomic_isa == OFI_ATOMIC_ISA_AVX512 ?		\
+		     func##_avx512(__VA_ARGS__) :			\
+		     ofi_atomic_isa == OFI_ATOMIC_ISA_AVX2 ?		\
+		     func##_avx2(__VA_ARGS__) :)			\
+	 ofi_atomic_isa >= OFI_ATOMIC_ISA_BASE ?			\
+	 func##_base(__VA_ARGS__) : 0)
+
+#else /* __GNUC__ */
+
+#define OFI_VEC_int8_t(x)
+#define OFI_VEC_uint8_t(x)
+#define OFI_VEC_int16_t(x)
+#define OFI_VEC_uint16_t(x)
+#define OFI_VEC_int32_t(x)
+#define OFI_VEC_uint32_t(x)
+#define OFI_VEC_int64_t(x)
+#define OFI_VEC_uint64_t(x)
+#define OFI_VEC_float(x)
+#define OFI_VEC_double(x)
+#define OFI_VEC_long_double(x)
+
+#endif /* __GNUC__ */
+
+#define OFI_OP_MIN_VEC(isa,type,dst,src) \
+		(dst) = OFI_VEC_BLEND(isa, type, (dst) > (src), dst, src)
+#define OFI_OP_MAX_VEC(isa,type,dst,src) \
+		(dst) = OFI_VEC_BLEND(isa, type, (dst) < (src), dst, src)
+#define OFI_OP_SUM_VEC(isa,type,dst,src)   (dst) += (src)
+#define OFI_OP_PROD_VEC(isa,type,dst,src)  (dst) *= (src)
+#define OFI_OP_BOR_VEC(isa,type,dst,src)   (dst) |= (src)
+#define OFI_OP_BAND_VEC(isa,type,dst,src)  (dst) &= (src)
+#define OFI_OP_BXOR_VEC(isa,type,dst,src)  (dst) ^= (src)
+#define OFI_OP_WRITE_VEC(isa,type,dst,src) (dst) = (src)
+
 
 /********************************
  * ATOMIC TYPE function templates
@@ -107,6 +218,7 @@ size_t ofi_datatype_size(enum fi_datatype datatype)
 
 #define OFI_DEF_NOOP_NAME NULL,
 #define OFI_DEF_NOOP_FUNC
+#define OFI_DEF_NOOP_VEC_FUNC
 
 /*
  * WRITE
@@ -136,6 +248,44 @@ size_t ofi_datatype_size(enum fi_datatype datatype)
 			op(type, d[i], s[i]);				\
 	}
 
+#define OFI_DEF_WRITE_VEC_KERNEL(isa, op, type)				\
+	OFI_VEC_TARGET_##isa static size_t				\
+	ofi_write_vec_## op ##_## type ##_## isa			\
+		(type *d, const type *s, size_t cnt)			\
+	{								\
+		size_t i;						\
+		ofi_vec_##isa##_##type vd, vs;				\
+		for (i = 0; i + OFI_VEC_CNT(isa, type) <= cnt;		\
+		     i += OFI_VEC_CNT(isa, type)) {			\
+			vd = OFI_VEC_LOAD(isa, type, &d[i]);		\
+			vs = OFI_VEC_LOAD(isa, type, &s[i]);		\
+			op##_VEC(isa, type, vd, vs);			\
+			OFI_VEC_STORE(isa, type, &d[i], vd);		\
+		}							\
+		return i;						\
+	}
+
+#define OFI_DEF_WRITE_VEC_KERNELS(op, type)				\
+	OFI_DEF_WRITE_VEC_KERNEL(base, op, type)			\
+	OFI_VEC_X86(OFI_DEF_WRITE_VEC_KERNEL(avx2, op, type)		\
+		    OFI_DEF_WRITE_VEC_KERNEL(avx512, op, type))
+
+#define OFI_DEF_WRITE_VEC_FUNC(op, type)				\
+	OFI_VEC_##type(OFI_DEF_WRITE_VEC_KERNELS(op, type))		\
+	static void ofi_write_## op ##_## type				\
+		(void *dst, const void *src, size_t cnt)		\
+	{								\
+		size_t i = 0;						\
+		type *d = (dst);					\
+		const type *s = (src);					\
+		OFI_VEC_##type(i = OFI_VEC_DISPATCH(			\
+			ofi_write_vec_## op ##_## type, d, s, cnt);)	\
+		for (; i < cnt; i++)					\
+			op(type, d[i], s[i]);				\
+	}
+
+#define OFI_DEF_WRITE_COMPLEX_VEC_FUNC	OFI_DEF_WRITE_COMPLEX_FUNC
+
 /*
  * READ (fetch)
  */
@@ -200,6 +350,48 @@ size_t ofi_datatype_size(enum fi_datatype datatype)
 		}							\
 	}
 
+#define OFI_DEF_READWRITE_VEC_KERNEL(isa, op, type)			\
+	OFI_VEC_TARGET_##isa static size_t				\
+	ofi_readwrite_vec_## op ##_## type ##_## isa			\
+		(type *d, const type *s, type *r, size_t cnt)		\
+	{								\
+		size_t i;						\
+		ofi_vec_##isa##_##type vd, vs;				\
+		for (i = 0; i + OFI_VEC_CNT(isa, type) <= cnt;		\
+		     i += OFI_VEC_CNT(isa, type)) {			\
+			vd = OFI_VEC_LOAD(isa, type, &d[i]);		\
+			vs = OFI_VEC_LOAD(isa, type, &s[i]);		\
+			OFI_VEC_STORE(isa, type, &r[i], vd);		\
+			op##_VEC(isa, type, vd, vs);			\
+			OFI_VEC_STORE(isa, type, &d[i], vd);		\
+		}							\
+		return i;						\
+	}
+
+#define OFI_DEF_READWRITE_VEC_KERNELS(op, type)				\
+	OFI_DEF_READWRITE_VEC_KERNEL(base, op, type)			\
+	OFI_VEC_X86(OFI_DEF_READWRITE_VEC_KERNEL(avx2, op, type)	\
+		    OFI_DEF_READWRITE_VEC_KERNEL(avx512, op, type))
+
+#define OFI_DEF_READWRITE_VEC_FUNC(op, type)				\
+	OFI_VEC_##type(OFI_DEF_READWRITE_VEC_KERNELS(op, type))		\
+	static void ofi_readwrite_## op ##_## type			\
+		(void *dst, const void *src, void *res, size_t cnt)	\
+	{								\
+		size_t i = 0;						\
+		type *d = (dst);					\
+		const type *s = (src);					\
+		type *r = (res);					\
+		OFI_VEC_##type(i = OFI_VEC_DISPATCH(			\
+			ofi_readwrite_vec_## op ##_## type, d, s, r, cnt);) \
+		for (; i < cnt; i++) {					\
+			r[i] = d[i];					\
+			op(type, d[i], s[i]);				\
+		}							\
+	}
+
+#define OFI_DEF_READWRITE_COMPLEX_VEC_FUNC OFI_DEF_READWRITE_COMPLEX_FUNC
+
 /*
  * CSWAP
  */
@@ -249,6 +441,8 @@ size_t ofi_datatype_size(enum fi_datatype datatype)
  * ATOMICTYPE - WRITE, READ, READWRITE, CSWAP, MSWAP
  * FUNCNAME - Define function or simply generate function name
  *            The latter is needed to populate the dispatch table
+ *            VEC_FUNC defines the function with a vector loop for the
+ *            element-wise write and read-write operations
  * op - OFI_OP_XXX function should perform (e.g. OFI_OP_MIN)
  */
 #define OFI_DEFINE_ALL_HANDLERS(ATOMICTYPE, FUNCNAME, op)		\
@@ -304,17 +498,17 @@ size_t ofi_datatype_size(enum fi_datatype datatype)
  * Write dispatch table
  **********************/
 
-OFI_DEFINE_REALNO_HANDLERS(WRITE, FUNC, OFI_OP_MIN)
-OFI_DEFINE_REALNO_HANDLERS(WRITE, FUNC, OFI_OP_MAX)
-OFI_DEFINE_ALL_HANDLERS(WRITE, FUNC, OFI_OP_SUM)
-OFI_DEFINE_ALL_HANDLERS(WRITE, FUNC, OFI_OP_PROD)
+OFI_DEFINE_REALNO_HANDLERS(WRITE, VEC_FUNC, OFI_OP_MIN)
+OFI_DEFINE_REALNO_HANDLERS(WRITE, VEC_FUNC, OFI_OP_MAX)
+OFI_DEFINE_ALL_HANDLERS(WRITE, VEC_FUNC, OFI_OP_SUM)
+OFI_DEFINE_ALL_HANDLERS(WRITE, VEC_FUNC, OFI_OP_PROD)
 OFI_DEFINE_ALL_HANDLERS(WRITE, FUNC, OFI_OP_LOR)
 OFI_DEFINE_ALL_HANDLERS(WRITE, FUNC, OFI_OP_LAND)
-OFI_DEFINE_INT_HANDLERS(WRITE, FUNC, OFI_OP_BOR)
-OFI_DEFINE_INT_HANDLERS(WRITE, FUNC, OFI_OP_BAND)
+OFI_DEFINE_INT_HANDLERS(WRITE, VEC_FUNC, OFI_OP_BOR)
+OFI_DEFINE_INT_HANDLERS(WRITE, VEC_FUNC, OFI_OP_BAND)
 OFI_DEFINE_ALL_HANDLERS(WRITE, FUNC, OFI_OP_LXOR)
-OFI_DEFINE_INT_HANDLERS(WRITE, FUNC, OFI_OP_BXOR)
-OFI_DEFINE_ALL_HANDLERS(WRITE, FUNC, OFI_OP_WRITE)
+OFI_DEFINE_INT_HANDLERS(WRITE, VEC_FUNC, OFI_OP_BXOR)
+OFI_DEFINE_ALL_HANDLERS(WRITE, VEC_FUNC, OFI_OP_WRITE)
 
 void (*ofi_atomic_write_handlers[OFI_WRITE_OP_LAST][FI_DATATYPE_LAST])
 	(void *dst, const void *src, size_t cnt) =
@@ -339,18 +533,18 @@ void (*ofi_atomic_write_handlers[OFI_WRITE_OP_LAST][FI_DATATYPE_LAST])
  * Read-write dispatch table
  ***************************/
 
-OFI_DEFINE_REALNO_HANDLERS(READWRITE, FUNC, OFI_OP_MIN)
-OFI_DEFINE_REALNO_HANDLERS(READWRITE, FUNC, OFI_OP_MAX)
-OFI_DEFINE_ALL_HANDLERS(READWRITE, FUNC, OFI_OP_SUM)
-OFI_DEFINE_ALL_HANDLERS(READWRITE, FUNC, OFI_OP_PROD)
+OFI_DEFINE_REALNO_HANDLERS(READWRITE, VEC_FUNC, OFI_OP_MIN)
+OFI_DEFINE_REALNO_HANDLERS(READWRITE, VEC_FUNC, OFI_OP_MAX)
+OFI_DEFINE_ALL_HANDLERS(READWRITE, VEC_FUNC, OFI_OP_SUM)
+OFI_DEFINE_ALL_HANDLERS(READWRITE, VEC_FUNC, OFI_OP_PROD)
 OFI_DEFINE_ALL_HANDLERS(READWRITE, FUNC, OFI_OP_LOR)
 OFI_DEFINE_ALL_HANDLERS(READWRITE, FUNC, OFI_OP_LAND)
-OFI_DEFINE_INT_HANDLERS(READWRITE, FUNC, OFI_OP_BOR)
-OFI_DEFINE_INT_HANDLERS(READWRITE, FUNC, OFI_OP_BAND)
+OFI_DEFINE_INT_HANDLERS(READWRITE, VEC_FUNC, OFI_OP_BOR)
+OFI_DEFINE_INT_HANDLERS(READWRITE, VEC_FUNC, OFI_OP_BAND)
 OFI_DEFINE_ALL_HANDLERS(READWRITE, FUNC, OFI_OP_LXOR)
-OFI_DEFINE_INT_HANDLERS(READWRITE, FUNC, OFI_OP_BXOR)
+OFI_DEFINE_INT_HANDLERS(READWRITE, VEC_FUNC, OFI_OP_BXOR)
 OFI_DEFINE_ALL_HANDLERS(READ, FUNC, OFI_OP_READ)
-OFI_DEFINE_ALL_HANDLERS(READWRITE, FUNC, OFI_OP_WRITE)
+OFI_DEFINE_ALL_HANDLERS(READWRITE, VEC_FUNC, OFI_OP_WRITE)
 
 void (*ofi_atomic_readwrite_handlers[OFI_READWRITE_OP_LAST][FI_DATATYPE_LAST])
 	(void *dst, const void *src, void *res, size_t cnt) =
@@ -447,3 +641,38 @@ int ofi_atomic_valid(const struct fi_provider *prov,
 
 	return 0;
 }
+
+int ofi_atomic_isa_supported(enum ofi_atomic_isa isa)
+{
+	switch (isa) {
+	case OFI_ATOMIC_ISA_SCALAR:
+		return 1;
+	case OFI_ATOMIC_ISA_BASE:
+#if defined(__GNUC__)
+		return 1;
+#else
+		return 0;
+#endif
+#if HAVE_X86_SIMD_DISPATCH
+	case OFI_ATOMIC_ISA_AVX2:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+	case OFI_ATOMIC_ISA_AVX512:
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx512bw");
+#endif
+	default:
+		return 0;
+	}
+}
+
+void ofi_atomic_init(void)
+{
+	int isa;
+
+	for (isa = OFI_ATOMIC_ISA_AVX512; isa > OFI_ATOMIC_ISA_SCALAR; isa--) {
+		if (ofi_atomic_isa_supported(isa))
+			break;
+	}
+	ofi_atomic_isa = isa;
+}
@@ -49,13 +49,17 @@
 #endif
 
 #include <fi_util.h>
+#include <fasthash.h>
 
 
 enum {
 	UTIL_NO_ENTRY = -1,
 	UTIL_DEFAULT_AV_SIZE = 1024,
+	UTIL_MIN_HASH_SIZE = 64,
 };
 
+#define UTIL_AV_HASH_SEED	0x9e3779b97f4a7c15ULL
+
 
 static int fi_get_src_sockaddr(const struct sockaddr *dest_addr, size_t dest_addrlen,
 			       struct sockaddr **src_addr, size_t *src_addrlen)
@@ -187,6 +191,27 @@ out:
 	return ret;
 }
 
+static int fi_get_str_addr(uint32_t addr_format, const char *node,
+			   void **addr, size_t *addrlen)
+{
+	uint32_t str_format;
+	int ret;
+
+	if (!node)
+		return -FI_ENODATA;
+
+	ret = ofi_str_toaddr(node, &str_format, addr, addrlen);
+	if (ret)
+		return ret;
+
+	if (str_format != addr_format) {
+		free(*addr);
+		*addr = NULL;
+		return -FI_EINVAL;
+	}
+	return 0;
+}
+
 int ofi_get_addr(uint32_t addr_format, uint64_t flags,
 		const char *node, const char *service,
 		void **addr, size_t *addrlen)
@@ -201,14 +226,31 @@ int ofi_get_addr(uint32_t addr_format, uint64_t flags,
 	case FI_SOCKADDR_IN6:
 		return fi_get_sockaddr(AF_INET6, flags, node, service,
 				       (struct sockaddr **) addr, addrlen);
+	case FI_ADDR_DPDK:
+		return fi_get_str_addr(addr_format, node, addr, addrlen);
 	default:
 		return -FI_ENOSYS;
 	}
 }
 
+/*
+ * Chunk 0 holds the first 2^chunk_shift entries; chunk k > 0 holds entries
+ * [2^(chunk_shift + k - 1), 2^(chunk_shift + k)).
+ */
 static void *util_av_get_data(struct util_av *av, int index)
 {
-	return (char *) av->data + (index * av->addrlen);
+	unsigned int hi;
+	int k;
+
+	hi = (unsigned int) index >> av->chunk_shift;
+	if (!hi)
+		return (char *) av->data[0] + (index * av->addrlen);
+
+	for (k = 0; hi; k++)
+		hi >>= 1;
+
+	index -= 1 << (av->chunk_shift + k - 1);
+	return (char *) av->data[k] + (index * av->addrlen);
 }
 
 void *ofi_av_get_addr(struct util_av *av, int index)
@@ -241,105 +283,202 @@ static int fi_verify_av_insert(struct util_av *av, uint64_t flags)
 	return 0;
 }
 
+static uint32_t util_av_hash_addr(struct util_av *av, const void *addr)
+{
+	return (uint32_t) fasthash64(addr, av->addrlen, UTIL_AV_HASH_SEED);
+}
+
+static void util_av_hash_reset(struct util_av_hash_entry *table, size_t size)
+{
+	size_t i;
+
+	for (i = 0; i < size; i++)
+		table[i].index = UTIL_NO_ENTRY;
+}
+
+static void util_av_hash_place(struct util_av_hash *hash, uint32_t key,
+			       int index)
+{
+	size_t i;
+
+	for (i = key & (hash->size - 1); hash->table[i].index != UTIL_NO_ENTRY;
+	     i = (i + 1) & (hash->size - 1))
+		;
+
+	hash->table[i].hash = key;
+	hash->table[i].index = index;
+}
+
 /*
  * Must hold AV lock
  */
-static int util_av_hash_insert(struct util_av_hash *hash, int slot, int index)
+static int util_av_hash_grow(struct util_av *av)
 {
-	int entry, i;
+	struct util_av_hash_entry *old_table;
+	size_t i, old_size;
 
-	if (slot < 0 || slot >= hash->slots)
-		return -FI_EINVAL;
+	old_table = av->hash.table;
+	old_size = av->hash.size;
 
-	if (hash->table[slot].index == UTIL_NO_ENTRY) {
-		hash->table[slot].index = index;
-		return 0;
+	av->hash.table = malloc(old_size * 2 * sizeof(*av->hash.table));
+	if (!av->hash.table) {
+		av->hash.table = old_table;
+		return -FI_ENOMEM;
 	}
 
-	if (hash->free_list == UTIL_NO_ENTRY)
-		return -FI_ENOSPC;
+	av->hash.size = old_size * 2;
+	util_av_hash_reset(av->hash.table, av->hash.size);
+	for (i = 0; i < old_size; i++) {
+		if (old_table[i].index != UTIL_NO_ENTRY)
+			util_av_hash_place(&av->hash, old_table[i].hash,
+					   old_table[i].index);
+	}
 
-	entry = hash->free_list;
-	hash->free_list = hash->table[hash->free_list].next;
+	FI_INFO(av->prov, FI_LOG_AV, "hash size %zu\n", av->hash.size);
+	free(old_table);
+	return 0;
+}
+
+/*
+ * Must hold AV lock
+ */
+static int util_av_hash_insert(struct util_av *av, const void *addr, int index)
+{
+	int ret;
 
-	for (i = slot; hash->table[i].next != UTIL_NO_ENTRY; )
-		i = hash->table[i].next;
+	if ((av->hash.used + 1) * 2 > av->hash.size) {
+		ret = util_av_hash_grow(av);
+		if (ret)
+			return ret;
+	}
 
-	hash->table[i].next = entry;
-	hash->table[entry].index = index;
-	hash->table[entry].next = UTIL_NO_ENTRY;
+	util_av_hash_place(&av->hash, util_av_hash_addr(av, addr), index);
+	av->hash.used++;
 	return 0;
 }
 
 /*
  * Must hold AV lock
  */
-int ofi_av_insert_addr(struct util_av *av, const void *addr, int slot, int *index)
+static ssize_t util_av_hash_find(struct util_av *av, const void *addr,
+				 uint32_t key)
 {
-	int ret;
+	struct util_av_hash_entry *entry;
+	size_t i;
 
-	if (av->free_list == UTIL_NO_ENTRY) {
+	for (i = key & (av->hash.size - 1); ; i = (i + 1) & (av->hash.size - 1)) {
+		entry = &av->hash.table[i];
+		if (entry->index == UTIL_NO_ENTRY)
+			return UTIL_NO_ENTRY;
+		if (entry->hash == key &&
+		    !memcmp(util_av_get_data(av, entry->index), addr,
+			    av->addrlen))
+			return i;
+	}
+}
+
+/*
+ * Must hold AV lock.  Removal shifts later members of the probe sequence
+ * back into the freed slot, so lookups never need tombstones.
+ */
+static void util_av_hash_remove(struct util_av *av, int index)
+{
+	struct util_av_hash *hash = &av->hash;
+	size_t i, j, home, mask = hash->size - 1;
+
+	for (i = util_av_hash_addr(av, util_av_get_data(av, index)) & mask;
+	     hash->table[i].index != index; i = (i + 1) & mask) {
+		if (hash->table[i].index == UTIL_NO_ENTRY)
+			return;
+	}
+
+	for (j = (i + 1) & mask; hash->table[j].index != UTIL_NO_ENTRY;
+	     j = (j + 1) & mask) {
+		home = hash->table[j].hash & mask;
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			hash->table[i] = hash->table[j];
+			i = j;
+		}
+	}
+	hash->table[i].index = UTIL_NO_ENTRY;
+	hash->used--;
+}
+
+/*
+ * Must hold AV lock.  Adds a chunk as large as the current AV and links
+ * its entries into the (empty) free list.
+ */
+static int util_av_grow(struct util_av *av)
+{
+	int k, i, *entry;
+
+	for (k = 0; k < UTIL_AV_MAX_CHUNKS && av->data[k]; k++)
+		;
+
+	if (k == UTIL_AV_MAX_CHUNKS || av->count > INT_MAX / 2) {
 		FI_WARN(av->prov, FI_LOG_AV, "AV is full\n");
 		return -FI_ENOSPC;
 	}
 
-	if (av->flags & FI_SOURCE) {
-		ret = util_av_hash_insert(&av->hash, slot, av->free_list);
-		if (ret) {
-			FI_WARN(av->prov, FI_LOG_AV,
-				"failed to insert addr into hash table\n");
-			return ret;
-		}
+	av->data[k] = malloc(av->count * av->addrlen);
+	if (!av->data[k])
+		return -FI_ENOMEM;
+
+	for (i = (int) av->count; i < (int) av->count * 2 - 1; i++) {
+		entry = util_av_get_data(av, i);
+		*entry = i + 1;
 	}
+	entry = util_av_get_data(av, av->count * 2 - 1);
+	*entry = UTIL_NO_ENTRY;
 
-	*index = av->free_list;
-	av->free_list = *(int *) util_av_get_data(av, av->free_list);
-	util_av_set_data(av, *index, addr, av->addrlen);
+	av->free_list = av->count;
+	av->count *= 2;
+	FI_INFO(av->prov, FI_LOG_AV, "AV size %zu\n", av->count);
 	return 0;
 }
 
 /*
  * Must hold AV lock
  */
-static void util_av_hash_remove(struct util_av_hash *hash, int slot, int index)
+int ofi_av_insert_addr(struct util_av *av, const void *addr, int *index)
 {
-	int i;
+	int ret;
 
-	if (slot < 0 || slot >= hash->slots)
-		return;
+	if (av->free_list == UTIL_NO_ENTRY) {
+		ret = util_av_grow(av);
+		if (ret)
+			return ret;
+	}
 
-	if (slot == index) {
-		if (hash->table[slot].next == UTIL_NO_ENTRY) {
-			hash->table[slot].index = UTIL_NO_ENTRY;
-			return;
-		} else {
-			index = hash->table[slot].next;
-			hash->table[slot] = hash->table[index];
+	if (av->flags & FI_SOURCE) {
+		ret = util_av_hash_insert(av, addr, av->free_list);
+		if (ret) {
+			FI_WARN(av->prov, FI_LOG_AV,
+				"failed to insert addr into hash table\n");
+			return ret;
 		}
-	} else {
-		for (i = slot; hash->table[i].next != index; )
-			i = hash->table[i].next;
-
-		hash->table[i].next = hash->table[index].next;
 	}
-	hash->table[index].next = hash->free_list;
-	hash->free_list = index;
+
+	*index = av->free_list;
+	av->free_list = *(int *) util_av_get_data(av, av->free_list);
+	util_av_set_data(av, *index, addr, av->addrlen);
+	return 0;
 }
 
-int ofi_av_remove_addr(struct util_av *av, int slot, int index)
+int ofi_av_remove_addr(struct util_av *av, int index)
 {
 	struct util_ep *ep;
 	struct dlist_entry *av_entry;
 	int *entry, *next, i;
 
-	if (index < 0 || (size_t)index > av->count) {
+	if (index < 0 || (size_t)index >= av->count) {
 		FI_WARN(av->prov, FI_LOG_AV, "index out of range\n");
 		return -FI_EINVAL;
 	}
 
 	fastlock_acquire(&av->lock);
 	if (av->flags & FI_SOURCE)
-		util_av_hash_remove(&av->hash, slot, index);
+		util_av_hash_remove(av, index);
 
 	entry = util_av_get_data(av, index);
 	if (av->free_list == UTIL_NO_ENTRY || index < av->free_list) {
@@ -358,37 +497,29 @@ int ofi_av_remove_addr(struct util_av *av, int slot, int index)
 	dlist_foreach(&av->ep_list, av_entry) {
 		ep = container_of(av_entry, struct util_ep, av_entry);
 		if (ep->cmap)
-			ofi_cmap_del_handle(ep->cmap->handles_av[index]);
+			ofi_cmap_del_handle_av(ep->cmap, index);
 	}
 
 	fastlock_release(&av->lock);
 	return 0;
 }
 
-int ofi_av_lookup_index(struct util_av *av, const void *addr, int slot)
+int ofi_av_lookup_index(struct util_av *av, const void *addr)
 {
-	int i, ret = -FI_ENODATA;
+	ssize_t i;
+	int ret = -FI_ENODATA;
 
-	if (slot < 0 || slot >= av->hash.slots) {
-		FI_WARN(av->prov, FI_LOG_AV, "invalid slot (%d)\n", slot);
+	if (!(av->flags & FI_SOURCE)) {
+		FI_WARN(av->prov, FI_LOG_AV, "AV not opened for FI_SOURCE\n");
 		return -FI_EINVAL;
 	}
 
 	fastlock_acquire(&av->lock);
-	if (av->hash.table[slot].index == UTIL_NO_ENTRY) {
-		FI_DBG(av->prov, FI_LOG_AV, "no entry at slot (%d)\n", slot);
-		goto out;
+	i = util_av_hash_find(av, addr, util_av_hash_addr(av, addr));
+	if (i != UTIL_NO_ENTRY) {
+		ret = av->hash.table[i].index;
+		FI_DBG(av->prov, FI_LOG_AV, "entry at index (%d)\n", ret);
 	}
-
-	for (i = slot; i != UTIL_NO_ENTRY; i = av->hash.table[i].next) {
-		if (!memcmp(ofi_av_get_addr(av, av->hash.table[i].index), addr,
-			    av->addrlen)) {
-			ret = av->hash.table[i].index;
-			FI_DBG(av->prov, FI_LOG_AV, "entry at index (%d)\n", ret);
-			break;
-		}
-	}
-out:
 	FI_DBG(av->prov, FI_LOG_AV, "%d\n", ret);
 	fastlock_release(&av->lock);
 	return ret;
@@ -418,6 +549,8 @@ int ofi_av_bind(struct fid *av_fid, struct fid *eq_fid, uint64_t flags)
 
 int ofi_av_close(struct util_av *av)
 {
+	int k;
+
 	if (ofi_atomic_get32(&av->ref)) {
 		FI_WARN(av->prov, FI_LOG_AV, "AV is busy\n");
 		return -FI_EBUSY;
@@ -429,27 +562,12 @@ int ofi_av_close(struct util_av *av)
 	ofi_atomic_dec32(&av->domain->ref);
 	fastlock_destroy(&av->lock);
 	/* TODO: unmap data? */
-	free(av->data);
+	for (k = 0; k < UTIL_AV_MAX_CHUNKS && av->data[k]; k++)
+		free(av->data[k]);
+	free(av->hash.table);
 	return 0;
 }
 
-static void util_av_hash_init(struct util_av_hash *hash)
-{
-	int i;
-
-	for (i = 0; i < hash->slots; i++) {
-		hash->table[i].index = UTIL_NO_ENTRY;
-		hash->table[i].next = UTIL_NO_ENTRY;
-	}
-
-	hash->free_list = hash->slots;
-	for (i = hash->slots; i < hash->total_count; i++) {
-		hash->table[i].index = UTIL_NO_ENTRY;
-		hash->table[i].next = i + 1;
-	}
-	hash->table[hash->total_count - 1].next = UTIL_NO_ENTRY;
-}
-
 static int util_av_init(struct util_av *av, const struct fi_av_attr *attr,
 			const struct util_av_attr *util_attr)
 {
@@ -467,16 +585,13 @@ static int util_av_init(struct util_av *av, const struct fi_av_attr *attr,
 	/* TODO: Handle FI_READ */
 	/* TODO: Handle mmap - shared AV */
 
-	if (util_attr->flags & FI_SOURCE) {
-		av->hash.slots = av->count;
-		av->hash.total_count = av->count + util_attr->overhead;
-		FI_INFO(av->prov, FI_LOG_AV,
-		       "FI_SOURCE requested, hash size %zu\n", av->hash.total_count);
-	}
+	for (av->chunk_shift = 0; ((size_t) 1 << av->chunk_shift) < av->count;
+	     av->chunk_shift++)
+		;
 
-	av->data = malloc((av->count * util_attr->addrlen) +
-			  (av->hash.total_count * sizeof(*av->hash.table)));
-	if (!av->data)
+	memset(av->data, 0, sizeof(av->data));
+	av->data[0] = malloc(av->count * util_attr->addrlen);
+	if (!av->data[0])
 		return -FI_ENOMEM;
 
 	for (i = 0; i < (int)av->count - 1; i++) {
@@ -487,8 +602,18 @@ static int util_av_init(struct util_av *av, const struct fi_av_attr *attr,
 	*entry = UTIL_NO_ENTRY;
 
 	if (util_attr->flags & FI_SOURCE) {
-		av->hash.table = util_av_get_data(av, av->count);
-		util_av_hash_init(&av->hash);
+		av->hash.size = MAX(roundup_power_of_two(av->count * 2),
+				    UTIL_MIN_HASH_SIZE);
+		av->hash.used = 0;
+		av->hash.table = malloc(av->hash.size *
+					sizeof(*av->hash.table));
+		if (!av->hash.table) {
+			free(av->data[0]);
+			return -FI_ENOMEM;
+		}
+		util_av_hash_reset(av->hash.table, av->hash.size);
+		FI_INFO(av->prov, FI_LOG_AV,
+		       "FI_SOURCE requested, hash size %zu\n", av->hash.size);
 	}
 
 	return ret;
@@ -565,39 +690,9 @@ int ofi_av_init(struct util_domain *domain, const struct fi_av_attr *attr,
  *
  *************************************************************************/
 
-static int ip_av_slot(struct util_av *av, const struct sockaddr *sa)
-{
-	uint32_t host;
-	uint16_t port;
-
-	if (!sa)
-		return UTIL_NO_ENTRY;
-
-	switch (((struct sockaddr *) sa)->sa_family) {
-	case AF_INET:
-		host = (uint16_t) ntohl(((struct sockaddr_in *) sa)->
-					sin_addr.s_addr);
-		port = ntohs(((struct sockaddr_in *) sa)->sin_port);
-		break;
-	case AF_INET6:
-		host = (uint16_t) ((struct sockaddr_in6 *) sa)->
-					sin6_addr.s6_addr[15];
-		port = ntohs(((struct sockaddr_in6 *) sa)->sin6_port);
-		break;
-	default:
-		assert(0);
-		return UTIL_NO_ENTRY;
-	}
-
-	/* TODO: Find a good hash function */
-	FI_DBG(av->prov, FI_LOG_AV, "slot %d\n",
-		((host << 16) | port) % av->hash.slots);
-	return ((host << 16) | port) % av->hash.slots;
-}
-
 int ip_av_get_index(struct util_av *av, const void *addr)
 {
-	return ofi_av_lookup_index(av, addr, ip_av_slot(av, addr));
+	return ofi_av_lookup_index(av, addr);
 }
 
 void ofi_av_write_event(struct util_av *av, uint64_t data,
@@ -652,7 +747,7 @@ static int ip_av_insert_addr(struct util_av *av, const void *addr,
 
 	if (ip_av_valid_addr(av, addr)) {
 		fastlock_acquire(&av->lock);
-		ret = ofi_av_insert_addr(av, addr, ip_av_slot(av, addr), &index);
+		ret = ofi_av_insert_addr(av, addr, &index);
 		fastlock_release(&av->lock);
 	} else {
 		ret = -FI_EADDRNOTAVAIL;
@@ -902,7 +997,7 @@ static int ip_av_remove(struct fid_av *av_fid, fi_addr_t *fi_addr, size_t count,
 			uint64_t flags)
 {
 	struct util_av *av;
-	int i, slot, index, ret;
+	int i, index, ret;
 
 	av = container_of(av_fid, struct util_av, av_fid);
 	if (flags) {
@@ -918,8 +1013,7 @@ static int ip_av_remove(struct fid_av *av_fid, fi_addr_t *fi_addr, size_t count,
 	 */
 	for (i = count - 1; i >= 0; i--) {
 		index = (int) fi_addr[i];
-		slot = ip_av_slot(av, ip_av_get_addr(av, index));
-		ret = ofi_av_remove_addr(av, slot, index);
+		ret = ofi_av_remove_addr(av, index);
 		if (ret) {
 			FI_WARN(av->prov, FI_LOG_AV,
 				"removal of fi_addr %d failed\n", index);
@@ -936,7 +1030,7 @@ static int ip_av_lookup(struct fid_av *av_fid, fi_addr_t fi_addr, void *addr,
 
 	av = container_of(av_fid, struct util_av, av_fid);
 	index = (int) fi_addr;
-	if (index < 0 || (size_t)index > av->count) {
+	if (index < 0 || (size_t)index >= av->count) {
 		FI_WARN(av->prov, FI_LOG_AV, "unknown address\n");
 		return -FI_EINVAL;
 	}
@@ -998,7 +1092,6 @@ int ip_av_create(struct fid_domain *domain_fid, struct fi_av_attr *attr,
 	else
 		util_attr.addrlen = sizeof(struct sockaddr_in6);
 
-	util_attr.overhead = attr->count >> 1;
 	util_attr.flags = domain->info_domain_caps & FI_SOURCE ? FI_SOURCE : 0;
 
 	if (attr->type == FI_AV_UNSPEC)
@@ -1069,6 +1162,9 @@ static void ofi_cmap_init_handle(struct util_cmap_handle *handle,
 	util_cmap_set_key(handle);
 	handle->fi_addr = fi_addr;
 	handle->peer = peer;
+	dlist_init(&handle->lru_entry);
+	handle->evict_state = CMAP_EVICT_NONE;
+	cmap->handle_cnt++;
 }
 
 static int ofi_cmap_match_peer(struct dlist_entry *entry, const void *addr)
@@ -1092,8 +1188,12 @@ static int util_cmap_del_handle(struct util_cmap_handle *handle)
 		handle->peer = NULL;
 	} else {
 		cmap->handles_av[handle->fi_addr] = 0;
+		if (handle->state == CMAP_EVICTING)
+			cmap->evicted_av[handle->fi_addr] = 1;
 	}
 	util_cmap_clear_key(handle);
+	dlist_remove(&handle->lru_entry);
+	cmap->handle_cnt--;
 
 	handle->state = CMAP_SHUTDOWN;
 	handle->cmap->attr.close(handle);
@@ -1118,17 +1218,63 @@ void ofi_cmap_del_handle(struct util_cmap_handle *handle)
 	fastlock_release(&cmap->lock);
 }
 
+/* handles_av may be reallocated, so it is only read under cmap->lock */
+void ofi_cmap_del_handle_av(struct util_cmap *cmap, fi_addr_t fi_addr)
+{
+	fastlock_acquire(&cmap->lock);
+	if (fi_addr < cmap->handles_av_cnt) {
+		if (cmap->handles_av[fi_addr])
+			util_cmap_del_handle(cmap->handles_av[fi_addr]);
+		/* The index may be reused for a different peer */
+		cmap->evicted_av[fi_addr] = 0;
+	}
+	fastlock_release(&cmap->lock);
+}
+
+/* Caller must hold cmap->lock */
+static int util_cmap_grow_handles_av(struct util_cmap *cmap, fi_addr_t fi_addr)
+{
+	struct util_cmap_handle **handles;
+	uint8_t *evicted;
+	size_t count = cmap->av->count;
+
+	if (fi_addr < cmap->handles_av_cnt)
+		return 0;
+
+	handles = realloc(cmap->handles_av, count * sizeof(*handles));
+	if (!handles)
+		return -FI_ENOMEM;
+	cmap->handles_av = handles;
+
+	evicted = realloc(cmap->evicted_av, count);
+	if (!evicted)
+		return -FI_ENOMEM;
+	cmap->evicted_av = evicted;
+
+	memset(&handles[cmap->handles_av_cnt], 0,
+	       (count - cmap->handles_av_cnt) * sizeof(*handles));
+	memset(&evicted[cmap->handles_av_cnt], 0,
+	       count - cmap->handles_av_cnt);
+	cmap->handles_av_cnt = count;
+	return 0;
+}
+
 /* Caller must hold cmap->lock */
 static int util_cmap_alloc_handle(struct util_cmap *cmap, fi_addr_t fi_addr,
 				  enum util_cmap_state state,
 				  struct util_cmap_handle **handle)
 {
+	if (util_cmap_grow_handles_av(cmap, fi_addr))
+		return -FI_ENOMEM;
+
 	*handle = cmap->attr.alloc();
 	if (!*handle)
 		return -FI_ENOMEM;
 	FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL, "Allocated new handle: %p for "
 	       "fi_addr: %" PRIu64 "\n", *handle, fi_addr);
 	ofi_cmap_init_handle(*handle, cmap, state, fi_addr, NULL);
+	(*handle)->reconnect = cmap->evicted_av[fi_addr];
+	cmap->evicted_av[fi_addr] = 0;
 	cmap->handles_av[fi_addr] = *handle;
 	return 0;
 }
@@ -1179,10 +1325,13 @@ util_cmap_get_handle(struct util_cmap *cmap, fi_addr_t fi_addr, void *addr)
 {
 	struct util_cmap_handle *handle;
 
-	if (fi_addr > cmap->av->count) {
+	if (fi_addr >= cmap->av->count) {
 		FI_WARN(cmap->av->prov, FI_LOG_EP_CTRL, "Invalid fi_addr\n");
 		return NULL;
 	}
+	if (util_cmap_grow_handles_av(cmap, fi_addr))
+		return NULL;
+
 	if (cmap->handles_av[fi_addr]) {
 		handle = cmap->handles_av[fi_addr];
 	} else {
@@ -1198,6 +1347,130 @@ util_cmap_get_handle(struct util_cmap *cmap, fi_addr_t fi_addr, void *addr)
 	return handle;
 }
 
+/* Caller must hold cmap->lock.  Evictions are rare, so the least recently
+ * used idle handle is searched for here rather than kept in order on every
+ * send. */
+static void util_cmap_evict_lru(struct util_cmap *cmap)
+{
+	struct util_cmap_handle *handle, *lru = NULL;
+	struct dlist_entry *entry;
+
+	if (!cmap->attr.max_conn || cmap->handle_cnt < cmap->attr.max_conn)
+		return;
+
+	dlist_foreach(&cmap->lru_list, entry) {
+		handle = container_of(entry, struct util_cmap_handle, lru_entry);
+		assert(handle->state == CMAP_CONNECTED);
+		if ((!lru || handle->last_use < lru->last_use) &&
+		    cmap->attr.idle(handle))
+			lru = handle;
+	}
+
+	if (!lru) {
+		FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL,
+		       "No idle connection to evict, exceeding connection cap\n");
+		return;
+	}
+	if (cmap->attr.evict_req(lru)) {
+		FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL,
+		       "Unable to request eviction, exceeding connection cap\n");
+		return;
+	}
+
+	FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL, "Evicting handle: %p\n", lru);
+	dlist_remove(&lru->lru_entry);
+	dlist_insert_tail(&lru->lru_entry, &cmap->evict_list);
+	lru->state = CMAP_EVICTING;
+	lru->evict_state = CMAP_EVICT_REQ_SENT;
+	cmap->stats.evictions++;
+}
+
+/* Caller must hold cmap->lock */
+static void util_cmap_evict_progress(struct util_cmap_handle *handle)
+{
+	struct util_cmap *cmap = handle->cmap;
+
+	if (handle->state != CMAP_EVICTING || !cmap->attr.idle(handle))
+		return;
+
+	switch (handle->evict_state) {
+	case CMAP_EVICT_ACK_PENDING:
+		if (cmap->attr.evict_ack(handle)) {
+			FI_WARN(cmap->av->prov, FI_LOG_EP_CTRL,
+				"Unable to ack connection eviction\n");
+			break;
+		}
+		handle->evict_state = CMAP_EVICT_ACK_SENT;
+		break;
+	case CMAP_EVICT_CLOSE_PENDING:
+		util_cmap_del_handle(handle);
+		break;
+	default:
+		break;
+	}
+}
+
+void ofi_cmap_process_evict_req(struct util_cmap *cmap,
+				struct util_cmap_handle *handle)
+{
+	FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL,
+	       "Processing eviction request for handle: %p\n", handle);
+	fastlock_acquire(&cmap->lock);
+	switch (handle->state) {
+	case CMAP_CONNECTED:
+		dlist_remove(&handle->lru_entry);
+		dlist_insert_tail(&handle->lru_entry, &cmap->evict_list);
+		handle->state = CMAP_EVICTING;
+		cmap->stats.remote_evictions++;
+		/* fall through */
+	case CMAP_EVICTING:
+		/* Both sides may evict at the same time, each acks the other */
+		if (handle->evict_state != CMAP_EVICT_CLOSE_PENDING)
+			handle->evict_state = CMAP_EVICT_ACK_PENDING;
+		util_cmap_evict_progress(handle);
+		break;
+	default:
+		FI_WARN(cmap->av->prov, FI_LOG_EP_CTRL, "Invalid cmap state: "
+			"%d when receiving eviction request\n", handle->state);
+	}
+	fastlock_release(&cmap->lock);
+}
+
+void ofi_cmap_process_evict_ack(struct util_cmap *cmap,
+				struct util_cmap_handle *handle)
+{
+	FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL,
+	       "Processing eviction ack for handle: %p\n", handle);
+	fastlock_acquire(&cmap->lock);
+	if (handle->state == CMAP_EVICTING) {
+		handle->evict_state = CMAP_EVICT_CLOSE_PENDING;
+		util_cmap_evict_progress(handle);
+	} else {
+		FI_WARN(cmap->av->prov, FI_LOG_EP_CTRL, "Invalid cmap state: "
+			"%d when receiving eviction ack\n", handle->state);
+	}
+	fastlock_release(&cmap->lock);
+}
+
+/* Called from the provider's progress while evict_list is not empty.  An
+ * evicting handle waits for its operations in flight to complete, and the
+ * provider may free a handle as soon as its last one completes, so idle
+ * handles are picked up here rather than signaled on completion. */
+void ofi_cmap_progress_evict(struct util_cmap *cmap)
+{
+	struct util_cmap_handle *handle;
+	struct dlist_entry *entry, *next;
+
+	fastlock_acquire(&cmap->lock);
+	for (entry = cmap->evict_list.next; entry != &cmap->evict_list;
+	     entry = next) {
+		next = entry->next;
+		handle = container_of(entry, struct util_cmap_handle, lru_entry);
+		util_cmap_evict_progress(handle);
+	}
+	fastlock_release(&cmap->lock);
+}
+
 void ofi_cmap_process_shutdown(struct util_cmap *cmap,
 			       struct util_cmap_handle *handle)
 {
@@ -1220,12 +1493,28 @@ void ofi_cmap_process_connect(struct util_cmap *cmap,
 			      struct util_cmap_handle *handle,
 			      uint64_t *remote_key)
 {
+	uint64_t elapsed;
+
 	FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL,
 		"Processing connect for handle: %p\n", handle);
 	fastlock_acquire(&cmap->lock);
+	if (handle->state == CMAP_CONNREQ_SENT) {
+		elapsed = fi_gettime_us() - handle->connect_start;
+		cmap->stats.connect_time_us += elapsed;
+		if (handle->reconnect) {
+			cmap->stats.reconnects++;
+			cmap->stats.reconnect_time_us += elapsed;
+			cmap->stats.reconnect_time_max_us =
+				MAX(cmap->stats.reconnect_time_max_us, elapsed);
+		}
+	} else {
+		cmap->stats.accepts++;
+	}
 	handle->state = CMAP_CONNECTED;
 	if (remote_key)
 		handle->remote_key = *remote_key;
+	handle->last_use = cmap->use_cnt++;
+	dlist_insert_tail(&handle->lru_entry, &cmap->lru_list);
 	fastlock_release(&cmap->lock);
 }
 
@@ -1276,6 +1565,7 @@ int ofi_cmap_process_connreq(struct util_cmap *cmap, void *addr,
 	if (!handle) {
 		FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL,
 		       "No handle found for given addr\n");
+		util_cmap_evict_lru(cmap);
 		ret = util_cmap_alloc_handle_peer(cmap, addr, CMAP_CONNREQ_RECV, &handle);
 		if (ret)
 			goto unlock;
@@ -1286,6 +1576,7 @@ int ofi_cmap_process_connreq(struct util_cmap *cmap, void *addr,
 
 	switch (handle->state) {
 	case CMAP_CONNECTED:
+	case CMAP_EVICTING:
 		FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL,
 			"Connection already present.\n");
 		ret = -FI_EALREADY;
@@ -1348,28 +1639,33 @@ int ofi_cmap_get_handle(struct util_cmap *cmap, fi_addr_t fi_addr,
 	if (!handle) {
 		FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL,
 		       "No handle found for given fi_addr\n");
+		util_cmap_evict_lru(cmap);
 		ret = util_cmap_alloc_handle(cmap, fi_addr, CMAP_IDLE, &handle);
 		if (ret)
 			goto unlock;
 	}
 	switch (handle->state) {
 	case CMAP_IDLE:
+		handle->connect_start = fi_gettime_us();
 		ret = cmap->attr.connect(cmap->ep, handle, fi_addr);
 		if (ret) {
 			util_cmap_del_handle(handle);
 			goto unlock;
 		}
 		handle->state = CMAP_CONNREQ_SENT;
+		cmap->stats.connects++;
 		ret = -FI_EAGAIN;
 		// TODO sleep on event fd instead of busy polling
 		break;
 	case CMAP_CONNREQ_SENT:
 	case CMAP_CONNREQ_RECV:
 	case CMAP_ACCEPT:
+	case CMAP_EVICTING:
 	case CMAP_SHUTDOWN:
 		ret = -FI_EAGAIN;
 		break;
 	case CMAP_CONNECTED:
+		handle->last_use = cmap->use_cnt++;
 		*handle_ret = handle;
 		break;
 	default:
@@ -1405,6 +1701,29 @@ static int util_cmap_event_handler_close(struct util_cmap *cmap)
 	return 0;
 }
 
+static void util_cmap_log_stats(struct util_cmap *cmap)
+{
+	struct util_cmap_stats *stats = &cmap->stats;
+
+	if (!stats->connects && !stats->accepts)
+		return;
+
+	FI_INFO(cmap->av->prov, FI_LOG_EP_CTRL, "connections: %" PRIu64
+		" connected, %" PRIu64 " accepted, %" PRIu64 " evicted, %"
+		PRIu64 " evicted by peers\n", stats->connects, stats->accepts,
+		stats->evictions, stats->remote_evictions);
+	if (stats->connects)
+		FI_INFO(cmap->av->prov, FI_LOG_EP_CTRL,
+			"average connect time: %" PRIu64 " us\n",
+			stats->connect_time_us / stats->connects);
+	if (stats->reconnects)
+		FI_INFO(cmap->av->prov, FI_LOG_EP_CTRL, "%" PRIu64
+			" reconnects, average time: %" PRIu64 " us, max: %"
+			PRIu64 " us\n", stats->reconnects,
+			stats->reconnect_time_us / stats->reconnects,
+			stats->reconnect_time_max_us);
+}
+
 void ofi_cmap_free(struct util_cmap *cmap)
 {
 	struct util_cmap_peer *peer;
@@ -1413,7 +1732,8 @@ void ofi_cmap_free(struct util_cmap *cmap)
 
 	fastlock_acquire(&cmap->lock);
 	FI_DBG(cmap->av->prov, FI_LOG_EP_CTRL, "Closing cmap\n");
-	for (i = 0; i < cmap->av->count; i++) {
+	util_cmap_log_stats(cmap);
+	for (i = 0; i < cmap->handles_av_cnt; i++) {
 		if (cmap->handles_av[i])
 			util_cmap_del_handle(cmap->handles_av[i]);
 	}
@@ -1424,12 +1744,24 @@ void ofi_cmap_free(struct util_cmap *cmap)
 	}
 	util_cmap_event_handler_close(cmap);
 	free(cmap->handles_av);
+	free(cmap->evicted_av);
 	free(cmap->attr.name);
 	fastlock_release(&cmap->lock);
 	fastlock_destroy(&cmap->lock);
 	free(cmap);
 }
 
+static void *util_cmap_event_handler(void *arg)
+{
+	struct util_cmap *cmap = arg;
+	void *ret;
+
+	ofi_thread_place(cmap->av->prov, &cmap->place);
+	ret = cmap->attr.event_handler(cmap->ep);
+	ofi_thread_report(cmap->av->prov, &cmap->place);
+	return ret;
+}
+
 struct util_cmap *ofi_cmap_alloc(struct util_ep *ep,
 				 struct util_cmap_attr *attr)
 {
@@ -1445,6 +1777,10 @@ struct util_cmap *ofi_cmap_alloc(struct util_ep *ep,
 	cmap->handles_av = calloc(cmap->av->count, sizeof(*cmap->handles_av));
 	if (!cmap->handles_av)
 		goto err1;
+	cmap->evicted_av = calloc(cmap->av->count, sizeof(*cmap->evicted_av));
+	if (!cmap->evicted_av)
+		goto err2;
+	cmap->handles_av_cnt = cmap->av->count;
 
 	cmap->attr = *attr;
 	cmap->attr.name = mem_dup(attr->name, ep->av->addrlen);
@@ -1455,10 +1791,14 @@ struct util_cmap *ofi_cmap_alloc(struct util_ep *ep,
 	ofi_key_idx_init(&cmap->key_idx, UTIL_CMAP_IDX_BITS);
 
 	dlist_init(&cmap->peer_list);
+	dlist_init(&cmap->lru_list);
+	dlist_init(&cmap->evict_list);
 	fastlock_init(&cmap->lock);
 
+	ofi_thread_place_init(&cmap->place, "cmap event handler",
+			      attr->numa_node);
 	if (pthread_create(&cmap->event_handler_thread, 0,
-			   cmap->attr.event_handler, ep)) {
+			   util_cmap_event_handler, cmap)) {
 		FI_WARN(ep->av->prov, FI_LOG_FABRIC,
 			"Unable to create msg_cm_listener_thread\n");
 		goto err3;
@@ -1467,6 +1807,7 @@ struct util_cmap *ofi_cmap_alloc(struct util_ep *ep,
 err3:
 	fastlock_destroy(&cmap->lock);
 err2:
+	free(cmap->evicted_av);
 	free(cmap->handles_av);
 err1:
 	free(cmap);
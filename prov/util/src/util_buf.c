@@ -68,6 +68,13 @@ int util_buf_grow(struct util_buf_pool *pool)
 			     pool->chunk_cnt * pool->entry_sz);
 	if (ret)
 		goto err;
+	/* Must precede the first touch below to take effect */
+	if (pool->numa_node != OFI_NUMA_ANY)
+		ofi_topo_bind_mem(buf_region->mem_region,
+				  pool->chunk_cnt * pool->entry_sz,
+				  pool->numa_node);
+	/* Lets users tell buffers that were never handed out */
+	memset(buf_region->mem_region, 0, pool->chunk_cnt * pool->entry_sz);
 
 	if (pool->alloc_hndlr) {
 		ret = pool->alloc_hndlr(pool->ctx, buf_region->mem_region,
@@ -92,11 +99,11 @@ err:
 	return -1;
 }
 
-struct util_buf_pool *util_buf_pool_create_ex(size_t size, size_t alignment,
-					      size_t max_cnt, size_t chunk_cnt,
-					      util_buf_region_alloc_hndlr alloc_hndlr,
-					      util_buf_region_free_hndlr free_hndlr,
-					      void *pool_ctx)
+struct util_buf_pool *util_buf_pool_create_node_ex(size_t size, size_t alignment,
+						   size_t max_cnt, size_t chunk_cnt,
+						   util_buf_region_alloc_hndlr alloc_hndlr,
+						   util_buf_region_free_hndlr free_hndlr,
+						   void *pool_ctx, int numa_node)
 {
 	size_t entry_sz;
 	struct util_buf_pool *buf_pool;
@@ -112,6 +119,7 @@ struct util_buf_pool *util_buf_pool_create_ex(size_t size, size_t alignment,
 	buf_pool->max_cnt = max_cnt;
 	buf_pool->chunk_cnt = chunk_cnt;
 	buf_pool->ctx = pool_ctx;
+	buf_pool->numa_node = numa_node;
 
 	entry_sz = util_buf_use_ftr(buf_pool) ?
 		(size + sizeof(struct util_buf_footer)) : size;
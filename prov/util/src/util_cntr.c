@@ -58,6 +58,7 @@ int ofi_check_cntr_attr(const struct fi_provider *prov,
 		/* fall through */
 	case FI_WAIT_UNSPEC:
 	case FI_WAIT_FD:
+	case FI_WAIT_MUTEX_COND:
 		break;
 	default:
 		FI_WARN(prov, FI_LOG_CNTR, "unsupported wait object\n");
@@ -49,6 +49,11 @@ int ofi_cq_write_error(struct util_cq *cq,
 
 	entry->err_entry = *err_entry;
 	fastlock_acquire(&cq->cq_lock);
+	if (ofi_cirque_freecnt(cq->cirq) <= cq->reserved) {
+		fastlock_release(&cq->cq_lock);
+		free(entry);
+		return -FI_EAGAIN;
+	}
 	slist_insert_tail(&entry->list_entry, &cq->err_list);
 	comp = ofi_cirque_tail(cq->cirq);
 	comp->flags = UTIL_FLAG_ERROR;
@@ -85,6 +90,7 @@ int ofi_check_cq_attr(const struct fi_provider *prov,
 		/* fall through */
 	case FI_WAIT_UNSPEC:
 	case FI_WAIT_FD:
+	case FI_WAIT_MUTEX_COND:
 		switch (attr->wait_cond) {
 		case FI_CQ_COND_NONE:
 		case FI_CQ_COND_THRESHOLD:
@@ -58,6 +58,7 @@ int ofi_domain_close(struct util_domain *domain)
 	fastlock_acquire(&domain->fabric->lock);
 	dlist_remove(&domain->list_entry);
 	fastlock_release(&domain->fabric->lock);
+	ofi_fabric_update_gen();
 
 	free(domain->name);
 	fastlock_destroy(&domain->lock);
@@ -111,6 +112,7 @@ int ofi_domain_init(struct fid_fabric *fabric_fid, const struct fi_info *info,
 	fastlock_acquire(&fabric->lock);
 	dlist_insert_tail(&domain->list_entry, &fabric->domain_list);
 	fastlock_release(&fabric->lock);
+	ofi_fabric_update_gen();
 
 	ofi_atomic_inc32(&fabric->ref);
 	return 0;
@@ -36,15 +36,21 @@
 
 #include <fi_util.h>
 #include <fi.h>
+#include <ofi_atomic.h>
 
 
 static DEFINE_LIST(fabric_list);
 static fastlock_t lock;
+/* Bumped whenever a fabric or domain is opened or closed.  util_getinfo
+ * reports open instances, so cached fi_getinfo results must not be
+ * reused across a change. */
+static uint32_t fabric_gen;
 
 
 void fi_util_init(void)
 {
 	fastlock_init(&lock);
+	ofi_atomic_init();
 }
 
 void fi_util_fini(void)
@@ -56,6 +62,7 @@ void ofi_fabric_insert(struct util_fabric *fabric)
 {
 	fastlock_acquire(&lock);
 	dlist_insert_tail(&fabric->list_entry, &fabric_list);
+	fabric_gen++;
 	fastlock_release(&lock);
 }
 
@@ -84,9 +91,27 @@ void ofi_fabric_remove(struct util_fabric *fabric)
 {
 	fastlock_acquire(&lock);
 	dlist_remove(&fabric->list_entry);
+	fabric_gen++;
 	fastlock_release(&lock);
 }
 
+void ofi_fabric_update_gen(void)
+{
+	fastlock_acquire(&lock);
+	fabric_gen++;
+	fastlock_release(&lock);
+}
+
+uint32_t ofi_fabric_get_gen(void)
+{
+	uint32_t gen;
+
+	fastlock_acquire(&lock);
+	gen = fabric_gen;
+	fastlock_release(&lock);
+	return gen;
+}
+
 
 static int ofi_fid_match(struct dlist_entry *entry, const void *fid)
 {
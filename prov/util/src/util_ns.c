@@ -53,22 +53,47 @@
 
 #define OFI_NS_DEFAULT_HOSTNAME	"localhost"
 
-#define OFI_NS_SOCKET_OP(op)							\
-static inline									\
-ssize_t util_ns_##op##_socket_op(SOCKET sock, void *buf, size_t len)		\
-{										\
-	ssize_t ret = 0, bytes = 0;						\
-	while (bytes != (len) && ret >= 0) {					\
-		ret = ofi_##op##_socket((sock),					\
-					(void *)((char *) (buf) + bytes),	\
-					(len) - bytes);				\
-		bytes = ((ret < 0) ? -1 : bytes + ret);				\
-	}									\
-	return bytes;								\
-}
-
-OFI_NS_SOCKET_OP(write)
-OFI_NS_SOCKET_OP(read)
+/* Most records carried by one command, larger batches are split */
+#define OFI_NS_MAX_BATCH	1024
+/* Bounds how long a stalled client can hold up the server */
+#define OFI_NS_SOCK_TIMEOUT_SEC	1
+/* Bounds how long a resolved name may be stale, e.g. after the peer
+ * that registered it restarted */
+#define OFI_NS_CACHE_TTL_MS	1000
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+static inline ssize_t util_ns_write_socket_op(SOCKET sock, void *buf,
+					      size_t len)
+{
+	ssize_t ret, bytes = 0;
+
+	while (bytes != len) {
+		/* A server that went away must not SIGPIPE the client */
+		ret = ofi_send_socket(sock, (char *) buf + bytes, len - bytes,
+				      MSG_NOSIGNAL);
+		if (ret <= 0)
+			return -1;
+		bytes += ret;
+	}
+	return bytes;
+}
+
+static inline ssize_t util_ns_read_socket_op(SOCKET sock, void *buf,
+					     size_t len)
+{
+	ssize_t ret, bytes = 0;
+
+	while (bytes != len) {
+		ret = ofi_read_socket(sock, (char *) buf + bytes, len - bytes);
+		if (ret <= 0)
+			return -1;
+		bytes += ret;
+	}
+	return bytes;
+}
 
 enum {
 	OFI_UTIL_NS_ADD,
@@ -77,13 +102,26 @@ enum {
 	OFI_UTIL_NS_ACK,
 };
 
+/*
+ * Every command is followed by count records: service and name for ADD
+ * and DEL, service for QUERY.  The server answers each command with an
+ * ACK.  For ADD and DEL, status holds the first error.  For QUERY, the
+ * ACK is followed by count records of status, service and name.
+ * Connections stay open across commands.
+ */
 struct util_ns_cmd {
 	int	op;
 	int	status;
+	int	count;
 };
 
 const size_t cmd_len = sizeof(struct util_ns_cmd);
 
+static inline size_t util_ns_query_rec_len(struct util_ns *ns)
+{
+	return sizeof(int) + ns->service_len + ns->name_len;
+}
+
 static int util_ns_map_init(struct util_ns *ns)
 {
 	ns->ns_map = rbtNew(ns->service_cmp);
@@ -174,108 +212,160 @@ static int util_ns_map_lookup(struct util_ns *ns, void *service_in,
 	return FI_SUCCESS;
 }
 
+/*
+ * Name server: a single thread multiplexes the listening socket and all
+ * client connections through fi_epoll.
+ */
+
+struct util_ns_server_conn {
+	struct dlist_entry	entry;
+	SOCKET			sock;
+};
+
+struct util_ns_server {
+	struct util_ns		*ns;
+	SOCKET			listenfd;
+	fi_epoll_t		epfd;
+	struct dlist_entry	conn_list;
+	void			*in_buf;
+	void			*out_buf;
+};
+
+static void util_ns_server_close_conn(struct util_ns_server *server,
+				      struct util_ns_server_conn *conn)
+{
+	(void) fi_epoll_del(server->epfd, conn->sock);
+	ofi_close_socket(conn->sock);
+	dlist_remove(&conn->entry);
+	free(conn);
+}
+
 static void util_ns_name_server_cleanup(void *args)
 {
-	void **cleanup_args = (void **)args;
-	ofi_close_socket((uintptr_t)cleanup_args[0]);
-	util_ns_map_fini((struct util_ns *)cleanup_args[1]);
+	struct util_ns_server *server = args;
+	struct util_ns_server_conn *conn;
+
+	while (!dlist_empty(&server->conn_list)) {
+		conn = container_of(server->conn_list.next,
+				    struct util_ns_server_conn, entry);
+		util_ns_server_close_conn(server, conn);
+	}
+	fi_epoll_close(server->epfd);
+	ofi_close_socket(server->listenfd);
+	free(server->in_buf);
+	free(server->out_buf);
+	util_ns_map_fini(server->ns);
 }
 
-static int util_ns_op_dispatcher(struct util_ns *ns,
-				 struct util_ns_cmd *cmd,
-				 SOCKET sock)
+static void util_ns_server_accept(struct util_ns_server *server)
 {
-	int ret = FI_SUCCESS;
-	size_t io_len = 0;
-	void *io_buf = NULL, *service, *name;
+	struct util_ns_server_conn *conn;
+	struct timeval tv = { .tv_sec = OFI_NS_SOCK_TIMEOUT_SEC };
+	SOCKET connfd;
+
+	connfd = accept(server->listenfd, NULL, 0);
+	if (connfd == INVALID_SOCKET)
+		return;
+
+	(void) setsockopt(connfd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	(void) setsockopt(connfd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+
+	conn = calloc(1, sizeof(*conn));
+	if (!conn)
+		goto err;
+	conn->sock = connfd;
+	if (fi_epoll_add(server->epfd, connfd, conn))
+		goto err;
+	dlist_insert_tail(&conn->entry, &server->conn_list);
+	return;
+err:
+	free(conn);
+	ofi_close_socket(connfd);
+}
+
+/* Serves one command, a non-zero return drops the connection */
+static int util_ns_op_dispatcher(struct util_ns_server *server, SOCKET sock)
+{
+	struct util_ns *ns = server->ns;
+	struct util_ns_cmd cmd;
+	size_t io_len, rec_len, i;
+	char *in, *out, *service, *name;
+	int ret;
+
+	if (util_ns_read_socket_op(sock, &cmd, cmd_len) != cmd_len)
+		return -FI_ENODATA;
+	if (cmd.count <= 0 || cmd.count > OFI_NS_MAX_BATCH)
+		return -FI_EINVAL;
+
+	in = server->in_buf;
+	out = server->out_buf;
 
-	switch (cmd->op) {
+	switch (cmd.op) {
 	case OFI_UTIL_NS_ADD:
 	case OFI_UTIL_NS_DEL:
-		io_len = ns->name_len + ns->service_len;
-		io_buf = calloc(io_len, 1);
-		if (!io_buf) {
-			ret = -FI_ENOMEM;
-			goto fn1;
-		}
-
-		ret = util_ns_read_socket_op(sock, io_buf, io_len);
-		if (ret == io_len) {
-			service = io_buf;
-			name = (void *)((char *)io_buf + ns->service_len);
-			ret = (cmd->op == OFI_UTIL_NS_ADD) ?
+		rec_len = ns->service_len + ns->name_len;
+		io_len = cmd.count * rec_len;
+		if (util_ns_read_socket_op(sock, in, io_len) != io_len)
+			return -FI_ENODATA;
+
+		cmd.status = FI_SUCCESS;
+		for (i = 0; i < cmd.count; i++) {
+			service = in + i * rec_len;
+			name = service + ns->service_len;
+			ret = (cmd.op == OFI_UTIL_NS_ADD) ?
 			      util_ns_map_add(ns, service, name) :
 			      util_ns_map_del(ns, service, name);
-		} else {
-			ret = -FI_ENODATA;
+			if (ret && !cmd.status)
+				cmd.status = ret;
 		}
-		goto fn2;
+		cmd.op = OFI_UTIL_NS_ACK;
+		io_len = cmd_len;
+		memcpy(out, &cmd, cmd_len);
+		break;
 
 	case OFI_UTIL_NS_QUERY:
-		io_len = ns->service_len;
-		/* allocate io_buf to be large enough */
-		io_buf = calloc(
-			cmd_len + ns->service_len + ns->name_len, 1
-		);
-		if (!io_buf) {
-			ret = -FI_ENOMEM;
-			goto fn1;
-		}
-
-		memcpy(io_buf, cmd, cmd_len);
-		cmd = io_buf;
-		service = (char *)io_buf + cmd_len;
-		name = (char *)service + ns->service_len;
-
-		ret = util_ns_read_socket_op(sock, service, io_len);
-		if (ret == io_len) {
-			cmd->op = OFI_UTIL_NS_ACK;
-			cmd->status = util_ns_map_lookup(
-				ns, service, name
-			);
-		} else {
-			ret = -FI_ENODATA;
-			goto fn2;
+		io_len = cmd.count * ns->service_len;
+		if (util_ns_read_socket_op(sock, in, io_len) != io_len)
+			return -FI_ENODATA;
+
+		rec_len = util_ns_query_rec_len(ns);
+		for (i = 0; i < cmd.count; i++) {
+			service = out + cmd_len + i * rec_len + sizeof(int);
+			name = service + ns->service_len;
+			memcpy(service, in + i * ns->service_len,
+			       ns->service_len);
+			ret = util_ns_map_lookup(ns, service, name);
+			memcpy(service - sizeof(int), &ret, sizeof(int));
 		}
-
-		if (!cmd->status)
-			io_len = cmd_len + ns->service_len + ns->name_len;
-		else
-			io_len = cmd_len;
-		ret = util_ns_write_socket_op(sock, io_buf, io_len);
-		ret = ((ret == cmd_len) ? FI_SUCCESS : -FI_ENODATA);
-		goto fn2;
+		cmd.op = OFI_UTIL_NS_ACK;
+		cmd.status = FI_SUCCESS;
+		io_len = cmd_len + cmd.count * rec_len;
+		memcpy(out, &cmd, cmd_len);
+		break;
 
 	default:
-		ret = -FI_ENODATA;
-		assert(0);
-		goto fn1;
+		return -FI_ENODATA;
 	}
 
-fn2:
-	free(io_buf);
-fn1:
-	return ret;
+	return (util_ns_write_socket_op(sock, out, io_len) == io_len) ?
+		FI_SUCCESS : -FI_ENODATA;
 }
 
 static void *util_ns_name_server_func(void *args)
 {
-	struct util_ns *ns;
+	struct util_ns_server server = { .ns = args };
 	struct addrinfo hints = {
 		.ai_flags = AI_PASSIVE,
 		.ai_family = AF_UNSPEC,
 		.ai_socktype = SOCK_STREAM
 	};
 	struct addrinfo *res, *p;
-	void *cleanup_args[2];
 	char *service;
-	SOCKET listenfd = INVALID_SOCKET, connfd;
-	int n, ret;
-	struct util_ns_cmd cmd = (const struct util_ns_cmd){ 0 };
-
-	ns = (struct util_ns *)args;
+	SOCKET listenfd = INVALID_SOCKET;
+	void *ctx;
+	int n, ret, state;
 
-	if (asprintf(&service, "%d", ns->ns_port) < 0)
+	if (asprintf(&service, "%d", server.ns->ns_port) < 0)
 		return NULL;
 
 	n = getaddrinfo(NULL, service, &hints, &res);
@@ -304,34 +394,54 @@ static void *util_ns_name_server_func(void *args)
 	if (listenfd == INVALID_SOCKET)
 		return NULL;
 
-	if (util_ns_map_init(ns))
-		goto done;
+	server.listenfd = listenfd;
+	dlist_init(&server.conn_list);
+	server.in_buf = malloc(OFI_NS_MAX_BATCH * util_ns_query_rec_len(server.ns));
+	server.out_buf = malloc(cmd_len + OFI_NS_MAX_BATCH *
+				util_ns_query_rec_len(server.ns));
+	if (!server.in_buf || !server.out_buf)
+		goto err1;
+
+	if (util_ns_map_init(server.ns))
+		goto err1;
 
 	ret = listen(listenfd, 256);
 	if (ret)
-		goto done;
+		goto err2;
+
+	if (fi_epoll_create(&server.epfd))
+		goto err2;
+	if (fi_epoll_add(server.epfd, listenfd, &server)) {
+		fi_epoll_close(server.epfd);
+		goto err2;
+	}
 
-	cleanup_args[0] = (void *)(uintptr_t)listenfd;
-	cleanup_args[1] = (void *)ns;
-	pthread_cleanup_push(util_ns_name_server_cleanup,
-			     (void *)cleanup_args);
+	pthread_cleanup_push(util_ns_name_server_cleanup, &server);
 
 	while (1) {
-		connfd = accept(listenfd, NULL, 0);
-		if (connfd != INVALID_SOCKET) {
-			/* Read service data */
-			ret = ofi_read_socket(connfd, &cmd, cmd_len);
-			if (ret == cmd_len) {
-				(void) util_ns_op_dispatcher(ns, &cmd,
-							     connfd);
-			}
-			ofi_close_socket(connfd);
+		/* Only the wait is a cancellation point, so a command is
+		 * never left half served */
+		ctx = fi_epoll_wait(server.epfd, -1);
+		if (!ctx)
+			continue;
+
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &state);
+		if (ctx == &server) {
+			util_ns_server_accept(&server);
+		} else if (util_ns_op_dispatcher(&server,
+				((struct util_ns_server_conn *) ctx)->sock)) {
+			util_ns_server_close_conn(&server, ctx);
 		}
+		pthread_setcancelstate(state, NULL);
 	}
 
 	pthread_cleanup_pop(1);
-
-done:
+	return NULL;
+err2:
+	util_ns_map_fini(server.ns);
+err1:
+	free(server.in_buf);
+	free(server.out_buf);
 	ofi_close_socket(listenfd);
 	return NULL;
 }
@@ -339,8 +449,25 @@ done:
 
 /*
  * Name server API: client side
+ *
+ * Each util_ns keeps one persistent connection per name server it talks
+ * to, along with a cache of the names resolved through it.  Entries are
+ * dropped when this util_ns deletes or re-adds the service, and expire
+ * after OFI_NS_CACHE_TTL_MS so that other processes' updates are seen.
  */
 
+struct util_ns_client {
+	struct dlist_entry	entry;
+	char			*hostname;
+	SOCKET			sock;
+	RbtHandle		cache;
+};
+
+struct util_ns_cache_entry {
+	uint64_t		expire_ms;
+	char			name[];
+};
+
 static int util_ns_connect_server(struct util_ns *ns, const char *server)
 {
 	struct addrinfo hints = {
@@ -377,153 +504,352 @@ static int util_ns_connect_server(struct util_ns *ns, const char *server)
 	return sockfd;
 }
 
-int ofi_ns_add_local_name(struct util_ns *ns, void *service, void *name)
+static void util_ns_cache_clear(RbtHandle cache)
 {
-	SOCKET sockfd;
-	int ret;
-	char *server = (ns->ns_hostname ?
-		ns->ns_hostname : OFI_NS_DEFAULT_HOSTNAME);
-	void *write_buf;
-	size_t write_len = 0;
-	struct util_ns_cmd cmd = {
-		.op = OFI_UTIL_NS_ADD,
-		.status = 0,
-	};
+	RbtIterator it;
+	void *service, *name;
 
-	write_buf = calloc(cmd_len + ns->service_len + ns->name_len, 1);
-	if (!write_buf) {
-		ret = -FI_ENOMEM;
-		goto err1;
+	while ((it = rbtBegin(cache)) != rbtEnd(cache)) {
+		rbtKeyValue(cache, it, &service, &name);
+		rbtErase(cache, it);
+		free(service);
+		free(name);
 	}
+}
 
-	memcpy(write_buf, &cmd, cmd_len);
-	write_len += cmd_len;
-	memcpy((void *)((char *)write_buf + write_len), service,
-	       ns->service_len);
-	write_len += ns->service_len;
-	memcpy((void *)((char *)write_buf + write_len), name,
-	       ns->name_len);
-	write_len += ns->name_len;
-
-	sockfd = util_ns_connect_server(ns, server);
-	if (sockfd == INVALID_SOCKET) {
-		ret = -FI_ENODATA;
-		goto err2;
+static int util_ns_cache_lookup(struct util_ns *ns,
+				struct util_ns_client *client,
+				void *service, void *name_out)
+{
+	struct util_ns_cache_entry *entry;
+	RbtIterator it;
+	void *key;
+
+	if (ns->is_service_wildcard && ns->is_service_wildcard(service))
+		return 0;
+
+	it = rbtFind(client->cache, service);
+	if (!it)
+		return 0;
+
+	rbtKeyValue(client->cache, it, &key, (void **) &entry);
+	if (fi_gettime_ms() >= entry->expire_ms) {
+		rbtErase(client->cache, it);
+		free(key);
+		free(entry);
+		return 0;
 	}
+	memcpy(name_out, entry->name, ns->name_len);
+	return 1;
+}
 
-	ret = util_ns_write_socket_op(sockfd, write_buf, write_len);
-	ret = ((ret == write_len) ? FI_SUCCESS : -FI_ENODATA);
+static void util_ns_cache_insert(struct util_ns *ns,
+				 struct util_ns_client *client,
+				 void *service_in, void *name_in)
+{
+	struct util_ns_cache_entry *entry;
+	RbtIterator it;
+	void *service;
+
+	it = rbtFind(client->cache, service_in);
+	if (it) {
+		rbtKeyValue(client->cache, it, &service, (void **) &entry);
+	} else {
+		service = mem_dup(service_in, ns->service_len);
+		entry = malloc(sizeof(*entry) + ns->name_len);
+		if (!service || !entry ||
+		    rbtInsert(client->cache, service, entry)) {
+			free(service);
+			free(entry);
+			return;
+		}
+	}
+	entry->expire_ms = fi_gettime_ms() + OFI_NS_CACHE_TTL_MS;
+	memcpy(entry->name, name_in, ns->name_len);
+}
 
-	ofi_close_socket(sockfd);
-err2:
-	free(write_buf);
-err1:
-	return ret;
+static void util_ns_cache_remove(struct util_ns_client *client,
+				 void *service_in)
+{
+	RbtIterator it;
+	void *service, *name;
+
+	it = rbtFind(client->cache, service_in);
+	if (!it)
+		return;
+
+	rbtKeyValue(client->cache, it, &service, &name);
+	rbtErase(client->cache, it);
+	free(service);
+	free(name);
 }
 
-int ofi_ns_del_local_name(struct util_ns *ns, void *service, void *name)
+/* Caller must hold ns->lock */
+static struct util_ns_client *
+util_ns_get_client(struct util_ns *ns, const char *server)
 {
-	SOCKET sockfd;
-	int ret;
-	const char *server_hostname = (ns->ns_hostname ?
-		ns->ns_hostname : OFI_NS_DEFAULT_HOSTNAME);
-	void *write_buf;
-	size_t write_len = 0;
-	struct util_ns_cmd cmd = {
-		.op = OFI_UTIL_NS_DEL,
-		.status = 0,
-	};
+	struct util_ns_client *client;
+	struct dlist_entry *entry;
 
-	write_buf = calloc(cmd_len + ns->service_len + ns->name_len, 1);
-	if (!write_buf) {
-		ret = -FI_ENOMEM;
-		goto err1;
+	dlist_foreach(&ns->client_list, entry) {
+		client = container_of(entry, struct util_ns_client, entry);
+		if (!strcmp(client->hostname, server))
+			return client;
 	}
 
-	memcpy(write_buf, &cmd, cmd_len);
-	write_len += cmd_len;
-	memcpy((void *)((char *)write_buf + write_len), service,
-	       ns->service_len);
-	write_len += ns->service_len;
-	memcpy((void *)((char *)write_buf + write_len), name,
-	       ns->name_len);
-	write_len += ns->name_len;
-
-	sockfd = util_ns_connect_server(ns, server_hostname);
-	if (sockfd == INVALID_SOCKET) {
-		ret = -FI_ENODATA;
-		goto err2;
+	client = calloc(1, sizeof(*client));
+	if (!client)
+		return NULL;
+
+	client->hostname = strdup(server);
+	client->cache = rbtNew(ns->service_cmp);
+	if (!client->hostname || !client->cache)
+		goto err;
+	client->sock = INVALID_SOCKET;
+	dlist_insert_tail(&client->entry, &ns->client_list);
+	return client;
+err:
+	if (client->cache)
+		rbtDelete(client->cache);
+	free(client->hostname);
+	free(client);
+	return NULL;
+}
+
+static void util_ns_free_client(struct util_ns_client *client)
+{
+	if (client->sock != INVALID_SOCKET)
+		ofi_close_socket(client->sock);
+	util_ns_cache_clear(client->cache);
+	rbtDelete(client->cache);
+	dlist_remove(&client->entry);
+	free(client->hostname);
+	free(client);
+}
+
+static int util_ns_client_xfer(struct util_ns *ns,
+			       struct util_ns_client *client,
+			       void *req, size_t req_len,
+			       struct util_ns_cmd *ack,
+			       void *resp, size_t resp_len)
+{
+	if (client->sock == INVALID_SOCKET) {
+		client->sock = util_ns_connect_server(ns, client->hostname);
+		if (client->sock == INVALID_SOCKET)
+			return -FI_ENODATA;
 	}
 
-	ret = util_ns_write_socket_op(sockfd, write_buf, write_len);
-	ret = ((ret == write_len) ? FI_SUCCESS : -FI_ENODATA);
+	if (util_ns_write_socket_op(client->sock, req, req_len) != req_len ||
+	    util_ns_read_socket_op(client->sock, ack, cmd_len) != cmd_len ||
+	    ack->op != OFI_UTIL_NS_ACK ||
+	    (resp_len && util_ns_read_socket_op(client->sock, resp,
+						resp_len) != resp_len)) {
+		ofi_close_socket(client->sock);
+		client->sock = INVALID_SOCKET;
+		return -FI_ENODATA;
+	}
+	return FI_SUCCESS;
+}
 
-	ofi_close_socket(sockfd);
-err2:
-	free(write_buf);
-err1:
+/*
+ * Sends a command over the persistent connection, reconnecting once if
+ * the server dropped it (e.g. it was restarted by another process).
+ * Caller must hold ns->lock.
+ */
+static int util_ns_client_cmd(struct util_ns *ns,
+			      struct util_ns_client *client,
+			      void *req, size_t req_len,
+			      struct util_ns_cmd *ack,
+			      void *resp, size_t resp_len)
+{
+	int reconnected = (client->sock == INVALID_SOCKET);
+	int ret;
+
+	ret = util_ns_client_xfer(ns, client, req, req_len, ack,
+				  resp, resp_len);
+	if (ret && !reconnected)
+		ret = util_ns_client_xfer(ns, client, req, req_len, ack,
+					  resp, resp_len);
 	return ret;
 }
 
-void *ofi_ns_resolve_name(struct util_ns *ns, const char *server_hostname,
-			  void *service)
+static const char *util_ns_local_hostname(struct util_ns *ns)
 {
-	void *dest_addr = NULL, *io_buf;
-	size_t io_len = 0;
-	SOCKET sockfd;
-	ssize_t ret = 0;
-	struct util_ns_cmd cmd = {
-		.op = OFI_UTIL_NS_QUERY,
-		.status = 0,
-	};
+	return ns->ns_hostname ? ns->ns_hostname : OFI_NS_DEFAULT_HOSTNAME;
+}
 
-	sockfd = util_ns_connect_server(ns, server_hostname);
-	if (sockfd == INVALID_SOCKET)
-		goto err1;
+static int util_ns_update_local_names(struct util_ns *ns, int op,
+				      void *services, void *names,
+				      size_t count)
+{
+	struct util_ns_client *client;
+	struct util_ns_cmd cmd = { .op = op }, ack;
+	size_t rec_len = ns->service_len + ns->name_len;
+	size_t i, j, n, req_len;
+	char *req, *rec;
+	int ret = FI_SUCCESS;
 
-	io_buf = calloc(cmd_len + ns->service_len, 1);
-	if (!io_buf)
-		goto err2;
+	req = malloc(cmd_len + MIN(count, OFI_NS_MAX_BATCH) * rec_len);
+	if (!req)
+		return -FI_ENOMEM;
 
-	memcpy(io_buf, &cmd, cmd_len);
-	io_len += cmd_len;
-	memcpy((void *)((char *)io_buf + io_len), service,
-	       ns->service_len);
-	io_len += ns->service_len;
+	pthread_mutex_lock(&ns->lock);
+	client = util_ns_get_client(ns, util_ns_local_hostname(ns));
+	if (!client) {
+		ret = -FI_ENOMEM;
+		goto out;
+	}
 
-	ret = util_ns_write_socket_op(sockfd, io_buf, io_len);
-	if (ret < 0)
-		goto err3;
+	for (i = 0; i < count; i += n) {
+		n = MIN(count - i, OFI_NS_MAX_BATCH);
+		for (j = 0; j < n; j++) {
+			rec = req + cmd_len + j * rec_len;
+			memcpy(rec, (char *) services +
+			       (i + j) * ns->service_len, ns->service_len);
+			memcpy(rec + ns->service_len, (char *) names +
+			       (i + j) * ns->name_len, ns->name_len);
+			util_ns_cache_remove(client, rec);
+		}
+		cmd.count = (int) n;
+		memcpy(req, &cmd, cmd_len);
+		req_len = cmd_len + n * rec_len;
+
+		ret = util_ns_client_cmd(ns, client, req, req_len, &ack,
+					 NULL, 0);
+		if (ret)
+			break;
+		if (ack.status && !ret)
+			ret = ack.status;
+	}
+out:
+	pthread_mutex_unlock(&ns->lock);
+	free(req);
+	return ret;
+}
 
-	free(io_buf);
+int ofi_ns_add_local_names(struct util_ns *ns, void *services, void *names,
+			   size_t count)
+{
+	return util_ns_update_local_names(ns, OFI_UTIL_NS_ADD, services,
+					  names, count);
+}
 
-	io_len = ns->service_len + ns->name_len;
-	io_buf = calloc(io_len, 1);
-	if (!io_buf)
-		goto err2;
+int ofi_ns_add_local_name(struct util_ns *ns, void *service, void *name)
+{
+	return util_ns_update_local_names(ns, OFI_UTIL_NS_ADD, service,
+					  name, 1);
+}
 
-	ret = util_ns_read_socket_op(sockfd, &cmd, cmd_len);
-	if (ret < 0 || cmd.status)
-		goto err3;
+int ofi_ns_del_local_name(struct util_ns *ns, void *service, void *name)
+{
+	return util_ns_update_local_names(ns, OFI_UTIL_NS_DEL, service,
+					  name, 1);
+}
 
-	ret = util_ns_read_socket_op(sockfd, io_buf, io_len);
-	if (ret == io_len) {
-		dest_addr = calloc(ns->name_len, 1);
-		if (!dest_addr)
-			goto err3;
-		io_len = 0;
-		memcpy(service, (void *)((char *)io_buf + io_len),
-		       ns->service_len);
-		io_len += ns->service_len;
-		memcpy(dest_addr, (void *)((char *)io_buf + io_len),
-		       ns->name_len);
+/*
+ * Resolves count services on server.  Names are written to the names
+ * array and wildcard services are updated in place.  status (may be
+ * NULL) receives 0 or a negative error per service.  Returns the number
+ * of services resolved, or a negative error if the server could not be
+ * reached.
+ */
+int ofi_ns_resolve_names(struct util_ns *ns, const char *server,
+			 void *services, void *names, int *status,
+			 size_t count)
+{
+	struct util_ns_client *client;
+	struct util_ns_cmd cmd = { .op = OFI_UTIL_NS_QUERY }, ack;
+	size_t rec_len = util_ns_query_rec_len(ns);
+	size_t batch = MIN(count, OFI_NS_MAX_BATCH);
+	size_t i, j, n, *idx;
+	char *req, *resp, *rec, *service, *name;
+	int ret = 0, resolved = 0, st, wildcard;
+
+	req = malloc(cmd_len + batch * ns->service_len);
+	resp = malloc(batch * rec_len);
+	idx = malloc(batch * sizeof(*idx));
+	if (!req || !resp || !idx) {
+		ret = -FI_ENOMEM;
+		goto free;
 	}
 
-err3:
-	free(io_buf);
-err2:
-	ofi_close_socket(sockfd);
-err1:
+	pthread_mutex_lock(&ns->lock);
+	client = util_ns_get_client(ns, server);
+	if (!client) {
+		ret = -FI_ENOMEM;
+		goto unlock;
+	}
+
+	for (i = 0; i < count; ) {
+		for (n = 0; i < count && n < OFI_NS_MAX_BATCH; i++) {
+			service = (char *) services + i * ns->service_len;
+			name = (char *) names + i * ns->name_len;
+			if (util_ns_cache_lookup(ns, client, service, name)) {
+				if (status)
+					status[i] = FI_SUCCESS;
+				resolved++;
+				continue;
+			}
+			memcpy(req + cmd_len + n * ns->service_len, service,
+			       ns->service_len);
+			idx[n++] = i;
+		}
+		if (!n)
+			break;
+
+		cmd.count = (int) n;
+		memcpy(req, &cmd, cmd_len);
+		ret = util_ns_client_cmd(ns, client, req,
+					 cmd_len + n * ns->service_len, &ack,
+					 resp, n * rec_len);
+		if (ret)
+			goto unlock;
+
+		for (j = 0; j < n; j++) {
+			rec = resp + j * rec_len;
+			service = (char *) services + idx[j] * ns->service_len;
+			name = (char *) names + idx[j] * ns->name_len;
+			memcpy(&st, rec, sizeof(int));
+			if (status)
+				status[idx[j]] = st;
+			if (st)
+				continue;
+
+			wildcard = ns->is_service_wildcard &&
+				   ns->is_service_wildcard(service);
+			memcpy(service, rec + sizeof(int), ns->service_len);
+			memcpy(name, rec + sizeof(int) + ns->service_len,
+			       ns->name_len);
+			if (!wildcard)
+				util_ns_cache_insert(ns, client, service, name);
+			resolved++;
+		}
+	}
+	ret = resolved;
+unlock:
+	pthread_mutex_unlock(&ns->lock);
+free:
+	free(idx);
+	free(resp);
+	free(req);
+	return ret;
+}
+
+void *ofi_ns_resolve_name(struct util_ns *ns, const char *server_hostname,
+			  void *service)
+{
+	void *dest_addr;
+	int status;
+
+	dest_addr = calloc(ns->name_len, 1);
+	if (!dest_addr)
+		return NULL;
+
+	if (ofi_ns_resolve_names(ns, server_hostname, service, dest_addr,
+				 &status, 1) != 1) {
+		free(dest_addr);
+		return NULL;
+	}
 	return dest_addr;
 }
 
@@ -592,5 +918,18 @@ int ofi_ns_init(struct util_ns_attr *attr, struct util_ns *ns)
 	if (attr->ns_hostname)
 		ns->ns_hostname = strdup(attr->ns_hostname);
 
+	dlist_init(&ns->client_list);
+	pthread_mutex_init(&ns->lock, NULL);
 	return FI_SUCCESS;
 }
+
+/* Closes the connections to name servers and drops cached names */
+void ofi_ns_fini(struct util_ns *ns)
+{
+	while (!dlist_empty(&ns->client_list))
+		util_ns_free_client(container_of(ns->client_list.next,
+						 struct util_ns_client, entry));
+	pthread_mutex_destroy(&ns->lock);
+	free(ns->ns_hostname);
+	ns->ns_hostname = NULL;
+}
@@ -0,0 +1,460 @@
+/*
+ * Copyright (c) 2017 Intel Corporation. All rights reserved.
+ *
+ * This software is available to you under a choice of one of two
+ * licenses.  You may choose to be licensed under the terms of the GNU
+ * General Public License (GPL) Version 2, available from the file
+ * COPYING in the main directory of this source tree, or the
+ * BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "config.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fi.h>
+#include <fi_topo.h>
+
+#ifdef __linux__
+
+#include <dirent.h>
+#include <ifaddrs.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/syscall.h>
+
+#define OFI_TOPO_SYSFS_NODE	"/sys/devices/system/node"
+#define OFI_MPOL_PREFERRED	1
+
+static struct {
+	int			node_cnt;
+	int			node_max;
+	cpu_set_t		*node_cpus;
+	enum ofi_topo_policy	policy;
+} ofi_topo = {
+	.node_cnt = 1,
+	.node_max = -1,
+};
+
+static pthread_once_t ofi_topo_once = PTHREAD_ONCE_INIT;
+
+static int ofi_topo_read(const char *path, char *buf, size_t size)
+{
+	FILE *file;
+	char *ret;
+
+	file = fopen(path, "r");
+	if (!file)
+		return -errno;
+
+	ret = fgets(buf, size, file);
+	fclose(file);
+	if (!ret)
+		return -FI_ENODATA;
+
+	buf[strcspn(buf, "\n")] = '\0';
+	return 0;
+}
+
+/* Parses the kernel cpulist format, extended with an optional stride */
+static int ofi_topo_parse_cpus(const char *list, cpu_set_t *set)
+{
+	unsigned long first, last, stride, cpu;
+	char *end;
+
+	CPU_ZERO(set);
+	while (*list) {
+		first = strtoul(list, &end, 10);
+		if (end == list)
+			return -FI_EINVAL;
+		last = first;
+		stride = 1;
+
+		if (*end == '-') {
+			list = end + 1;
+			last = strtoul(list, &end, 10);
+			if (end == list || last < first)
+				return -FI_EINVAL;
+		}
+		if (*end == ':') {
+			list = end + 1;
+			stride = strtoul(list, &end, 10);
+			if (end == list || !stride)
+				return -FI_EINVAL;
+		}
+
+		for (cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu += stride)
+			CPU_SET(cpu, set);
+
+		if (*end == ',')
+			end++;
+		else if (*end)
+			return -FI_EINVAL;
+		list = end;
+	}
+	return CPU_COUNT(set) ? 0 : -FI_EINVAL;
+}
+
+static void ofi_topo_get_policy(void)
+{
+	char *str = NULL;
+
+	ofi_topo.policy = OFI_TOPO_POLICY_DEVICE;
+	if (fi_param_get_str(NULL, "thread_placement", &str) || !str)
+		return;
+
+	/* Anything else, including "device", keeps the default */
+	if (!strcasecmp(str, "none"))
+		ofi_topo.policy = OFI_TOPO_POLICY_NONE;
+	else if (!strcasecmp(str, "buffer"))
+		ofi_topo.policy = OFI_TOPO_POLICY_BUFFER;
+}
+
+static void ofi_topo_init(void)
+{
+	char path[PATH_MAX], buf[4096];
+	struct dirent *entry;
+	cpu_set_t *cpus;
+	DIR *dir;
+	int node;
+
+	ofi_topo_get_policy();
+
+	dir = opendir(OFI_TOPO_SYSFS_NODE);
+	if (!dir)
+		return;
+
+	while ((entry = readdir(dir))) {
+		if (sscanf(entry->d_name, "node%d", &node) == 1)
+			ofi_topo.node_max = MAX(ofi_topo.node_max, node);
+	}
+	if (ofi_topo.node_max < 1)
+		goto out;
+
+	cpus = calloc(ofi_topo.node_max + 1, sizeof(*cpus));
+	if (!cpus)
+		goto out;
+
+	ofi_topo.node_cnt = 0;
+	for (node = 0; node <= ofi_topo.node_max; node++) {
+		snprintf(path, sizeof(path), OFI_TOPO_SYSFS_NODE "/node%d/cpulist",
+			 node);
+		/* Memory only nodes have an empty list and get no threads */
+		if (ofi_topo_read(path, buf, sizeof(buf)) ||
+		    ofi_topo_parse_cpus(buf, &cpus[node]))
+			continue;
+		ofi_topo.node_cnt++;
+	}
+
+	if (ofi_topo.node_cnt > 1) {
+		ofi_topo.node_cpus = cpus;
+	} else {
+		ofi_topo.node_cnt = 1;
+		free(cpus);
+	}
+out:
+	closedir(dir);
+}
+
+static inline void ofi_topo_discover(void)
+{
+	pthread_once(&ofi_topo_once, ofi_topo_init);
+}
+
+static inline int ofi_topo_valid_node(int node)
+{
+	return ofi_topo.node_cpus && node >= 0 && node <= ofi_topo.node_max &&
+	       CPU_COUNT(&ofi_topo.node_cpus[node]);
+}
+
+int ofi_topo_node_cnt(void)
+{
+	ofi_topo_discover();
+	return ofi_topo.node_cnt;
+}
+
+int ofi_topo_cpu_node(int cpu)
+{
+	int node;
+
+	ofi_topo_discover();
+	if (!ofi_topo.node_cpus || cpu < 0 || cpu >= CPU_SETSIZE)
+		return OFI_NUMA_ANY;
+
+	for (node = 0; node <= ofi_topo.node_max; node++) {
+		if (CPU_ISSET(cpu, &ofi_topo.node_cpus[node]))
+			return node;
+	}
+	return OFI_NUMA_ANY;
+}
+
+int ofi_topo_cur_node(void)
+{
+	return ofi_topo_cpu_node(sched_getcpu());
+}
+
+int ofi_topo_dev_node(const char *name)
+{
+	static const char *classes[] = { "net", "infiniband" };
+	char path[PATH_MAX], buf[16];
+	size_t i;
+	int node;
+
+	ofi_topo_discover();
+	if (!ofi_topo.node_cpus || !name || !*name || strchr(name, '/'))
+		return OFI_NUMA_ANY;
+
+	for (i = 0; i < sizeof(classes) / sizeof(classes[0]); i++) {
+		snprintf(path, sizeof(path), "/sys/class/%s/%s/device/numa_node",
+			 classes[i], name);
+		if (ofi_topo_read(path, buf, sizeof(buf)))
+			continue;
+		node = atoi(buf);
+		return ofi_topo_valid_node(node) ? node : OFI_NUMA_ANY;
+	}
+	return OFI_NUMA_ANY;
+}
+
+static int ofi_topo_addr_match(const struct sockaddr *ifaddr,
+			       const struct sockaddr *addr)
+{
+	if (!ifaddr || ifaddr->sa_family != addr->sa_family)
+		return 0;
+
+	switch (addr->sa_family) {
+	case AF_INET:
+		return ((struct sockaddr_in *) ifaddr)->sin_addr.s_addr ==
+		       ((struct sockaddr_in *) addr)->sin_addr.s_addr;
+	case AF_INET6:
+		return !memcmp(&((struct sockaddr_in6 *) ifaddr)->sin6_addr,
+			       &((struct sockaddr_in6 *) addr)->sin6_addr,
+			       sizeof(struct in6_addr));
+	default:
+		return 0;
+	}
+}
+
+int ofi_topo_addr_node(const struct sockaddr *addr)
+{
+	struct ifaddrs *ifaddrs, *ifa;
+	int node = OFI_NUMA_ANY;
+
+	ofi_topo_discover();
+	if (!ofi_topo.node_cpus || !addr || getifaddrs(&ifaddrs))
+		return OFI_NUMA_ANY;
+
+	for (ifa = ifaddrs; ifa; ifa = ifa->ifa_next) {
+		if (ofi_topo_addr_match(ifa->ifa_addr, addr)) {
+			node = ofi_topo_dev_node(ifa->ifa_name);
+			break;
+		}
+	}
+
+	freeifaddrs(ifaddrs);
+	return node;
+}
+
+int ofi_topo_info_node(const struct fi_info *info)
+{
+	int node = OFI_NUMA_ANY;
+
+	if (!info)
+		return node;
+
+	switch (info->addr_format) {
+	case FI_SOCKADDR:
+	case FI_SOCKADDR_IN:
+	case FI_SOCKADDR_IN6:
+		node = ofi_topo_addr_node(info->src_addr);
+		break;
+	default:
+		break;
+	}
+
+	if (node == OFI_NUMA_ANY && info->domain_attr)
+		node = ofi_topo_dev_node(info->domain_attr->name);
+	return node;
+}
+
+int ofi_topo_select_node(int dev_node)
+{
+	ofi_topo_discover();
+	if (!ofi_topo.node_cpus)
+		return OFI_NUMA_ANY;
+
+	switch (ofi_topo.policy) {
+	case OFI_TOPO_POLICY_DEVICE:
+		if (ofi_topo_valid_node(dev_node))
+			return dev_node;
+		/* fall through */
+	case OFI_TOPO_POLICY_BUFFER:
+		return ofi_topo_cur_node();
+	default:
+		return OFI_NUMA_ANY;
+	}
+}
+
+int ofi_topo_bind_mem(void *addr, size_t len, int node)
+{
+#ifdef SYS_mbind
+	unsigned long mask[CPU_SETSIZE / (8 * sizeof(unsigned long))] = { 0 };
+	uintptr_t start, end;
+	long page_size;
+
+	if (!ofi_topo_valid_node(node) || node >= CPU_SETSIZE)
+		return 0;
+
+	/* mbind works on whole pages, leave partial ones to first touch */
+	page_size = sysconf(_SC_PAGESIZE);
+	start = ((uintptr_t) addr + page_size - 1) & ~(page_size - 1);
+	end = ((uintptr_t) addr + len) & ~(page_size - 1);
+	if (start >= end)
+		return 0;
+
+	mask[node / (8 * sizeof(*mask))] |= 1UL << (node % (8 * sizeof(*mask)));
+	if (syscall(SYS_mbind, start, end - start, OFI_MPOL_PREFERRED, mask,
+		    8 * sizeof(mask), 0))
+		return -errno;
+#endif
+	return 0;
+}
+
+int ofi_thread_set_cpus(const char *cpulist)
+{
+	cpu_set_t set;
+	int ret;
+
+	ret = ofi_topo_parse_cpus(cpulist, &set);
+	if (ret)
+		return ret;
+
+	return -pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+void ofi_thread_place(const struct fi_provider *prov,
+		      struct ofi_thread_place *place)
+{
+	cpu_set_t set;
+	int ret;
+
+	ofi_topo_discover();
+	if (ofi_topo_valid_node(place->node) &&
+	    !pthread_getaffinity_np(pthread_self(), sizeof(set), &set)) {
+		/* Stay within whatever the application allowed us */
+		CPU_AND(&set, &set, &ofi_topo.node_cpus[place->node]);
+		if (CPU_COUNT(&set)) {
+			ret = pthread_setaffinity_np(pthread_self(),
+						     sizeof(set), &set);
+			if (ret && prov)
+				FI_WARN(prov, FI_LOG_CORE,
+					"unable to bind %s thread to node %d: %s\n",
+					place->name, place->node, strerror(ret));
+		}
+	}
+
+	place->start_cpu = sched_getcpu();
+	if (prov)
+		FI_INFO(prov, FI_LOG_CORE,
+			"%s thread placed on node %d, starting on cpu %d\n",
+			place->name, place->node, place->start_cpu);
+}
+
+void ofi_thread_report(const struct fi_provider *prov,
+		       struct ofi_thread_place *place)
+{
+	place->end_cpu = sched_getcpu();
+	if (prov)
+		FI_INFO(prov, FI_LOG_CORE,
+			"%s thread for node %d ran on cpu %d (node %d) "
+			"to cpu %d (node %d)\n", place->name, place->node,
+			place->start_cpu, ofi_topo_cpu_node(place->start_cpu),
+			place->end_cpu, ofi_topo_cpu_node(place->end_cpu));
+}
+
+#else /* __linux__ */
+
+int ofi_topo_node_cnt(void)
+{
+	return 1;
+}
+
+int ofi_topo_cpu_node(int cpu)
+{
+	return OFI_NUMA_ANY;
+}
+
+int ofi_topo_cur_node(void)
+{
+	return OFI_NUMA_ANY;
+}
+
+int ofi_topo_dev_node(const char *name)
+{
+	return OFI_NUMA_ANY;
+}
+
+int ofi_topo_addr_node(const struct sockaddr *addr)
+{
+	return OFI_NUMA_ANY;
+}
+
+int ofi_topo_info_node(const struct fi_info *info)
+{
+	return OFI_NUMA_ANY;
+}
+
+int ofi_topo_select_node(int dev_node)
+{
+	return OFI_NUMA_ANY;
+}
+
+int ofi_topo_bind_mem(void *addr, size_t len, int node)
+{
+	return 0;
+}
+
+int ofi_thread_set_cpus(const char *cpulist)
+{
+	return -FI_ENOSYS;
+}
+
+void ofi_thread_place(const struct fi_provider *prov,
+		      struct ofi_thread_place *place)
+{
+}
+
+void ofi_thread_report(const struct fi_provider *prov,
+		       struct ofi_thread_place *place)
+{
+}
+
+#endif /* __linux__ */
@@ -37,6 +37,7 @@
 #include <fi_enosys.h>
 #include <fi_util.h>
 
+#define UTIL_WAIT_SPIN_COUNT	64
 
 int ofi_trywait(struct fid_fabric *fabric, struct fid **fids, int count)
 {
@@ -116,6 +117,8 @@ int fi_wait_init(struct util_fabric *fabric, struct fi_wait_attr *attr,
 
 	wait->prov = fabric->prov;
 	ofi_atomic_initialize32(&wait->ref, 0);
+	ofi_atomic_initialize32(&wait->waiters, 0);
+	wait->exported = 0;
 	wait->wait_fid.fid.fclass = FI_CLASS_WAIT;
 
 	switch (attr->wait_obj) {
@@ -142,9 +145,40 @@ int fi_wait_init(struct util_fabric *fabric, struct fi_wait_attr *attr,
 	return 0;
 }
 
+/*
+ * The signaler publishes its event (CQ entry, counter update, ...) before
+ * calling signal, and a waiter registers itself before running try.  The
+ * barriers on both sides ensure that either the signaler sees the waiter
+ * or the waiter's try sees the event, so the signal can be dropped when
+ * nobody is waiting.
+ */
+static int util_wait_need_signal(struct util_wait *wait)
+{
+	if (wait->exported)
+		return 1;
+
+	ofi_atomic_mb();
+	return ofi_atomic_get32(&wait->waiters);
+}
+
+static void util_wait_enter(struct util_wait *wait)
+{
+	ofi_atomic_inc32(&wait->waiters);
+	ofi_atomic_mb();
+}
+
+static void util_wait_exit(struct util_wait *wait)
+{
+	ofi_atomic_dec32(&wait->waiters);
+}
+
 static void util_wait_fd_signal(struct util_wait *util_wait)
 {
 	struct util_wait_fd *wait;
+
+	if (!util_wait_need_signal(util_wait))
+		return;
+
 	wait = container_of(util_wait, struct util_wait_fd, util_wait);
 	fd_signal_set(&wait->signal);
 }
@@ -170,19 +204,25 @@ static int util_wait_fd_run(struct fid_wait *wait_fid, int timeout)
 	wait = container_of(wait_fid, struct util_wait_fd, util_wait.wait_fid);
 	start = (timeout >= 0) ? fi_gettime_ms() : 0;
 
+	util_wait_enter(&wait->util_wait);
 	while (1) {
 		ret = wait->util_wait.try(&wait->util_wait);
 		if (ret)
-			return ret == -FI_EAGAIN ? 0 : ret;
+			break;
 
 		if (timeout >= 0) {
 			timeout -= (int) (fi_gettime_ms() - start);
-			if (timeout <= 0)
-				return -FI_ETIMEDOUT;
+			if (timeout <= 0) {
+				ret = -FI_ETIMEDOUT;
+				break;
+			}
+			start = fi_gettime_ms();
 		}
 
 		fi_epoll_wait(wait->epoll_fd, timeout);
 	}
+	util_wait_exit(&wait->util_wait);
+	return ret == -FI_EAGAIN ? 0 : ret;
 }
 
 static int util_wait_fd_control(struct fid *fid, int command, void *arg)
@@ -195,6 +235,7 @@ static int util_wait_fd_control(struct fid *fid, int command, void *arg)
 	case FI_GETWAIT:
 #ifdef HAVE_EPOLL
 		*(int *) arg = wait->epoll_fd;
+		wait->util_wait.exported = 1;
 		ret = 0;
 #else
 		ret = -FI_ENOSYS;
@@ -311,3 +352,199 @@ err1:
 	free(wait);
 	return ret;
 }
+
+static void util_wait_cond_signal(struct util_wait *util_wait)
+{
+	struct util_wait_cond *wait;
+
+	if (!util_wait_need_signal(util_wait))
+		return;
+
+	wait = container_of(util_wait, struct util_wait_cond, util_wait);
+	pthread_mutex_lock(&wait->mutex);
+	wait->signaled = 1;
+	pthread_cond_broadcast(&wait->cond);
+	pthread_mutex_unlock(&wait->mutex);
+}
+
+static int util_wait_cond_try(struct util_wait *wait)
+{
+	struct util_wait_cond *wait_cond;
+	void *context;
+	int ret;
+
+	wait_cond = container_of(wait, struct util_wait_cond, util_wait);
+	if (wait_cond->signaled) {
+		pthread_mutex_lock(&wait_cond->mutex);
+		wait_cond->signaled = 0;
+		pthread_mutex_unlock(&wait_cond->mutex);
+	}
+	ret = fi_poll(&wait->pollset->poll_fid, &context, 1);
+	return (ret > 0) ? -FI_EAGAIN : ret;
+}
+
+/*
+ * Poll the wait set for a short while before sleeping on the condition.
+ * Completions that arrive within the spin window are picked up without
+ * the signaler having to wake anyone.
+ */
+static int util_wait_cond_run(struct fid_wait *wait_fid, int timeout)
+{
+	struct util_wait_cond *wait;
+	uint64_t end;
+	int ret, spin;
+
+	wait = container_of(wait_fid, struct util_wait_cond, util_wait.wait_fid);
+	end = (timeout >= 0) ? fi_gettime_ms() + timeout : 0;
+
+	util_wait_enter(&wait->util_wait);
+	while (1) {
+		for (spin = 0; spin < UTIL_WAIT_SPIN_COUNT; spin++) {
+			ret = wait->util_wait.try(&wait->util_wait);
+			if (ret)
+				goto out;
+		}
+
+		if (timeout >= 0) {
+			timeout = (int) (end - fi_gettime_ms());
+			if (timeout <= 0) {
+				ret = -FI_ETIMEDOUT;
+				goto out;
+			}
+		}
+
+		pthread_mutex_lock(&wait->mutex);
+		if (!wait->signaled)
+			fi_wait_cond(&wait->cond, &wait->mutex, timeout);
+		pthread_mutex_unlock(&wait->mutex);
+	}
+out:
+	util_wait_exit(&wait->util_wait);
+	return ret == -FI_EAGAIN ? 0 : ret;
+}
+
+static int util_wait_cond_control(struct fid *fid, int command, void *arg)
+{
+	struct util_wait_cond *wait;
+	struct fi_mutex_cond *mut_cond;
+	int ret;
+
+	wait = container_of(fid, struct util_wait_cond, util_wait.wait_fid.fid);
+	switch (command) {
+	case FI_GETWAIT:
+		mut_cond = arg;
+		mut_cond->mutex = &wait->mutex;
+		mut_cond->cond = &wait->cond;
+		wait->util_wait.exported = 1;
+		ret = 0;
+		break;
+	default:
+		FI_INFO(wait->util_wait.prov, FI_LOG_FABRIC,
+			"unsupported command\n");
+		ret = -FI_ENOSYS;
+		break;
+	}
+	return ret;
+}
+
+static int util_wait_cond_close(struct fid *fid)
+{
+	struct util_wait_cond *wait;
+	int ret;
+
+	wait = container_of(fid, struct util_wait_cond, util_wait.wait_fid.fid);
+	ret = fi_wait_cleanup(&wait->util_wait);
+	if (ret)
+		return ret;
+
+	pthread_cond_destroy(&wait->cond);
+	pthread_mutex_destroy(&wait->mutex);
+	free(wait);
+	return 0;
+}
+
+static struct fi_ops_wait util_wait_cond_ops = {
+	.size = sizeof(struct fi_ops_wait),
+	.wait = util_wait_cond_run,
+};
+
+static struct fi_ops util_wait_cond_fi_ops = {
+	.size = sizeof(struct fi_ops),
+	.close = util_wait_cond_close,
+	.bind = fi_no_bind,
+	.control = util_wait_cond_control,
+	.ops_open = fi_no_ops_open,
+};
+
+static int util_verify_wait_cond_attr(const struct fi_provider *prov,
+				      const struct fi_wait_attr *attr)
+{
+	int ret;
+
+	ret = ofi_check_wait_attr(prov, attr);
+	if (ret)
+		return ret;
+
+	if (attr->wait_obj != FI_WAIT_MUTEX_COND) {
+		FI_WARN(prov, FI_LOG_FABRIC, "unsupported wait object\n");
+		return -FI_EINVAL;
+	}
+
+	return 0;
+}
+
+int ofi_wait_cond_open(struct fid_fabric *fabric_fid, struct fi_wait_attr *attr,
+		       struct fid_wait **waitset)
+{
+	struct util_fabric *fabric;
+	struct util_wait_cond *wait;
+	int ret;
+
+	fabric = container_of(fabric_fid, struct util_fabric, fabric_fid);
+	ret = util_verify_wait_cond_attr(fabric->prov, attr);
+	if (ret)
+		return ret;
+
+	wait = calloc(1, sizeof(*wait));
+	if (!wait)
+		return -FI_ENOMEM;
+
+	ret = fi_wait_init(fabric, attr, &wait->util_wait);
+	if (ret)
+		goto err1;
+
+	wait->util_wait.signal = util_wait_cond_signal;
+	wait->util_wait.try = util_wait_cond_try;
+	ret = -pthread_mutex_init(&wait->mutex, NULL);
+	if (ret)
+		goto err2;
+
+	ret = -pthread_cond_init(&wait->cond, NULL);
+	if (ret)
+		goto err3;
+
+	wait->util_wait.wait_fid.fid.ops = &util_wait_cond_fi_ops;
+	wait->util_wait.wait_fid.ops = &util_wait_cond_ops;
+
+	*waitset = &wait->util_wait.wait_fid;
+	return 0;
+
+err3:
+	pthread_mutex_destroy(&wait->mutex);
+err2:
+	fi_wait_cleanup(&wait->util_wait);
+err1:
+	free(wait);
+	return ret;
+}
+
+int ofi_wait_open(struct fid_fabric *fabric, struct fi_wait_attr *attr,
+		  struct fid_wait **waitset)
+{
+	switch (attr->wait_obj) {
+	case FI_WAIT_MUTEX_COND:
+		return ofi_wait_cond_open(fabric, attr, waitset);
+	default:
+		return ofi_wait_fd_open(fabric, attr, waitset);
+	}
+}
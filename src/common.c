@@ -196,6 +196,27 @@ uint64_t fi_gettime_us(void)
 	return now.tv_sec * 1000000 + now.tv_usec;
 }
 
+const char *ofi_hex_str(const uint8_t *data, size_t len)
+{
+	static char str[64];
+	const char hex[] = "0123456789abcdef";
+	size_t i, p;
+
+	if (len >= (sizeof(str) >> 1))
+		len = (sizeof(str) >> 1) - 1;
+
+	for (p = 0, i = 0; i < len; i++) {
+		str[p++] = hex[data[i] >> 4];
+		str[p++] = hex[data[i] & 0xF];
+	}
+
+	if (len == (sizeof(str) >> 1) - 1)
+		str[p++] = '~';
+
+	str[p] = '\0';
+	return str;
+}
+
 const char *ofi_straddr(char *buf, size_t *len,
 			uint32_t addr_format, const void *addr)
 {
@@ -264,11 +285,14 @@ sa_sin6:
 	case FI_ADDR_MLX:
 		size = snprintf(buf, *len, "fi_addr_mlx://%p", addr);
 		break;
-    case FI_ADDR_DPDK:
-        // todo dpdk, what is in addr for dpdk?
-        // %p just prints address that pointer is pointing to
-        size = snprintf(buf, *len, "fi_addr_dpdk://%p", addr);
-        break;
+	case FI_ADDR_DPDK:
+		size = snprintf(buf, *len, "fi_addr_dpdk://"
+				"%02x:%02x:%02x:%02x:%02x:%02x/%" PRIu16,
+				((uint8_t *) addr)[0], ((uint8_t *) addr)[1],
+				((uint8_t *) addr)[2], ((uint8_t *) addr)[3],
+				((uint8_t *) addr)[4], ((uint8_t *) addr)[5],
+				ntohs(*(uint16_t *) ((uint8_t *) addr + 6)));
+		break;
 	case FI_ADDR_STR:
 		size = snprintf(buf, *len, "%s", (const char *) addr);
 		break;
@@ -309,8 +333,8 @@ static uint32_t ofi_addr_format(const char *str)
 		return FI_ADDR_BGQ;
 	else if (!strcasecmp(fmt, "fi_addr_mlx"))
 		return FI_ADDR_MLX;
-    else if (!strcasecmp(fmt, "fi_addr_dpdk"))
-        return FI_ADDR_DPDK;
+	else if (!strcasecmp(fmt, "fi_addr_dpdk"))
+		return FI_ADDR_DPDK;
 
 	return FI_FORMAT_UNSPEC;
 }
@@ -348,6 +372,32 @@ static int ofi_str_to_psmx2(const char *str, void **addr, size_t *len)
 	return -FI_EINVAL;
 }
 
+/* DPDK addresses are an Ethernet address followed by a 16-bit queue id
+ * in network byte order. */
+static int ofi_str_to_dpdk(const char *str, void **addr, size_t *len)
+{
+	uint8_t *mac;
+	uint16_t qid;
+	int ret;
+
+	*len = 8;
+	if (!(*addr = calloc(1, *len)))
+		return -FI_ENOMEM;
+
+	mac = *addr;
+	ret = sscanf(str, "%*[^:]://%" SCNx8 ":%" SCNx8 ":%" SCNx8 ":%"
+		     SCNx8 ":%" SCNx8 ":%" SCNx8 "/%" SCNu16, &mac[0],
+		     &mac[1], &mac[2], &mac[3], &mac[4], &mac[5], &qid);
+	if (ret == 7) {
+		qid = htons(qid);
+		memcpy(mac + 6, &qid, sizeof qid);
+		return 0;
+	}
+
+	free(*addr);
+	return -FI_EINVAL;
+}
+
 static int ofi_str_to_sin(const char *str, void **addr, size_t *len)
 {
 	struct sockaddr_in *sin;
@@ -442,11 +492,12 @@ int ofi_str_toaddr(const char *str, uint32_t *addr_format,
 		return ofi_str_to_psmx(str, addr, len);
 	case FI_ADDR_PSMX2:
 		return ofi_str_to_psmx2(str, addr, len);
+	case FI_ADDR_DPDK:
+		return ofi_str_to_dpdk(str, addr, len);
 	case FI_SOCKADDR_IB:
 	case FI_ADDR_GNI:
 	case FI_ADDR_BGQ:
 	case FI_ADDR_MLX:
-    case FI_ADDR_DPDK;
 	default:
 		return -FI_ENOSYS;
 	}
@@ -39,10 +39,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include <dirent.h>
+#include <limits.h>
 
 #include <rdma/fi_errno.h>
 #include "fi_util.h"
 #include "fi.h"
+#include "fasthash.h"
+#include "fi_iov.h"
 #include "prov.h"
 
 #ifdef HAVE_LIBDL
@@ -61,6 +64,52 @@ pthread_mutex_t ofi_ini_lock = PTHREAD_MUTEX_INITIALIZER;
 
 static struct fi_filter prov_filter;
 
+/*
+ * Provider libraries whose file name matches an excluded provider are
+ * not opened by fi_ini.  The file name does not always match the name
+ * the provider registers under, and utility providers are never
+ * filtered, so they are opened on first use by a query that could
+ * need them.
+ */
+struct ofi_prov_lib {
+	struct slist_entry	entry;
+	char			*path;
+};
+
+static struct slist prov_deferred;
+
+/*
+ * Set under ofi_ini_lock while deferred libraries are opened after fi_ini.
+ * Providers registered then may already be in use by other threads, so a
+ * deferred library never replaces one, and new entries are published to
+ * readers that walk the provider list without the lock.
+ */
+static int prov_late;
+
+/*
+ * fi_getinfo results are cached per process, keyed by the full query.
+ * Entries hold the fabric generation at the time of the query, since
+ * the results reference open fabrics and domains.
+ */
+#define OFI_INFO_CACHE_SIZE 64
+
+struct ofi_info_cache_entry {
+	struct dlist_entry	entry;
+	uint64_t		hash;
+	uint32_t		version;
+	uint32_t		gen;
+	uint64_t		flags;
+	char			*node;
+	char			*service;
+	struct fi_info		*hints;
+	struct fi_info		*info;
+};
+
+static DEFINE_LIST(info_cache);
+static size_t info_cache_cnt;
+static int info_cache_enabled = 1;
+static pthread_mutex_t info_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
 
 static int ofi_find_name(char **names, const char *name)
 {
@@ -116,8 +165,11 @@ static void cleanup_provider(struct fi_provider *provider, void *dlhandle)
 	}
 
 #ifdef HAVE_LIBDL
-	if (dlhandle)
+	if (dlhandle) {
+		/* queued log records reference the library's strings */
+		ofi_log_flush();
 		dlclose(dlhandle);
+	}
 #endif
 }
 
@@ -182,6 +234,14 @@ static int ofi_register_provider(struct fi_provider *provider, void *dlhandle)
 	}
 
 	prov = ofi_getprov(provider->name, strlen(provider->name));
+	if (prov && prov_late) {
+		FI_INFO(&core_prov, FI_LOG_CORE,
+			"a %s provider is already in use; "
+			"ignoring the deferred one\n", provider->name);
+		ret = -FI_EALREADY;
+		goto cleanup;
+	}
+
 	if (prov) {
 		/* If this provider is older than an already-loaded
 		 * provider of the same name, then discard this one.
@@ -217,6 +277,8 @@ static int ofi_register_provider(struct fi_provider *provider, void *dlhandle)
 
 	prov->dlhandle = dlhandle;
 	prov->provider = provider;
+	if (prov_late)
+		ofi_atomic_mb();
 	if (prov_tail)
 		prov_tail->next = prov;
 	else
@@ -331,13 +393,63 @@ void ofi_create_filter(struct fi_filter *filter, const char *raw_filter)
 }
 
 #ifdef HAVE_LIBDL
+static void ofi_ini_lib(const char *lib)
+{
+	void *dlhandle;
+	struct fi_provider* (*inif)(void);
+
+	FI_DBG(&core_prov, FI_LOG_CORE, "opening provider lib %s\n", lib);
+
+	dlhandle = dlopen(lib, RTLD_NOW);
+	if (dlhandle == NULL) {
+		FI_WARN(&core_prov, FI_LOG_CORE,
+		       "dlopen(%s): %s\n", lib, dlerror());
+		return;
+	}
+
+	inif = dlsym(dlhandle, "fi_prov_ini");
+	if (inif == NULL) {
+		FI_WARN(&core_prov, FI_LOG_CORE, "dlsym: %s\n", dlerror());
+		dlclose(dlhandle);
+	} else
+		ofi_register_provider((inif)(), dlhandle);
+}
+
+/* Library names have the form lib<name>-<FI_LIB_SUFFIX> */
+static int ofi_lib_filtered(const char *file)
+{
+	char name[NAME_MAX];
+	size_t len = strlen(file);
+	size_t sfx = sizeof ("-" FI_LIB_SUFFIX) - 1;
+
+	if (strncmp(file, "lib", 3) || len <= sfx + 3 ||
+	    len - sfx - 3 >= sizeof(name))
+		return 0;
+
+	memcpy(name, file + 3, len - sfx - 3);
+	name[len - sfx - 3] = '\0';
+	return ofi_apply_filter(&prov_filter, name);
+}
+
+static int ofi_defer_lib(char *lib)
+{
+	struct ofi_prov_lib *prov_lib;
+
+	prov_lib = calloc(1, sizeof(*prov_lib));
+	if (!prov_lib)
+		return -FI_ENOMEM;
+
+	FI_INFO(&core_prov, FI_LOG_CORE, "deferring provider lib %s\n", lib);
+	prov_lib->path = lib;
+	slist_insert_tail(&prov_lib->entry, &prov_deferred);
+	return 0;
+}
+
 static void ofi_ini_dir(const char *dir)
 {
 	int n = 0;
 	char *lib;
-	void *dlhandle;
 	struct dirent **liblist = NULL;
-	struct fi_provider* (*inif)(void);
 
 	n = scandir(dir, &liblist, lib_filter, NULL);
 	if (n < 0)
@@ -349,24 +461,15 @@ static void ofi_ini_dir(const char *dir)
 			       "asprintf failed to allocate memory\n");
 			goto libdl_done;
 		}
-		FI_DBG(&core_prov, FI_LOG_CORE, "opening provider lib %s\n", lib);
 
-		dlhandle = dlopen(lib, RTLD_NOW);
-		free(liblist[n]);
-		if (dlhandle == NULL) {
-			FI_WARN(&core_prov, FI_LOG_CORE,
-			       "dlopen(%s): %s\n", lib, dlerror());
-			free(lib);
+		if (ofi_lib_filtered(liblist[n]->d_name) && !ofi_defer_lib(lib)) {
+			free(liblist[n]);
 			continue;
 		}
-		free(lib);
 
-		inif = dlsym(dlhandle, "fi_prov_ini");
-		if (inif == NULL) {
-			FI_WARN(&core_prov, FI_LOG_CORE, "dlsym: %s\n", dlerror());
-			dlclose(dlhandle);
-		} else
-			ofi_register_provider((inif)(), dlhandle);
+		free(liblist[n]);
+		ofi_ini_lib(lib);
+		free(lib);
 	}
 
 libdl_done:
@@ -376,6 +479,54 @@ libdl_done:
 }
 #endif
 
+/* Caller must hold ofi_ini_lock */
+static void ofi_ini_deferred(void)
+{
+	struct ofi_prov_lib *prov_lib;
+	struct slist_entry *entry;
+
+	while (!slist_empty(&prov_deferred)) {
+		entry = slist_remove_head(&prov_deferred);
+		prov_lib = container_of(entry, struct ofi_prov_lib, entry);
+#ifdef HAVE_LIBDL
+		ofi_ini_lib(prov_lib->path);
+#endif
+		free(prov_lib->path);
+		free(prov_lib);
+	}
+}
+
+/* With an include list, a listed provider that did not register may
+ * live in a library whose file name differs from the provider name. */
+static int ofi_filter_satisfied(void)
+{
+	int i;
+
+	if (!prov_filter.names || prov_filter.negated)
+		return 1;
+
+	for (i = 0; prov_filter.names[i]; i++) {
+		if (!ofi_getprov(prov_filter.names[i],
+				 strlen(prov_filter.names[i])))
+			return 0;
+	}
+	return 1;
+}
+
+static void ofi_info_cache_flush(void);
+
+static void ofi_load_deferred(void)
+{
+	pthread_mutex_lock(&ofi_ini_lock);
+	if (!slist_empty(&prov_deferred)) {
+		prov_late = 1;
+		ofi_ini_deferred();
+		prov_late = 0;
+		ofi_info_cache_flush();
+	}
+	pthread_mutex_unlock(&ofi_ini_lock);
+}
+
 void fi_ini(void)
 {
 	char *param_val = NULL;
@@ -397,8 +548,24 @@ void fi_ini(void)
 			" (default: no). Setting this to yes could improve"
 			" performance at the expense of making fork() potentially"
 			" unsafe");
+	fi_param_define(NULL, "getinfo_cache", FI_PARAM_BOOL,
+			"Reuse fi_getinfo results for repeated identical"
+			" queries within a process (default: yes)");
 	fi_param_get_str(NULL, "provider", &param_val);
 	ofi_create_filter(&prov_filter, param_val);
+	fi_param_get_bool(NULL, "getinfo_cache", &info_cache_enabled);
+	fi_param_define(NULL, "copy_nt_threshold", FI_PARAM_INT,
+			"Size in bytes at which data copies made by providers"
+			" bypass the cache using non-temporal stores, 0 to"
+			" disable (default: per-thread share of the last level"
+			" cache)");
+	ofi_iov_init();
+	fi_param_define(NULL, "thread_placement", FI_PARAM_STRING,
+			"Where provider progress and helper threads run and"
+			" their buffer pools are allocated on NUMA systems:"
+			" none, buffer (node of the thread opening the"
+			" endpoint) or device (node of the NIC, falling back"
+			" to buffer) (default: device)");
 
 #ifdef HAVE_LIBDL
 	int n = 0;
@@ -440,7 +607,8 @@ libdl_done:
 	ofi_register_provider(BGQ_INIT, NULL);
 	ofi_register_provider(NETDIR_INIT, NULL);
 	ofi_register_provider(RXM_INIT, NULL);
-    ofi_register_provider(DPDK_INIT, NULL);
+	ofi_register_provider(PERF_INIT, NULL);
+	ofi_register_provider(DPDK_INIT, NULL);
 
 	{
 		/* TODO: RXD is not stable for now. Disable it by default */
@@ -460,6 +628,9 @@ libdl_done:
 
 	/* Seriously, read it! */
 
+	if (!ofi_filter_satisfied())
+		ofi_ini_deferred();
+
 	ofi_init = 1;
 
 unlock:
@@ -468,11 +639,21 @@ unlock:
 
 FI_DESTRUCTOR(fi_fini(void))
 {
+	struct ofi_prov_lib *prov_lib;
 	struct ofi_prov *prov;
 
 	if (!ofi_init)
 		return;
 
+	ofi_info_cache_flush();
+
+	while (!slist_empty(&prov_deferred)) {
+		prov_lib = container_of(slist_remove_head(&prov_deferred),
+					struct ofi_prov_lib, entry);
+		free(prov_lib->path);
+		free(prov_lib);
+	}
+
 	while (prov_head) {
 		prov = prov_head;
 		prov_head = prov->next;
@@ -635,6 +816,266 @@ static int ofi_layering_ok(const struct fi_provider *provider,
 	return 1;
 }
 
+static int ofi_str_equal(const char *a, const char *b)
+{
+	return (a && b) ? !strcmp(a, b) : a == b;
+}
+
+static int ofi_mem_equal(const void *a, const void *b, size_t len)
+{
+	return (a && b) ? !memcmp(a, b, len) : a == b;
+}
+
+/*
+ * Attribute structures are compared bytewise after clearing their
+ * pointer fields.  Differences in padding can only cause a miss.
+ */
+static int ofi_hints_equal(const struct fi_info *a, const struct fi_info *b)
+{
+	struct fi_ep_attr ep_a, ep_b;
+	struct fi_domain_attr dom_a, dom_b;
+	struct fi_fabric_attr fab_a, fab_b;
+
+	if (!a || !b)
+		return a == b;
+
+	if (a->caps != b->caps || a->mode != b->mode ||
+	    a->addr_format != b->addr_format ||
+	    a->src_addrlen != b->src_addrlen ||
+	    a->dest_addrlen != b->dest_addrlen ||
+	    !ofi_mem_equal(a->src_addr, b->src_addr, a->src_addrlen) ||
+	    !ofi_mem_equal(a->dest_addr, b->dest_addr, a->dest_addrlen) ||
+	    !ofi_mem_equal(a->tx_attr, b->tx_attr, sizeof(*a->tx_attr)) ||
+	    !ofi_mem_equal(a->rx_attr, b->rx_attr, sizeof(*a->rx_attr)))
+		return 0;
+
+	if (!a->ep_attr || !b->ep_attr) {
+		if (a->ep_attr != b->ep_attr)
+			return 0;
+	} else {
+		ep_a = *a->ep_attr;
+		ep_b = *b->ep_attr;
+		ep_a.auth_key = ep_b.auth_key = NULL;
+		if (memcmp(&ep_a, &ep_b, sizeof(ep_a)) ||
+		    !ofi_mem_equal(a->ep_attr->auth_key, b->ep_attr->auth_key,
+				   ep_a.auth_key_size))
+			return 0;
+	}
+
+	if (!a->domain_attr || !b->domain_attr) {
+		if (a->domain_attr != b->domain_attr)
+			return 0;
+	} else {
+		dom_a = *a->domain_attr;
+		dom_b = *b->domain_attr;
+		dom_a.name = dom_b.name = NULL;
+		dom_a.auth_key = dom_b.auth_key = NULL;
+		if (memcmp(&dom_a, &dom_b, sizeof(dom_a)) ||
+		    !ofi_str_equal(a->domain_attr->name, b->domain_attr->name) ||
+		    !ofi_mem_equal(a->domain_attr->auth_key,
+				   b->domain_attr->auth_key,
+				   dom_a.auth_key_size))
+			return 0;
+	}
+
+	if (!a->fabric_attr || !b->fabric_attr)
+		return a->fabric_attr == b->fabric_attr;
+
+	fab_a = *a->fabric_attr;
+	fab_b = *b->fabric_attr;
+	fab_a.name = fab_b.name = NULL;
+	fab_a.prov_name = fab_b.prov_name = NULL;
+	return !memcmp(&fab_a, &fab_b, sizeof(fab_a)) &&
+	       ofi_str_equal(a->fabric_attr->name, b->fabric_attr->name) &&
+	       ofi_str_equal(a->fabric_attr->prov_name,
+			     b->fabric_attr->prov_name);
+}
+
+/* Queries against open objects are answered by the providers directly */
+static int ofi_info_cacheable(const struct fi_info *hints)
+{
+	if (!info_cache_enabled)
+		return 0;
+
+	return !hints || (!hints->handle &&
+		(!hints->fabric_attr || !hints->fabric_attr->fabric) &&
+		(!hints->domain_attr || !hints->domain_attr->domain));
+}
+
+static uint64_t ofi_info_cache_hash(uint32_t version, const char *node,
+				    const char *service, uint64_t flags,
+				    const struct fi_info *hints)
+{
+	uint64_t hash;
+
+	hash = fasthash64(&flags, sizeof flags, version);
+	if (node)
+		hash = fasthash64(node, strlen(node), hash);
+	if (service)
+		hash = fasthash64(service, strlen(service), hash);
+	if (hints) {
+		hash = fasthash64(&hints->caps, sizeof hints->caps, hash);
+		if (hints->ep_attr)
+			hash = fasthash64(&hints->ep_attr->type,
+					  sizeof hints->ep_attr->type, hash);
+		if (hints->fabric_attr && hints->fabric_attr->prov_name)
+			hash = fasthash64(hints->fabric_attr->prov_name,
+					  strlen(hints->fabric_attr->prov_name),
+					  hash);
+	}
+	return hash;
+}
+
+static struct fi_info *ofi_dupinfo_list(const struct fi_info *info)
+{
+	struct fi_info *head = NULL, *tail = NULL, *cur;
+
+	for (; info; info = info->next) {
+		cur = fi_dupinfo(info);
+		if (!cur) {
+			fi_freeinfo(head);
+			return NULL;
+		}
+
+		if (!head)
+			head = cur;
+		else
+			tail->next = cur;
+		tail = cur;
+	}
+	return head;
+}
+
+static void ofi_info_cache_free(struct ofi_info_cache_entry *entry)
+{
+	dlist_remove(&entry->entry);
+	info_cache_cnt--;
+	free(entry->node);
+	free(entry->service);
+	fi_freeinfo(entry->hints);
+	fi_freeinfo(entry->info);
+	free(entry);
+}
+
+static void ofi_info_cache_flush(void)
+{
+	pthread_mutex_lock(&info_cache_lock);
+	while (!dlist_empty(&info_cache))
+		ofi_info_cache_free(container_of(info_cache.next,
+				struct ofi_info_cache_entry, entry));
+	pthread_mutex_unlock(&info_cache_lock);
+}
+
+/* Caller must hold info_cache_lock */
+static struct ofi_info_cache_entry *
+ofi_info_cache_find(uint64_t hash, uint32_t version, const char *node,
+		    const char *service, uint64_t flags,
+		    const struct fi_info *hints)
+{
+	struct ofi_info_cache_entry *entry;
+	struct dlist_entry *item;
+
+	dlist_foreach(&info_cache, item) {
+		entry = container_of(item, struct ofi_info_cache_entry, entry);
+		if (entry->hash == hash && entry->version == version &&
+		    entry->flags == flags &&
+		    ofi_str_equal(entry->node, node) &&
+		    ofi_str_equal(entry->service, service) &&
+		    ofi_hints_equal(entry->hints, hints))
+			return entry;
+	}
+	return NULL;
+}
+
+static int ofi_info_cache_get(uint64_t hash, uint32_t version,
+			      const char *node, const char *service,
+			      uint64_t flags, const struct fi_info *hints,
+			      uint32_t gen, struct fi_info **info)
+{
+	struct ofi_info_cache_entry *entry;
+	int ret = -FI_ENODATA;
+
+	pthread_mutex_lock(&info_cache_lock);
+	entry = ofi_info_cache_find(hash, version, node, service, flags, hints);
+	if (entry) {
+		if (entry->gen != gen) {
+			ofi_info_cache_free(entry);
+		} else {
+			/* keep recently used entries at the head */
+			dlist_remove(&entry->entry);
+			dlist_insert_head(&entry->entry, &info_cache);
+			*info = ofi_dupinfo_list(entry->info);
+			ret = *info ? 0 : -FI_ENOMEM;
+		}
+	}
+	pthread_mutex_unlock(&info_cache_lock);
+	return ret;
+}
+
+static void ofi_info_cache_put(uint64_t hash, uint32_t version,
+			       const char *node, const char *service,
+			       uint64_t flags, const struct fi_info *hints,
+			       uint32_t gen, const struct fi_info *info)
+{
+	struct ofi_info_cache_entry *entry;
+
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return;
+
+	entry->hash = hash;
+	entry->version = version;
+	entry->gen = gen;
+	entry->flags = flags;
+	if ((node && !(entry->node = strdup(node))) ||
+	    (service && !(entry->service = strdup(service))) ||
+	    (hints && !(entry->hints = fi_dupinfo(hints))) ||
+	    !(entry->info = ofi_dupinfo_list(info)))
+		goto err;
+
+	pthread_mutex_lock(&info_cache_lock);
+	if (ofi_info_cache_find(hash, version, node, service, flags, hints)) {
+		pthread_mutex_unlock(&info_cache_lock);
+		goto err;
+	}
+
+	if (info_cache_cnt == OFI_INFO_CACHE_SIZE)
+		ofi_info_cache_free(container_of(info_cache.prev,
+				struct ofi_info_cache_entry, entry));
+	dlist_insert_head(&entry->entry, &info_cache);
+	info_cache_cnt++;
+	pthread_mutex_unlock(&info_cache_lock);
+	return;
+
+err:
+	free(entry->node);
+	free(entry->service);
+	fi_freeinfo(entry->hints);
+	fi_freeinfo(entry->info);
+	free(entry);
+}
+
+/*
+ * Deferred libraries can only be skipped when the query names registered
+ * providers that rule out any other layering: an explicit util;core pair,
+ * or the sockets provider alone.
+ */
+static int ofi_need_deferred(const char *util_name, size_t util_len,
+			     const char *core_name, size_t core_len)
+{
+	if (slist_empty(&prov_deferred))
+		return 0;
+
+	if (util_name && core_name)
+		return !ofi_getprov(util_name, util_len) ||
+		       !ofi_getprov(core_name, core_len);
+
+	if (core_name && !strncasecmp(core_name, "sockets", core_len))
+		return !ofi_getprov(core_name, core_len);
+
+	return 1;
+}
+
 __attribute__((visibility ("default")))
 int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 		const char *service, uint64_t flags,
@@ -644,7 +1085,9 @@ int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 	struct fi_info *tail, *cur;
 	const char *util_name = NULL, *core_name = NULL;
 	size_t util_len = 0, core_len = 0;
-	int ret;
+	uint64_t hash = 0;
+	uint32_t gen = 0;
+	int ret, cache;
 
 	if (!ofi_init)
 		fi_ini();
@@ -656,6 +1099,8 @@ int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 	}
 
 	if (flags == FI_PROV_ATTR_ONLY) {
+		if (!slist_empty(&prov_deferred))
+			ofi_load_deferred();
 		return ofi_getprovinfo(info);
 	}
 
@@ -666,6 +1111,18 @@ int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 					  &core_len);
 	}
 
+	if (ofi_need_deferred(util_name, util_len, core_name, core_len))
+		ofi_load_deferred();
+
+	cache = ofi_info_cacheable(hints);
+	if (cache) {
+		gen = ofi_fabric_get_gen();
+		hash = ofi_info_cache_hash(version, node, service, flags, hints);
+		if (!ofi_info_cache_get(hash, version, node, service, flags,
+					hints, gen, info))
+			return 0;
+	}
+
 	*info = tail = NULL;
 	for (prov = prov_head; prov; prov = prov->next) {
 		if (!ofi_layering_ok(prov->provider, util_name, util_len,
@@ -711,7 +1168,13 @@ int DEFAULT_SYMVER_PRE(fi_getinfo)(uint32_t version, const char *node,
 		tail->fabric_attr->api_version = version;
 	}
 
-	return *info ? 0 : -FI_ENODATA;
+	if (!*info)
+		return -FI_ENODATA;
+
+	if (cache)
+		ofi_info_cache_put(hash, version, node, service, flags, hints,
+				   gen, *info);
+	return 0;
 }
 CURRENT_SYMVER(fi_getinfo_, fi_getinfo);
 
@@ -861,6 +1324,10 @@ int DEFAULT_SYMVER_PRE(fi_fabric)(struct fi_fabric_attr *attr,
 		return -FI_EINVAL;
 
 	prov = ofi_getprov(top_name, len);
+	if (!prov && !slist_empty(&prov_deferred)) {
+		ofi_load_deferred();
+		prov = ofi_getprov(top_name, len);
+	}
 	if (!prov || !prov->provider->fabric)
 		return -FI_ENODEV;
 
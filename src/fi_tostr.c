@@ -141,7 +141,7 @@ static void fi_tostr_addr_format(char *buf, uint32_t addr_format)
 	CASEENUMSTR(FI_ADDR_GNI);
 	CASEENUMSTR(FI_ADDR_BGQ);
 	CASEENUMSTR(FI_ADDR_MLX);
-    CASEENUMSTR(FI_ADDR_DPDK);
+	CASEENUMSTR(FI_ADDR_DPDK);
 	CASEENUMSTR(FI_ADDR_STR);
 	default:
 		if (addr_format & FI_PROV_SPECIFIC)
@@ -238,7 +238,6 @@ static void fi_tostr_protocol(char *buf, uint32_t protocol)
 	CASEENUMSTR(FI_PROTO_PSMX);
 	CASEENUMSTR(FI_PROTO_PSMX2);
 	CASEENUMSTR(FI_PROTO_UDP);
-    CASEENUMSTR(FI_PROTO_DPDK);
 	CASEENUMSTR(FI_PROTO_SOCK_TCP);
 	CASEENUMSTR(FI_PROTO_IB_RDM);
 	CASEENUMSTR(FI_PROTO_IWARP_RDM);
@@ -246,7 +245,7 @@ static void fi_tostr_protocol(char *buf, uint32_t protocol)
 	CASEENUMSTR(FI_PROTO_RXM);
 	CASEENUMSTR(FI_PROTO_RXD);
 	CASEENUMSTR(FI_PROTO_MLX);
-    CASEENUMSTR(FI_PROTO_DPDK);
+	CASEENUMSTR(FI_PROTO_DPDK);
 	CASEENUMSTR(FI_PROTO_NETWORKDIRECT);
 	default:
 		if (protocol & FI_PROV_SPECIFIC)
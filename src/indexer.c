@@ -42,34 +42,47 @@
 /*
  * Indexer - to find a structure given an index
  *
- * We store pointers using a double lookup and return an index to the
- * user which is then used to retrieve the pointer.  The upper bits of
- * the index are itself an index into an array of memory allocations.
- * The lower bits specify the offset into the allocated memory where
- * the pointer is stored.
+ * We store pointers using a three level lookup and return an index to
+ * the user which is then used to retrieve the pointer.  The upper bits
+ * of the index select a block from the directory, the middle bits a
+ * leaf array within that block, and the lower bits specify the offset
+ * into the leaf where the pointer is stored.
  *
- * This allows us to adjust the number of pointers stored by the index
- * list without taking a lock during data lookups.
+ * Allocations are never moved once made, which allows us to adjust the
+ * number of pointers stored by the index list without taking a lock
+ * during data lookups.
  */
 
 static int ofi_idx_grow(struct indexer *idx)
 {
-	union ofi_idx_entry *entry;
+	union ofi_idx_entry *entry, ***dir;
 	int i, start_index;
 
 	if (idx->size >= OFI_IDX_ARRAY_SIZE)
 		goto nomem;
 
-	idx->array[idx->size] = calloc(OFI_IDX_ENTRY_SIZE, sizeof(union ofi_idx_entry));
-	if (!idx->array[idx->size])
-		goto nomem;
-
-	entry = idx->array[idx->size];
 	start_index = idx->size << OFI_IDX_ENTRY_BITS;
-	entry[OFI_IDX_ENTRY_SIZE - 1].next = idx->free_list;
+	if (!idx->array) {
+		idx->array = calloc(OFI_IDX_DIR_SIZE, sizeof(*idx->array));
+		if (!idx->array)
+			goto nomem;
+	}
+
+	dir = &idx->array[ofi_idx_dir_index(start_index)];
+	if (!*dir) {
+		*dir = calloc(OFI_IDX_MID_SIZE, sizeof(**dir));
+		if (!*dir)
+			goto nomem;
+	}
 
+	entry = calloc(OFI_IDX_ENTRY_SIZE, sizeof(union ofi_idx_entry));
+	if (!entry)
+		goto nomem;
+
+	entry[OFI_IDX_ENTRY_SIZE - 1].next = ofi_idx_link(idx->free_list);
 	for (i = OFI_IDX_ENTRY_SIZE - 2; i >= 0; i--)
-		entry[i].next = start_index + i + 1;
+		entry[i].next = ofi_idx_link(start_index + i + 1);
+	(*dir)[ofi_idx_mid_index(start_index)] = entry;
 
 	/* Index 0 is reserved */
 	if (start_index == 0)
@@ -93,9 +106,9 @@ int ofi_idx_insert(struct indexer *idx, void *item)
 			return index;
 	}
 
-	entry = idx->array[ofi_idx_array_index(index)];
-	idx->free_list = entry[ofi_idx_entry_index(index)].next;
-	entry[ofi_idx_entry_index(index)].item = item;
+	entry = ofi_idx_slot(idx, index);
+	idx->free_list = ofi_idx_unlink(entry->next);
+	entry->item = item;
 	return index;
 }
 
@@ -104,89 +117,139 @@ void *ofi_idx_remove(struct indexer *idx, int index)
 	union ofi_idx_entry *entry;
 	void *item;
 
-	entry = idx->array[ofi_idx_array_index(index)];
-	item = entry[ofi_idx_entry_index(index)].item;
-	entry[ofi_idx_entry_index(index)].next = idx->free_list;
+	entry = ofi_idx_slot(idx, index);
+	item = entry->item;
+	entry->next = ofi_idx_link(idx->free_list);
 	idx->free_list = index;
 	return item;
 }
 
 void ofi_idx_replace(struct indexer *idx, int index, void *item)
 {
-	union ofi_idx_entry *entry;
-
-	entry = idx->array[ofi_idx_array_index(index)];
-	entry[ofi_idx_entry_index(index)].item = item;
+	ofi_idx_slot(idx, index)->item = item;
 }
 
 void ofi_idx_reset(struct indexer *idx)
 {
-	while (idx->size) {
-		free(idx->array[idx->size - 1]);
-		idx->array[idx->size - 1] = NULL;
-		idx->size--;
+	int i, j;
+
+	if (idx->array) {
+		for (i = 0; i < OFI_IDX_DIR_SIZE && idx->array[i]; i++) {
+			for (j = 0; j < OFI_IDX_MID_SIZE; j++)
+				free(idx->array[i][j]);
+			free(idx->array[i]);
+		}
+		free(idx->array);
+		idx->array = NULL;
 	}
+	idx->size = 0;
 	idx->free_list = 0;
 }
 
-static int ofi_idm_grow(struct index_map *idm, int index)
+static void **ofi_idm_grow(struct index_map *idm, int index)
 {
-	idm->array[ofi_idx_array_index(index)] = calloc(OFI_IDX_ENTRY_SIZE, sizeof(void *));
-	if (!idm->array[ofi_idx_array_index(index)])
+	struct ofi_idm_block **block;
+	void **entry;
+
+	if (!idm->array) {
+		idm->array = calloc(OFI_IDX_DIR_SIZE, sizeof(*idm->array));
+		if (!idm->array)
+			goto nomem;
+	}
+
+	block = &idm->array[ofi_idx_dir_index(index)];
+	if (!*block) {
+		*block = calloc(1, sizeof(**block));
+		if (!*block)
+			goto nomem;
+	}
+
+	entry = calloc(OFI_IDX_ENTRY_SIZE, sizeof(void *));
+	if (!entry)
 		goto nomem;
 
-	return index;
+	(*block)->leaf[ofi_idx_mid_index(index)] = entry;
+	(*block)->used++;
+	return entry;
 
 nomem:
 	errno = ENOMEM;
-	return -1;
+	return NULL;
 }
 
 int ofi_idm_set(struct index_map *idm, int index, void *item)
 {
+	struct ofi_idm_block *block;
 	void **entry;
 
-	if (index > OFI_IDX_MAX_INDEX) {
+	if (index < 0) {
 		errno = ENOMEM;
 		return -1;
 	}
 
-	if (!idm->array[ofi_idx_array_index(index)]) {
-		if (ofi_idm_grow(idm, index) < 0)
+	block = idm->array ? idm->array[ofi_idx_dir_index(index)] : NULL;
+	entry = block ? block->leaf[ofi_idx_mid_index(index)] : NULL;
+	if (!entry) {
+		entry = ofi_idm_grow(idm, index);
+		if (!entry)
 			return -1;
+		block = idm->array[ofi_idx_dir_index(index)];
 	}
 
-	entry = idm->array[ofi_idx_array_index(index)];
+	/* Replacing an entry does not change the leaf's population */
+	if (!entry[ofi_idx_entry_index(index)] && item)
+		block->count[ofi_idx_mid_index(index)]++;
+	else if (entry[ofi_idx_entry_index(index)] && !item)
+		block->count[ofi_idx_mid_index(index)]--;
 	entry[ofi_idx_entry_index(index)] = item;
-	idm->count[ofi_idx_array_index(index)]++;
 	return index;
 }
 
 void *ofi_idm_clear(struct index_map *idm, int index)
 {
+	struct ofi_idm_block *block;
 	void **entry;
 	void *item;
 
-	entry = idm->array[ofi_idx_array_index(index)];
+	if (!ofi_idm_lookup(idm, index))
+		return NULL;
+
+	block = idm->array[ofi_idx_dir_index(index)];
+	entry = block->leaf[ofi_idx_mid_index(index)];
 	item = entry[ofi_idx_entry_index(index)];
 	entry[ofi_idx_entry_index(index)] = NULL;
-	if (--idm->count[ofi_idx_array_index(index)] == 0) {
-		free(idm->array[ofi_idx_array_index(index)]);
-		idm->array[ofi_idx_array_index(index)] = NULL;
+	if (--block->count[ofi_idx_mid_index(index)] == 0) {
+		free(entry);
+		block->leaf[ofi_idx_mid_index(index)] = NULL;
+		if (--block->used == 0) {
+			free(block);
+			idm->array[ofi_idx_dir_index(index)] = NULL;
+		}
 	}
 	return item;
 }
 
 void ofi_idm_reset(struct index_map *idm)
 {
-	int i;
-
-	for (i=0; i<OFI_IDX_ARRAY_SIZE; i++) {
-		if (idm->array[i]) {
-			free(idm->array[i]);
-			idm->array[i] = NULL;
-			idm->count[i] = 0;
+	struct ofi_idm_block *block;
+	int i, j;
+
+	if (!idm->array)
+		return;
+
+	for (i = 0; i < OFI_IDX_DIR_SIZE; i++) {
+		block = idm->array[i];
+		if (!block)
+			continue;
+
+		for (j = 0; j < OFI_IDX_MID_SIZE && block->used; j++) {
+			if (block->leaf[j]) {
+				free(block->leaf[j]);
+				block->used--;
+			}
 		}
+		free(block);
 	}
+	free(idm->array);
+	idm->array = NULL;
 }
-
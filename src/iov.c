@@ -33,10 +33,83 @@
 #include "config.h"
 
 #include <string.h>
+#include <unistd.h>
 
 #include <fi.h>
 #include <fi_iov.h>
 
+#if defined(__x86_64__) && defined(__SSE2__)
+#include <emmintrin.h>
+#define OFI_HAVE_COPY_NT 1
+#else
+#define OFI_HAVE_COPY_NT 0
+#endif
+
+size_t ofi_copy_nt_threshold = SIZE_MAX;
+
+/*
+ * Streaming stores pay off once a copy no longer fits in this thread's
+ * share of the last level cache; smaller copies are likely to be read
+ * again while still cached.  FI_COPY_NT_THRESHOLD overrides the default,
+ * with 0 disabling non-temporal copies.
+ */
+void ofi_iov_init(void)
+{
+	long cache = -1, l2 = -1, cpus;
+	int threshold;
+
+	if (!OFI_HAVE_COPY_NT)
+		return;
+
+#if defined(_SC_LEVEL3_CACHE_SIZE) && defined(_SC_LEVEL2_CACHE_SIZE)
+	cache = sysconf(_SC_LEVEL3_CACHE_SIZE);
+	l2 = sysconf(_SC_LEVEL2_CACHE_SIZE);
+#endif
+	cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (cache > 0 && cpus > 0)
+		ofi_copy_nt_threshold = MAX(cache / cpus, l2);
+
+	if (!fi_param_get_int(NULL, "copy_nt_threshold", &threshold))
+		ofi_copy_nt_threshold = threshold > 0 ? threshold : SIZE_MAX;
+}
+
+#if OFI_HAVE_COPY_NT
+void ofi_memcpy_nt(void *dst, const void *src, size_t len)
+{
+	__m128i x0, x1, x2, x3;
+	const char *s = src;
+	char *d = dst;
+	size_t head;
+
+	/* streaming stores must be 16 byte aligned */
+	head = MIN((size_t) (-(uintptr_t) d & 15), len);
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	len -= head;
+
+	for (; len >= 64; d += 64, s += 64, len -= 64) {
+		x0 = _mm_loadu_si128((const __m128i *) s);
+		x1 = _mm_loadu_si128((const __m128i *) (s + 16));
+		x2 = _mm_loadu_si128((const __m128i *) (s + 32));
+		x3 = _mm_loadu_si128((const __m128i *) (s + 48));
+		_mm_stream_si128((__m128i *) d, x0);
+		_mm_stream_si128((__m128i *) (d + 16), x1);
+		_mm_stream_si128((__m128i *) (d + 32), x2);
+		_mm_stream_si128((__m128i *) (d + 48), x3);
+	}
+
+	/* streaming stores are weakly ordered */
+	_mm_sfence();
+	memcpy(d, s, len);
+}
+#else
+void ofi_memcpy_nt(void *dst, const void *src, size_t len)
+{
+	memcpy(dst, src, len);
+}
+#endif
+
 uint64_t ofi_copy_iov_buf(const struct iovec *iov, size_t iov_count,
 			uint64_t iov_offset, void *buf, uint64_t bufsize,
 			int dir)
@@ -58,9 +131,9 @@ uint64_t ofi_copy_iov_buf(const struct iovec *iov, size_t iov_count,
 
 		len = MIN(len, bufsize);
 		if (dir == OFI_COPY_BUF_TO_IOV)
-			memcpy(iov_buf, (char *) buf + done, len);
+			ofi_memcpy(iov_buf, (char *) buf + done, len);
 		else if (dir == OFI_COPY_IOV_TO_BUF)
-			memcpy((char *) buf + done, iov_buf, len);
+			ofi_memcpy((char *) buf + done, iov_buf, len);
 
 		iov_offset = 0;
 		bufsize -= len;
@@ -32,9 +32,13 @@
  *
  */
 
+#include <errno.h>
+#include <inttypes.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include <rdma/fi_errno.h>
 
@@ -82,25 +86,723 @@ uint64_t log_mask;
 struct fi_filter prov_log_filter;
 
 
-const char *ofi_hex_str(const uint8_t *data, size_t len)
+/*
+ * Asynchronous logging.  When FI_LOG_ASYNC is set, fi_log() does not format
+ * or write anything.  Each logging thread owns a single producer ring into
+ * which it copies a binary record: timestamp, provider, subsystem, call site,
+ * format pointer and the raw arguments.  A flusher thread merges the rings by
+ * timestamp, formats the records and writes them out.  Records are dropped,
+ * and counted, if a ring is full; logging never blocks the caller.
+ *
+ * Format and function strings are referenced by pointer, so rings must be
+ * drained before a provider library is unloaded (see ofi_log_flush).
+ */
+enum {
+	OFI_LOG_REC_MAX		= 1024,
+	OFI_LOG_REC_PAD		= 0xffff,
+	OFI_LOG_SPEC_MAX	= 32,
+	OFI_LOG_FLUSH_US	= 1000,
+};
+
+enum ofi_log_arg {
+	OFI_LOG_ARG_NONE,
+	OFI_LOG_ARG_INT,
+	OFI_LOG_ARG_LONG,
+	OFI_LOG_ARG_LLONG,
+	OFI_LOG_ARG_SIZE,
+	OFI_LOG_ARG_INTMAX,
+	OFI_LOG_ARG_PTRDIFF,
+	OFI_LOG_ARG_DOUBLE,
+	OFI_LOG_ARG_LDOUBLE,
+	OFI_LOG_ARG_PTR,
+	OFI_LOG_ARG_STR,
+	OFI_LOG_ARG_ERRNO,
+	OFI_LOG_ARG_INVALID,
+};
+
+struct ofi_log_spec {
+	const char		*start;
+	size_t			len;
+	int			stars;
+	enum ofi_log_arg	type;
+};
+
+struct ofi_log_rec {
+	uint32_t		size;
+	uint16_t		level;
+	uint16_t		subsys;
+	uint64_t		time;
+	const struct fi_provider *prov;
+	const char		*func;
+	const char		*fmt;
+	int			line;
+	uint64_t		data[];
+};
+
+struct ofi_log_ring {
+	struct dlist_entry	entry;
+	ofi_atomic64_t		head;
+	ofi_atomic64_t		tail;
+	ofi_atomic64_t		dropped;
+	ofi_atomic32_t		closed;
+	uint64_t		reported;
+	unsigned int		id;
+	size_t			mask;
+	char			*buf;
+};
+
+static int log_async;
+static size_t log_async_size = 1 << 20;
+static FILE *log_file;
+static pthread_key_t log_ring_key;
+static __thread struct ofi_log_ring *log_ring;
+static DEFINE_LIST(log_rings);
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned int log_ring_cnt;
+static pthread_t log_thread;
+static int log_thread_run;
+
+static inline FILE *ofi_log_out(void)
+{
+	return log_file ? log_file : stderr;
+}
+
+/* Parse the conversion starting at the '%' in fmt.  Positional arguments,
+ * wide characters and %n are reported as invalid. */
+static const char *ofi_log_parse(const char *fmt, struct ofi_log_spec *spec)
+{
+	const char *p = fmt + 1;
+	int len_mod = 0;
+
+	spec->start = fmt;
+	spec->stars = 0;
+
+	while (*p && strchr("-+ #0'", *p))
+		p++;
+	if (*p == '*') {
+		spec->stars++;
+		p++;
+	} else {
+		while (*p >= '0' && *p <= '9')
+			p++;
+		if (*p == '$')
+			goto invalid;
+	}
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->stars++;
+			p++;
+		} else {
+			while (*p >= '0' && *p <= '9')
+				p++;
+		}
+	}
+
+	switch (*p) {
+	case 'h':
+		p += (p[1] == 'h') ? 2 : 1;
+		break;
+	case 'l':
+		if (p[1] == 'l') {
+			len_mod = 'q';
+			p += 2;
+		} else {
+			len_mod = 'l';
+			p++;
+		}
+		break;
+	case 'q':
+	case 'L':
+	case 'j':
+	case 'z':
+	case 'Z':
+	case 't':
+		len_mod = *p++;
+		break;
+	}
+
+	switch (*p) {
+	case 'd': case 'i': case 'o': case 'u': case 'x': case 'X':
+		switch (len_mod) {
+		case 'l':
+			spec->type = OFI_LOG_ARG_LONG;
+			break;
+		case 'q':
+		case 'L':
+			spec->type = OFI_LOG_ARG_LLONG;
+			break;
+		case 'j':
+			spec->type = OFI_LOG_ARG_INTMAX;
+			break;
+		case 'z':
+		case 'Z':
+			spec->type = OFI_LOG_ARG_SIZE;
+			break;
+		case 't':
+			spec->type = OFI_LOG_ARG_PTRDIFF;
+			break;
+		default:
+			spec->type = OFI_LOG_ARG_INT;
+			break;
+		}
+		break;
+	case 'c':
+		if (len_mod)
+			goto invalid;
+		spec->type = OFI_LOG_ARG_INT;
+		break;
+	case 'e': case 'E': case 'f': case 'F':
+	case 'g': case 'G': case 'a': case 'A':
+		spec->type = (len_mod == 'L') ?
+			     OFI_LOG_ARG_LDOUBLE : OFI_LOG_ARG_DOUBLE;
+		break;
+	case 's':
+		if (len_mod)
+			goto invalid;
+		spec->type = OFI_LOG_ARG_STR;
+		break;
+	case 'p':
+		spec->type = OFI_LOG_ARG_PTR;
+		break;
+	case 'm':
+		spec->type = OFI_LOG_ARG_ERRNO;
+		break;
+	case '%':
+		spec->type = OFI_LOG_ARG_NONE;
+		break;
+	default:
+		goto invalid;
+	}
+
+	spec->len = ++p - fmt;
+	if (spec->len >= OFI_LOG_SPEC_MAX)
+		goto invalid;
+	return p;
+
+invalid:
+	spec->type = OFI_LOG_ARG_INVALID;
+	return NULL;
+}
+
+/* Strings are stored as a length followed by the NUL terminated string. */
+static size_t ofi_log_put_str(char *data, size_t avail, const char *str)
+{
+	uint64_t len;
+
+	if (avail < 2 * sizeof(uint64_t))
+		return 0;
+
+	len = strlen(str);
+	if (len >= avail - sizeof(uint64_t))
+		len = avail - sizeof(uint64_t) - 1;
+	*(uint64_t *) data = len;
+	memcpy(data + sizeof(uint64_t), str, len);
+	data[sizeof(uint64_t) + len] = '\0';
+	return sizeof(uint64_t) + ((len + 8) & ~7);
+}
+
+/* Copy the arguments consumed by fmt into data.  Returns the number of
+ * bytes used, or -1 if fmt contains a conversion that cannot be deferred. */
+static ssize_t ofi_log_capture(char *data, size_t size, const char *fmt,
+			       va_list vargs, int err)
+{
+	struct ofi_log_spec spec;
+	long double ldval;
+	size_t off = 0;
+	int i;
+
+	for (fmt = strchr(fmt, '%'); fmt; fmt = strchr(fmt, '%')) {
+		fmt = ofi_log_parse(fmt, &spec);
+		if (!fmt)
+			return -1;
+
+		/* the largest fixed size argument is a long double and
+		 * two '*' ints */
+		if (size - off < 4 * sizeof(uint64_t))
+			return off;
+
+		for (i = 0; i < spec.stars; i++) {
+			*(int64_t *) (data + off) = va_arg(vargs, int);
+			off += sizeof(uint64_t);
+		}
+
+		switch (spec.type) {
+		case OFI_LOG_ARG_INT:
+			*(int64_t *) (data + off) = va_arg(vargs, int);
+			break;
+		case OFI_LOG_ARG_LONG:
+			*(int64_t *) (data + off) = va_arg(vargs, long);
+			break;
+		case OFI_LOG_ARG_LLONG:
+			*(int64_t *) (data + off) = va_arg(vargs, long long);
+			break;
+		case OFI_LOG_ARG_SIZE:
+			*(uint64_t *) (data + off) = va_arg(vargs, size_t);
+			break;
+		case OFI_LOG_ARG_INTMAX:
+			*(int64_t *) (data + off) = va_arg(vargs, intmax_t);
+			break;
+		case OFI_LOG_ARG_PTRDIFF:
+			*(int64_t *) (data + off) = va_arg(vargs, ptrdiff_t);
+			break;
+		case OFI_LOG_ARG_DOUBLE:
+			*(double *) (data + off) = va_arg(vargs, double);
+			break;
+		case OFI_LOG_ARG_LDOUBLE:
+			ldval = va_arg(vargs, long double);
+			memcpy(data + off, &ldval, sizeof(ldval));
+			off += (sizeof(long double) + 7) & ~7;
+			continue;
+		case OFI_LOG_ARG_PTR:
+			*(void **) (data + off) = va_arg(vargs, void *);
+			break;
+		case OFI_LOG_ARG_STR:
+			off += ofi_log_put_str(data + off, size - off,
+					       va_arg(vargs, char *) ?: "(null)");
+			continue;
+		case OFI_LOG_ARG_ERRNO:
+			off += ofi_log_put_str(data + off, size - off,
+					       strerror(err));
+			continue;
+		default:
+			continue;
+		}
+		off += sizeof(uint64_t);
+	}
+	return off;
+}
+
+/* Inverse of ofi_log_capture: expand rec into buf, returns length. */
+static size_t ofi_log_expand(char *buf, size_t size, struct ofi_log_rec *rec)
 {
-	static char str[64];
-	const char hex[] = "0123456789abcdef";
-	size_t i, p;
+	struct ofi_log_spec spec;
+	char sbuf[OFI_LOG_SPEC_MAX];
+	const char *fmt, *next;
+	char *data = (char *) rec->data;
+	char *end = (char *) rec + rec->size;
+	size_t off = 0, need;
+	uint64_t len;
+	long double ldval;
+	int star[2] = { 0, 0 }, i, ret;
 
-	if (len >= (sizeof(str) >> 1))
-		len = (sizeof(str) >> 1) - 1;
+#define OFI_LOG_PRINT(val)						\
+	(spec.stars == 0 ? snprintf(buf + off, size - off, sbuf, val) :	\
+	 spec.stars == 1 ? snprintf(buf + off, size - off, sbuf,	\
+				    star[0], val) :			\
+	 snprintf(buf + off, size - off, sbuf, star[0], star[1], val))
 
-	for (p = 0, i = 0; i < len; i++) {
-		str[p++] = hex[data[i] >> 4];
-		str[p++] = hex[data[i] & 0xF];
+	if (!rec->fmt) {
+		len = *(uint64_t *) data;
+		need = MIN(len, size - 1);
+		memcpy(buf, data + sizeof(uint64_t), need);
+		buf[need] = '\0';
+		return need;
 	}
 
-	if (len == (sizeof(str) >> 1) - 1)
-		str[p++] = '~';
+	for (fmt = rec->fmt; *fmt && off < size - 1; fmt = next) {
+		next = strchr(fmt, '%');
+		if (next != fmt) {
+			need = next ? (size_t) (next - fmt) : strlen(fmt);
+			need = MIN(need, size - 1 - off);
+			memcpy(buf + off, fmt, need);
+			off += need;
+			if (!next)
+				break;
+			continue;
+		}
+
+		next = ofi_log_parse(fmt, &spec);
+		need = spec.stars * sizeof(uint64_t) +
+		       ((spec.type == OFI_LOG_ARG_LDOUBLE) ?
+			((sizeof(long double) + 7) & ~7) : sizeof(uint64_t));
+		if (!next || (spec.type != OFI_LOG_ARG_NONE &&
+			      data + need > end))
+			break;
+
+		memcpy(sbuf, spec.start, spec.len);
+		sbuf[spec.len] = '\0';
+		for (i = 0; i < spec.stars; i++) {
+			star[i] = (int) *(int64_t *) data;
+			data += sizeof(uint64_t);
+		}
 
-	str[p] = '\0';
-	return str;
+		switch (spec.type) {
+		case OFI_LOG_ARG_NONE:
+			ret = snprintf(buf + off, size - off, "%%");
+			break;
+		case OFI_LOG_ARG_INT:
+			ret = OFI_LOG_PRINT((int) *(int64_t *) data);
+			break;
+		case OFI_LOG_ARG_LONG:
+			ret = OFI_LOG_PRINT((long) *(int64_t *) data);
+			break;
+		case OFI_LOG_ARG_LLONG:
+			ret = OFI_LOG_PRINT((long long) *(int64_t *) data);
+			break;
+		case OFI_LOG_ARG_SIZE:
+			ret = OFI_LOG_PRINT((size_t) *(uint64_t *) data);
+			break;
+		case OFI_LOG_ARG_INTMAX:
+			ret = OFI_LOG_PRINT((intmax_t) *(int64_t *) data);
+			break;
+		case OFI_LOG_ARG_PTRDIFF:
+			ret = OFI_LOG_PRINT((ptrdiff_t) *(int64_t *) data);
+			break;
+		case OFI_LOG_ARG_DOUBLE:
+			ret = OFI_LOG_PRINT(*(double *) data);
+			break;
+		case OFI_LOG_ARG_LDOUBLE:
+			memcpy(&ldval, data, sizeof(ldval));
+			ret = OFI_LOG_PRINT(ldval);
+			data += ((sizeof(long double) + 7) & ~7) -
+				sizeof(uint64_t);
+			break;
+		case OFI_LOG_ARG_PTR:
+			ret = OFI_LOG_PRINT(*(void **) data);
+			break;
+		case OFI_LOG_ARG_ERRNO:
+			sbuf[spec.len - 1] = 's';
+			/* fall through */
+		case OFI_LOG_ARG_STR:
+			len = *(uint64_t *) data;
+			data += sizeof(uint64_t);
+			if (data + len + 1 > end)
+				goto out;
+			ret = OFI_LOG_PRINT(data);
+			data += (len + 8) & ~7;
+			off += MIN((size_t) ret, size - 1 - off);
+			continue;
+		default:
+			goto out;
+		}
+		if (spec.type != OFI_LOG_ARG_NONE)
+			data += sizeof(uint64_t);
+		off += MIN((size_t) ret, size - 1 - off);
+	}
+out:
+	buf[off] = '\0';
+	return off;
+#undef OFI_LOG_PRINT
+}
+
+static void ofi_log_ring_close(void *arg)
+{
+	struct ofi_log_ring *ring = arg;
+
+	ofi_atomic_set32(&ring->closed, 1);
+}
+
+static struct ofi_log_ring *ofi_log_ring_create(void)
+{
+	struct ofi_log_ring *ring;
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return NULL;
+
+	ring->buf = malloc(log_async_size);
+	if (!ring->buf) {
+		free(ring);
+		return NULL;
+	}
+
+	ring->mask = log_async_size - 1;
+	ofi_atomic_initialize64(&ring->head, 0);
+	ofi_atomic_initialize64(&ring->tail, 0);
+	ofi_atomic_initialize64(&ring->dropped, 0);
+	ofi_atomic_initialize32(&ring->closed, 0);
+
+	pthread_mutex_lock(&log_lock);
+	ring->id = log_ring_cnt++;
+	dlist_insert_tail(&ring->entry, &log_rings);
+	pthread_mutex_unlock(&log_lock);
+
+	pthread_setspecific(log_ring_key, ring);
+	return ring;
+}
+
+static void ofi_log_ring_free(struct ofi_log_ring *ring)
+{
+	dlist_remove(&ring->entry);
+	free(ring->buf);
+	free(ring);
+}
+
+/* Reserve OFI_LOG_REC_MAX contiguous bytes at the tail of the ring,
+ * wrapping with a pad record if needed.  Only the owning thread calls this. */
+static struct ofi_log_rec *ofi_log_reserve(struct ofi_log_ring *ring,
+					   uint64_t *tail)
+{
+	struct ofi_log_rec *pad;
+	uint64_t head, off, contig;
+
+	head = ofi_atomic_get64(&ring->head);
+	*tail = ofi_atomic_get64(&ring->tail);
+	off = *tail & ring->mask;
+	contig = ring->mask + 1 - off;
+
+	if (contig < OFI_LOG_REC_MAX) {
+		if (*tail + contig + OFI_LOG_REC_MAX - head > ring->mask + 1)
+			return NULL;
+		pad = (struct ofi_log_rec *) (ring->buf + off);
+		pad->size = contig;
+		pad->level = OFI_LOG_REC_PAD;
+		*tail += contig;
+		off = 0;
+	} else if (*tail + OFI_LOG_REC_MAX - head > ring->mask + 1) {
+		return NULL;
+	}
+	return (struct ofi_log_rec *) (ring->buf + off);
+}
+
+static int ofi_log_async(const struct fi_provider *prov,
+			 enum fi_log_level level, enum fi_log_subsys subsys,
+			 const char *func, int line, const char *fmt,
+			 va_list vargs)
+{
+	struct ofi_log_ring *ring = log_ring;
+	struct ofi_log_rec *rec;
+	size_t avail;
+	ssize_t len;
+	uint64_t tail;
+	va_list copy;
+	int err = errno;
+
+	if (!ring) {
+		ring = ofi_log_ring_create();
+		if (!ring)
+			return -FI_ENOMEM;
+		log_ring = ring;
+	}
+
+	rec = ofi_log_reserve(ring, &tail);
+	if (!rec) {
+		ofi_atomic_inc64(&ring->dropped);
+		return 0;
+	}
+
+	rec->level = level;
+	rec->subsys = subsys;
+	rec->time = fi_gettime_us();
+	rec->prov = prov;
+	rec->func = func;
+	rec->line = line;
+	rec->fmt = fmt;
+
+	avail = OFI_LOG_REC_MAX - sizeof(*rec);
+	va_copy(copy, vargs);
+	len = ofi_log_capture((char *) rec->data, avail, fmt, copy, err);
+	va_end(copy);
+	if (len < 0) {
+		/* cannot defer this format, store the formatted text */
+		rec->fmt = NULL;
+		len = vsnprintf((char *) &rec->data[1], avail - sizeof(uint64_t),
+				fmt, vargs);
+		len = MIN((size_t) len, avail - sizeof(uint64_t) - 1);
+		rec->data[0] = len;
+		len = sizeof(uint64_t) + len + 1;
+	}
+
+	rec->size = (sizeof(*rec) + len + 7) & ~7;
+	ofi_atomic_set64(&ring->tail, tail + rec->size);
+	return 0;
+}
+
+static struct ofi_log_rec *ofi_log_peek(struct ofi_log_ring *ring)
+{
+	struct ofi_log_rec *rec;
+	uint64_t head, tail;
+
+	head = ofi_atomic_get64(&ring->head);
+	tail = ofi_atomic_get64(&ring->tail);
+	while (head != tail) {
+		rec = (struct ofi_log_rec *) (ring->buf + (head & ring->mask));
+		if (rec->level != OFI_LOG_REC_PAD)
+			return rec;
+		head += rec->size;
+		ofi_atomic_set64(&ring->head, head);
+	}
+	return NULL;
+}
+
+static void ofi_log_write(struct ofi_log_ring *ring, struct ofi_log_rec *rec)
+{
+	char buf[2048];
+	int size;
+
+	size = snprintf(buf, sizeof(buf), "%s:%u:%" PRIu64 ".%06" PRIu64
+			":%s:%s:%s():%d<%s> ", PACKAGE, ring->id,
+			rec->time / 1000000, rec->time % 1000000,
+			rec->prov->name, log_subsys[rec->subsys], rec->func,
+			rec->line, log_levels[rec->level]);
+	size += ofi_log_expand(buf + size, sizeof(buf) - size, rec);
+	fwrite(buf, 1, size, ofi_log_out());
+}
+
+static void ofi_log_report_drops(struct ofi_log_ring *ring)
+{
+	uint64_t dropped;
+
+	dropped = ofi_atomic_get64(&ring->dropped);
+	if (dropped == ring->reported)
+		return;
+
+	fprintf(ofi_log_out(), "%s:%u: log ring full, dropped %" PRIu64
+		" messages\n", PACKAGE, ring->id, dropped - ring->reported);
+	ring->reported = dropped;
+}
+
+/* Write out all records in timestamp order.  Caller holds log_lock. */
+static size_t ofi_log_drain(void)
+{
+	struct ofi_log_ring *ring, *next_ring;
+	struct ofi_log_rec *rec, *next;
+	struct dlist_entry *item, *tmp;
+	size_t cnt = 0;
+
+	dlist_foreach_container(&log_rings, struct ofi_log_ring, ring, entry)
+		ofi_log_report_drops(ring);
+
+	for (;;) {
+		next = NULL;
+		next_ring = NULL;
+		dlist_foreach_container(&log_rings, struct ofi_log_ring,
+					ring, entry) {
+			rec = ofi_log_peek(ring);
+			if (rec && (!next || rec->time < next->time)) {
+				next = rec;
+				next_ring = ring;
+			}
+		}
+		if (!next)
+			break;
+
+		ofi_log_write(next_ring, next);
+		ofi_atomic_add64(&next_ring->head, next->size);
+		cnt++;
+	}
+
+	for (item = log_rings.next; item != &log_rings; item = tmp) {
+		tmp = item->next;
+		ring = container_of(item, struct ofi_log_ring, entry);
+		if (ofi_atomic_get32(&ring->closed) && !ofi_log_peek(ring)) {
+			ofi_log_report_drops(ring);
+			ofi_log_ring_free(ring);
+		}
+	}
+
+	if (cnt)
+		fflush(ofi_log_out());
+	return cnt;
+}
+
+static void *ofi_log_flusher(void *arg)
+{
+	size_t cnt;
+
+	OFI_UNUSED(arg);
+	for (;;) {
+		pthread_mutex_lock(&log_lock);
+		if (!log_thread_run) {
+			pthread_mutex_unlock(&log_lock);
+			break;
+		}
+		cnt = ofi_log_drain();
+		pthread_mutex_unlock(&log_lock);
+
+		if (!cnt)
+			usleep(OFI_LOG_FLUSH_US);
+	}
+	return NULL;
+}
+
+void ofi_log_flush(void)
+{
+	if (!log_async)
+		return;
+
+	pthread_mutex_lock(&log_lock);
+	ofi_log_drain();
+	pthread_mutex_unlock(&log_lock);
+}
+
+/* Drain before forking so that the child does not repeat queued records. */
+static void ofi_log_fork_prepare(void)
+{
+	pthread_mutex_lock(&log_lock);
+	if (log_async)
+		ofi_log_drain();
+}
+
+static void ofi_log_fork_parent(void)
+{
+	pthread_mutex_unlock(&log_lock);
+}
+
+/* Only the forking thread survives in the child, restart the flusher. */
+static void ofi_log_fork_child(void)
+{
+	pthread_mutex_unlock(&log_lock);
+	if (log_async && pthread_create(&log_thread, NULL,
+					ofi_log_flusher, NULL))
+		log_async = 0;
+}
+
+static void ofi_log_async_init(void)
+{
+	int async = 0, size = 0;
+
+	fi_param_define(NULL, "log_async", FI_PARAM_BOOL,
+			"Record log messages into per-thread rings and format"
+			" them from a background thread (default: no)");
+	fi_param_define(NULL, "log_async_size", FI_PARAM_INT,
+			"Size in bytes of each thread's asynchronous log ring"
+			" (default: 1048576)");
+	fi_param_get_bool(NULL, "log_async", &async);
+	if (!async)
+		return;
+
+	if (!fi_param_get_int(NULL, "log_async_size", &size) && size > 0)
+		log_async_size = MAX(roundup_power_of_two(size),
+				     4 * OFI_LOG_REC_MAX);
+
+	if (pthread_key_create(&log_ring_key, ofi_log_ring_close))
+		return;
+
+	log_thread_run = 1;
+	if (pthread_create(&log_thread, NULL, ofi_log_flusher, NULL)) {
+		pthread_key_delete(log_ring_key);
+		return;
+	}
+	pthread_atfork(ofi_log_fork_prepare, ofi_log_fork_parent,
+		       ofi_log_fork_child);
+	log_async = 1;
+}
+
+static void ofi_log_async_fini(void)
+{
+	struct ofi_log_ring *ring;
+
+	if (!log_async)
+		return;
+
+	pthread_mutex_lock(&log_lock);
+	log_thread_run = 0;
+	pthread_mutex_unlock(&log_lock);
+	pthread_join(log_thread, NULL);
+
+	pthread_mutex_lock(&log_lock);
+	log_async = 0;
+	ofi_log_drain();
+	while (!dlist_empty(&log_rings)) {
+		dlist_pop_front(&log_rings, struct ofi_log_ring, ring, entry);
+		ofi_log_report_drops(ring);
+		free(ring->buf);
+		free(ring);
+	}
+	pthread_mutex_unlock(&log_lock);
+	pthread_key_delete(log_ring_key);
 }
 
 static int fi_convert_log_str(const char *value)
@@ -122,6 +824,7 @@ void fi_log_init(void)
 	struct fi_filter subsys_filter;
 	int level, i;
 	char *levelstr = NULL, *provstr = NULL, *subsysstr = NULL;
+	char *filestr = NULL;
 
 	fi_param_define(NULL, "log_level", FI_PARAM_STRING,
 			"Specify logging level: warn, trace, info, debug (default: warn)");
@@ -144,10 +847,23 @@ void fi_log_init(void)
 			log_mask |= (1 << (i + FI_LOG_SUBSYS_OFFSET));
 	}
 	ofi_free_filter(&subsys_filter);
+
+	fi_param_define(NULL, "log_file", FI_PARAM_STRING,
+			"Append log output to the given file (default: stderr)");
+	fi_param_get_str(NULL, "log_file", &filestr);
+	if (filestr)
+		log_file = fopen(filestr, "a");
+
+	ofi_log_async_init();
 }
 
 void fi_log_fini(void)
 {
+	ofi_log_async_fini();
+	if (log_file) {
+		fclose(log_file);
+		log_file = NULL;
+	}
 	ofi_free_filter(&prov_log_filter);
 }
 
@@ -170,10 +886,18 @@ void DEFAULT_SYMVER_PRE(fi_log)(const struct fi_provider *prov, enum fi_log_leve
 		const char *fmt, ...)
 {
 	char buf[1024];
-	int size;
+	int size, ret;
 
 	va_list vargs;
 
+	if (log_async) {
+		va_start(vargs, fmt);
+		ret = ofi_log_async(prov, level, subsys, func, line, fmt, vargs);
+		va_end(vargs);
+		if (!ret)
+			return;
+	}
+
 	size = snprintf(buf, sizeof(buf), "%s:%s:%s:%s():%d<%s> ", PACKAGE,
 			prov->name, log_subsys[subsys], func, line,
 			log_levels[level]);
@@ -182,6 +906,6 @@ void DEFAULT_SYMVER_PRE(fi_log)(const struct fi_provider *prov, enum fi_log_leve
 	vsnprintf(buf + size, sizeof(buf) - size, fmt, vargs);
 	va_end(vargs);
 
-	fprintf(stderr, "%s", buf);
+	fprintf(ofi_log_out(), "%s", buf);
 }
 DEFAULT_SYMVER(fi_log_, fi_log, FABRIC_1.0);
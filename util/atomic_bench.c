@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This software is available to you under the BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Correctness check and throughput benchmark for the element-wise atomic
+ * write and read-write handlers.  Every handler is run at each SIMD level
+ * supported by the CPU and its result compared bit for bit against the
+ * scalar loop, using a misaligned buffer and an element count that leaves
+ * a scalar tail.  Throughput is then reported per operation and datatype
+ * for each level.
+ */
+
+#include <config.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fi.h>
+#include <ofi_atomic.h>
+
+#include "bench.h"
+
+#define ATOMIC_BENCH_ISA_CNT	(OFI_ATOMIC_ISA_AVX512 + 1)
+#define ATOMIC_BENCH_ELEM_MAX	sizeof(ofi_complex_long_double)
+
+enum atomic_bench_kind {
+	ATOMIC_BENCH_WRITE,
+	ATOMIC_BENCH_READWRITE,
+};
+
+static const char *atomic_bench_isa_str[ATOMIC_BENCH_ISA_CNT] = {
+	[OFI_ATOMIC_ISA_SCALAR] = "scalar",
+	[OFI_ATOMIC_ISA_BASE] = "base",
+	[OFI_ATOMIC_ISA_AVX2] = "avx2",
+	[OFI_ATOMIC_ISA_AVX512] = "avx512",
+};
+
+static char *src, *dst, *res, *orig, *ref, *ref_res;
+
+/* Floating point values stay at or above 1.0 in magnitude so that
+ * repeated products overflow rather than run into denormals. */
+static double atomic_bench_fp(void)
+{
+	double val = 1.0 + (rand() % 1024) / 1024.0;
+
+	return rand() & 1 ? val : -val;
+}
+
+static void atomic_bench_fill(void *buf, enum fi_datatype datatype,
+			      size_t cnt)
+{
+	size_t i;
+
+	switch (datatype) {
+	case FI_FLOAT:
+	case FI_FLOAT_COMPLEX:
+		for (i = 0; i < cnt * ofi_datatype_size(datatype) /
+			    sizeof(float); i++)
+			((float *) buf)[i] = (float) atomic_bench_fp();
+		break;
+	case FI_DOUBLE:
+	case FI_DOUBLE_COMPLEX:
+		for (i = 0; i < cnt * ofi_datatype_size(datatype) /
+			    sizeof(double); i++)
+			((double *) buf)[i] = atomic_bench_fp();
+		break;
+	case FI_LONG_DOUBLE:
+	case FI_LONG_DOUBLE_COMPLEX:
+		memset(buf, 0, cnt * ofi_datatype_size(datatype));
+		for (i = 0; i < cnt * ofi_datatype_size(datatype) /
+			    sizeof(long double); i++)
+			((long double *) buf)[i] = atomic_bench_fp();
+		break;
+	default:
+		for (i = 0; i < cnt * ofi_datatype_size(datatype); i++)
+			((char *) buf)[i] = (char) rand();
+		break;
+	}
+}
+
+static int atomic_bench_valid(enum atomic_bench_kind kind, int op,
+			      int datatype)
+{
+	return kind == ATOMIC_BENCH_WRITE ?
+		ofi_atomic_write_handlers[op][datatype] != NULL :
+		ofi_atomic_readwrite_handlers[op][datatype] != NULL;
+}
+
+static void atomic_bench_run(enum atomic_bench_kind kind, int op,
+			     int datatype, void *dst_buf, void *res_buf,
+			     size_t cnt)
+{
+	if (kind == ATOMIC_BENCH_WRITE)
+		ofi_atomic_write_handlers[op][datatype](dst_buf, src, cnt);
+	else
+		ofi_atomic_readwrite_handlers[op][datatype](dst_buf, src,
+							    res_buf, cnt);
+}
+
+/* Compare each SIMD level against the scalar loop */
+static size_t atomic_bench_check(enum atomic_bench_kind kind, int op,
+				 int datatype, size_t cnt)
+{
+	size_t size = ofi_datatype_size(datatype), errors = 0;
+	int isa;
+
+	atomic_bench_fill(src, datatype, cnt + 1);
+	atomic_bench_fill(orig, datatype, cnt + 1);
+
+	ofi_atomic_isa = OFI_ATOMIC_ISA_SCALAR;
+	memcpy(ref, orig, (cnt + 1) * size);
+	memset(ref_res, 0, (cnt + 1) * size);
+	atomic_bench_run(kind, op, datatype, ref + size, ref_res + size, cnt);
+
+	for (isa = OFI_ATOMIC_ISA_BASE; isa < ATOMIC_BENCH_ISA_CNT; isa++) {
+		if (!ofi_atomic_isa_supported(isa))
+			continue;
+
+		ofi_atomic_isa = isa;
+		memcpy(dst, orig, (cnt + 1) * size);
+		memset(res, 0, (cnt + 1) * size);
+		atomic_bench_run(kind, op, datatype, dst + size, res + size,
+				 cnt);
+		if (memcmp(dst, ref, (cnt + 1) * size) ||
+		    (kind == ATOMIC_BENCH_READWRITE &&
+		     memcmp(res, ref_res, (cnt + 1) * size))) {
+			fprintf(stderr, "mismatch: %s %s %s\n",
+				atomic_bench_isa_str[isa],
+				fi_tostr(&op, FI_TYPE_ATOMIC_OP),
+				fi_tostr(&datatype, FI_TYPE_ATOMIC_TYPE));
+			errors++;
+		}
+	}
+	return errors;
+}
+
+static void atomic_bench_perf(enum atomic_bench_kind kind, int op,
+			      int datatype, size_t cnt, int iters)
+{
+	size_t size = ofi_datatype_size(datatype);
+	uint64_t start;
+	int isa, i;
+
+	printf("%-10s %-8s ", kind == ATOMIC_BENCH_WRITE ?
+	       "write" : "readwrite", fi_tostr(&op, FI_TYPE_ATOMIC_OP));
+	printf("%-26s", fi_tostr(&datatype, FI_TYPE_ATOMIC_TYPE));
+
+	for (isa = 0; isa < ATOMIC_BENCH_ISA_CNT; isa++) {
+		if (!ofi_atomic_isa_supported(isa)) {
+			printf(" %9s", "-");
+			continue;
+		}
+
+		ofi_atomic_isa = isa;
+		atomic_bench_fill(dst, datatype, cnt);
+		start = fi_gettime_us();
+		for (i = 0; i < iters; i++)
+			atomic_bench_run(kind, op, datatype, dst, res, cnt);
+		printf(" %9.1f", bench_mbps(cnt * size * iters,
+					    fi_gettime_us() - start));
+	}
+	printf("\n");
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "usage: %s [-n elements] [-i iterations] [-c]\n"
+		"\t-c  check results only, skip throughput\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	size_t cnt = 4096, errors = 0;
+	int iters = 1000, check_only = 0;
+	int kind, op, datatype, isa;
+
+	while ((op = getopt(argc, argv, "n:i:ch")) != -1) {
+		switch (op) {
+		case 'n':
+			cnt = strtoul(optarg, NULL, 0);
+			break;
+		case 'i':
+			iters = atoi(optarg);
+			break;
+		case 'c':
+			check_only = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (cnt < 2 || iters <= 0) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	src = malloc((cnt + 1) * ATOMIC_BENCH_ELEM_MAX);
+	dst = malloc((cnt + 1) * ATOMIC_BENCH_ELEM_MAX);
+	res = malloc((cnt + 1) * ATOMIC_BENCH_ELEM_MAX);
+	orig = malloc((cnt + 1) * ATOMIC_BENCH_ELEM_MAX);
+	ref = malloc((cnt + 1) * ATOMIC_BENCH_ELEM_MAX);
+	ref_res = malloc((cnt + 1) * ATOMIC_BENCH_ELEM_MAX);
+	if (!src || !dst || !res || !orig || !ref || !ref_res) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	/* Odd counts leave a scalar tail after the vector loop */
+	for (kind = ATOMIC_BENCH_WRITE; kind <= ATOMIC_BENCH_READWRITE; kind++) {
+		for (op = 0; op < OFI_WRITE_OP_LAST; op++) {
+			for (datatype = 0; datatype < FI_DATATYPE_LAST;
+			     datatype++) {
+				if (!atomic_bench_valid(kind, op, datatype))
+					continue;
+				errors += atomic_bench_check(kind, op,
+							     datatype, cnt - 1);
+				errors += atomic_bench_check(kind, op,
+							     datatype, 7);
+			}
+		}
+	}
+
+	if (!check_only) {
+		printf("%-10s %-8s %-26s", "# kind", "op", "datatype");
+		for (isa = 0; isa < ATOMIC_BENCH_ISA_CNT; isa++)
+			printf(" %9s", atomic_bench_isa_str[isa]);
+		printf("   (MB/s)\n");
+
+		for (kind = ATOMIC_BENCH_WRITE;
+		     kind <= ATOMIC_BENCH_READWRITE; kind++) {
+			for (op = 0; op < OFI_WRITE_OP_LAST; op++) {
+				for (datatype = 0; datatype < FI_DATATYPE_LAST;
+				     datatype++) {
+					if (atomic_bench_valid(kind, op,
+							       datatype))
+						atomic_bench_perf(kind, op,
+							datatype, cnt, iters);
+				}
+			}
+		}
+	}
+
+	free(src);
+	free(dst);
+	free(res);
+	free(orig);
+	free(ref);
+	free(ref_res);
+	return bench_errors(errors);
+}
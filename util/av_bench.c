@@ -0,0 +1,205 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This software is available to you under the BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Micro-benchmark for the utility AV: bulk insertion into a growing AV
+ * and FI_SOURCE reverse lookups.  Addresses are packed into a few
+ * subnets with a small range of ports, which is the pattern seen from
+ * large jobs.
+ */
+
+#include <config.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#include <fi_util.h>
+
+#include "bench.h"
+
+#define AV_BENCH_PORTS	64
+
+static struct fi_provider av_bench_prov = {
+	.name = "av_bench",
+	.version = FI_VERSION(1, 0),
+	.fi_version = FI_VERSION(1, 5),
+};
+
+static void av_bench_addr(struct sockaddr_in *sin, size_t i)
+{
+	memset(sin, 0, sizeof *sin);
+	sin->sin_family = AF_INET;
+	sin->sin_addr.s_addr = htonl((10 << 24) + 1 + i / AV_BENCH_PORTS);
+	sin->sin_port = htons(5000 + i % AV_BENCH_PORTS);
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "usage: %s [-n addresses] [-c initial_av_count]\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	struct util_domain domain;
+	struct fi_av_attr attr;
+	struct sockaddr_in *addrs, miss;
+	struct util_av *util_av;
+	struct fid_av *av;
+	fi_addr_t *fi_addrs, *rm_addrs;
+	size_t i, half, cnt = 1 << 20, errors = 0;
+	uint64_t start;
+	int op, ret;
+
+	memset(&attr, 0, sizeof attr);
+	attr.type = FI_AV_TABLE;
+	attr.count = 1024;
+
+	while ((op = getopt(argc, argv, "n:c:h")) != -1) {
+		switch (op) {
+		case 'n':
+			cnt = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			attr.count = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	memset(&domain, 0, sizeof domain);
+	domain.prov = &av_bench_prov;
+	domain.addr_format = FI_SOCKADDR_IN;
+	domain.av_type = FI_AV_UNSPEC;
+	domain.info_domain_caps = FI_SOURCE;
+	ofi_atomic_initialize32(&domain.ref, 0);
+
+	ret = ip_av_create(&domain.domain_fid, &attr, &av, NULL);
+	if (ret) {
+		fprintf(stderr, "ip_av_create: %s\n", fi_strerror(-ret));
+		return EXIT_FAILURE;
+	}
+	util_av = container_of(av, struct util_av, av_fid);
+
+	addrs = calloc(cnt, sizeof(*addrs));
+	fi_addrs = calloc(cnt, sizeof(*fi_addrs));
+	rm_addrs = calloc(cnt, sizeof(*rm_addrs));
+	if (!addrs || !fi_addrs || !rm_addrs) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < cnt; i++)
+		av_bench_addr(&addrs[i], i);
+
+	bench_header();
+
+	start = fi_gettime_us();
+	ret = fi_av_insert(av, addrs, cnt, fi_addrs, 0, NULL);
+	bench_report("insert", cnt, fi_gettime_us() - start);
+	if (ret != (int) cnt) {
+		fprintf(stderr, "inserted %d of %zu addresses\n", ret, cnt);
+		return EXIT_FAILURE;
+	}
+	if (util_av->count < cnt || util_av->hash.used != cnt) {
+		fprintf(stderr, "av size %zu, %zu hashed after growth\n",
+			util_av->count, util_av->hash.used);
+		errors++;
+	}
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		if (ip_av_get_index(util_av, &addrs[i]) != (int) fi_addrs[i])
+			errors++;
+	}
+	bench_report("lookup_hit", cnt, fi_gettime_us() - start);
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		av_bench_addr(&miss, i + cnt);
+		if (ip_av_get_index(util_av, &miss) >= 0)
+			errors++;
+	}
+	bench_report("lookup_miss", cnt, fi_gettime_us() - start);
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		if (memcmp(ip_av_get_addr(util_av, (int) fi_addrs[i]),
+			   &addrs[i], sizeof(addrs[i])))
+			errors++;
+	}
+	bench_report("addr_get", cnt, fi_gettime_us() - start);
+
+	/* Odd addresses first: removing them leaves gaps in every probe
+	 * run that the backward-shift delete must close. */
+	half = cnt / 2;
+	for (i = 0; i < cnt; i++)
+		rm_addrs[i & 1 ? i / 2 : half + i / 2] = fi_addrs[i];
+
+	start = fi_gettime_us();
+	ret = fi_av_remove(av, rm_addrs, half, 0);
+	bench_report("remove_half", half, fi_gettime_us() - start);
+	if (ret) {
+		fprintf(stderr, "fi_av_remove: %s\n", fi_strerror(-ret));
+		errors++;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		ret = ip_av_get_index(util_av, &addrs[i]);
+		if (i & 1 ? ret >= 0 : ret != (int) fi_addrs[i])
+			errors++;
+	}
+
+	start = fi_gettime_us();
+	ret = fi_av_remove(av, &rm_addrs[half], cnt - half, 0);
+	bench_report("remove", cnt - half, fi_gettime_us() - start);
+	if (ret) {
+		fprintf(stderr, "fi_av_remove: %s\n", fi_strerror(-ret));
+		errors++;
+	}
+	if (util_av->hash.used) {
+		fprintf(stderr, "%zu addresses hashed after removal\n",
+			util_av->hash.used);
+		errors++;
+	}
+
+	printf("# av size %zu, hash size %zu\n",
+	       util_av->count, util_av->hash.size);
+
+	fi_close(&av->fid);
+	free(rm_addrs);
+	free(fi_addrs);
+	free(addrs);
+	return bench_errors(errors);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This software is available to you under the BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fi.h>
+
+#include "bench.h"
+
+void bench_header(void)
+{
+	printf("%-16s %10s %12s %10s\n", "# test", "count", "total(ms)",
+	       "ns/op");
+}
+
+void bench_report(const char *test, size_t cnt, uint64_t usec)
+{
+	printf("%-16s %10zu %12.3f %10.1f\n", test, cnt, usec / 1e3,
+	       cnt ? usec * 1e3 / cnt : 0.0);
+}
+
+/* Bytes per microsecond, which is MB/s */
+double bench_mbps(size_t bytes, uint64_t usec)
+{
+	return usec ? (double) bytes / usec : 0.0;
+}
+
+/* Prints the error footer and returns the exit status */
+int bench_errors(size_t errors)
+{
+	printf("# errors %zu\n", errors);
+	return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,20 @@
+#! /bin/sh
+#
+# Runs the internal benchmarks with small counts, as checks of the code
+# they measure.  Each benchmark exits non-zero on a result mismatch.
+
+set -ex
+
+./util/fi_av_bench -n 4096 -c 16
+# a port of its own, clear of a name server already running
+./util/fi_ns_bench -n 1000 -p 12346
+./util/fi_idx_bench -n 5000 -s 3
+./util/fi_getinfo_bench -p UDP -e dgram -n 100 -c 2 -g
+./util/fi_log_bench -n 2000 -t 4 -c log_bench.out
+# a ring of a few records wraps constantly
+FI_LOG_ASYNC=1 FI_LOG_ASYNC_SIZE=4096 \
+	./util/fi_log_bench -n 2000 -t 4 -c log_bench.out
+rm -f log_bench.out
+# odd counts leave a scalar tail behind the vector loops
+./util/fi_atomic_bench -c -n 1001
+./util/fi_copy_bench -c -s 100000
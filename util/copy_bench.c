@@ -0,0 +1,291 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This software is available to you under the BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Correctness check and throughput benchmark for the iov copy routines.
+ * The single iov fast path and the non-temporal copy are compared byte
+ * for byte against memcpy over misaligned buffers, offsets and truncated
+ * lengths.  Throughput is then reported across copy sizes for the
+ * generic iov loop, the inline single iov path with cached stores, the
+ * same path with non-temporal stores, and the default threshold.
+ */
+
+#include <config.h>
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fi.h>
+#include <fi_iov.h>
+
+#include "bench.h"
+
+#define COPY_BENCH_ALIGN	64
+#define COPY_BENCH_IOV_CNT	3
+#define COPY_BENCH_CHECK_MAX	((1 << 20) + 13)
+
+enum copy_bench_mode {
+	COPY_BENCH_LOOP,
+	COPY_BENCH_INLINE,
+	COPY_BENCH_NT,
+	COPY_BENCH_AUTO,
+	COPY_BENCH_MODE_CNT,
+};
+
+static const char *copy_bench_mode_str[COPY_BENCH_MODE_CNT] = {
+	[COPY_BENCH_LOOP] = "loop",
+	[COPY_BENCH_INLINE] = "inline",
+	[COPY_BENCH_NT] = "nt",
+	[COPY_BENCH_AUTO] = "auto",
+};
+
+static char *src, *dst, *ref;
+static size_t default_threshold;
+
+static void copy_bench_fill(char *buf, size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = (char) rand();
+}
+
+/* Expected result of copying buf into iov past iov_offset */
+static uint64_t copy_bench_ref(const struct iovec *iov, size_t iov_count,
+			       uint64_t iov_offset, const char *buf,
+			       uint64_t bufsize)
+{
+	uint64_t done = 0, len;
+	size_t i;
+
+	for (i = 0; i < iov_count; i++) {
+		if (iov_offset >= iov[i].iov_len) {
+			iov_offset -= iov[i].iov_len;
+			continue;
+		}
+		len = iov[i].iov_len - iov_offset;
+		len = len < bufsize - done ? len : bufsize - done;
+		memcpy((char *) iov[i].iov_base + iov_offset + (ref - dst),
+		       buf + done, len);
+		done += len;
+		iov_offset = 0;
+	}
+	return done;
+}
+
+/*
+ * Split len bytes of dst into iov_count pieces.  The reference copy is
+ * written at the same offsets within ref.
+ */
+static void copy_bench_iov(struct iovec *iov, size_t iov_count, size_t skew,
+			   size_t len)
+{
+	size_t i, off = skew;
+
+	for (i = 0; i < iov_count; i++) {
+		iov[i].iov_base = dst + off;
+		iov[i].iov_len = i < iov_count - 1 ? len / iov_count :
+			len - (iov_count - 1) * (len / iov_count);
+		off += iov[i].iov_len;
+	}
+}
+
+static size_t copy_bench_check_one(size_t len, size_t skew, size_t iov_count,
+				   uint64_t iov_offset, uint64_t bufsize)
+{
+	struct iovec iov[COPY_BENCH_IOV_CNT];
+	uint64_t done, expect;
+	char *buf = src + (skew * 7) % COPY_BENCH_ALIGN;
+	size_t total = len + 2 * COPY_BENCH_ALIGN;
+
+	copy_bench_fill(dst, total);
+	memcpy(ref, dst, total);
+	copy_bench_fill(buf, bufsize);
+	copy_bench_iov(iov, iov_count, skew, len);
+
+	expect = copy_bench_ref(iov, iov_count, iov_offset, buf, bufsize);
+	done = ofi_copy_to_iov(iov, iov_count, iov_offset, buf, bufsize);
+	if (done != expect || memcmp(dst, ref, total)) {
+		fprintf(stderr, "to_iov mismatch: len %zu skew %zu iov %zu "
+			"offset %" PRIu64 " bufsize %" PRIu64 "\n",
+			len, skew, iov_count, iov_offset, bufsize);
+		return 1;
+	}
+
+	memset(ref, 0, bufsize);
+	done = ofi_copy_from_iov(ref, bufsize, iov, iov_count, iov_offset);
+	if (done != expect || memcmp(ref, buf, done)) {
+		fprintf(stderr, "from_iov mismatch: len %zu skew %zu iov %zu "
+			"offset %" PRIu64 " bufsize %" PRIu64 "\n",
+			len, skew, iov_count, iov_offset, bufsize);
+		return 1;
+	}
+	return 0;
+}
+
+/* Checks the sizes up to max_len */
+static size_t copy_bench_check(size_t max_len)
+{
+	static const size_t lens[] = { 0, 1, 15, 16, 17, 63, 64, 65, 127,
+				       1000, 4096, 65536 + 13,
+				       COPY_BENCH_CHECK_MAX };
+	size_t i, skew, iov_count, len, errors = 0;
+	int nt;
+
+	for (nt = 0; nt < 2; nt++) {
+		ofi_copy_nt_threshold = nt ? 1 : SIZE_MAX;
+		for (i = 0; i < sizeof(lens) / sizeof(lens[0]) &&
+			    lens[i] <= max_len; i++) {
+			len = lens[i];
+			for (skew = 0; skew < 16; skew += 3) {
+				for (iov_count = 1;
+				     iov_count <= COPY_BENCH_IOV_CNT;
+				     iov_count += 2) {
+					errors += copy_bench_check_one(len,
+						skew, iov_count, 0, len);
+					errors += copy_bench_check_one(len,
+						skew, iov_count, len / 3,
+						len);
+					errors += copy_bench_check_one(len,
+						skew, iov_count, 0, len / 2);
+					errors += copy_bench_check_one(len,
+						skew, iov_count, len + 1, len);
+				}
+			}
+		}
+	}
+	ofi_copy_nt_threshold = default_threshold;
+	return errors;
+}
+
+static void copy_bench_perf(size_t len, size_t total)
+{
+	struct iovec iov;
+	uint64_t start;
+	size_t i, iters;
+	int mode;
+
+	iters = total / len ? total / len : 1;
+	iov.iov_base = dst;
+	iov.iov_len = len;
+	printf("%12zu", len);
+
+	for (mode = 0; mode < COPY_BENCH_MODE_CNT; mode++) {
+		ofi_copy_nt_threshold = mode == COPY_BENCH_NT ? 1 :
+					mode == COPY_BENCH_AUTO ?
+					default_threshold : SIZE_MAX;
+
+		/* touch the destination outside the timed loop */
+		memset(dst, 0, len);
+		start = fi_gettime_us();
+		for (i = 0; i < iters; i++) {
+			if (mode == COPY_BENCH_LOOP)
+				ofi_copy_iov_buf(&iov, 1, 0, src, len,
+						 OFI_COPY_BUF_TO_IOV);
+			else
+				ofi_copy_to_iov(&iov, 1, 0, src, len);
+		}
+		printf(" %9.1f", bench_mbps(len * iters,
+					    fi_gettime_us() - start));
+	}
+	printf("\n");
+	ofi_copy_nt_threshold = default_threshold;
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "usage: %s [-s max size] [-b bytes per size] [-c]\n"
+		"\t-c  check results only, skip throughput\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	size_t max_len = 64 << 20, total = 1 << 30, errors = 0, len, size;
+	int check_only = 0, mode, op;
+
+	while ((op = getopt(argc, argv, "s:b:ch")) != -1) {
+		switch (op) {
+		case 's':
+			max_len = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			total = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			check_only = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (max_len < 64 || !total) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	ofi_iov_init();
+	default_threshold = ofi_copy_nt_threshold;
+
+	size = (max_len > COPY_BENCH_CHECK_MAX ? max_len :
+		COPY_BENCH_CHECK_MAX) + 2 * COPY_BENCH_ALIGN;
+	src = malloc(size);
+	dst = malloc(size);
+	ref = malloc(size);
+	if (!src || !dst || !ref) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	copy_bench_fill(src, size);
+	errors = copy_bench_check(max_len);
+
+	if (!check_only) {
+		if (default_threshold == SIZE_MAX)
+			printf("# nt threshold: disabled\n");
+		else
+			printf("# nt threshold: %zu\n", default_threshold);
+
+		printf("%12s", "# size");
+		for (mode = 0; mode < COPY_BENCH_MODE_CNT; mode++)
+			printf(" %9s", copy_bench_mode_str[mode]);
+		printf("   (MB/s)\n");
+
+		for (len = 64; len <= max_len; len *= 4)
+			copy_bench_perf(len, total);
+	}
+
+	free(src);
+	free(dst);
+	free(ref);
+	return bench_errors(errors);
+}
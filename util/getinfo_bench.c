@@ -0,0 +1,217 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This software is available to you under the BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Startup benchmark for fi_getinfo: time library initialization plus the
+ * first query in freshly forked processes, then repeated identical
+ * queries in one process.  Run with FI_GETINFO_CACHE=0 to compare against
+ * uncached queries, and with FI_PROVIDER to measure deferred loading.
+ */
+
+#include <config.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <rdma/fabric.h>
+#include <rdma/fi_errno.h>
+
+#include <fi.h>
+
+#include "bench.h"
+
+static int getinfo_bench_query(const char *node, struct fi_info *hints)
+{
+	struct fi_info *info;
+	int ret;
+
+	ret = fi_getinfo(FI_VERSION(1, 5), node, NULL, 0, hints, &info);
+	if (!ret)
+		fi_freeinfo(info);
+	return ret;
+}
+
+/* Returns whether any result references the open fabric */
+static int getinfo_bench_find(const char *node, struct fi_info *hints,
+			      struct fid_fabric *fabric)
+{
+	struct fi_info *info, *cur;
+	int ret;
+
+	ret = fi_getinfo(FI_VERSION(1, 5), node, NULL, 0, hints, &info);
+	if (ret)
+		return ret;
+
+	for (cur = info; cur && cur->fabric_attr->fabric != fabric;
+	     cur = cur->next)
+		;
+	ret = cur != NULL;
+	fi_freeinfo(info);
+	return ret;
+}
+
+/*
+ * Opening or closing a fabric bumps the fabric generation, so cached
+ * results must not be reused across it.  Needs a provider that reports
+ * open fabrics, such as one built on util_getinfo.
+ */
+static size_t getinfo_bench_check_gen(const char *node, struct fi_info *hints)
+{
+	struct fid_fabric *fabric;
+	struct fi_info *info;
+	size_t errors = 0;
+	int ret;
+
+	ret = fi_getinfo(FI_VERSION(1, 5), node, NULL, 0, hints, &info);
+	if (ret) {
+		fprintf(stderr, "fi_getinfo: %s\n", fi_strerror(-ret));
+		return 1;
+	}
+
+	ret = fi_fabric(info->fabric_attr, &fabric, NULL);
+	fi_freeinfo(info);
+	if (ret) {
+		fprintf(stderr, "fi_fabric: %s\n", fi_strerror(-ret));
+		return 1;
+	}
+
+	if (getinfo_bench_find(node, hints, fabric) != 1) {
+		fprintf(stderr, "open fabric missing from results\n");
+		errors++;
+	}
+
+	fi_close(&fabric->fid);
+	if (getinfo_bench_find(node, hints, fabric) != 0) {
+		fprintf(stderr, "closed fabric still in results\n");
+		errors++;
+	}
+	return errors;
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "usage: %s [-p provider] [-e rdm|msg|dgram] "
+		"[-a node] [-n queries] [-c processes] [-g]\n"
+		"\t-g  check that opening and closing a fabric invalidates "
+		"cached results\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	struct fi_info *hints;
+	char *node = NULL;
+	size_t i, cnt = 10000, procs = 32, errors = 0;
+	uint64_t start;
+	pid_t pid;
+	int op, ret, status, check_gen = 0;
+
+	hints = fi_allocinfo();
+	if (!hints) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	while ((op = getopt(argc, argv, "p:e:a:n:c:gh")) != -1) {
+		switch (op) {
+		case 'p':
+			hints->fabric_attr->prov_name = strdup(optarg);
+			break;
+		case 'e':
+			if (!strcasecmp(optarg, "msg"))
+				hints->ep_attr->type = FI_EP_MSG;
+			else if (!strcasecmp(optarg, "dgram"))
+				hints->ep_attr->type = FI_EP_DGRAM;
+			else
+				hints->ep_attr->type = FI_EP_RDM;
+			break;
+		case 'a':
+			node = optarg;
+			break;
+		case 'n':
+			cnt = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			procs = strtoul(optarg, NULL, 0);
+			break;
+		case 'g':
+			check_gen = 1;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	bench_header();
+
+	/* The parent has not initialized the library yet, so every child
+	 * pays for fi_ini and its first query. */
+	if (procs) {
+		start = fi_gettime_us();
+		for (i = 0; i < procs; i++) {
+			pid = fork();
+			if (pid < 0) {
+				perror("fork");
+				return EXIT_FAILURE;
+			}
+			if (!pid)
+				_exit(getinfo_bench_query(node, hints) ? 1 : 0);
+
+			if (waitpid(pid, &status, 0) < 0 ||
+			    !WIFEXITED(status) || WEXITSTATUS(status))
+				errors++;
+		}
+		bench_report("startup", procs,
+				     fi_gettime_us() - start);
+	}
+
+	start = fi_gettime_us();
+	ret = getinfo_bench_query(node, hints);
+	bench_report("first_query", 1, fi_gettime_us() - start);
+	if (ret) {
+		fprintf(stderr, "fi_getinfo: %s\n", fi_strerror(-ret));
+		return EXIT_FAILURE;
+	}
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		if (getinfo_bench_query(node, hints))
+			errors++;
+	}
+	bench_report("repeat_query", cnt, fi_gettime_us() - start);
+
+	if (check_gen)
+		errors += getinfo_bench_check_gen(node, hints);
+
+	fi_freeinfo(hints);
+	return bench_errors(errors);
+}
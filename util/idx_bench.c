@@ -0,0 +1,197 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This software is available to you under the BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Micro-benchmark for the indexer and index map: fill, look up and
+ * drain a table well past the old 64K entry limit.  Index map keys are
+ * spread out by a stride to exercise sparse tables, the pattern seen
+ * when connections are keyed by AV index in large jobs.
+ */
+
+#include <config.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fi.h>
+#include <fi_indexer.h>
+
+#include "bench.h"
+
+/* Visit the indices in a fixed pseudo-random order */
+static size_t idx_bench_shuffle(size_t i, size_t cnt)
+{
+	return (i * 2654435761UL) % cnt;
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "usage: %s [-n entries] [-s index_map_stride]\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	struct indexer idx;
+	struct index_map idm;
+	int *index;
+	size_t i, j, cnt = 1 << 20, stride = 7, errors = 0;
+	uint64_t start;
+	int op, size;
+
+	while ((op = getopt(argc, argv, "n:s:h")) != -1) {
+		switch (op) {
+		case 'n':
+			cnt = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			stride = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (!cnt || !stride || (cnt - 1) * stride > OFI_IDX_MAX_INDEX) {
+		fprintf(stderr, "entries * stride exceeds the maximum index\n");
+		return EXIT_FAILURE;
+	}
+
+	index = calloc(cnt, sizeof(*index));
+	if (!index) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	memset(&idx, 0, sizeof idx);
+	memset(&idm, 0, sizeof idm);
+
+	bench_header();
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		index[i] = ofi_idx_insert(&idx, &index[i]);
+		if (index[i] <= 0)
+			errors++;
+	}
+	bench_report("idx_insert", cnt, fi_gettime_us() - start);
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		if (ofi_idx_lookup(&idx, index[i]) != &index[i])
+			errors++;
+	}
+	bench_report("idx_lookup_seq", cnt, fi_gettime_us() - start);
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		j = idx_bench_shuffle(i, cnt);
+		if (ofi_idx_lookup(&idx, index[j]) != &index[j])
+			errors++;
+	}
+	bench_report("idx_lookup_rand", cnt, fi_gettime_us() - start);
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		if (ofi_idx_remove(&idx, index[i]) != &index[i])
+			errors++;
+	}
+	bench_report("idx_remove", cnt, fi_gettime_us() - start);
+
+	/* Removed slots hold free list links, which must not read back as
+	 * items, and are reused before the indexer grows again. */
+	size = idx.size;
+	for (i = 0; i < cnt; i++) {
+		if (ofi_idx_lookup(&idx, index[i]))
+			errors++;
+	}
+	for (i = 0; i < cnt; i++) {
+		index[i] = ofi_idx_insert(&idx, &index[i]);
+		if (ofi_idx_lookup(&idx, index[i]) != &index[i])
+			errors++;
+	}
+	if (idx.size != size)
+		errors++;
+	ofi_idx_reset(&idx);
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		if (ofi_idm_set(&idm, (int) (i * stride), &index[i]) < 0)
+			errors++;
+	}
+	bench_report("idm_set", cnt, fi_gettime_us() - start);
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		if (ofi_idm_lookup(&idm, (int) (i * stride)) != &index[i])
+			errors++;
+	}
+	bench_report("idm_lookup_seq", cnt, fi_gettime_us() - start);
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		j = idx_bench_shuffle(i, cnt);
+		if (ofi_idm_lookup(&idm, (int) (j * stride)) != &index[j])
+			errors++;
+	}
+	bench_report("idm_lookup_rand", cnt, fi_gettime_us() - start);
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		if (ofi_idm_lookup(&idm, (int) (i * stride + 1)) &&
+		    stride > 1)
+			errors++;
+	}
+	bench_report("idm_lookup_miss", cnt, fi_gettime_us() - start);
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		if (ofi_idm_clear(&idm, (int) (i * stride)) != &index[i])
+			errors++;
+	}
+	bench_report("idm_clear", cnt, fi_gettime_us() - start);
+
+	for (i = 0; i < cnt; i++) {
+		if (ofi_idm_lookup(&idm, (int) (i * stride)))
+			errors++;
+	}
+
+	if (idm.array) {
+		for (i = 0; i < OFI_IDX_DIR_SIZE; i++) {
+			if (idm.array[i])
+				errors++;
+		}
+	}
+	ofi_idm_reset(&idm);
+
+	free(index);
+	return bench_errors(errors);
+}
@@ -0,0 +1,269 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This software is available to you under the BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Throughput benchmark for fi_log: several threads log a typical data path
+ * message as fast as they can.  Compare FI_LOG_ASYNC=0 and FI_LOG_ASYNC=1,
+ * with FI_LOG_FILE=/dev/null to leave out the cost of the output device.
+ * With -c, the messages are written to a file and checked instead.
+ */
+
+#include <config.h>
+
+#include <getopt.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include <rdma/fabric.h>
+#include <rdma/providers/fi_prov.h>
+#include <rdma/providers/fi_log.h>
+
+#include <fi.h>
+
+#include "bench.h"
+
+static struct fi_provider log_bench_prov = {
+	.version = FI_VERSION(1, 0),
+	.fi_version = FI_VERSION(1, 5),
+	.name = "log_bench",
+};
+
+static size_t log_bench_cnt = 1000000;
+
+#define LOG_BENCH_CHECK_FMT "thread %zu seq %zu len %5zu tag 0x%016" PRIx64 \
+			    " name '%s' rate %.3f\n"
+#define LOG_BENCH_CHECK_ARGS(thread, seq) (thread), (seq), (seq) & 0xffff, \
+	((uint64_t) (thread) << 32) | (seq), log_bench_names[(seq) % 4], \
+	(seq) / 8.0
+
+#define LOG_BENCH_CHECK_BURST 8
+
+static const char *log_bench_names[] = {
+	"ep", "", "a longer endpoint name", "x",
+};
+
+static void *log_bench_thread(void *arg)
+{
+	uint64_t tag = (uintptr_t) arg;
+	size_t i;
+
+	for (i = 0; i < log_bench_cnt; i++) {
+		FI_WARN(&log_bench_prov, FI_LOG_EP_DATA,
+			"tx ep %p len %zu tag 0x%" PRIx64 " seq %zu\n",
+			(void *) &i, i & 0xffff, tag, i);
+	}
+	return NULL;
+}
+
+static void *log_bench_check_thread(void *arg)
+{
+	size_t thread = (uintptr_t) arg;
+	size_t i;
+
+	for (i = 0; i < log_bench_cnt; i++) {
+		FI_WARN(&log_bench_prov, FI_LOG_EP_DATA, LOG_BENCH_CHECK_FMT,
+			LOG_BENCH_CHECK_ARGS(thread, i));
+
+		/* let the flusher keep up, so small rings wrap rather
+		 * than just fill */
+		if (i % LOG_BENCH_CHECK_BURST == LOG_BENCH_CHECK_BURST - 1)
+			usleep(1000);
+	}
+	return NULL;
+}
+
+/* Initialize the library, which reads the logging variables */
+static void log_bench_init(void)
+{
+	struct fi_info *info;
+
+	if (!fi_getinfo(FI_VERSION(1, 5), NULL, NULL, 0, NULL, &info))
+		fi_freeinfo(info);
+}
+
+static int log_bench_run(size_t nthreads, void *(*func)(void *))
+{
+	pthread_t *threads;
+	size_t i;
+
+	threads = calloc(nthreads, sizeof(*threads));
+	if (!threads) {
+		fprintf(stderr, "out of memory\n");
+		return -1;
+	}
+
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, func,
+				   (void *) (uintptr_t) i)) {
+			fprintf(stderr, "pthread_create failed\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+
+	free(threads);
+	return 0;
+}
+
+/*
+ * Logs from a child process, whose exit drains the asynchronous rings,
+ * then compares each line of the file with snprintf() of the same
+ * arguments.  Full rings drop new records, so each thread's lines need
+ * only be in order, with the reported drops making up the difference.
+ */
+static size_t log_bench_check(const char *file, size_t nthreads)
+{
+	char line[1024], expect[1024], *msg;
+	size_t *next, thread, seq, lines = 0, errors = 0;
+	uint64_t dropped, drops = 0;
+	unsigned int id;
+	int status;
+	pid_t pid;
+	FILE *f;
+
+	remove(file);
+	setenv("FI_LOG_FILE", file, 1);
+	setenv("FI_LOG_LEVEL", "warn", 1);
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		return 1;
+	}
+	if (!pid) {
+		log_bench_init();
+		exit(log_bench_run(nthreads, log_bench_check_thread) ?
+		     EXIT_FAILURE : EXIT_SUCCESS);
+	}
+
+	if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) ||
+	    WEXITSTATUS(status))
+		return 1;
+
+	next = calloc(nthreads, sizeof(*next));
+	f = fopen(file, "r");
+	if (!next || !f) {
+		fprintf(stderr, "cannot read %s\n", file);
+		free(next);
+		return 1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "libfabric:%u: log ring full, dropped %"
+			   SCNu64, &id, &dropped) == 2) {
+			drops += dropped;
+			continue;
+		}
+
+		/* the library logs its own warnings as well */
+		if (!strstr(line, ":log_bench:"))
+			continue;
+
+		msg = strstr(line, "<warn> ");
+		if (!msg || sscanf(msg, "<warn> thread %zu seq %zu",
+				   &thread, &seq) != 2 ||
+		    thread >= nthreads || seq < next[thread]) {
+			fprintf(stderr, "unexpected: %s", line);
+			errors++;
+			continue;
+		}
+
+		msg += strlen("<warn> ");
+		snprintf(expect, sizeof(expect), LOG_BENCH_CHECK_FMT,
+			 LOG_BENCH_CHECK_ARGS(thread, seq));
+		if (strcmp(msg, expect)) {
+			fprintf(stderr, "expected: %sgot: %s", expect, msg);
+			errors++;
+		}
+		next[thread] = seq + 1;
+		lines++;
+	}
+	fclose(f);
+	free(next);
+
+	printf("# lines %zu, dropped %" PRIu64 "\n", lines, drops);
+	if (lines + drops != nthreads * log_bench_cnt) {
+		fprintf(stderr, "%zu messages unaccounted for\n",
+			nthreads * log_bench_cnt - lines - (size_t) drops);
+		errors++;
+	}
+	return errors;
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "usage: %s [-n messages per thread] [-t threads] "
+		"[-c file]\n"
+		"\t-c  log to file and check its contents, skip throughput\n",
+		name);
+}
+
+int main(int argc, char **argv)
+{
+	char *check_file = NULL;
+	size_t nthreads = 1;
+	uint64_t start;
+	int op;
+
+	while ((op = getopt(argc, argv, "n:t:c:h")) != -1) {
+		switch (op) {
+		case 'n':
+			log_bench_cnt = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			nthreads = strtoul(optarg, NULL, 0);
+			break;
+		case 'c':
+			check_file = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (check_file)
+		return bench_errors(log_bench_check(check_file, nthreads));
+
+	log_bench_init();
+
+	bench_header();
+
+	start = fi_gettime_us();
+	if (log_bench_run(nthreads, log_bench_thread))
+		return EXIT_FAILURE;
+	bench_report("log", nthreads * log_bench_cnt,
+		     fi_gettime_us() - start);
+	return EXIT_SUCCESS;
+}
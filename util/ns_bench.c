@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2017 Intel Corporation.  All rights reserved.
+ *
+ * This software is available to you under the BSD license below:
+ *
+ *     Redistribution and use in source and binary forms, with or
+ *     without modification, are permitted provided that the following
+ *     conditions are met:
+ *
+ *      - Redistributions of source code must retain the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer.
+ *
+ *      - Redistributions in binary form must reproduce the above
+ *        copyright notice, this list of conditions and the following
+ *        disclaimer in the documentation and/or other materials
+ *        provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ * BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ * ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/*
+ * Startup benchmark for the utility name server: a local server is
+ * loaded with names which are then resolved one at a time over a
+ * persistent connection, again from the client cache, and in batches.
+ */
+
+#include <config.h>
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fi_util.h>
+
+#include "bench.h"
+
+#define NS_BENCH_NAME_LEN	16
+
+static int ns_bench_service_cmp(void *svc1, void *svc2)
+{
+	int service1 = *(int *) svc1, service2 = *(int *) svc2;
+
+	return (service1 < service2) ? -1 : (service1 > service2);
+}
+
+static void ns_bench_name(char *name, int service)
+{
+	memset(name, 0, NS_BENCH_NAME_LEN);
+	snprintf(name, NS_BENCH_NAME_LEN, "ep%d", service);
+}
+
+static int ns_bench_client(struct util_ns_attr *attr, struct util_ns *ns)
+{
+	memset(ns, 0, sizeof(*ns));
+	return ofi_ns_init(attr, ns);
+}
+
+static void usage(char *name)
+{
+	fprintf(stderr, "usage: %s [-n names] [-p port]\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	struct util_ns_attr attr = {
+		.ns_port = 12345,
+		.name_len = NS_BENCH_NAME_LEN,
+		.service_len = sizeof(int),
+		.service_cmp = ns_bench_service_cmp,
+	};
+	struct util_ns server, ns;
+	char *names, *out, expect[NS_BENCH_NAME_LEN];
+	int *services, *status;
+	size_t i, cnt = 100000, errors = 0;
+	uint64_t start;
+	void *name;
+	int op, ret;
+
+	while ((op = getopt(argc, argv, "n:p:h")) != -1) {
+		switch (op) {
+		case 'n':
+			cnt = strtoul(optarg, NULL, 0);
+			break;
+		case 'p':
+			attr.ns_port = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+
+	services = calloc(cnt, sizeof(*services));
+	status = calloc(cnt, sizeof(*status));
+	names = calloc(cnt, NS_BENCH_NAME_LEN);
+	out = calloc(cnt, NS_BENCH_NAME_LEN);
+	if (!services || !status || !names || !out) {
+		fprintf(stderr, "out of memory\n");
+		return EXIT_FAILURE;
+	}
+
+	for (i = 0; i < cnt; i++) {
+		services[i] = (int) i;
+		ns_bench_name(names + i * NS_BENCH_NAME_LEN, (int) i);
+	}
+
+	memset(&server, 0, sizeof(server));
+	ret = ofi_ns_init(&attr, &server);
+	if (ret) {
+		fprintf(stderr, "ofi_ns_init: %s\n", fi_strerror(-ret));
+		return EXIT_FAILURE;
+	}
+	ofi_ns_start_server(&server);
+
+	bench_header();
+
+	start = fi_gettime_us();
+	ret = ofi_ns_add_local_names(&server, services, names, cnt);
+	bench_report("add_batch", cnt, fi_gettime_us() - start);
+	if (ret) {
+		fprintf(stderr, "ofi_ns_add_local_names: %s\n",
+			fi_strerror(-ret));
+		return EXIT_FAILURE;
+	}
+
+	if (ns_bench_client(&attr, &ns))
+		return EXIT_FAILURE;
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		name = ofi_ns_resolve_name(&ns, "localhost", &services[i]);
+		ns_bench_name(expect, services[i]);
+		if (!name || memcmp(name, expect, NS_BENCH_NAME_LEN))
+			errors++;
+		free(name);
+	}
+	bench_report("resolve", cnt, fi_gettime_us() - start);
+
+	start = fi_gettime_us();
+	for (i = 0; i < cnt; i++) {
+		name = ofi_ns_resolve_name(&ns, "localhost", &services[i]);
+		ns_bench_name(expect, services[i]);
+		if (!name || memcmp(name, expect, NS_BENCH_NAME_LEN))
+			errors++;
+		free(name);
+	}
+	bench_report("resolve_cached", cnt, fi_gettime_us() - start);
+	ofi_ns_fini(&ns);
+
+	if (ns_bench_client(&attr, &ns))
+		return EXIT_FAILURE;
+
+	start = fi_gettime_us();
+	ret = ofi_ns_resolve_names(&ns, "localhost", services, out, status,
+				   cnt);
+	bench_report("resolve_batch", cnt, fi_gettime_us() - start);
+	if (ret != (int) cnt ||
+	    memcmp(out, names, cnt * NS_BENCH_NAME_LEN))
+		errors++;
+	ofi_ns_fini(&ns);
+
+	services[0] = (int) cnt;
+	if (ns_bench_client(&attr, &ns) ||
+	    ofi_ns_resolve_names(&ns, "localhost", services, out, status,
+				 1) != 0 || status[0] != -FI_ENOENT)
+		errors++;
+	ofi_ns_fini(&ns);
+
+	ofi_ns_stop_server(&server);
+	ofi_ns_fini(&server);
+	free(out);
+	free(names);
+	free(status);
+	free(services);
+	return bench_errors(errors);
+}
@@ -41,6 +41,7 @@
 #include <netdb.h>
 #include <poll.h>
 #include <limits.h>
+#include <pthread.h>
 
 #include <stdbool.h>
 #include <stdio.h>
@@ -60,6 +61,8 @@
 #include <rdma/fi_eq.h>
 #include <rdma/fi_errno.h>
 #include <rdma/fi_tagged.h>
+#include <rdma/fi_rma.h>
+#include <rdma/fi_atomic.h>
 
 #ifndef OFI_MR_BASIC_MAP
 #define OFI_MR_BASIC_MAP (FI_MR_ALLOCATED | FI_MR_PROV_KEY | FI_MR_VIRT_ADDR)
@@ -84,6 +87,33 @@ enum {
 	PP_OPT_VERIFY_DATA = 1 << 3,
 };
 
+enum pp_test {
+	PP_TEST_PINGPONG,
+	PP_TEST_BW,
+	PP_TEST_BIBW,
+	PP_TEST_UNEXP,
+	PP_TEST_WRITE,
+	PP_TEST_READ,
+	PP_TEST_ATOMIC,
+	PP_TEST_MAX,
+};
+
+static const char *pp_test_names[PP_TEST_MAX] = {
+	[PP_TEST_PINGPONG] = "pingpong",
+	[PP_TEST_BW] = "bw",
+	[PP_TEST_BIBW] = "bibw",
+	[PP_TEST_UNEXP] = "unexp",
+	[PP_TEST_WRITE] = "write",
+	[PP_TEST_READ] = "read",
+	[PP_TEST_ATOMIC] = "atomic",
+};
+
+enum pp_format {
+	PP_FORMAT_TEXT,
+	PP_FORMAT_CSV,
+	PP_FORMAT_JSON,
+};
+
 struct pp_opts {
 	uint16_t src_port;
 	uint16_t dst_port;
@@ -92,6 +122,18 @@ struct pp_opts {
 	int transfer_size;
 	int sizes_enabled;
 	int options;
+	enum pp_test test;
+	enum pp_format format;
+	int window;
+	int pairs;
+};
+
+struct pp_result {
+	int size;
+	int sent;
+	int acked;
+	int xfers_per_iter;
+	uint64_t start, end;
 };
 
 #define PP_SIZE_MAX_POWER_TWO 22
@@ -102,6 +144,11 @@ struct pp_opts {
 #define PP_MAX_CTRL_MSG 64
 #define PP_CTRL_BUF_LEN 64
 #define PP_MR_KEY 0xC0DE
+#define PP_KEY_LEN 32
+#define PP_ACK_SIZE 4
+#define PP_MAX_SIZES 64
+#define PP_CQ_BATCH 16
+#define PP_DEFAULT_WINDOW 64
 
 #define INTEG_SEED 7
 #define PP_ENABLE_ALL (~0)
@@ -196,6 +243,14 @@ struct ct_pingpong {
 	SOCKET ctrl_connfd;
 	char ctrl_buf[PP_CTRL_BUF_LEN + 1];
 	char rem_name[PP_MAX_CTRL_MSG];
+
+	/* streaming tests: tx contexts first, then the rx ring */
+	struct fi_context *ctx_ring;
+	uint64_t remote_addr, remote_key;
+
+	int pair_idx;
+	int result_cnt;
+	struct pp_result results[PP_MAX_SIZES];
 };
 
 static const char integ_alphabet[] =
@@ -495,13 +550,20 @@ int pp_ctrl_init(struct ct_pingpong *ct)
 
 	PP_DEBUG("Initializing control messages\n");
 
+	/* Each endpoint pair has its own control connection, on consecutive
+	 * ports starting from the selected ones.
+	 */
 	if (ct->opts.dst_addr) {
 		if (ct->opts.dst_port == 0)
 			ct->opts.dst_port = default_ctrl;
+		ct->opts.dst_port += ct->pair_idx;
+		if (ct->opts.src_port)
+			ct->opts.src_port += ct->pair_idx;
 		ret = pp_ctrl_init_client(ct);
 	} else {
 		if (ct->opts.src_port == 0)
 			ct->opts.src_port = default_ctrl;
+		ct->opts.src_port += ct->pair_idx;
 		ret = pp_ctrl_init_server(ct);
 	}
 
@@ -791,6 +853,44 @@ int pp_ctrl_txrx_msg_count(struct ct_pingpong *ct)
 	return 0;
 }
 
+int pp_ctrl_exchange_keys(struct ct_pingpong *ct)
+{
+	char buf[PP_KEY_LEN + 1];
+	uint64_t addr;
+	int ret;
+
+	PP_DEBUG("Exchanging RMA address and key\n");
+
+	addr = (ct->fi->domain_attr->mr_mode & FI_MR_VIRT_ADDR) ?
+	       (uintptr_t)ct->rx_buf : 0;
+	snprintf(buf, sizeof(buf), "%016" PRIx64 "%016" PRIx64, addr,
+		 fi_mr_key(ct->mr));
+
+	ret = pp_ctrl_send(ct, buf, PP_KEY_LEN);
+	if (ret < 0)
+		return ret;
+
+	ret = pp_ctrl_recv(ct, buf, PP_KEY_LEN);
+	if (ret < 0)
+		return ret;
+	if (ret < PP_KEY_LEN) {
+		PP_ERR("bad length of received key (len=%d/%d)", ret,
+		       PP_KEY_LEN);
+		return -EBADMSG;
+	}
+
+	buf[PP_KEY_LEN] = '\0';
+	if (sscanf(buf, "%16" SCNx64 "%16" SCNx64, &ct->remote_addr,
+		   &ct->remote_key) != 2) {
+		PP_ERR("malformed key: <%s>", buf);
+		return -EBADMSG;
+	}
+
+	PP_DEBUG("RMA address and key exchanged\n");
+
+	return 0;
+}
+
 /*******************************************************************************
  *                                         Options
  ******************************************************************************/
@@ -1057,6 +1157,80 @@ void show_perf(char *name, int tsize, int sent, int acked,
 	       bytes / (1.0 * elapsed), usec_per_xfer, 1.0 / usec_per_xfer);
 }
 
+void pp_show_result(struct ct_pingpong *ct, struct pp_result *res, int pairs)
+{
+	static int header = 1;
+	const char *test = pp_test_names[ct->opts.test];
+	uint64_t xfers = (uint64_t)res->sent * res->xfers_per_iter;
+	uint64_t bytes = xfers * res->size;
+	int64_t elapsed = MAX(res->end - res->start, 1);
+	char name[PP_STR_LEN];
+	int window;
+
+	if (ct->opts.format == PP_FORMAT_TEXT) {
+		if (pairs > 1)
+			snprintf(name, sizeof(name), "%s x%d", test, pairs);
+		else
+			snprintf(name, sizeof(name), "%s", test);
+		show_perf(ct->opts.test == PP_TEST_PINGPONG && pairs == 1 ?
+			  NULL : name, res->size, res->sent, res->acked,
+			  res->start, res->end, res->xfers_per_iter);
+		return;
+	}
+
+	if (xfers == 0)
+		return;
+
+	window = ct->opts.test == PP_TEST_PINGPONG ? 1 : ct->opts.window;
+	if (ct->opts.format == PP_FORMAT_CSV) {
+		if (header) {
+			printf("test,provider,ep_type,pairs,window,size,xfers,"
+			       "bytes,usec,mb_per_sec,usec_per_xfer,"
+			       "mxfers_per_sec\n");
+			header = 0;
+		}
+		printf("%s,%s,%s,%d,%d,%d,%" PRIu64 ",%" PRIu64 ",%" PRId64
+		       ",%.2f,%.3f,%.3f\n", test,
+		       ct->fi->fabric_attr->prov_name,
+		       fi_tostr(&ct->fi->ep_attr->type, FI_TYPE_EP_TYPE),
+		       pairs, window, res->size, xfers, bytes, elapsed,
+		       bytes / (1.0 * elapsed), (double)elapsed / xfers,
+		       xfers / (1.0 * elapsed));
+	} else {
+		printf("{\"test\": \"%s\", \"provider\": \"%s\", "
+		       "\"ep_type\": \"%s\", \"pairs\": %d, \"window\": %d, "
+		       "\"size\": %d, \"xfers\": %" PRIu64 ", "
+		       "\"bytes\": %" PRIu64 ", \"usec\": %" PRId64 ", "
+		       "\"mb_per_sec\": %.2f, \"usec_per_xfer\": %.3f, "
+		       "\"mxfers_per_sec\": %.3f}\n", test,
+		       ct->fi->fabric_attr->prov_name,
+		       fi_tostr(&ct->fi->ep_attr->type, FI_TYPE_EP_TYPE),
+		       pairs, window, res->size, xfers, bytes, elapsed,
+		       bytes / (1.0 * elapsed), (double)elapsed / xfers,
+		       xfers / (1.0 * elapsed));
+	}
+	fflush(stdout);
+}
+
+/* Results of endpoint pairs are printed together once all pairs are done. */
+void pp_report(struct ct_pingpong *ct, int size, int sent, int acked,
+	       int xfers_per_iter)
+{
+	struct pp_result res = {
+		.size = size,
+		.sent = sent,
+		.acked = acked,
+		.xfers_per_iter = xfers_per_iter,
+		.start = ct->start,
+		.end = ct->end,
+	};
+
+	if (ct->opts.pairs <= 1)
+		pp_show_result(ct, &res, 1);
+	else if (ct->result_cnt < PP_MAX_SIZES)
+		ct->results[ct->result_cnt++] = res;
+}
+
 /*******************************************************************************
  *                                      Data Messaging
  ******************************************************************************/
@@ -1081,7 +1255,7 @@ int pp_cq_readerr(struct fid_cq *cq)
 static int pp_get_cq_comp(struct fid_cq *cq, uint64_t *cur, uint64_t total,
 			  int timeout_sec)
 {
-	struct fi_cq_err_entry comp;
+	struct fi_cq_err_entry comp[PP_CQ_BATCH];
 	uint64_t a = 0, b = 0;
 	int ret = 0;
 
@@ -1089,12 +1263,14 @@ static int pp_get_cq_comp(struct fid_cq *cq, uint64_t *cur, uint64_t total,
 		a = pp_gettime_us();
 
 	while (total - *cur > 0) {
-		ret = fi_cq_read(cq, &comp, 1);
+		/* never reap completions beyond total, they belong to the
+		 * next call */
+		ret = fi_cq_read(cq, comp, MIN(total - *cur, PP_CQ_BATCH));
 		if (ret > 0) {
 			if (timeout_sec >= 0)
 				a = pp_gettime_us();
 
-			(*cur)++;
+			(*cur) += ret;
 		} else if (ret < 0 && ret != -FI_EAGAIN) {
 			if (ret == -FI_EAVAIL) {
 				ret = pp_cq_readerr(cq);
@@ -1282,6 +1458,13 @@ void init_test(struct ct_pingpong *ct, struct pp_opts *opts)
 	if (!(opts->options & PP_OPT_ITER))
 		opts->iterations = size_to_count(opts->transfer_size);
 
+	/* streaming tests count iterations in windows */
+	if (opts->test != PP_TEST_PINGPONG) {
+		if (!(opts->options & PP_OPT_ITER))
+			opts->iterations /= opts->window;
+		opts->iterations = MAX(opts->iterations, 1);
+	}
+
 	ct->cnt_ack_msg = 0;
 }
 
@@ -1297,6 +1480,7 @@ uint64_t pp_init_cq_data(struct fi_info *info)
 
 int pp_alloc_msgs(struct ct_pingpong *ct)
 {
+	uint64_t access = FI_SEND | FI_RECV;
 	int ret;
 	long alignment = 1;
 
@@ -1330,10 +1514,14 @@ int pp_alloc_msgs(struct ct_pingpong *ct)
 
 	ct->remote_cq_data = pp_init_cq_data(ct->fi);
 
-	if (ct->fi->domain_attr->mr_mode & FI_MR_LOCAL) {
-		ret = fi_mr_reg(ct->domain, ct->buf, ct->buf_size,
-				FI_SEND | FI_RECV, 0, PP_MR_KEY, 0, &(ct->mr),
-				NULL);
+	/* RMA and atomic tests target the rx buffer of the peer */
+	if (ct->fi->caps & (FI_RMA | FI_ATOMIC))
+		access |= FI_READ | FI_WRITE | FI_REMOTE_READ | FI_REMOTE_WRITE;
+
+	if ((ct->fi->domain_attr->mr_mode & FI_MR_LOCAL) ||
+	    (access & FI_REMOTE_WRITE)) {
+		ret = fi_mr_reg(ct->domain, ct->buf, ct->buf_size, access, 0,
+				PP_MR_KEY, 0, &(ct->mr), NULL);
 		if (ret) {
 			PP_PRINTERR("fi_mr_reg", ret);
 			return ret;
@@ -1342,6 +1530,13 @@ int pp_alloc_msgs(struct ct_pingpong *ct)
 		ct->mr = &(ct->no_mr);
 	}
 
+	ct->ctx_ring = calloc(3 * ct->opts.window + 2, sizeof(*ct->ctx_ring));
+	if (!ct->ctx_ring) {
+		ret = -FI_ENOMEM;
+		PP_PRINTERR("calloc", ret);
+		return ret;
+	}
+
 	return 0;
 }
 
@@ -1810,6 +2005,8 @@ void pp_free_res(struct ct_pingpong *ct)
 		ct->buf = ct->rx_buf = ct->tx_buf = NULL;
 		ct->buf_size = ct->rx_size = ct->tx_size = 0;
 	}
+	free(ct->ctx_ring);
+	ct->ctx_ring = NULL;
 	if (ct->fi_pep) {
 		fi_freeinfo(ct->fi_pep);
 		ct->fi_pep = NULL;
@@ -1920,12 +2117,23 @@ void pp_pingpong_usage(char *name, char *desc)
 	fprintf(stderr, " %-20s %s\n", "-m <transmit mode>",
 		"transmit mode type: msg|tagged (msg)");
 
+	fprintf(stderr, " %-20s %s\n", "-t <test>",
+		"test: pingpong|bw|bibw|unexp|write|read|atomic (pingpong)");
+	fprintf(stderr, " %-20s %s\n", "-W <window>",
+		"operations in flight for streaming tests (64)");
+	fprintf(stderr, " %-20s %s\n", "-T <pairs>",
+		"number of endpoint pairs, each run by a thread (1)");
+	fprintf(stderr, " %-20s %s\n", "-o <format>",
+		"output format: text|csv|json (text)");
+
 	fprintf(stderr, " %-20s %s\n", "-h", "display this help output");
 	fprintf(stderr, " %-20s %s\n", "-v", "enable debugging output");
 }
 
 void pp_parse_opts(struct ct_pingpong *ct, int op, char *optarg)
 {
+	int i;
+
 	switch (op) {
 
 	/* Domain */
@@ -1998,6 +2206,51 @@ void pp_parse_opts(struct ct_pingpong *ct, int op, char *optarg)
 		}
 		break;
 
+	/* Test */
+	case 't':
+		for (i = 0; i < PP_TEST_MAX; i++) {
+			if (!strcasecmp(pp_test_names[i], optarg))
+				break;
+		}
+		if (i == PP_TEST_MAX) {
+			fprintf(stderr, "Unknown test : %s\n", optarg);
+			exit(EXIT_FAILURE);
+		}
+		ct->opts.test = i;
+		if (i == PP_TEST_WRITE || i == PP_TEST_READ)
+			ct->hints->caps |= FI_RMA;
+		else if (i == PP_TEST_ATOMIC)
+			ct->hints->caps |= FI_ATOMIC;
+		break;
+
+	/* Window */
+	case 'W':
+		ct->opts.window = (int)parse_ulong(optarg, INT_MAX);
+		if (ct->opts.window < 1)
+			ct->opts.window = 1;
+		break;
+
+	/* Endpoint pairs */
+	case 'T':
+		ct->opts.pairs = (int)parse_ulong(optarg, INT16_MAX);
+		if (ct->opts.pairs < 1)
+			ct->opts.pairs = 1;
+		break;
+
+	/* Output format */
+	case 'o':
+		if (!strcasecmp("text", optarg)) {
+			ct->opts.format = PP_FORMAT_TEXT;
+		} else if (!strcasecmp("csv", optarg)) {
+			ct->opts.format = PP_FORMAT_CSV;
+		} else if (!strcasecmp("json", optarg)) {
+			ct->opts.format = PP_FORMAT_JSON;
+		} else {
+			fprintf(stderr, "Unknown format : %s\n", optarg);
+			exit(EXIT_FAILURE);
+		}
+		break;
+
 	/* Debug */
 	case 'v':
 		pp_debug = 1;
@@ -2061,28 +2314,388 @@ int pingpong(struct ct_pingpong *ct)
 		return ret;
 
 	PP_DEBUG("Results:\n");
-	show_perf(NULL, ct->opts.transfer_size, ct->opts.iterations,
-		  ct->cnt_ack_msg, ct->start, ct->end, 2);
+	pp_report(ct, ct->opts.transfer_size, ct->opts.iterations,
+		  ct->cnt_ack_msg, 2);
+
+	return 0;
+}
+
+/*******************************************************************************
+ *      Streaming, RMA and atomic tests
+ ******************************************************************************/
+
+/* Receives are posted and matched in order, so the contexts of the last
+ * 2 * window + 2 receives are never in use twice.
+ */
+static inline struct fi_context *pp_rx_ctx(struct ct_pingpong *ct)
+{
+	return &ct->ctx_ring[ct->opts.window +
+			     ct->rx_seq % (2 * ct->opts.window + 2)];
+}
+
+static int pp_post_rx_window(struct ct_pingpong *ct, int count)
+{
+	int i, ret;
+
+	for (i = 0; i < count; i++) {
+		ret = pp_post_rx(ct, ct->ep, ct->rx_size, pp_rx_ctx(ct));
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static int pp_post_tx_window(struct ct_pingpong *ct, int size, int count)
+{
+	int i, ret;
+
+	for (i = 0; i < count; i++) {
+		if (size < ct->fi->tx_attr->inject_size)
+			ret = pp_post_inject(ct, ct->ep, size);
+		else
+			ret = pp_post_tx(ct, ct->ep, size, &ct->ctx_ring[i]);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+/* Wait for all receives but the spare one to complete */
+static int pp_wait_rx_window(struct ct_pingpong *ct)
+{
+	return pp_get_rx_comp(ct, ct->rx_seq - 1);
+}
+
+static int pp_send_ack(struct ct_pingpong *ct)
+{
+	int ret;
+
+	ret = pp_post_tx_window(ct, PP_ACK_SIZE, 1);
+	if (ret)
+		return ret;
+
+	return pp_get_tx_comp(ct, ct->tx_seq);
+}
+
+static int pp_wait_ack(struct ct_pingpong *ct)
+{
+	int ret;
+
+	ret = pp_get_rx_comp(ct, ct->rx_cq_cntr + 1);
+	if (ret)
+		return ret;
+
+	return pp_post_rx(ct, ct->ep, ct->rx_size, pp_rx_ctx(ct));
+}
+
+/* The client streams windows of messages, the server acks each window after
+ * posting the receives of the next one.
+ */
+int pp_bw(struct ct_pingpong *ct)
+{
+	int size = ct->opts.transfer_size;
+	int window = ct->opts.window;
+	int ret, i;
+
+	if (!ct->opts.dst_addr) {
+		ret = pp_post_rx_window(ct, window);
+		if (ret)
+			return ret;
+	}
+
+	ret = pp_ctrl_sync(ct);
+	if (ret)
+		return ret;
+
+	pp_start(ct);
+	for (i = 0; i < ct->opts.iterations; i++) {
+		if (ct->opts.dst_addr) {
+			ret = pp_post_tx_window(ct, size, window);
+			if (ret)
+				return ret;
+
+			ret = pp_get_tx_comp(ct, ct->tx_seq);
+			if (ret)
+				return ret;
+
+			ret = pp_wait_ack(ct);
+		} else {
+			ret = pp_wait_rx_window(ct);
+			if (ret)
+				return ret;
+
+			if (i < ct->opts.iterations - 1) {
+				ret = pp_post_rx_window(ct, window);
+				if (ret)
+					return ret;
+			}
+
+			ret = pp_send_ack(ct);
+		}
+		if (ret)
+			return ret;
+	}
+	pp_stop(ct);
+
+	if (ct->opts.dst_addr)
+		pp_report(ct, size, ct->opts.iterations, ct->opts.iterations,
+			  window);
+	return 0;
+}
+
+/* Both sides stream windows at the same time and exchange acks */
+int pp_bibw(struct ct_pingpong *ct)
+{
+	int size = ct->opts.transfer_size;
+	int window = ct->opts.window;
+	int ret, i;
+
+	ret = pp_post_rx_window(ct, window);
+	if (ret)
+		return ret;
+
+	ret = pp_ctrl_sync(ct);
+	if (ret)
+		return ret;
+
+	pp_start(ct);
+	for (i = 0; i < ct->opts.iterations; i++) {
+		ret = pp_post_tx_window(ct, size, window);
+		if (ret)
+			return ret;
 
+		ret = pp_get_tx_comp(ct, ct->tx_seq);
+		if (ret)
+			return ret;
+
+		ret = pp_wait_rx_window(ct);
+		if (ret)
+			return ret;
+
+		if (i < ct->opts.iterations - 1) {
+			ret = pp_post_rx_window(ct, window);
+			if (ret)
+				return ret;
+		}
+
+		ret = pp_send_ack(ct);
+		if (ret)
+			return ret;
+
+		ret = pp_wait_ack(ct);
+		if (ret)
+			return ret;
+	}
+	pp_stop(ct);
+
+	if (ct->opts.dst_addr)
+		pp_report(ct, size, ct->opts.iterations, ct->opts.iterations,
+			  2 * window);
+	return 0;
+}
+
+/* The server sends a window of messages before the client posts the
+ * receives for them. Only the time the client spends matching them is
+ * measured.
+ */
+int pp_unexp(struct ct_pingpong *ct)
+{
+	int size = ct->opts.transfer_size;
+	int window = ct->opts.window;
+	uint64_t elapsed = 0, start;
+	int ret, i;
+
+	ret = pp_ctrl_sync(ct);
+	if (ret)
+		return ret;
+
+	for (i = 0; i < ct->opts.iterations; i++) {
+		if (ct->opts.dst_addr) {
+			ret = pp_ctrl_sync(ct);
+			if (ret)
+				return ret;
+
+			start = pp_gettime_us();
+			ret = pp_post_rx_window(ct, window);
+			if (ret)
+				return ret;
+
+			ret = pp_wait_rx_window(ct);
+			if (ret)
+				return ret;
+			elapsed += pp_gettime_us() - start;
+
+			ret = pp_send_ack(ct);
+		} else {
+			ret = pp_post_tx_window(ct, size, window);
+			if (ret)
+				return ret;
+
+			ret = pp_ctrl_sync(ct);
+			if (ret)
+				return ret;
+
+			ret = pp_get_tx_comp(ct, ct->tx_seq);
+			if (ret)
+				return ret;
+
+			ret = pp_wait_ack(ct);
+		}
+		if (ret)
+			return ret;
+	}
+
+	if (ct->opts.dst_addr) {
+		ct->start = 0;
+		ct->end = elapsed;
+		pp_report(ct, size, ct->opts.iterations, ct->opts.iterations,
+			  window);
+	}
+	return 0;
+}
+
+static int pp_is_rma_test(struct ct_pingpong *ct)
+{
+	return ct->opts.test == PP_TEST_WRITE ||
+	       ct->opts.test == PP_TEST_READ ||
+	       ct->opts.test == PP_TEST_ATOMIC;
+}
+
+/* Atomics use 64 bit integers, sizes that are not a multiple are skipped */
+static int pp_size_valid(struct ct_pingpong *ct, int size)
+{
+	size_t count;
+
+	if (ct->opts.test != PP_TEST_ATOMIC)
+		return 1;
+
+	if (size < sizeof(uint64_t) || size % sizeof(uint64_t))
+		return 0;
+
+	if (fi_fetch_atomicvalid(ct->ep, FI_UINT64, FI_SUM, &count))
+		return 0;
+
+	return size / sizeof(uint64_t) <= count;
+}
+
+ssize_t pp_post_rma(struct ct_pingpong *ct, size_t size,
+		    struct fi_context *ctx)
+{
+	switch (ct->opts.test) {
+	case PP_TEST_READ:
+		PP_POST(fi_read, pp_get_tx_comp, ct->tx_seq, "fi_read",
+			ct->ep, ct->tx_buf, size, fi_mr_desc(ct->mr),
+			ct->remote_fi_addr, ct->remote_addr, ct->remote_key,
+			ctx);
+		break;
+	case PP_TEST_ATOMIC:
+		PP_POST(fi_fetch_atomic, pp_get_tx_comp, ct->tx_seq,
+			"fi_fetch_atomic", ct->ep, ct->tx_buf,
+			size / sizeof(uint64_t), fi_mr_desc(ct->mr),
+			ct->rx_buf, fi_mr_desc(ct->mr), ct->remote_fi_addr,
+			ct->remote_addr, ct->remote_key, FI_UINT64, FI_SUM,
+			ctx);
+		break;
+	default:
+		PP_POST(fi_write, pp_get_tx_comp, ct->tx_seq, "fi_write",
+			ct->ep, ct->tx_buf, size, fi_mr_desc(ct->mr),
+			ct->remote_fi_addr, ct->remote_addr, ct->remote_key,
+			ctx);
+		break;
+	}
+	return 0;
+}
+
+/* The client issues windows of RMA or atomic operations targeting the rx
+ * buffer of the server, which only drives progress until it gets an ack.
+ */
+int pp_rma(struct ct_pingpong *ct)
+{
+	int size = ct->opts.transfer_size;
+	int window = ct->opts.window;
+	int ret, i, j;
+
+	ret = pp_ctrl_sync(ct);
+	if (ret)
+		return ret;
+
+	if (!ct->opts.dst_addr)
+		return pp_wait_ack(ct);
+
+	pp_start(ct);
+	for (i = 0; i < ct->opts.iterations; i++) {
+		for (j = 0; j < window; j++) {
+			ret = pp_post_rma(ct, size, &ct->ctx_ring[j]);
+			if (ret)
+				return ret;
+		}
+
+		ret = pp_get_tx_comp(ct, ct->tx_seq);
+		if (ret)
+			return ret;
+	}
+	pp_stop(ct);
+
+	ret = pp_send_ack(ct);
+	if (ret)
+		return ret;
+
+	pp_report(ct, size, ct->opts.iterations, ct->opts.iterations, window);
 	return 0;
 }
 
+int pp_run_test(struct ct_pingpong *ct)
+{
+	switch (ct->opts.test) {
+	case PP_TEST_BW:
+		return pp_bw(ct);
+	case PP_TEST_BIBW:
+		return pp_bibw(ct);
+	case PP_TEST_UNEXP:
+		return pp_unexp(ct);
+	case PP_TEST_WRITE:
+	case PP_TEST_READ:
+	case PP_TEST_ATOMIC:
+		return pp_rma(ct);
+	default:
+		return pingpong(ct);
+	}
+}
+
 int run_suite_pingpong(struct ct_pingpong *ct)
 {
 	int i, sizes_cnt;
 	int ret = 0;
 	int *sizes = NULL;
 
+	size_t queue_size;
+
 	pp_banner_fabric_info(ct);
 
+	/* Keep a window, the spare receive and an ack within the queues */
+	queue_size = MIN(ct->fi->tx_attr->size, ct->fi->rx_attr->size);
+	if (queue_size > 2 && ct->opts.window > queue_size - 2) {
+		ct->opts.window = queue_size - 2;
+		PP_DEBUG("Window limited to %d\n", ct->opts.window);
+	}
+
+	if (pp_is_rma_test(ct)) {
+		ret = pp_ctrl_exchange_keys(ct);
+		if (ret)
+			return ret;
+	}
+
 	sizes_cnt = generate_test_sizes(&ct->opts, ct->tx_size, &sizes);
 
 	PP_DEBUG("Count of sizes to test: %d\n", sizes_cnt);
 
 	for (i = 0; i < sizes_cnt; i++) {
+		if (!pp_size_valid(ct, sizes[i]))
+			continue;
+
 		ct->opts.transfer_size = sizes[i];
 		init_test(ct, &(ct->opts));
-		ret = pingpong(ct);
+		ret = pp_run_test(ct);
 		if (ret)
 			goto out;
 	}
@@ -2169,6 +2782,102 @@ out:
 	return ret;
 }
 
+static int pp_run(struct ct_pingpong *ct)
+{
+	switch (ct->hints->ep_attr->type) {
+	case FI_EP_DGRAM:
+		if (ct->opts.options & PP_OPT_SIZE)
+			ct->hints->ep_attr->max_msg_size =
+				ct->opts.transfer_size;
+		return run_pingpong_dgram(ct);
+	case FI_EP_RDM:
+		return run_pingpong_rdm(ct);
+	case FI_EP_MSG:
+		return run_pingpong_msg(ct);
+	default:
+		fprintf(stderr, "Endpoint unsupported: %d\n",
+			ct->hints->ep_attr->type);
+		return EXIT_FAILURE;
+	}
+}
+
+static void *pp_run_pair(void *arg)
+{
+	return (void *)(intptr_t)pp_run(arg);
+}
+
+/* Sums the results of all pairs over the time from the first start to the
+ * last end.
+ */
+static void pp_show_pairs(struct ct_pingpong *pairs, int cnt)
+{
+	struct pp_result res;
+	int i, j, result_cnt = PP_MAX_SIZES;
+
+	for (i = 0; i < cnt; i++)
+		result_cnt = MIN(result_cnt, pairs[i].result_cnt);
+
+	for (j = 0; j < result_cnt; j++) {
+		res = pairs[0].results[j];
+		for (i = 1; i < cnt; i++) {
+			res.sent += pairs[i].results[j].sent;
+			res.acked += pairs[i].results[j].acked;
+			res.start = MIN(res.start, pairs[i].results[j].start);
+			res.end = MAX(res.end, pairs[i].results[j].end);
+		}
+		pp_show_result(&pairs[0], &res, cnt);
+	}
+}
+
+static int pp_run_pairs(struct ct_pingpong *ct)
+{
+	struct ct_pingpong *pairs;
+	pthread_t *threads;
+	void *thread_ret;
+	int i, cnt, ret = 0;
+
+	pairs = calloc(ct->opts.pairs, sizeof(*pairs));
+	threads = calloc(ct->opts.pairs, sizeof(*threads));
+	if (!pairs || !threads) {
+		ret = -FI_ENOMEM;
+		goto out;
+	}
+
+	for (cnt = 0; cnt < ct->opts.pairs; cnt++) {
+		pairs[cnt] = *ct;
+		pairs[cnt].pair_idx = cnt;
+		pairs[cnt].hints = fi_dupinfo(ct->hints);
+		if (!pairs[cnt].hints) {
+			ret = -FI_ENOMEM;
+			break;
+		}
+
+		ret = -pthread_create(&threads[cnt], NULL, pp_run_pair,
+				      &pairs[cnt]);
+		if (ret) {
+			PP_PRINTERR("pthread_create", ret);
+			fi_freeinfo(pairs[cnt].hints);
+			break;
+		}
+	}
+
+	for (i = 0; i < cnt; i++) {
+		pthread_join(threads[i], &thread_ret);
+		if (!ret)
+			ret = (int)(intptr_t)thread_ret;
+	}
+
+	if (!ret)
+		pp_show_pairs(pairs, cnt);
+
+	for (i = 0; i < cnt; i++)
+		pp_free_res(&pairs[i]);
+out:
+	free(threads);
+	free(pairs);
+	return ret;
+}
+
 int main(int argc, char **argv)
 {
 	int op, ret = EXIT_SUCCESS;
@@ -2178,7 +2887,9 @@ int main(int argc, char **argv)
 		.opts = {
 			.iterations = 1000,
 			.transfer_size = 1024,
-			.sizes_enabled = PP_DEFAULT_SIZE
+			.sizes_enabled = PP_DEFAULT_SIZE,
+			.window = PP_DEFAULT_WINDOW,
+			.pairs = 1,
 		},
 		.eq_attr.wait_obj = FI_WAIT_UNSPEC,
 	};
@@ -2193,7 +2904,7 @@ int main(int argc, char **argv)
 
 	ofi_osd_init();
 
-	while ((op = getopt(argc, argv, "hvd:p:e:I:S:B:P:cm:")) != -1) {
+	while ((op = getopt(argc, argv, "hvd:p:e:I:S:B:P:cm:t:W:T:o:")) != -1) {
 		switch (op) {
 		default:
 			pp_parse_opts(&ct, op, optarg);
@@ -2211,24 +2922,25 @@ int main(int argc, char **argv)
 
 	pp_banner_options(&ct);
 
-	switch (ct.hints->ep_attr->type) {
-	case FI_EP_DGRAM:
-		if (ct.opts.options & PP_OPT_SIZE)
-			ct.hints->ep_attr->max_msg_size = ct.opts.transfer_size;
-		ret = run_pingpong_dgram(&ct);
-		break;
-	case FI_EP_RDM:
-		ret = run_pingpong_rdm(&ct);
-		break;
-	case FI_EP_MSG:
-		ret = run_pingpong_msg(&ct);
-		break;
-	default:
-		fprintf(stderr, "Endpoint unsupported: %d\n",
-			ct.hints->ep_attr->type);
-		ret = EXIT_FAILURE;
+	if (ct.opts.test == PP_TEST_UNEXP &&
+	    ct.hints->ep_attr->type == FI_EP_DGRAM) {
+		fprintf(stderr, "The unexp test needs a reliable endpoint\n");
+		pp_free_res(&ct);
+		return EXIT_FAILURE;
 	}
 
+	/* data verification state is shared by all pairs */
+	if (ct.opts.pairs > 1 && (ct.opts.options & PP_OPT_VERIFY_DATA)) {
+		fprintf(stderr, "Data checks need a single endpoint pair\n");
+		pp_free_res(&ct);
+		return EXIT_FAILURE;
+	}
+
+	if (ct.opts.pairs > 1)
+		ret = pp_run_pairs(&ct);
+	else
+		ret = pp_run(&ct);
+
 	pp_free_res(&ct);
 	return -ret;
 }